@@ -65,6 +65,20 @@ struct vertex_data {
   vertex_data(float value = 1) : value(value), self_weight(0) { }
 }; // End of vertex data
 
+/**
+ * The update function only reads the value of the neighboring
+ * vertices so we declare it as a hot field.  The graph then keeps the
+ * values in a separate dense array which is much smaller than the
+ * vertex data.
+ */
+namespace graphlab {
+  template<> struct hot_data_traits<vertex_data> {
+    BOOST_STATIC_CONSTANT(bool, enabled = true);
+    typedef float hot_type;
+    static hot_type get(const vertex_data& vdata) { return vdata.value; }
+  };
+}
+
 
 
 //! The type of graph used in this program
@@ -116,10 +130,9 @@ void pagerank_update(gl_types::iscope &scope,
   float sum = vdata.value * vdata.self_weight;
   
   foreach(graphlab::edge_id_t eid, scope.in_edge_ids()) {
-    // Get the neighobr vertex value
-    const vertex_data& neighbor_vdata =
-      scope.const_neighbor_vertex_data(scope.source(eid));
-    double neighbor_value = neighbor_vdata.value;
+    // Get the neighobr vertex value from the hot data array
+    double neighbor_value = 
+      scope.const_neighbor_vertex_hot_data(scope.source(eid));
     
     // Get the edge data for the neighbor
     edge_data& edata = scope.edge_data(eid);
@@ -33,6 +33,7 @@
 #include <graphlab/schedulers/ischeduler.hpp>
 #include <graphlab/scope/iscope.hpp>
 #include <graphlab/graph/graph.hpp>
+#include <graphlab/graph/graph_reordering.hpp>
 #include <graphlab/core_base.hpp>
 
 
@@ -309,6 +310,25 @@ namespace graphlab {
     }
 
 
+    /**
+     * \brief Renumber the vertices of the graph to improve locality.
+     *
+     * This must be called after the graph is constructed but before
+     * any tasks are added.  It will destroy the current engine.  See
+     * graph_reordering for the available methods ("rcm", "degree",
+     * "bfs" and "metis").
+     *
+     * \return A vector mapping old vertex ids to new vertex ids
+     */
+    std::vector<vertex_id_type> reorder_graph(const std::string& method) {
+      check_engine_modification();
+      destroy_engine();
+      std::vector<vertex_id_type> perm;
+      graph_reordering::reorder(method, mgraph, perm);
+      mgraph.permute_vertices(perm);
+      return perm;
+    }
+
     /**
      * \brief Run the engine until a termination condition is reached or
      * there are no more tasks remaining to execute.
@@ -445,6 +465,24 @@ namespace graphlab {
                         sync_interval, merge, rangelow, rangehigh);
       
     }
+
+    /**
+     * \brief Registers a sync which is maintained incrementally by
+     * the update threads.  See iengine::set_incremental_sync().
+     */
+    void set_incremental_sync(glshared_base& shared,
+                              typename types::iengine::sync_function_type sync,
+                              typename types::iengine::sync_function_type unsync,
+                              glshared_base::apply_function_type apply,
+                              const any& zero,
+                              size_t sync_interval,
+                              typename types::iengine::merge_function_type merge,
+                              vertex_id_type rangelow = 0,
+                              vertex_id_type rangehigh = -1) { 
+      engine_has_been_modified = true;
+      engine().set_incremental_sync(shared, sync, unsync, apply, zero, 
+                                    sync_interval, merge, rangelow, rangehigh);
+    }
     
 
     /**
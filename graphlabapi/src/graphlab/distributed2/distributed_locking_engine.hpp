@@ -48,6 +48,7 @@
 
 #include <graphlab/rpc/dc.hpp>
 #include <graphlab/rpc/async_consensus.hpp>
+#include <graphlab/rpc/call_aggregator.hpp>
 #include <graphlab/distributed2/distributed_glshared_manager.hpp>
 #include <graphlab/distributed2/graph/dgraph_scope.hpp>
 #include <graphlab/distributed2/graph/graph_lock.hpp>
@@ -261,6 +262,10 @@ class distributed_locking_engine:public iengine<Graph> {
   std::string make_log;
   async_consensus consensus;
   
+  /// Batches add_task calls to vertices owned by other machines
+  call_aggregator<update_task_type, double, 
+                  typename update_task_type::hash_functor> remote_tasks;
+  
   struct sync_task {
     sync_function_type sync_fun;
     merge_function_type merge_fun;
@@ -343,6 +348,10 @@ class distributed_locking_engine:public iengine<Graph> {
                             max_deferred_tasks(1000),
                             barrier_time(0.0),
                             consensus(dc, ncpus),
+                            remote_tasks(dc, 
+                                         boost::bind(&distributed_locking_engine::add_task, 
+                                                     this, _1, _2),
+                                         max_priority),
                             scheduler(this, graph, std::max(ncpus, size_t(1))),
                             graphlock(NULL),
                             chandy_misra(0),
@@ -490,13 +499,16 @@ class distributed_locking_engine:public iengine<Graph> {
       }
     }
     else {
-      rmi.remote_call(graph.globalvid_to_owner(task.vertex()),
-                      &distributed_locking_engine<Graph, Scheduler>::add_task,
-                      task,
-                      priority);
+      // sent in batches. Repeated tasks keep the highest priority.
+      remote_tasks.call(graph.globalvid_to_owner(task.vertex()), task, priority);
     }
   }
 
+  /// Combines the priorities of a task added several times
+  static void max_priority(double& priority, const double& other) {
+    priority = std::max(priority, other);
+  }
+
   /**
    * \brief Creates a collection of tasks on all the vertices in
    * 'vertices', and all with the same update function and priority
@@ -1092,6 +1104,8 @@ class distributed_locking_engine:public iengine<Graph> {
                    sched_status::status_enum& stat, 
                    update_task_type &task) {
     threads_alive.dec();
+    // tasks still waiting in the aggregator are not seen by the consensus
+    remote_tasks.flush();
     consensus.begin_done_critical_section();
     stat = scheduler.get_next_task(threadid, task);
     if (stat == sched_status::EMPTY) {
@@ -1337,6 +1351,7 @@ class distributed_locking_engine:public iengine<Graph> {
     }
     logstream(LOG_INFO) << "max_deferred = " << max_deferred_tasks << std::endl; 
     logstream(LOG_INFO) << "priority_degree_limit = " << priority_degree_limit << std::endl;
+    remote_tasks.flush();
     rmi.dc().full_barrier();
     // reset indices
     ti.start();
@@ -37,18 +37,22 @@
 #include <cmath>
 #include <cassert>
 #include <algorithm>
+#include <sys/resource.h>
 #include <boost/bind.hpp>
 
 #include <graphlab/parallel/pthread_tools.hpp>
 #include <graphlab/parallel/atomic.hpp>
 #include <graphlab/util/timer.hpp>
+#include <graphlab/util/cycle_histogram.hpp>
 #include <graphlab/util/random.hpp>
 #include <graphlab/util/mutable_queue.hpp>
 #include <graphlab/util/counting_queue.hpp>
 
 #include <graphlab/graph/graph.hpp>
 #include <graphlab/scope/iscope.hpp>
+#include <graphlab/scope/vertex_lock_table.hpp>
 #include <graphlab/engine/iengine.hpp>
+#include <graphlab/engine/task_trace.hpp>
 #include <graphlab/tasks/update_task.hpp>
 #include <graphlab/logger/logger.hpp>
 #include <graphlab/monitoring/imonitor.hpp>
@@ -57,6 +61,19 @@
 #include <graphlab/metrics/metrics.hpp>
 
 #include <graphlab/macros_def.hpp>
+
+/**
+ * Compiling with GRAPHLAB_ENGINE_PROFILE defined makes every worker
+ * of the asynchronous engine time its scheduler calls, scope
+ * acquisitions, updates, commits and idle periods with rdtsc().
+ * Otherwise the probes compile to nothing.
+ */
+#ifdef GRAPHLAB_ENGINE_PROFILE
+#define ENGINE_PROBE(x) x
+#else
+#define ENGINE_PROBE(x)
+#endif
+
 namespace graphlab {
 
   
@@ -74,6 +91,7 @@ namespace graphlab {
     using base::release_scheduler_and_scope_manager;
     using base::get_scheduler;
     using base::get_scope_manager;
+    using base::set_scheduler_numa;
     
 
     typedef iengine<Graph> iengine_base;
@@ -156,6 +174,45 @@ namespace graphlab {
 
     /** Use schedule yielding when waiting on the scheduler*/
     bool use_sched_yield;
+
+    /** Pin workers and place the graph by NUMA node */
+    bool use_numa;
+
+    /** The assignment of workers and vertices to NUMA nodes */
+    numa_map numa;
+
+    /** The maximum number of tasks taken from the scheduler at once */
+    size_t batch_size;
+
+    /** Skip the neighbor locks of vertices the scheduler isolates */
+    bool use_chromatic;
+
+    /** The scope acquired for those vertices */
+    scope_range::scope_range_enum chromatic_scope_range;
+
+    /** The vertex lock implementation used by the scope factory */
+    vertex_lock_table::lock_type_enum lock_type;
+
+    /** The number of vertex lock stripes (0 = one lock per vertex) */
+    size_t lock_stripes;
+
+    /** The file the executed tasks are written to (empty = none) */
+    std::string trace_file;
+
+    /** The trace run instead of the scheduler (empty = none) */
+    std::string replay_file;
+
+    /** Seeds the random generator of worker i with seed + i (0 = off) */
+    size_t random_seed;
+
+    /** Whether the workers record or replay trace */
+    bool tracing, replaying;
+
+    /** The recorded or replayed tasks */
+    task_trace<Graph> trace;
+
+    /** The position of each worker in the replayed trace */
+    std::vector<size_t> replay_pos;
     
     /** set to 1 if the processor is in the midst of asking scheduler for stuff
      *  and running an update */
@@ -164,6 +221,31 @@ namespace graphlab {
     
     /** Track the number of updates */
     std::vector<size_t> update_counts;
+
+    /** Track the number of updates on vertices of another NUMA node */
+    std::vector<size_t> remote_update_counts;
+
+    /** The seconds each cpu spent without a task to run */
+    std::vector<double> idle_times;
+
+    /** Measures the time since the worker threads were started */
+    timer run_timer;
+
+    /** When the first worker noticed termination (0 = not yet) */
+    volatile double termination_time;
+
+#ifdef GRAPHLAB_ENGINE_PROFILE
+    /** The rdtsc() histograms of one worker */
+    struct worker_profile {
+      cycle_histogram scheduler;  ///< get_next_task(s) calls
+      cycle_histogram scope;      ///< acquiring the scope locks
+      cycle_histogram update;     ///< running the update function
+      cycle_histogram commit;     ///< committing and releasing the scope
+      cycle_histogram idle;       ///< periods without tasks
+      char pad[64];
+    };
+    std::vector<worker_profile> profiles;
+#endif
     
     /** track an approximation to the number of updates. This 
         is only updated every (APX_INTERVAL+1) updates per thread.
@@ -217,6 +299,8 @@ namespace graphlab {
 
     struct sync_task {
       sync_function_type sync_fun;
+      /// Removes a vertex from the accumulator. Only incremental syncs
+      sync_function_type unsync_fun;
       merge_function_type merge_fun;
       glshared_base::apply_function_type apply_fun;
       size_t sync_interval;
@@ -226,8 +310,10 @@ namespace graphlab {
       vertex_id_type rangelow;
       vertex_id_type rangehigh;
       glshared_base *sharedvariable;
+      /// The accumulated value of an incremental sync
+      any total;
       sync_task() :
-        sync_fun(NULL), merge_fun(NULL), apply_fun(NULL),
+        sync_fun(NULL), unsync_fun(NULL), merge_fun(NULL), apply_fun(NULL),
         sync_interval(-1),
         next_time(0), rangelow(0), 
         rangehigh(vertex_id_type(-1)), sharedvariable(NULL) { }
@@ -239,6 +325,17 @@ namespace graphlab {
     /// A map from the shared variable to the sync task
     std::map<glshared_base*, size_t> var2synctask;
 
+    /// The ids of the incremental sync tasks
+    std::vector<size_t> incremental_syncs;
+
+    /// The per cpu partial accumulators of the incremental syncs,
+    /// indexed by cpu and sync id
+    std::vector<std::vector<any> > sync_deltas;
+    std::vector<spinlock> sync_delta_locks;
+
+    /// Evaluate syncs without locking the vertex ranges
+    bool approximate_syncs;
+
     /// Sync Tasks ordered by the negative of the next update time. (it is a max-heap)
     mutable_queue<size_t, int> sync_task_queue;
     std::pair<size_t, int> sync_task_queue_head;
@@ -260,6 +357,8 @@ namespace graphlab {
     
     mutex sync_now_lock;
     conditional sync_now_cond;
+    /// The number of syncs handed to the syncers and completed by them
+    size_t sync_enqueued_counts;
     size_t sync_now_counts;
     
   public:
@@ -279,8 +378,23 @@ namespace graphlab {
       ncpus( std::max(ncpus, size_t(1)) ),
       use_cpu_affinity(false),
       use_sched_yield(true),
+      use_numa(false),
+      batch_size(1),
+      use_chromatic(false),
+      chromatic_scope_range(scope_range::NULL_CONSISTENCY),
+      lock_type(vertex_lock_table::PTHREAD_LOCKS),
+      lock_stripes(0),
+      random_seed(0),
+      tracing(false),
+      replaying(false),
       proc_in_update(std::max(ncpus, size_t(1))),
       update_counts(std::max(ncpus, size_t(1)), 0),
+      remote_update_counts(std::max(ncpus, size_t(1)), 0),
+      idle_times(std::max(ncpus, size_t(1)), 0),
+      termination_time(0),
+#ifdef GRAPHLAB_ENGINE_PROFILE
+      profiles(std::max(ncpus, size_t(1))),
+#endif
       monitor(NULL),
       start_time_millis(lowres_time_millis()),
       timeout_millis(0),
@@ -293,8 +407,11 @@ namespace graphlab {
       default_scope_range(scope_range::EDGE_CONSISTENCY),
       sync_barrier(ncpus),
       sync_accumulators(ncpus),
+      sync_delta_locks(ncpus),
+      approximate_syncs(false),
       task_exec_queue(ncpus),
       engine_metrics("engine"),
+      sync_enqueued_counts(0),
       sync_now_counts(0){
       
       syncers.resize(ncpus);
@@ -337,9 +454,61 @@ namespace graphlab {
       use_cpu_affinity = value;
     }
 
-    void set_engine_options(const scheduler_options& opts) { }
+    void set_engine_options(const scheduler_options& opts) {
+      opts.get_int_option("numa", use_numa);
+      set_scheduler_numa(use_numa);
+      opts.get_int_option("batch", batch_size);
+      batch_size = std::max(batch_size, size_t(1));
+      opts.get_int_option("chromatic", use_chromatic);
+      std::string lock_name;
+      if(opts.get_string_option("locks", lock_name) &&
+         !vertex_lock_table::parse_lock_type(lock_name, lock_type)) {
+        logstream(LOG_WARNING) << "Unknown lock type " << lock_name 
+                               << ". Using pthread locks." << std::endl;
+        lock_type = vertex_lock_table::PTHREAD_LOCKS;
+      }
+      opts.get_int_option("lock_stripes", lock_stripes);
+      opts.get_string_option("trace", trace_file);
+      opts.get_string_option("replay", replay_file);
+      opts.get_int_option("seed", random_seed);
+      std::string sync_mode;
+      if(opts.get_string_option("sync_mode", sync_mode)) {
+        if(sync_mode != "locked" && sync_mode != "approximate") {
+          logstream(LOG_WARNING) << "Unknown sync mode " << sync_mode 
+                                 << ". Using locked syncs." << std::endl;
+        }
+        approximate_syncs = (sync_mode == "approximate");
+      }
+    }
     
-    static void print_options_help(std::ostream& out) { }
+    static void print_options_help(std::ostream& out) {
+      out << "numa = [integer, default = 0]. If set the workers are pinned "
+          << "to the cpus of each NUMA node, the graph is placed on the "
+          << "nodes and the scheduler prefers local tasks\n";
+      out << "batch = [integer, default = 1]. Number of tasks each worker "
+          << "takes from the scheduler and runs back to back\n";
+      out << "chromatic = [integer, default = 0]. If set the neighbors of "
+          << "a vertex are not locked when the scheduler runs one color "
+          << "at a time (see the chromatic scheduler)\n";
+      out << "locks = [pthread | compact, default = pthread]. The vertex "
+          << "locks. compact uses 4 byte spinning reader/writer locks\n";
+      out << "lock_stripes = [integer, default = 0]. If set, blocks of "
+          << "consecutive vertices share this many locks instead of one "
+          << "lock per vertex\n";
+      out << "sync_mode = [locked | approximate, default = locked]. "
+          << "Locked syncs freeze all updates while they scan the graph. "
+          << "Approximate syncs only lock one vertex at a time and may "
+          << "observe updates made during the scan\n";
+      out << "trace = [file name]. Writes the vertex and update function "
+          << "of every task each worker runs to the file\n";
+      out << "replay = [file name]. Each worker runs the tasks of a trace "
+          << "written by this binary in the recorded order instead of "
+          << "asking the scheduler. Tasks added by the updates are "
+          << "ignored. Workers beyond ncpus are folded onto the first "
+          << "ncpus workers, so replaying with one cpu is deterministic\n";
+      out << "seed = [integer, default = 0]. If set, the random number "
+          << "generator of worker i is seeded with seed + i\n";
+    }
 
 
     /**
@@ -362,6 +531,7 @@ namespace graphlab {
       ScopeFactory* scope_manager = get_scope_manager();
 
       scope_manager->set_default_scope(default_scope_range);
+      scope_manager->set_lock_table(lock_type, lock_stripes);
       
       // std::cout << "Scheduler Options:\n";
       // std::cout << sched_options();
@@ -373,16 +543,34 @@ namespace graphlab {
        */
       // Prepare the graph
       graph.finalize();      
+      if(use_numa) {
+        numa = numa_map(ncpus, graph.num_vertices());
+        if(!graph.numa_bind(numa)) {
+          logstream(LOG_WARNING) 
+            << "Unable to place the graph on the NUMA nodes" << std::endl;
+        }
+      }
+      if(use_chromatic) {
+        chromatic_scope_range = 
+          get_chromatic_scope_range(default_scope_range);
+      }
       // Clear the update counts
       
       for (size_t i = 0;i < proc_in_update.size(); ++i) proc_in_update[i].val = 0;
 
       std::fill(update_counts.begin(), update_counts.end(), 0);
+      std::fill(remote_update_counts.begin(), remote_update_counts.end(), 0);
+      std::fill(idle_times.begin(), idle_times.end(), 0);
+      prepare_trace();
+#ifdef GRAPHLAB_ENGINE_PROFILE
+      profiles.assign(ncpus, worker_profile());
+#endif
       apx_update_counts.value = 0;
       numsyncs.value = 0;
       // Reset timers
       start_time_millis = lowres_time_millis();
       last_check_millis = 0;
+      init_incremental_syncs();
       // Reset active flag
       active = true;  
       // Reset the last exec status 
@@ -395,11 +583,27 @@ namespace graphlab {
       // evaluate all syncs
       scheduler->start();
       
+      const double cpu_time_start = process_cpu_time();
+      termination_time = 0;
+      run_timer.start();
       run_threaded(scheduler, scope_manager);
+      const double run_time = run_timer.current_time();
+      const double cpu_time = process_cpu_time() - cpu_time_start;
 
-      // complete sync of all variables
+      // complete sync of all variables.  The incremental syncs
+      // are exact once all updates are folded in.
       for (size_t i = 0;i < sync_tasks.size(); ++i) {
-        sync_now(*sync_tasks[i].sharedvariable);
+        if (sync_tasks[i].unsync_fun != NULL) apply_incremental_sync(i);
+        else sync_now(*sync_tasks[i].sharedvariable);
+      }
+      // do not release the scopes under a sync started while running
+      sync_now_lock.lock();
+      const size_t pending_syncs = sync_enqueued_counts;
+      sync_now_lock.unlock();
+      wait_for_syncs(pending_syncs);
+      if (tracing && !trace.save(trace_file)) {
+        logstream(LOG_WARNING) << "Unable to write the task trace to "
+                               << trace_file << std::endl;
       }
       scheduler_metrics = scheduler->get_metrics();
       release_scheduler_and_scope_manager();
@@ -412,14 +616,39 @@ namespace graphlab {
                            (double)update_counts[i], INTEGER);
         engine_metrics.add_vector_entry("updatecount_vector", i, (double)update_counts[i]);
       }
+      if(use_numa) {
+        engine_metrics.set_integer("numa_nodes", numa.num_nodes());
+        for(size_t i = 0; i < update_counts.size(); ++i) {
+          const size_t node = numa.worker_node(i);
+          engine_metrics.add_vector_entry("numa_node_updates", node,
+                                          (double)update_counts[i]);
+          engine_metrics.add_vector_entry("numa_node_remote_updates", node,
+                                          (double)remote_update_counts[i]);
+        }
+      }
       engine_metrics.add("runtime",
                          ((double)lowres_time_millis()-(double)start_time_millis)*0.001, TIME);
+      // Metrics: idle behavior.  cpu_time is the user and system
+      // time of the process while the workers ran and
+      // termination_latency the time from the first worker noticing
+      // termination until all workers exited
+      for(size_t i = 0; i < idle_times.size(); ++i) 
+        engine_metrics.add("idle_time", idle_times[i], TIME);
+      engine_metrics.add("cpu_time", cpu_time, TIME);
+      if (termination_time > 0) 
+        engine_metrics.add("termination_latency", 
+                           run_time - termination_time, TIME);
       engine_metrics.set("termination_reason", 
                          exec_status_as_string(termination_reason));
+#ifdef GRAPHLAB_ENGINE_PROFILE
+      report_profiles();
+#endif
 
       engine_metrics.set_integer("num_vertices", graph.num_vertices());
       engine_metrics.set_integer("num_edges", graph.num_edges());
       engine_metrics.set_integer("num_syncs", numsyncs.value);
+      if (tracing || replaying)
+        engine_metrics.set_integer("trace_tasks", trace.size());
       
       // ok. if death was due to an exception, rethrow
       if (termination_reason == EXEC_EXCEPTION) {
@@ -433,6 +662,7 @@ namespace graphlab {
      */
     void stop() {
       termination_reason = EXEC_FORCED_ABORT;
+      note_termination();
       active = false;
     }
     
@@ -584,30 +814,39 @@ namespace graphlab {
       }
     }
 
+    /**
+     * \brief Registers a sync which is maintained incrementally by
+     * the update threads.  See iengine::set_incremental_sync().
+     */
+    void set_incremental_sync(glshared_base& shared,
+                              sync_function_type sync,
+                              sync_function_type unsync,
+                              glshared_base::apply_function_type apply,
+                              const any& zero,
+                              size_t sync_interval,
+                              merge_function_type merge,
+                              vertex_id_type rangelow = 0,
+                              vertex_id_type rangehigh = -1) {
+      ASSERT_TRUE(unsync != NULL);
+      ASSERT_MSG(merge != NULL, 
+                 "Incremental syncs require a merge function");
+      set_sync(shared, sync, apply, zero, sync_interval, merge, 
+               rangelow, rangehigh);
+      sync_tasks.back().unsync_fun = unsync;
+    }
+
     /**
      * Performs a sync immediately. This function requires that the shared
      * variable already be registered with the engine.
      * and that the engine is not currently running. 
-     * \todo This sync currently does not evaluate in parallel. 
+     * The sync is evaluated in parallel if it has a merge function.
      */
     void sync_now(glshared_base& shared) {
       ASSERT_FALSE(active);
       // makes sure the sync registration exists
       std::map<glshared_base*, size_t>::iterator iter = var2synctask.find(&shared);
       ASSERT_TRUE(iter != var2synctask.end());
-      sync_now_lock.lock();
-      size_t cur_sync_now_value = sync_now_counts;
-      sync_now_lock.unlock();
-      
-      task_exec_queue.enqueue(iter->second);
-      task_exec_queue.broadcast();
-      // wait for completion
-      sync_now_lock.lock();
-      while (sync_now_counts == cur_sync_now_value) {
-        sync_now_cond.wait(sync_now_lock);
-      }
-      sync_now_lock.unlock();
-      
+      wait_for_syncs(enqueue_sync(iter->second));
     }
     
 
@@ -651,7 +890,10 @@ namespace graphlab {
         // Start the worker thread using the thread group with cpu
         // affinity attached (CPU affinity currently only supported in
         // linux) since Mac affinity is set through the NX frameworks
-        if(use_cpu_affinity)  {
+        if(use_numa) {
+          threads.launch(boost::bind(&engine_thread::run, &(workers[i])), 
+                         numa.worker_cpu(i));
+        } else if(use_cpu_affinity)  {
           threads.launch(boost::bind(&engine_thread::run, &(workers[i])), i);
         } else {
           threads.launch(boost::bind(&engine_thread::run, &(workers[i])));
@@ -814,6 +1056,92 @@ namespace graphlab {
 
     
 
+    /**
+     * Returns the scope used in chromatic mode for a vertex whose
+     * neighbors are not updated concurrently.  Only the center
+     * vertex lock is kept, and only if syncs are registered since
+     * they lock vertex ranges.  Full consistency writes to the
+     * neighbors, which may be updated by another vertex of the same
+     * color, so it always keeps its locks.
+     */
+    scope_range::scope_range_enum 
+    get_chromatic_scope_range(scope_range::scope_range_enum range) const {
+      if(range == scope_range::FULL_CONSISTENCY) {
+        logstream(LOG_WARNING) 
+          << "Chromatic mode does not support the full scope, "
+          << "vertices are locked as usual" << std::endl;
+        return range;
+      }
+      if(sync_tasks.empty()) return scope_range::NULL_CONSISTENCY;
+      switch(central_vertex_lock_type(range)) {
+      case scope_range::READ_LOCK: return scope_range::VERTEX_READ_CONSISTENCY;
+      case scope_range::WRITE_LOCK: return scope_range::VERTEX_CONSISTENCY;
+      default: return scope_range::NULL_CONSISTENCY;
+      }
+    } // end of get_chromatic_scope_range
+
+    /**
+     * Fills task_block with the next tasks for cpuid and returns the
+     * number of tasks obtained.  Without batching this is a single
+     * call to get_next_task.
+     */
+    size_t next_tasks(size_t cpuid, Scheduler* scheduler,
+                      std::vector<update_task_type>& task_block) {
+      if (replaying) return next_replay_tasks(cpuid, task_block);
+      if (task_block.size() == 1) {
+        return scheduler->get_next_task(cpuid, task_block[0]) == 
+          sched_status::NEWTASK;
+      }
+      return scheduler->get_next_tasks(cpuid, &(task_block[0]), 
+                                       task_block.size());
+    }
+
+    /** Fills task_block with the next tasks of cpuid in the trace */
+    size_t next_replay_tasks(size_t cpuid,
+                             std::vector<update_task_type>& task_block) {
+      const std::vector<task_trace_entry>& tasks = trace.tasks(cpuid);
+      size_t ntasks = 0;
+      while(ntasks < task_block.size() && replay_pos[cpuid] < tasks.size()) {
+        const task_trace_entry& entry = tasks[replay_pos[cpuid]++];
+        task_block[ntasks++] = 
+          update_task_type(entry.vertex, trace.function(entry));
+      }
+      return ntasks;
+    }
+
+    /** 
+     * Loads the trace to replay or clears the trace to record,
+     * depending on the trace and replay options.
+     */
+    void prepare_trace() {
+      replaying = false;
+      tracing = false;
+      if (!replay_file.empty()) {
+        replaying = trace.load(replay_file);
+        if (!replaying) {
+          logstream(LOG_WARNING) << "Unable to read the task trace "
+                                 << replay_file << std::endl;
+        } else {
+          if (trace.vertex_bound() > graph.num_vertices()) {
+            logstream(LOG_FATAL) << "The task trace " << replay_file 
+                                 << " runs vertex " << trace.vertex_bound() - 1
+                                 << " but the graph has " 
+                                 << graph.num_vertices() << " vertices" 
+                                 << std::endl;
+          }
+          trace.fold(ncpus);
+          replay_pos.assign(ncpus, 0);
+        }
+        if (!trace_file.empty()) {
+          logstream(LOG_WARNING) << "Not recording a trace while "
+                                 << "replaying one" << std::endl;
+        }
+      } else if (!trace_file.empty()) {
+        tracing = true;
+        trace.clear(ncpus);
+      }
+    }
+
     /** runs the engine to termination. 
      * \note Do not use for simulated engine
     */
@@ -822,8 +1150,12 @@ namespace graphlab {
                   ScopeFactory* scope_manager) {
       // Loop until we get a task for recieve a termination signal
       size_t ctr = 0;
-      size_t updcount = 0;
       bool isempty = false;
+      std::vector<update_task_type> task_block(batch_size);
+      // the time this cpu ran out of tasks, negative while busy
+      double idle_start = -1;
+      ENGINE_PROBE(unsigned long long idle_probe = 0);
+      if (random_seed > 0) random::get_source().seed(random_seed + cpuid);
       while(active) {
         if (__builtin_expect(ctr == 0 || isempty, 0)) {
           if (cpuid == 0) { 
@@ -837,6 +1169,7 @@ namespace graphlab {
           if (last_check_millis < timemillis || isempty) {
             last_check_millis = timemillis;
             if (satisfies_termination_condition()) {
+              note_termination();
               active = false;
               break;
             }
@@ -853,23 +1186,36 @@ namespace graphlab {
         --ctr;
 
         /**
-         * Get and execute the next task from the scheduler.
+         * Get and execute the next block of tasks from the scheduler.
          */
         proc_in_update[cpuid].val = 1;
         
-        update_task_type task;
-        sched_status::status_enum stat = scheduler->get_next_task(cpuid, task);
+        ENGINE_PROBE(unsigned long long probe = rdtsc());
+        size_t ntasks = next_tasks(cpuid, scheduler, task_block);
+        ENGINE_PROBE(probe = profiles[cpuid].scheduler.lap(probe));
         
-        if (stat == sched_status::EMPTY) {
+        if (ntasks == 0 && replaying) {
+          // this worker has run its part of the trace
+          proc_in_update[cpuid].val = 0;
+          break;
+        }
+        if (ntasks == 0) {
           isempty = true;
           // check the schedule terminator
           scheduler->get_terminator().begin_critical_section(cpuid);
-          stat = scheduler->get_next_task(cpuid, task);
-          if (stat == sched_status::NEWTASK) {
+          ntasks = next_tasks(cpuid, scheduler, task_block);
+          ENGINE_PROBE(probe = profiles[cpuid].scheduler.lap(probe));
+          if (ntasks > 0) {
             scheduler->get_terminator().cancel_critical_section(cpuid);
           }
           else {
+            if (idle_start < 0) {
+              idle_start = run_timer.current_time();
+              ENGINE_PROBE(idle_probe = probe);
+            }
+            // the terminator may back off or park the cpu here
             if (scheduler->get_terminator().end_critical_section(cpuid)) {
+              note_termination();
               active = false;
             }
             else {
@@ -878,41 +1224,73 @@ namespace graphlab {
           }
         }
         
-        if (stat == sched_status::NEWTASK) {
+        if (ntasks > 0) {
           isempty = false;
-          // If the status is new task than we must execute the task
-          const vertex_id_type vertex = task.vertex();
-          assert(vertex < graph.num_vertices());
-          assert(task.function() != NULL);
-
-          // Lock the vertex to ensure that no other processor tries
-          // to take it build a scope
-          iscope_type* scope = scope_manager->get_scope(cpuid, vertex);
-          assert(scope != NULL);                    
+          if (idle_start >= 0) {
+            idle_times[cpuid] += run_timer.current_time() - idle_start;
+            idle_start = -1;
+            ENGINE_PROBE(profiles[cpuid].idle.add(probe - idle_probe));
+          }
           // get the callback for this cpu
           typename Scheduler::callback_type& scallback = 
                                       scheduler->get_callback(cpuid);
-          // execute the task
-          
-          task.function()(*scope, scallback);
-          // Commit any changes to the scope
-          scope->commit();
-          // Release the scope
-          scope_manager->release_scope(scope);
-          //logger(LOG_DEBUG  , "Worker %d released lock on %d.\n", cpuid, vertex);        
+          for(size_t i = 0; i < ntasks; ++i) {
+            const update_task_type& task = task_block[i];
+            const vertex_id_type vertex = task.vertex();
+            assert(vertex < graph.num_vertices());
+            assert(task.function() != NULL);
+            // Start loading the next vertex while this one runs
+            if (i + 1 < ntasks) 
+              graph.prefetch_vertex(task_block[i + 1].vertex());
+
+            // Lock the vertex to ensure that no other processor tries
+            // to take it build a scope
+            ENGINE_PROBE(probe = rdtsc());
+            iscope_type* scope = 
+              (use_chromatic && scheduler->exclusive_neighborhood(vertex)) ?
+              scope_manager->get_scope(cpuid, vertex, chromatic_scope_range) :
+              scope_manager->get_scope(cpuid, vertex);
+            assert(scope != NULL);                    
+            ENGINE_PROBE(probe = profiles[cpuid].scope.lap(probe));
+            // execute the task
+            if (!incremental_syncs.empty()) 
+              fold_incremental_syncs(cpuid, *scope, true);
+            task.function()(*scope, scallback);
+            if (!incremental_syncs.empty()) 
+              fold_incremental_syncs(cpuid, *scope, false);
+            ENGINE_PROBE(probe = profiles[cpuid].update.lap(probe));
+            // Commit any changes to the scope
+            scope->commit();
+            // Release the scope
+            scope_manager->release_scope(scope);
+            ENGINE_PROBE(profiles[cpuid].commit.lap(probe));
+            if(use_numa && numa.vertex_node(vertex) != numa.worker_node(cpuid))
+              remote_update_counts[cpuid]++;
+            if (tracing) trace.record(cpuid, vertex, task.function());
+          }
 
-          // Mark the task as completed in the scheduler
-          scheduler->completed_task(cpuid, task);
-          // record the successful execution of the task
-          if ((updcount & APX_INTERVAL) == APX_INTERVAL) {
-            apx_update_counts.inc(APX_INTERVAL + 1);
+          // Mark the tasks as completed in the scheduler. Replayed
+          // tasks did not come from the scheduler.
+          if (!replaying) {
+            if (ntasks == 1) scheduler->completed_task(cpuid, task_block[0]);
+            else scheduler->completed_tasks(cpuid, &(task_block[0]), ntasks);
           }
-          update_counts[cpuid]++;
+          // record the successful execution of the tasks. The
+          // approximate count grows by APX_INTERVAL + 1 each time
+          // the count of this cpu crosses a multiple of it.
+          const size_t updcount = update_counts[cpuid];
+          update_counts[cpuid] += ntasks;
+          const size_t crossed = (update_counts[cpuid] & ~APX_INTERVAL) - 
+            (updcount & ~APX_INTERVAL);
+          if (crossed > 0) apx_update_counts.inc(crossed);
         } 
         
         proc_in_update[cpuid].val = 0;
       } // end of while(true)
-      //update_counts[cpuid] += updcount;
+      if (idle_start >= 0) {
+        idle_times[cpuid] += run_timer.current_time() - idle_start;
+        ENGINE_PROBE(profiles[cpuid].idle.lap(idle_probe));
+      }
       // loop until all processors are either
       // 1: here. or 
       // 2: waiting inside the evaluate_sync_queue function
@@ -920,11 +1298,59 @@ namespace graphlab {
       while(numpinupdate > 0) {
         numpinupdate = 0;
         for (size_t i = 0;i < proc_in_update.size(); ++i) {
-          numpinupdate += proc_in_update[cpuid].val;
+          numpinupdate += proc_in_update[i].val;
         }
-        sched_yield();
+        if (numpinupdate > 0) sched_yield();
       }
     }
+
+#ifdef GRAPHLAB_ENGINE_PROFILE
+    /**
+     * Adds the merged worker histograms to the engine metrics, in
+     * seconds, together with the per cpu totals.
+     */
+    void report_profiles() {
+      const double tps = rdtsc_ticks_per_second();
+      const char* names[] = {"profile_scheduler", "profile_scope", 
+                             "profile_update", "profile_commit", 
+                             "profile_idle"};
+      for(size_t h = 0; h < 5; ++h) {
+        cycle_histogram merged;
+        for(size_t i = 0; i < profiles.size(); ++i) {
+          const cycle_histogram& hist = profile_histogram(profiles[i], h);
+          merged.merge(hist);
+          engine_metrics.add_vector_entry(std::string(names[h]) + 
+                                          "_vector", i, hist.total() / tps);
+        }
+        merged.report(engine_metrics, names[h], tps);
+      }
+      engine_metrics.set("profile_ticks_per_second", tps);
+    }
+
+    static const cycle_histogram& 
+    profile_histogram(const worker_profile& prof, size_t h) {
+      switch(h) {
+      case 0: return prof.scheduler;
+      case 1: return prof.scope;
+      case 2: return prof.update;
+      case 3: return prof.commit;
+      default: return prof.idle;
+      }
+    }
+#endif
+
+    /** Records the time the first worker noticed termination */
+    void note_termination() {
+      if (termination_time == 0) termination_time = run_timer.current_time();
+    }
+
+    /** The user and system time consumed by the process in seconds */
+    static double process_cpu_time() {
+      struct rusage usage;
+      getrusage(RUSAGE_SELF, &usage);
+      return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + 
+        1e-6 * (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec);
+    }
     
     void construct_sync_queue() {
       sync_task_queue.clear();
@@ -946,43 +1372,46 @@ namespace graphlab {
 
 
     void sync_loop(size_t cpuid) {
-      size_t syncid = 0;
       while(true) {
         // Block until the update threads signal the sync condition.
         std::pair<size_t, bool> syncid_succ = task_exec_queue.poll_till_pop();
         if (syncid_succ.second == false) return;
+        const size_t syncid = syncid_succ.first;
 
         ScopeFactory* scope_manager = get_scope_manager();
-        // Each syncer tries to acquire its share of the graph.
-        size_t numv = graph.num_vertices();
-        size_t v_per_cpu = 1+ (numv-1)/(ncpus);
-        size_t v_start = v_per_cpu * cpuid;
-        size_t v_end = std::min(numv-1, v_start + v_per_cpu-1);
-        scope_manager->acquire_range_lock(v_start, v_end);
-
+        // The first syncer locks the graph in vertex order, which is
+        // the order used by the update threads.  Locking one range
+        // per syncer before the barrier deadlocks when an update
+        // holds a vertex of one range and waits on another range.
+        // Approximate syncs lock each vertex as they read it instead.
+        const size_t numv = graph.num_vertices();
+        const bool lock_graph = !approximate_syncs && cpuid == 0 && numv > 0;
+        if (lock_graph) scope_manager->acquire_range_lock(0, numv - 1);
         
         sync_barrier.wait();
         
-
+        // returns on the first syncer once all syncers are done
         parallel_evaluate_sync(syncid, scope_manager, cpuid);
 
-
-        scope_manager->release_range_lock(v_start, v_end);
+        if (lock_graph) scope_manager->release_range_lock(0, numv - 1);
         // engine is not active. This is a sync now
-        if (cpuid == 0 && active == false) {
+        if (cpuid == 0) {
           sync_now_lock.lock();
           sync_now_counts++;
-          sync_now_cond.signal();
+          sync_now_cond.broadcast();
           sync_now_lock.unlock();
         }
       }
     }
 
 
-    // Assumptions: The all syncer threads have got the lock of the entire graph.
+    // Assumptions: The all syncer threads have got the lock of the
+    // entire graph, unless the syncs are approximate.
     void parallel_evaluate_sync(size_t syncid, 
                                  ScopeFactory* scope_manager,
                                  size_t cpuid) {
+        const scope_range::scope_range_enum sync_range = approximate_syncs ?
+          scope_range::VERTEX_READ_CONSISTENCY : scope_range::NULL_CONSISTENCY;
         if (sync_tasks[syncid].merge_fun != NULL) {
         // Threaded engine and we have a merge function 
         // we can do a parallel reduction
@@ -1009,7 +1438,7 @@ namespace graphlab {
         accumulator = sync.zero;
         for (vertex_id_type i = v_mymin; i < v_mymax; ++i) {
           iscope_type* scope = scope_manager->get_scope(ncpus+cpuid, i, 
-                                          scope_range::NULL_CONSISTENCY);
+                                                        sync_range);
           sync.sync_fun(*scope, accumulator);
           scope->commit();
           scope_manager->release_scope(scope);
@@ -1025,6 +1454,7 @@ namespace graphlab {
           for (size_t i = 1; i < sync_accumulators.size(); ++i) {
             sync.merge_fun(mergeresult, sync_accumulators[i]);
           }
+          if (sync.unsync_fun != NULL) reset_incremental_sync(syncid, mergeresult);
           sync.sharedvariable->apply(sync.apply_fun, accumulator);
         }
       } else {
@@ -1041,8 +1471,9 @@ namespace graphlab {
           //accumulate through all the vertices
           any accumulator = sync.zero;
           for (vertex_id_type i = vmin; i <= vmax; ++i) {
-            iscope_type* scope = scope_manager->get_scope(cpuid, i,
-                                          scope_range::NULL_CONSISTENCY);
+            iscope_type* scope = scope_manager->get_scope(ncpus+cpuid, i,
+                                                          sync_range);
+            sync.sync_fun(*scope, accumulator);
             scope->commit();
             scope_manager->release_scope(scope);
           }
@@ -1060,6 +1491,97 @@ namespace graphlab {
       }
     }
     
+    /**
+     * Hands a sync to the syncer threads and returns the number of
+     * syncs which must complete before this one has.
+     */
+    size_t enqueue_sync(size_t syncid) {
+      sync_now_lock.lock();
+      task_exec_queue.enqueue(syncid);
+      const size_t ticket = ++sync_enqueued_counts;
+      sync_now_lock.unlock();
+      task_exec_queue.broadcast();
+      return ticket;
+    }
+
+    /** Blocks until ticket syncs have been completed */
+    void wait_for_syncs(size_t ticket) {
+      sync_now_lock.lock();
+      while (sync_now_counts < ticket) {
+        sync_now_cond.wait(sync_now_lock);
+      }
+      sync_now_lock.unlock();
+    }
+
+    /**
+     * Sizes the partial accumulators of the incremental syncs and
+     * evaluates them once over the whole graph.  Must be called while
+     * the engine is not active.
+     */
+    void init_incremental_syncs() {
+      incremental_syncs.clear();
+      sync_deltas.assign(ncpus, std::vector<any>(sync_tasks.size()));
+      for (size_t i = 0; i < sync_tasks.size(); ++i) {
+        if (sync_tasks[i].unsync_fun == NULL) continue;
+        incremental_syncs.push_back(i);
+        sync_now(*sync_tasks[i].sharedvariable);
+      }
+      if (!incremental_syncs.empty() && 
+          default_scope_range == scope_range::FULL_CONSISTENCY) {
+        logstream(LOG_WARNING) 
+          << "Incremental syncs do not observe the changes to the neighbors "
+          << "made under the full scope" << std::endl;
+      }
+    }
+
+    /**
+     * Sets the value of an incremental sync after a full evaluation
+     * and clears its partial accumulators.
+     */
+    void reset_incremental_sync(size_t syncid, const any& total) {
+      sync_task& sync = sync_tasks[syncid];
+      sync.total = total;
+      for (size_t i = 0; i < sync_deltas.size(); ++i) {
+        sync_delta_locks[i].lock();
+        sync_deltas[i][syncid] = sync.zero;
+        sync_delta_locks[i].unlock();
+      }
+    }
+
+    /**
+     * Merges the partial accumulators of an incremental sync into its
+     * value and applies it to the shared variable.
+     */
+    void apply_incremental_sync(size_t syncid) {
+      sync_task& sync = sync_tasks[syncid];
+      numsyncs.inc();
+      for (size_t i = 0; i < sync_deltas.size(); ++i) {
+        sync_delta_locks[i].lock();
+        sync.merge_fun(sync.total, sync_deltas[i][syncid]);
+        sync_deltas[i][syncid] = sync.zero;
+        sync_delta_locks[i].unlock();
+      }
+      any accumulator = sync.total;
+      sync.sharedvariable->apply(sync.apply_fun, accumulator);
+    }
+
+    /**
+     * Adds the contribution of the vertex of the scope to the partial
+     * accumulators of cpuid, or removes it if unfold is set.
+     */
+    void fold_incremental_syncs(size_t cpuid, iscope_type& scope, 
+                                bool unfold) {
+      const vertex_id_type vertex = scope.vertex();
+      sync_delta_locks[cpuid].lock();
+      foreach(size_t syncid, incremental_syncs) {
+        sync_task& sync = sync_tasks[syncid];
+        if (vertex < sync.rangelow || vertex > sync.rangehigh) continue;
+        if (unfold) sync.unsync_fun(scope, sync_deltas[cpuid][syncid]);
+        else sync.sync_fun(scope, sync_deltas[cpuid][syncid]);
+      }
+      sync_delta_locks[cpuid].unlock();
+    }
+
     // evaluate the sync queue. Loop through at most max_sync times.
     // Should only be called by cpu0.
     void evaluate_sync_queue(ScopeFactory* scope_manager,
@@ -1093,9 +1615,14 @@ namespace graphlab {
         sync_task_queue_head = sync_task_queue.pop();
 
         // go for it. Evaluate the extracted task
-        // Put the syncid into the exec task queue, and signal waiting syncers.
-        task_exec_queue.enqueue(sync_task_queue_head.first);
-        task_exec_queue.broadcast();
+        if (sync_tasks[sync_task_queue_head.first].unsync_fun != NULL) {
+          // incremental syncs only merge the partial accumulators
+          apply_incremental_sync(sync_task_queue_head.first);
+        } else {
+          // Put the syncid into the exec task queue, and signal
+          // waiting syncers.
+          enqueue_sync(sync_task_queue_head.first);
+        }
         // put it back if the interval is postive
         if (sync_tasks[sync_task_queue_head.first].sync_interval > 0) {
           int next_time((int)(approximate_last_update_count() + 
@@ -1117,6 +1644,7 @@ namespace graphlab {
   
 
 }; // end of namespace graphlab
+#undef ENGINE_PROBE
 #include <graphlab/macros_undef.hpp>
 
 #endif
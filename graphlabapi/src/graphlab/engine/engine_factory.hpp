@@ -32,6 +32,7 @@
 // The engines
 #include <graphlab/engine/iengine.hpp>
 #include <graphlab/engine/asynchronous_engine.hpp>
+#include <graphlab/engine/synchronous_engine.hpp>
 #include <graphlab/engine/engine_options.hpp>
 
 
@@ -61,6 +62,9 @@ namespace graphlab {
       if(engine == "async") {
         typedef asynchronous_engine<Graph, Scheduler, ScopeFactory> engine_type;
         return new engine_type(_graph, ncpus);
+      } else if(engine == "sync") {
+        // The synchronous engine has no scheduler or scope factory
+        return new synchronous_engine<Graph>(_graph, ncpus);
       } else {
         std::cout << "Invalid engine type: " << engine
                   << std::endl;
@@ -147,6 +151,8 @@ namespace graphlab {
       if(eng != NULL) {
         // Should we merge instead?
         eng->set_scheduler_options( eopts.get_scheduler_options() );
+        eng->set_cpu_affinities( eopts.get_cpu_affinities() );
+        eng->set_sched_yield( eopts.get_sched_yield() );
       }
       return eng;
 #undef __GENERATE_NEW_ENGINE__ 
@@ -163,7 +169,7 @@ namespace graphlab {
      * Allocate an engine given the strings for the engine type, scope
      * factory, and scheduler.
      *
-     * \param engine  Type of engine to construct. {async, synchronous}
+     * \param engine  Type of engine to construct. {async, sync}
      * \param scope    Type of scope to use.  {none, vertex, edge, full}
      * \param scheduler Type of scheduler to use synchronous, fifo, priority, sampling,
      *                 sweep, multiqueue_fifo, multiqueue_priority,
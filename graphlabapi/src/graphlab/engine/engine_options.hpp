@@ -43,7 +43,7 @@ namespace graphlab {
    engine. </li>
 
    <li> std::string engine_type: The type of engine to use.  Currently
-   we support {async,  synchronous}. </li>
+   we support {async, sync}. </li>
 
    <li> std::string scope_type: The type of locking protocol (scope)
    to use. Currently we support {none, vertex, edge, full}. </li>
@@ -62,7 +62,7 @@ namespace graphlab {
   public:
     //! The number of cpus
     size_t ncpus;
-    //! The type of engine {async,  synchronous}
+    //! The type of engine {async, sync}
     std::string engine_type;
     scheduler_options engine_opts;
     
@@ -349,6 +349,36 @@ namespace graphlab {
                           vertex_id_type rangelow = 0,
                           vertex_id_type rangehigh = -1) = 0;
 
+    /**
+     * \brief Registers a sync which is maintained incrementally.
+     *
+     * Behaves like set_sync() except that engines supporting it do
+     * not rescan the graph while running.  Each update thread keeps a
+     * partial accumulator: before an update function runs, unsync
+     * removes the contribution of the vertex from it and afterwards
+     * sync adds the new contribution back.  The partial accumulators
+     * are merged into the shared variable every sync_interval
+     * updates.
+     *
+     * unsync must undo sync, both may only read the data of the
+     * center vertex, and merge must not be NULL.  The result is not
+     * exact with the full scope since updates may then change the
+     * neighbors as well.  Engines without incremental syncs register
+     * an ordinary sync.
+     */
+    virtual void set_incremental_sync(glshared_base& shared,
+                                      sync_function_type sync,
+                                      sync_function_type unsync,
+                                      glshared_base::apply_function_type apply,
+                                      const any& zero,
+                                      size_t sync_interval,
+                                      merge_function_type merge,
+                                      vertex_id_type rangelow = 0,
+                                      vertex_id_type rangehigh = -1) {
+      set_sync(shared, sync, apply, zero, sync_interval, merge,
+               rangelow, rangehigh);
+    }
+
     /**
      * Performs a sync immediately. This function requires that the shared
      * variable already be registered with the engine.
@@ -62,6 +62,9 @@ namespace graphlab {
 
     /// lazy deletion.
     bool deletionmark; // = has_engine_run
+
+    /// If set the scheduler is given a numa_map
+    bool use_numa;
   
     scheduler_options schedopts;
 
@@ -97,6 +100,9 @@ namespace graphlab {
       if (scheduler == NULL && scope_manager == NULL) {
         scheduler = new Scheduler(this, graph, std::max(ncpus, size_t(1)));
         scheduler->set_options(schedopts);
+        if(use_numa) 
+          scheduler->set_numa_map(numa_map(std::max(ncpus, size_t(1)), 
+                                           graph.num_vertices()));
         scope_manager = new ScopeFactory(graph, std::max(ncpus, size_t(1)));
         update_graph_tracker();
       }
@@ -152,6 +158,17 @@ namespace graphlab {
       // lazy deletion
       deletionmark = true;
     }
+
+    /** Enable or disable the numa_map given to the scheduler */
+    void set_scheduler_numa(bool value) {
+      use_numa = value;
+      if(scheduler != NULL) {
+        scheduler->set_numa_map(use_numa? 
+                                numa_map(std::max(ncpus, size_t(1)), 
+                                         graph.num_vertices()) :
+                                numa_map());
+      }
+    }
   
   public:
   
@@ -162,7 +179,8 @@ namespace graphlab {
       ncpus(ncpus),
       scope_manager(NULL),
       scheduler(NULL),
-      deletionmark(false) {
+      deletionmark(false),
+      use_numa(false) {
       update_graph_tracker();
     }
 
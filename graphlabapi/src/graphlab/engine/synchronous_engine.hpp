@@ -0,0 +1,672 @@
+/**  
+ * Copyright (c) 2009 Carnegie Mellon University. 
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+
+#ifndef GRAPHLAB_SYNCHRONOUS_ENGINE_HPP
+#define GRAPHLAB_SYNCHRONOUS_ENGINE_HPP
+
+#include <cassert>
+#include <algorithm>
+#include <map>
+#include <boost/bind.hpp>
+
+#include <graphlab/parallel/pthread_tools.hpp>
+#include <graphlab/parallel/atomic.hpp>
+#include <graphlab/util/timer.hpp>
+#include <graphlab/util/dense_bitset.hpp>
+
+#include <graphlab/graph/graph.hpp>
+#include <graphlab/scope/iscope.hpp>
+#include <graphlab/scope/double_buffered_scope.hpp>
+#include <graphlab/schedulers/icallback.hpp>
+#include <graphlab/engine/iengine.hpp>
+#include <graphlab/tasks/update_task.hpp>
+#include <graphlab/logger/logger.hpp>
+#include <graphlab/monitoring/imonitor.hpp>
+#include <graphlab/shared_data/glshared.hpp>
+#include <graphlab/metrics/metrics.hpp>
+
+#include <graphlab/macros_def.hpp>
+namespace graphlab {
+
+  
+  /**
+   * A bulk synchronous engine.  Execution proceeds in supersteps.
+   * In each superstep every active vertex is updated once, in
+   * parallel and without locks.  Update functions see the data of
+   * their neighbors as it was at the end of the previous superstep
+   * (see double_buffered_scope).  Tasks added during a superstep
+   * activate the vertex for the next superstep.  The engine
+   * terminates when a superstep activates no vertex.
+   *
+   * The active vertices are kept in two bitmaps, one for the
+   * current and one for the next superstep.  Priorities are ignored
+   * and if several update functions are scheduled on the same
+   * vertex in one superstep only one of them is run.  The scheduler
+   * and scope type are not used.
+   */
+  template<typename Graph>
+  class synchronous_engine : public iengine<Graph> {
+  public:
+    typedef iengine<Graph> iengine_base;
+    typedef typename iengine_base::vertex_id_type vertex_id_type;
+    typedef typename iengine_base::update_task_type update_task_type;
+    typedef typename iengine_base::update_function_type update_function_type;
+    typedef typename iengine_base::imonitor_type imonitor_type;
+    typedef typename iengine_base::termination_function_type termination_function_type;
+    typedef typename iengine_base::iscope_type iscope_type;
+    typedef typename iengine_base::sync_function_type sync_function_type;
+    typedef typename iengine_base::merge_function_type merge_function_type;
+
+    typedef typename Graph::edge_id_type edge_id_type;
+    typedef typename Graph::vertex_data_type vertex_data_type;
+    typedef double_buffered_scope<Graph> scope_type;
+
+    /** 
+     * The callback given to the update functions.  New tasks
+     * activate the vertex in the next superstep.
+     */
+    class superstep_callback : public icallback<Graph> {
+      synchronous_engine* engine;
+    public:
+      superstep_callback(synchronous_engine* engine) : engine(engine) { }
+      void add_task(update_task_type task, double priority) {
+        engine->schedule(task.vertex(), task.function());
+      }
+      void add_tasks(const std::vector<vertex_id_type>& vertices, 
+                     update_function_type func, double priority) {
+        foreach(vertex_id_type vertex, vertices) engine->schedule(vertex, func);
+      }
+      void force_abort() { engine->stop(); }
+    }; // end of superstep_callback
+
+  private:
+
+    /** Vertices are handed to the workers in chunks of this size */
+    static const size_t CHUNK_SIZE = 4096;
+
+    /** The graph that this engine is executing */
+    Graph& graph;
+    
+    /** Number of cpus to use */
+    size_t ncpus; 
+
+    /** Use processor affinities */
+    bool use_cpu_affinity;
+
+    /** Stop after this many supersteps. 0 means no limit */
+    size_t max_iterations;
+
+    /** The vertex data at the end of the previous superstep */
+    std::vector<vertex_data_type> previous;
+
+    /** The vertices active in the current and in the next superstep */
+    dense_bitset active_bits[2];
+    /** The update function scheduled on each active vertex */
+    std::vector<update_function_type> active_functions[2];
+    /** Which of the two bitmaps is the current superstep */
+    size_t current;
+    /** Number of vertices activated for the next superstep */
+    atomic<size_t> num_next_active;
+    /** Number of vertices active in the current superstep */
+    size_t num_active;
+
+    /** The next chunk of vertices to execute and to commit */
+    atomic<size_t> next_exec_chunk;
+    atomic<size_t> next_commit_chunk;
+
+    superstep_callback callback;
+    barrier superstep_barrier;
+
+    /** Track the number of updates */
+    std::vector<size_t> update_counts;
+    size_t num_supersteps;
+    size_t numsyncs;
+
+    imonitor_type* monitor;
+    size_t start_time_millis;
+    size_t timeout_millis;
+    size_t task_budget;
+    std::vector<termination_function_type> term_functions;
+
+    /** Set while the workers should run another superstep */
+    bool active;
+    /** Set until the first superstep begins */
+    bool first_superstep;
+    /** Set by stop() */
+    bool abort_requested;
+    const char* exception_message;
+    exec_status termination_reason;
+    /** Protects exception_message and termination_reason while running */
+    mutex exception_lock;
+
+    struct sync_task {
+      sync_function_type sync_fun;
+      merge_function_type merge_fun;
+      glshared_base::apply_function_type apply_fun;
+      size_t sync_interval;
+      size_t last_update_count;
+      any zero;
+      vertex_id_type rangelow;
+      vertex_id_type rangehigh;
+      glshared_base *sharedvariable;
+      sync_task() :
+        sync_fun(NULL), merge_fun(NULL), apply_fun(NULL),
+        sync_interval(0), last_update_count(0), rangelow(0), 
+        rangehigh(vertex_id_type(-1)), sharedvariable(NULL) { }
+    };
+    
+    /// A list of all registered sync tasks
+    std::vector<sync_task> sync_tasks;
+    /// A map from the shared variable to the sync task
+    std::map<glshared_base*, size_t> var2synctask;
+    /// The syncs to run before the next superstep
+    std::vector<size_t> pending_syncs;
+    std::vector<any> sync_accumulators;
+
+    metrics engine_metrics;
+
+  public:
+
+    synchronous_engine(Graph& graph, size_t ncpus = 1) :
+      graph(graph),
+      ncpus( std::max(ncpus, size_t(1)) ),
+      use_cpu_affinity(false),
+      max_iterations(0),
+      current(0),
+      num_next_active(0),
+      num_active(0),
+      callback(this),
+      superstep_barrier( std::max(ncpus, size_t(1)) ),
+      update_counts(std::max(ncpus, size_t(1)), 0),
+      num_supersteps(0),
+      numsyncs(0),
+      monitor(NULL),
+      start_time_millis(lowres_time_millis()),
+      timeout_millis(0),
+      task_budget(0),
+      active(false),
+      first_superstep(false),
+      abort_requested(false),
+      exception_message(NULL),
+      termination_reason(EXEC_UNSET),
+      sync_accumulators(std::max(ncpus, size_t(1))),
+      engine_metrics("engine") { }
+
+    //! Get the number of cpus
+    size_t get_ncpus() const { return ncpus; }
+
+    void set_cpu_affinities(bool value) {
+      use_cpu_affinity = value;
+    }
+
+    /** All updates of a superstep are lock free, the scope is ignored */
+    void set_default_scope(scope_range::scope_range_enum default_scope_range) { }
+
+    /** There is no scheduler */
+    void set_scheduler_options(const scheduler_options& opts) { }
+
+    void set_engine_options(const scheduler_options& opts) {
+      opts.get_int_option("max_iterations", max_iterations);
+    }
+    
+    static void print_options_help(std::ostream& out) {
+      out << "max_iterations = [integer, default = 0]. Maximum number of "
+          << "supersteps, 0 for no limit\n";
+    }
+
+    using iengine<Graph>::exec_status_as_string;
+
+    /** Execute the engine */
+    void start() {
+      graph.finalize();
+      prepare_task_arrays();
+      // Take the initial copy of the vertex data
+      previous.resize(graph.num_vertices());
+      for(vertex_id_type v = 0; v < graph.num_vertices(); ++v) 
+        previous[v] = graph.vertex_data(v);
+
+      std::fill(update_counts.begin(), update_counts.end(), 0);
+      for(size_t i = 0; i < sync_tasks.size(); ++i) 
+        sync_tasks[i].last_update_count = 0;
+      num_supersteps = 0;
+      numsyncs = 0;
+      num_active = 0;
+      start_time_millis = lowres_time_millis();
+      abort_requested = false;
+      termination_reason = EXEC_UNSET;
+      exception_message = NULL;
+      active = true;
+      first_superstep = true;
+
+      run_threaded();
+
+      engine_metrics.set("termination_reason", 
+                         exec_status_as_string(termination_reason));
+      for(size_t i = 0; i < update_counts.size(); ++i) {
+        engine_metrics.add("updatecount", 
+                           (double)update_counts[i], INTEGER);
+        engine_metrics.add_vector_entry("updatecount_vector", i, 
+                                        (double)update_counts[i]);
+      }
+      engine_metrics.add("runtime",
+                         ((double)lowres_time_millis() - 
+                          (double)start_time_millis) * 0.001, TIME);
+      engine_metrics.set_integer("num_supersteps", num_supersteps);
+      engine_metrics.set_integer("num_vertices", graph.num_vertices());
+      engine_metrics.set_integer("num_edges", graph.num_edges());
+      engine_metrics.set_integer("num_syncs", numsyncs);
+
+      // ok. if death was due to an exception, rethrow
+      if (termination_reason == EXEC_EXCEPTION) {
+        throw(exception_message);
+      }
+    } // end of start
+
+    /**
+     * Stop the engine after the current superstep
+     */
+    void stop() {
+      abort_requested = true;
+    }
+    
+    metrics get_metrics() {
+      return engine_metrics;
+    }
+
+    void reset_metrics() {
+      engine_metrics.clear();
+    }
+
+    exec_status last_exec_status() const {
+      return termination_reason;
+    }
+
+    size_t last_update_count() const {
+      size_t sum = 0;
+      for(size_t i = 0; i < update_counts.size(); ++i)
+        sum += update_counts[i];
+      return sum;
+    } // end of last_update_count
+
+    void register_monitor(imonitor_type* _monitor = NULL) {
+      monitor = _monitor;
+      if(monitor != NULL) monitor->init(this);
+    } 
+
+    void add_terminator(termination_function_type term) {
+      term_functions.push_back(term);
+    }
+
+    void clear_terminators() {
+      term_functions.clear();
+    }
+
+    void set_timeout(size_t timeout_seconds = 0) {
+      timeout_millis = timeout_seconds * 1000;
+    }
+    
+    void set_task_budget(size_t max_tasks) {
+      task_budget = max_tasks;
+    }
+
+    /**
+     * Activate the vertex for the next superstep
+     */
+    void add_task(update_task_type task, double priority) {
+      if(!active) prepare_task_arrays();
+      schedule(task.vertex(), task.function());
+    }
+
+    void add_tasks(const std::vector<vertex_id_type>& vertices,
+                   update_function_type func, double priority) {
+      if(!active) prepare_task_arrays();
+      foreach(vertex_id_type vertex, vertices) schedule(vertex, func);
+    }
+
+    void add_task_to_all(update_function_type func, double priority) {
+      if(!active) prepare_task_arrays();
+      for(vertex_id_type v = 0; v < graph.num_vertices(); ++v) 
+        schedule(v, func);
+    }
+
+    /** 
+     * Activate vertex for the next superstep.  Safe to call from
+     * the update functions.
+     */
+    void schedule(vertex_id_type vertex, update_function_type func) {
+      assert(func != NULL);
+      const size_t next = 1 - current;
+      ASSERT_LT(vertex, active_bits[next].size());
+      // several update functions may schedule the same vertex
+      fetch_and_store(active_functions[next][vertex], func);
+      if(!active_bits[next].set_bit(vertex)) num_next_active.inc();
+    } // end of schedule
+
+    /**
+     * Registers a sync with the engine.  Syncs run between
+     * supersteps once at least sync_interval updates have been
+     * executed since their last evaluation.  See
+     * iengine::set_sync().
+     */
+    void set_sync(glshared_base& shared,
+                  sync_function_type sync,
+                  glshared_base::apply_function_type apply,
+                  const any& zero,
+                  size_t sync_interval = 0,
+                  merge_function_type merge = NULL,
+                  vertex_id_type rangelow = 0,
+                  vertex_id_type rangehigh = -1) {
+      sync_task st;
+      st.sync_fun = sync;
+      st.merge_fun = merge;
+      st.apply_fun = apply;
+      st.sync_interval = sync_interval;
+      st.zero = zero;
+      st.rangelow = rangelow;
+      st.rangehigh = rangehigh;
+      st.sharedvariable = &shared;
+      sync_tasks.push_back(st);
+      var2synctask[&shared] = sync_tasks.size() - 1;
+    }
+
+    /**
+     * Performs a sync immediately on the calling thread.  The engine
+     * must not be running.
+     */
+    void sync_now(glshared_base& shared) {
+      ASSERT_FALSE(active);
+      typename std::map<glshared_base*, size_t>::iterator iter = 
+        var2synctask.find(&shared);
+      ASSERT_TRUE(iter != var2synctask.end());
+      sync_task& sync = sync_tasks[iter->second];
+      previous.resize(graph.num_vertices());
+      for(vertex_id_type v = 0; v < graph.num_vertices(); ++v) 
+        previous[v] = graph.vertex_data(v);
+      any accumulator = sync.zero;
+      accumulate_sync(sync, 0, 1, accumulator);
+      sync.sharedvariable->apply(sync.apply_fun, accumulator);
+    }
+
+  private:
+
+    /** Allocate the bitmaps if the graph changed size */
+    void prepare_task_arrays() {
+      const size_t nverts = graph.num_vertices();
+      for(size_t i = 0; i < 2; ++i) {
+        if(active_bits[i].size() != nverts) {
+          active_bits[i].resize(nverts);
+          active_bits[i].clear();
+          active_functions[i].assign(nverts, NULL);
+          if(i == 1 - current) num_next_active.value = 0;
+        }
+      }
+    } // end of prepare_task_arrays
+
+    void run_threaded() {
+      thread_group threads;
+      for(size_t i = 0; i < ncpus; ++i) {
+        const boost::function<void (void)> worker = 
+          boost::bind(&synchronous_engine::run_worker, this, i);
+        if(use_cpu_affinity) threads.launch(worker, i);
+        else threads.launch(worker);
+      }
+      // the workers catch the exceptions of the update functions
+      threads.join();
+    } // end of run threaded
+
+    /**
+     * Records an exception thrown by an update or sync function.  The
+     * worker keeps going through the barriers and all workers stop
+     * together at the beginning of the next superstep.
+     */
+    void record_exception(const char* c) {
+      exception_lock.lock();
+      if(termination_reason != EXEC_EXCEPTION) {
+        logstream(LOG_ERROR) << "Exception Caught: " << c << std::endl;
+        exception_message = c;
+        termination_reason = EXEC_EXCEPTION;
+      }
+      exception_lock.unlock();
+    } // end of record_exception
+
+    /** The main loop of each worker */
+    void run_worker(size_t cpuid) {
+      while(true) {
+        if(cpuid == 0) begin_superstep();
+        superstep_barrier.wait();
+        for(size_t i = 0; i < pending_syncs.size(); ++i) 
+          parallel_evaluate_sync(pending_syncs[i], cpuid);
+        if(!active) break;
+        try {
+          execute_superstep(cpuid);
+        }
+        catch(const char* c) {
+          record_exception(c);
+        }
+        superstep_barrier.wait();
+        commit_superstep(cpuid);
+        superstep_barrier.wait();
+      }
+    } // end of run_worker
+
+    /**
+     * Run by worker 0 between supersteps while the other workers
+     * wait on the barrier.  Swaps the bitmaps, tests the termination
+     * conditions and picks the syncs to run.
+     */
+    void begin_superstep() {
+      if(!first_superstep) ++num_supersteps;
+      // The next superstep becomes the current one
+      current = 1 - current;
+      num_active = num_next_active.value;
+      num_next_active.value = 0;
+      next_exec_chunk.value = 0;
+      next_commit_chunk.value = 0;
+
+      if(termination_reason == EXEC_EXCEPTION) {
+        active = false;
+      } else if(satisfies_termination_condition()) {
+        active = false;
+      } 
+      pending_syncs.clear();
+      if(!active) {
+        // Keep the unexecuted tasks for the next call to start()
+        current = 1 - current;
+        num_next_active.value = num_active;
+      }
+      if(termination_reason == EXEC_EXCEPTION) {
+        // do not run user code again after a failure
+      } else if(!active || first_superstep) {
+        // Every sync is evaluated before the first and after the
+        // last superstep
+        for(size_t i = 0; i < sync_tasks.size(); ++i) pending_syncs.push_back(i);
+      } else {
+        const size_t nupdates = last_update_count();
+        for(size_t i = 0; i < sync_tasks.size(); ++i) {
+          sync_task& sync = sync_tasks[i];
+          if(sync.sync_interval > 0 && 
+             nupdates - sync.last_update_count >= sync.sync_interval) {
+            pending_syncs.push_back(i);
+          }
+        }
+      }
+      for(size_t i = 0; i < pending_syncs.size(); ++i) 
+        sync_tasks[pending_syncs[i]].last_update_count = last_update_count();
+      first_superstep = false;
+    } // end of begin_superstep
+
+    bool satisfies_termination_condition() {
+      if(abort_requested) {
+        termination_reason = EXEC_FORCED_ABORT;
+        return true;
+      }
+      if(num_active == 0) {
+        termination_reason = EXEC_TASK_DEPLETION;
+        return true;
+      }
+      if(max_iterations > 0 && num_supersteps >= max_iterations) {
+        termination_reason = EXEC_TASK_DEPLETION;
+        return true;
+      }
+      if(timeout_millis > 0 && 
+         start_time_millis + timeout_millis < lowres_time_millis()) {
+        termination_reason = EXEC_TIMEOUT;
+        return true;
+      }
+      if(task_budget > 0 && last_update_count() > task_budget) {
+        termination_reason = EXEC_TASK_BUDGET_EXCEEDED;
+        return true;
+      }
+      for (size_t i = 0; i < term_functions.size(); ++i) {
+        if (term_functions[i]()) {
+          termination_reason = EXEC_TERM_FUNCTION;
+          return true;
+        }
+      }
+      return false;
+    } // end of satisfies_termination_condition
+
+    /** Update the active vertices, chunk by chunk */
+    void execute_superstep(size_t cpuid) {
+      const size_t nverts = graph.num_vertices();
+      const dense_bitset& bits = active_bits[current];
+      const std::vector<update_function_type>& functions = 
+        active_functions[current];
+      scope_type scope;
+      size_t nupdates = 0;
+      while(true) {
+        const size_t begin = next_exec_chunk.inc_ret_last(CHUNK_SIZE);
+        if(begin >= nverts) break;
+        const size_t end = std::min(begin + CHUNK_SIZE, nverts);
+        uint32_t v = begin;
+        bool found = bits.get(v) || bits.next_bit(v);
+        while(found && v < end) {
+          scope.init(&graph, &previous, v);
+          functions[v](scope, callback);
+          ++nupdates;
+          found = bits.next_bit(v);
+        }
+      }
+      update_counts[cpuid] += nupdates;
+    } // end of execute_superstep
+
+    /** 
+     * Publish the new values of the updated vertices to the read
+     * buffer and clear the current bitmap.  Chunks are multiples of
+     * the bitmap word size so the bits can be cleared without atomics.
+     */
+    void commit_superstep(size_t cpuid) {
+      typedef typename Graph::vertex_hot_traits vertex_hot_traits;
+      typedef typename Graph::edge_hot_traits edge_hot_traits;
+      const size_t nverts = graph.num_vertices();
+      dense_bitset& bits = active_bits[current];
+      while(true) {
+        const size_t begin = next_commit_chunk.inc_ret_last(CHUNK_SIZE);
+        if(begin >= nverts) break;
+        const size_t end = std::min(begin + CHUNK_SIZE, nverts);
+        uint32_t v = begin;
+        bool found = bits.get(v) || bits.next_bit(v);
+        while(found && v < end) {
+          previous[v] = graph.vertex_data(v);
+          if(vertex_hot_traits::enabled) graph.refresh_vertex_hot_data(v);
+          if(edge_hot_traits::enabled) {
+            foreach(edge_id_type eid, graph.in_edge_ids(v)) 
+              graph.refresh_edge_hot_data(eid);
+            foreach(edge_id_type eid, graph.out_edge_ids(v)) 
+              graph.refresh_edge_hot_data(eid);
+          }
+          bits.clear_bit_unsync(v);
+          found = bits.next_bit(v);
+        }
+      }
+    } // end of commit_superstep
+
+    /** Accumulate the sync over the share of the range owned by cpuid */
+    void accumulate_sync(sync_task& sync, size_t cpuid, size_t nworkers,
+                         any& accumulator) {
+      const size_t nverts = graph.num_vertices();
+      if(nverts == 0) return;
+      const vertex_id_type vmin = sync.rangelow;
+      const vertex_id_type vmax = 
+        std::min(sync.rangehigh, vertex_id_type(nverts - 1));
+      if(vmin > vmax) return;
+      const size_t len = size_t(vmax - vmin) + 1;
+      const vertex_id_type v_mymin = vertex_id_type(vmin + (len * cpuid) / nworkers);
+      const vertex_id_type v_mymax = vertex_id_type(vmin + (len * (cpuid + 1)) / nworkers);
+      scope_type scope;
+      for (vertex_id_type i = v_mymin; i < v_mymax; ++i) {
+        scope.init(&graph, &previous, i);
+        sync.sync_fun(scope, accumulator);
+      }
+    } // end of accumulate_sync
+
+    /** 
+     * Called by all the workers.  The reduction is done in parallel
+     * if the sync has a merge function.
+     */
+    void parallel_evaluate_sync(size_t syncid, size_t cpuid) {
+      sync_task& sync = sync_tasks[syncid];
+      if(sync.merge_fun != NULL) {
+        any& accumulator = sync_accumulators[cpuid];
+        accumulator = sync.zero;
+        try {
+          accumulate_sync(sync, cpuid, ncpus, accumulator);
+        }
+        catch(const char* c) {
+          record_exception(c);
+        }
+        superstep_barrier.wait();
+        // termination_reason is stable between the barriers
+        if(cpuid == 0 && termination_reason != EXEC_EXCEPTION) {
+          try {
+            for(size_t i = 1; i < sync_accumulators.size(); ++i) 
+              sync.merge_fun(accumulator, sync_accumulators[i]);
+            sync.sharedvariable->apply(sync.apply_fun, accumulator);
+            ++numsyncs;
+          }
+          catch(const char* c) {
+            record_exception(c);
+          }
+        }
+      } else if(cpuid == 0 && termination_reason != EXEC_EXCEPTION) {
+        try {
+          any accumulator = sync.zero;
+          accumulate_sync(sync, 0, 1, accumulator);
+          sync.sharedvariable->apply(sync.apply_fun, accumulator);
+          ++numsyncs;
+        }
+        catch(const char* c) {
+          record_exception(c);
+        }
+      }
+      superstep_barrier.wait();
+    } // end of parallel_evaluate_sync
+    
+  }; // end of synchronous_engine
+  
+} // end of namespace graphlab
+#include <graphlab/macros_undef.hpp>
+
+#endif
+
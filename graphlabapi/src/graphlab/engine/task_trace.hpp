@@ -0,0 +1,247 @@
+/**  
+ * Copyright (c) 2009 Carnegie Mellon University. 
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+
+#ifndef GRAPHLAB_TASK_TRACE_HPP
+#define GRAPHLAB_TASK_TRACE_HPP
+
+#include <vector>
+#include <algorithm>
+#include <string>
+#include <fstream>
+#include <stdint.h>
+
+#include <graphlab/parallel/pthread_tools.hpp>
+#include <graphlab/tasks/update_task.hpp>
+#include <graphlab/serialization/serialization_includes.hpp>
+#include <graphlab/serialization/serializable_pod.hpp>
+#include <graphlab/logger/logger.hpp>
+
+namespace graphlab {
+
+  /** One executed task of a task_trace */
+  struct task_trace_entry {
+    uint32_t vertex;
+    uint32_t function;   ///< index into the function table of the trace
+  };
+
+}
+SERIALIZABLE_POD(graphlab::task_trace_entry);
+
+#include <graphlab/macros_def.hpp>
+namespace graphlab {
+
+  /**
+   * \ingroup engine
+   * Records the (vertex, update function) pairs each worker of an
+   * engine executes, in order, and writes them to disk as 8 bytes a
+   * task.  A saved trace can be loaded to replay the same tasks in
+   * the same order on each worker.
+   *
+   * Update functions are stored as offsets from a function of this
+   * class, so a trace can only be replayed by the binary that
+   * recorded it and the update functions must be linked into the
+   * same binary as the engine.
+   */
+  template<typename Graph>
+  class task_trace {
+  public:
+    typedef Graph graph_type;
+    typedef typename graph_type::vertex_id_type vertex_id_type;
+    typedef update_task<Graph> update_task_type;
+    typedef typename update_task_type::update_function_type 
+    update_function_type;
+
+    /// Identifies trace files.  Changes with the format.
+    static const uint64_t TRACE_MAGIC = 0x3145434152544c47ULL;
+
+    task_trace(size_t ncpus = 0) { clear(ncpus); }
+
+    /** Empties the trace and prepares it for ncpus workers */
+    void clear(size_t ncpus) {
+      logs.clear();
+      logs.resize(ncpus);
+      known_functions.clear();
+      known_functions.resize(ncpus);
+      functions.clear();
+    }
+
+    size_t num_cpus() const { return logs.size(); }
+
+    /** The number of tasks recorded over all workers */
+    size_t size() const {
+      size_t total = 0;
+      for(size_t i = 0; i < logs.size(); ++i) total += logs[i].size();
+      return total;
+    }
+
+    /** Appends the task run by cpuid.  Only cpuid may call this. */
+    void record(size_t cpuid, vertex_id_type vertex, 
+                update_function_type func) {
+      task_trace_entry entry;
+      entry.vertex = vertex;
+      entry.function = function_id(cpuid, func);
+      logs[cpuid].push_back(entry);
+    }
+
+    /** The tasks of a worker in the order they ran */
+    const std::vector<task_trace_entry>& tasks(size_t cpuid) const {
+      return logs[cpuid];
+    }
+
+    /** 
+     * The update function of a trace entry.  The function indices
+     * are checked by load().
+     */
+    update_function_type function(const task_trace_entry& entry) const {
+      return functions[entry.function];
+    }
+
+    /** One more than the largest vertex id of the trace */
+    size_t vertex_bound() const {
+      size_t bound = 0;
+      for(size_t i = 0; i < logs.size(); ++i) {
+        for(size_t j = 0; j < logs[i].size(); ++j) {
+          bound = std::max(bound, size_t(logs[i][j].vertex) + 1);
+        }
+      }
+      return bound;
+    }
+
+    /**
+     * Moves the tasks of every recorded worker i to worker 
+     * i % ncpus, so that a trace can be replayed with fewer workers
+     * than it was recorded with.  With ncpus = 1 the replay runs all
+     * tasks on one thread and is deterministic.
+     */
+    void fold(size_t ncpus) {
+      ASSERT_GT(ncpus, 0);
+      if (ncpus >= logs.size()) { 
+        logs.resize(ncpus);
+        known_functions.resize(ncpus);
+        return;
+      }
+      for(size_t i = ncpus; i < logs.size(); ++i) {
+        std::vector<task_trace_entry>& target = logs[i % ncpus];
+        target.insert(target.end(), logs[i].begin(), logs[i].end());
+      }
+      logs.resize(ncpus);
+      known_functions.resize(ncpus);
+    }
+
+    void save(oarchive& arc) const {
+      arc << TRACE_MAGIC << functions.size();
+      for(size_t i = 0; i < functions.size(); ++i) {
+        arc << int64_t(reinterpret_cast<intptr_t>(functions[i]) - anchor());
+      }
+      arc << logs;
+    }
+
+    void load(iarchive& arc) {
+      uint64_t magic = 0;
+      arc >> magic;
+      ASSERT_MSG(magic == TRACE_MAGIC, "Not a task trace");
+      size_t nfunctions = 0;
+      arc >> nfunctions;
+      if (nfunctions > size_t(uint32_t(-1))) {
+        logstream(LOG_FATAL) << "Corrupt task trace with " << nfunctions 
+                             << " functions" << std::endl;
+      }
+      functions.resize(nfunctions);
+      for(size_t i = 0; i < nfunctions; ++i) {
+        int64_t offset = 0;
+        arc >> offset;
+        functions[i] = 
+          reinterpret_cast<update_function_type>(anchor() + offset);
+      }
+      arc >> logs;
+      known_functions.clear();
+      known_functions.resize(logs.size());
+      // a corrupt trace must not index past the function table
+      for(size_t i = 0; i < logs.size(); ++i) {
+        for(size_t j = 0; j < logs[i].size(); ++j) {
+          if (logs[i][j].function >= functions.size()) {
+            logstream(LOG_FATAL) << "Task trace entry " << j << " of cpu " << i
+                                 << " uses function " << logs[i][j].function
+                                 << " of " << functions.size() << std::endl;
+          }
+        }
+      }
+    }
+
+    /** Writes the trace to filename. Returns false on failure. */
+    bool save(const std::string& filename) const {
+      std::ofstream fout(filename.c_str(), std::ios::binary);
+      if (!fout.good()) return false;
+      oarchive oarc(fout);
+      save(oarc);
+      fout.close();
+      return !fout.fail();
+    }
+
+    /** Reads a trace written by save(). Returns false on failure. */
+    bool load(const std::string& filename) {
+      std::ifstream fin(filename.c_str(), std::ios::binary);
+      if (!fin.good()) return false;
+      iarchive iarc(fin);
+      load(iarc);
+      return !fin.fail();
+    }
+
+  private:
+    std::vector<std::vector<task_trace_entry> > logs;
+    /// function table, shared by the workers
+    std::vector<update_function_type> functions;
+    mutex functions_lock;
+    /// the (function, id) pairs each worker has already looked up
+    std::vector<std::vector<std::pair<update_function_type, uint32_t> > >
+    known_functions;
+
+    uint32_t function_id(size_t cpuid, update_function_type func) {
+      std::vector<std::pair<update_function_type, uint32_t> >& known = 
+        known_functions[cpuid];
+      for(size_t i = 0; i < known.size(); ++i) {
+        if (known[i].first == func) return known[i].second;
+      }
+      functions_lock.lock();
+      uint32_t id = 0;
+      while(id < functions.size() && functions[id] != func) ++id;
+      if (id == functions.size()) functions.push_back(func);
+      functions_lock.unlock();
+      known.push_back(std::make_pair(func, id));
+      return id;
+    }
+
+    /// the function the update function addresses are relative to
+    static void anchor_function() { }
+    static intptr_t anchor() { 
+      return reinterpret_cast<intptr_t>(&anchor_function);
+    }
+  };
+
+  template<typename Graph>
+  const uint64_t task_trace<Graph>::TRACE_MAGIC;
+
+}
+#include <graphlab/macros_undef.hpp>
+#endif
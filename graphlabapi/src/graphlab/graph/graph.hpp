@@ -60,6 +60,10 @@
 
 #include <boost/bind.hpp>
 #include <boost/unordered_set.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/static_assert.hpp>
+#include <boost/type_traits/has_trivial_copy.hpp>
+#include <boost/type_traits/has_trivial_destructor.hpp>
 
 
 
@@ -68,10 +72,16 @@
 
 #include <graphlab/serialization/iarchive.hpp>
 #include <graphlab/serialization/oarchive.hpp>
+#include <graphlab/serialization/iterator.hpp>
 
 
 
 #include <graphlab/util/random.hpp>
+#include <graphlab/util/dense_bitset.hpp>
+#include <graphlab/util/mmap_vector.hpp>
+#include <graphlab/parallel/atomic.hpp>
+#include <graphlab/parallel/numa_tools.hpp>
+#include <graphlab/graph/hot_data_traits.hpp>
 
 
 
@@ -131,6 +141,19 @@ namespace graphlab {
      graph::finalize() is needed after graph construction to restore
      the invariant.  The engine routines will defensively call
      graph::finalize() it is not first called by the user.
+
+     <h2> Compressed Adjacency </h2>
+
+     The per-vertex edge vectors are convenient while the graph is
+     being constructed but cost a heap allocation and a vector header
+     per vertex per direction.  Calling
+     graph::set_compact_on_finalize(true) causes graph::finalize() to
+     pack both directions into contiguous offset and index arrays (CSR
+     for the out edges and CSC for the in edges).  The edge_list
+     objects returned by graph::in_edge_ids() and graph::out_edge_ids()
+     then point directly into these arrays.  Any later call to
+     graph::add_edge() transparently reverts to the growable layout and
+     the next graph::finalize() compacts the graph again.
   */
   template<typename VertexData, typename EdgeData>
   class graph {
@@ -208,6 +231,14 @@ namespace graphlab {
 
     /** The type of the edge data stored in the graph */
     typedef EdgeData   edge_data_type;
+
+    /** The hot fields of the vertex data.  See hot_data_traits */
+    typedef hot_data_traits<VertexData> vertex_hot_traits;
+    typedef typename vertex_hot_traits::hot_type vertex_hot_type;
+
+    /** The hot fields of the edge data.  See hot_data_traits */
+    typedef hot_data_traits<EdgeData> edge_hot_traits;
+    typedef typename edge_hot_traits::hot_type edge_hot_type;
     
   public:
 
@@ -215,7 +246,8 @@ namespace graphlab {
     /**
      * Build a basic graph
      */
-    graph() : finalized(true),changeid(0) {  }
+    graph() : finalized(true), compact_on_finalize(false),
+              csr_active(false), changeid(0) {  }
 
     /**
      * Create a graph with nverts vertices.
@@ -223,7 +255,8 @@ namespace graphlab {
     graph(size_t nverts) : 
       vertices(nverts),
       in_edges(nverts), out_edges(nverts), vcolors(nverts),
-      finalized(true),changeid(0) { }
+      finalized(true), compact_on_finalize(false),
+      csr_active(false), changeid(0) { }
 
     graph(const graph<VertexData, EdgeData>& g) { (*this) = g; }
 
@@ -237,10 +270,31 @@ namespace graphlab {
       edges.clear();
       in_edges.clear();
       out_edges.clear();
+      clear_csr();
+      vertex_hot.clear();
+      edge_hot.clear();
       vcolors.clear();
       finalized = true;
       ++changeid;
     }
+
+    /**
+     * \brief Request that finalize() packs the adjacency structure
+     * into contiguous CSR/CSC arrays.
+     *
+     * If the graph is currently compacted and value is false the
+     * growable layout is restored immediately.
+     */
+    void set_compact_on_finalize(bool value) {
+      compact_on_finalize = value;
+      if(!compact_on_finalize && csr_active) expand_csr();
+    }
+
+    /** \brief Returns true if finalize() will compact the graph */
+    bool get_compact_on_finalize() const { return compact_on_finalize; }
+
+    /** \brief Returns true if the adjacency is currently compacted */
+    bool is_compact() const { return csr_active; }
     
     /**
      * Finalize a graph by sorting its edges to maximize the
@@ -253,58 +307,18 @@ namespace graphlab {
     void finalize() {   
       //      std::cout << "considering finalize" << std::endl;
       // check to see if the graph is already finalized
-      if(finalized) return;
-      //      std::cout << "Finalizing" << std::endl;
-      typedef std::vector< edge_id_type > edge_set;
-      edge_id_less_functor less_functor(this);      
-      // Sort all in edges sets
-      //      foreach(edge_set& eset, in_edges) {
-#pragma omp parallel for
-      for(ssize_t i = 0; i < ssize_t(in_edges.size()); ++i) {
-        edge_set& eset(in_edges[i]);
-        // Sort the edge vector
-        std::sort(eset.begin(),
-                  eset.end(),
-                  less_functor);
-        // Test for duplicate edges
-        if (eset.size() > 1) {
-          for(size_t j = 0; j < eset.size()-1; ++j) {
-            // Duplicate edge test
-            if(!edge_id_less(eset[j], eset[j+1])) {
-              logstream(LOG_FATAL)
-                << "Duplicate edge "
-                << "(" << source(eset[j]) << ", " << target(eset[j]) << ") "
-                << "found!  GraphLab does not support graphs "
-                << "with duplicate edges." << std::endl;
-            }
-          }
-        }  
-      } // end of for loop
-
-
-      // Sort all out edges sets
-      //      foreach(edge_set& eset, out_edges) {
-#pragma omp parallel for
-      for(ssize_t i = 0; i < ssize_t(out_edges.size()); ++i) {
-        edge_set& eset(out_edges[i]);
-        std::sort(eset.begin(),
-                  eset.end(),
-                  less_functor);
-        // Test for dupliate edges
-        if (eset.size() > 1) {
-          for(size_t j = 0; j < eset.size()-1; ++j) {
-            // Duplicate edge test
-            if(!edge_id_less(eset[j], eset[j+1])) {
-              logstream(LOG_FATAL)
-                << "Duplicate edge "
-                << "(" << source(eset[j]) << ", " << target(eset[j]) << ") "
-                << "found!  GraphLab does not support graphs "
-                << "with duplicate edges." << std::endl;
-            }
-          }
-        }
+      if(finalized) {
+        if(compact_on_finalize && !csr_active) compact_csr();
+        refresh_hot_data();
+        return;
       }
+      //      std::cout << "Finalizing" << std::endl;
+      // Sort all in edges sets and then all out edges sets
+      sort_edge_map(in_edges);
+      sort_edge_map(out_edges);
       finalized = true;
+      if(compact_on_finalize) compact_csr();
+      refresh_hot_data();
     } // End of finalize
             
     /** \brief Get the number of vertices */
@@ -326,13 +340,13 @@ namespace graphlab {
     /** \brief Get the number of in edges of a particular vertex */
     size_t num_in_neighbors(vertex_id_type v) const {
       ASSERT_LT(v, vertices.size());
-      return in_edges[v].size();
+      return in_edge_ids(v).size();
     } // end of num vertices
     
     /** \brief Get the number of out edges of a particular vertex */
     size_t num_out_neighbors(vertex_id_type v) const  {
       ASSERT_LT(v, vertices.size());
-      return out_edges[v].size();
+      return out_edge_ids(v).size();
     } // end of num vertices
 
     /** \brief Finds an edge.
@@ -341,37 +355,38 @@ namespace graphlab {
         edge is found, the edge ID is returned in the second element of the pair. */
     std::pair<bool, edge_id_type>
     find(vertex_id_type source, vertex_id_type target) const {
-      ASSERT_LT(source, in_edges.size());
-      ASSERT_LT(target, out_edges.size());
+      ASSERT_LT(source, vertices.size());
+      ASSERT_LT(target, vertices.size());
+      const edge_list target_in = in_edge_ids(target);
+      const edge_list source_out = out_edge_ids(source);
       // Check the base case that the souce or target have no edges
-      if (in_edges[target].size() == 0 ||
-          out_edges[source].size() == 0) {
+      if (target_in.size() == 0 || source_out.size() == 0) {
         return std::make_pair(false,-1);
       } else if(finalized) { // O( log degree ) search ========================>
         // if it is finalized then do the search using a binary search
         // If their are fewer in edges into the target search the in
         // edges
-        if(in_edges[target].size() < out_edges[source].size()) {
+        if(target_in.size() < source_out.size()) {
           // search the source vertices for the edge
-          size_t index = binary_search(in_edges[target], source, target);
-          if(index < in_edges[target].size())
-            return std::make_pair(true, in_edges[target][index]);
+          size_t index = binary_search(target_in, source, target);
+          if(index < target_in.size())
+            return std::make_pair(true, target_in[index]);
           else
             return std::make_pair(false,-1);
         } else { // If their are fewer edges out of the source binary
                  // search there
           // search the source vertices for the edge
-          size_t index = binary_search(out_edges[source], source, target);
-          if(index < out_edges[source].size())
-            return std::make_pair(true, out_edges[source][index]);
+          size_t index = binary_search(source_out, source, target);
+          if(index < source_out.size())
+            return std::make_pair(true, source_out[index]);
           else
             return std::make_pair(false,-1);
         }
       } else { // O( degree ) search ==========================================>
         // if there are few in edges at the target search there
-        if(in_edges[target].size() < out_edges[source].size()) {
+        if(target_in.size() < source_out.size()) {
           // linear search the in_edges at the target 
-          foreach(edge_id_type eid, in_edges[target]) {
+          foreach(edge_id_type eid, target_in) {
             ASSERT_LT(eid, edges.size());
             if(edges[eid].source() == source 
                && edges[eid].target() == target) {
@@ -381,7 +396,7 @@ namespace graphlab {
           return std::make_pair(false, -1);
         } else { // fewer out edges at the source
           // linear search the out_edges at the source
-          foreach(edge_id_type eid, out_edges[source]) {
+          foreach(edge_id_type eid, source_out) {
             ASSERT_LT(eid, edges.size());
             if(edges[eid].source() == source 
                && edges[eid].target() == target) {
@@ -423,8 +438,15 @@ namespace graphlab {
     vertex_id_type add_vertex(const VertexData& vdata = VertexData() ) {
       vertices.push_back(vdata);
       // Resize edge maps
-      out_edges.push_back(std::vector<edge_id_type>()); // resize(vertices.size());
-      in_edges.push_back(std::vector<edge_id_type>()); // resize(vertices.size());
+      if(csr_active) {
+        // A new vertex has no edges so the compact layout only needs
+        // an additional (empty) range
+        csr_in_offsets.push_back(csr_in_offsets.back());
+        csr_out_offsets.push_back(csr_out_offsets.back());
+      } else {
+        out_edges.push_back(std::vector<edge_id_type>()); // resize(vertices.size());
+        in_edges.push_back(std::vector<edge_id_type>()); // resize(vertices.size());
+      }
       vcolors.push_back(vertex_color_type()); // resize(vertices.size());
       return (vertex_id_type)vertices.size() - 1;
     } // End of add vertex;
@@ -438,8 +460,13 @@ namespace graphlab {
       ASSERT_GE(num_vertices, vertices.size());
       vertices.resize(num_vertices);
       // Resize edge maps
-      out_edges.resize(vertices.size());
-      in_edges.resize(vertices.size());
+      if(csr_active) {
+        csr_in_offsets.resize(vertices.size() + 1, csr_in_offsets.back());
+        csr_out_offsets.resize(vertices.size() + 1, csr_out_offsets.back());
+      } else {
+        out_edges.resize(vertices.size());
+        in_edges.resize(vertices.size());
+      }
       vcolors.resize(vertices.size());
     } // End of resize
     
@@ -471,6 +498,10 @@ namespace graphlab {
         ASSERT_MSG(source != target, "Attempting to add self edge!");
       }
 
+      // The compact layout cannot grow so revert to the per vertex
+      // edge vectors
+      if(csr_active) expand_csr();
+
       // Add the edge to the set of edge data (this copies the edata)
       edges.push_back( edge( source, target, edata ) );
 
@@ -493,6 +524,109 @@ namespace graphlab {
                       *(out_edges[source].end()-1)));
       return edge_id;
     } // End of add edge
+
+
+    /**
+     * \brief Add a batch of edges and finalize the graph.
+     *
+     * Each element of the range must provide source(), target() and
+     * data() (for instance edge_type).  All the vertices must already
+     * exist.  The degrees of the new edges are counted first so that
+     * every array is sized exactly once, and the edge sets are then
+     * filled and sorted in parallel.  On return the graph is
+     * finalized (and compacted if compact_on_finalize is set) which
+     * is much cheaper than calling add_edge() for each edge followed
+     * by finalize().  Self edges and duplicate edges are not
+     * permitted.
+     */
+    template<typename RandomAccessIterator>
+    void add_edges(RandomAccessIterator begin, RandomAccessIterator end) {
+      const size_t first = edges.size();
+      const size_t nnew = end - begin;
+      ASSERT_LT(first + nnew, size_t(edge_id_type(-1)));
+      if(nnew == 0) { finalize(); return; }
+      // Validate the batch before changing the graph so that a
+      // rejected batch leaves the graph as it was.  This is done
+      // sequentially since exceptions must not escape a parallel
+      // region.  Sorting the existing edges first reports their
+      // duplicates and allows binary searching them.
+      if(first > 0 && !finalized) {
+        sort_edge_map(in_edges);
+        sort_edge_map(out_edges);
+        finalized = true;
+      }
+      std::vector< std::pair<vertex_id_type, vertex_id_type> > 
+        batch_edges(nnew);
+      for(size_t i = 0; i < nnew; ++i) {
+        const vertex_id_type source = begin[i].source();
+        const vertex_id_type target = begin[i].target();
+        if(source >= vertices.size() || target >= vertices.size()) {
+          logstream(LOG_FATAL) 
+            << "Attempting add_edges (" << source
+            << " -> " << target
+            << ") when there are only " << vertices.size() 
+            << " vertices" << std::endl;
+        }
+        if(source == target) {
+          logstream(LOG_FATAL) 
+            << "Attempting to add self edge (" << source << " -> " 
+            << target <<  ").  "
+            << "This operation is not permitted in GraphLab!" << std::endl;
+        }
+        batch_edges[i] = std::make_pair(source, target);
+      }
+      std::sort(batch_edges.begin(), batch_edges.end());
+      for(size_t i = 0; i < nnew; ++i) {
+        const vertex_id_type source = batch_edges[i].first;
+        const vertex_id_type target = batch_edges[i].second;
+        if((i > 0 && batch_edges[i - 1] == batch_edges[i]) ||
+           (first > 0 && find(source, target).first)) {
+          logstream(LOG_FATAL)
+            << "Duplicate edge "
+            << "(" << source << ", " << target << ") "
+            << "found!  GraphLab does not support graphs "
+            << "with duplicate edges." << std::endl;
+        }
+      }
+      std::vector< std::pair<vertex_id_type, vertex_id_type> >().swap(batch_edges);
+      // Copy the edges and count the degrees
+      std::vector< atomic<edge_id_type> > in_degree(vertices.size());
+      std::vector< atomic<edge_id_type> > out_degree(vertices.size());
+      edges.resize(first + nnew);
+#pragma omp parallel for
+      for(ssize_t i = 0; i < ssize_t(nnew); ++i) {
+        const vertex_id_type source = begin[i].source();
+        const vertex_id_type target = begin[i].target();
+        edges[first + i] = edge(source, target, begin[i].data());
+        in_degree[target].inc();
+        out_degree[source].inc();
+      }
+      // Group the new edges by vertex in sorted order
+      mmap_vector<edge_id_type> in_offsets, in_eids, out_offsets, out_eids;
+      bucket_new_edges(first, true, in_degree, in_offsets, in_eids);
+      bucket_new_edges(first, false, out_degree, out_offsets, out_eids);
+      if(first == 0) {
+        // There are no existing edges so the buckets are the compact
+        // adjacency
+        clear_csr();
+        std::vector< std::vector<edge_id_type> >().swap(in_edges);
+        std::vector< std::vector<edge_id_type> >().swap(out_edges);
+        csr_in_offsets.swap(in_offsets);
+        csr_in_eids.swap(in_eids);
+        csr_out_offsets.swap(out_offsets);
+        csr_out_eids.swap(out_eids);
+        csr_active = true;
+        finalized = true;
+        if(!compact_on_finalize) expand_csr();
+      } else {
+        expand_csr();
+        merge_edge_map(in_edges, in_offsets, in_eids);
+        merge_edge_map(out_edges, out_offsets, out_eids);
+        finalized = true;
+        if(compact_on_finalize) compact_csr();
+      }
+      refresh_hot_data();
+    } // End of add edges
         
     
     /** \brief Returns a reference to the data stored on the vertex v. */
@@ -507,6 +641,66 @@ namespace graphlab {
       return vertices[v];
     } // end of data(v)
 
+    /** 
+     * \brief Returns the hot fields of the vertex data.  
+     *
+     * Requires hot_data_traits<VertexData> to be specialized.  The
+     * value reflects the vertex data as of the last call to
+     * finalize(), refresh_hot_data() or refresh_vertex_hot_data(v).
+     */
+    const vertex_hot_type& vertex_hot_data(vertex_id_type v) const {
+      BOOST_STATIC_ASSERT(vertex_hot_traits::enabled);
+      ASSERT_LT(v, vertex_hot.size());
+      return vertex_hot[v];
+    } // end of vertex_hot_data(v)
+
+    /** 
+     * \brief Returns the hot fields of the edge data.
+     *
+     * Requires hot_data_traits<EdgeData> to be specialized.
+     */
+    const edge_hot_type& edge_hot_data(edge_id_type edge_id) const {
+      BOOST_STATIC_ASSERT(edge_hot_traits::enabled);
+      ASSERT_LT(edge_id, edge_hot.size());
+      return edge_hot[edge_id];
+    } // end of edge_hot_data(e)
+
+    /** \brief Copy the hot fields of vertex v into the hot array */
+    void refresh_vertex_hot_data(vertex_id_type v) {
+      if(vertex_hot_traits::enabled) {
+        ASSERT_LT(v, vertex_hot.size());
+        vertex_hot[v] = vertex_hot_traits::get(vertices[v]);
+      }
+    } // end of refresh vertex hot data
+
+    /** \brief Copy the hot fields of edge e into the hot array */
+    void refresh_edge_hot_data(edge_id_type edge_id) {
+      if(edge_hot_traits::enabled) {
+        ASSERT_LT(edge_id, edge_hot.size());
+        edge_hot[edge_id] = edge_hot_traits::get(edges[edge_id].data());
+      }
+    } // end of refresh edge hot data
+
+    /** 
+     * \brief Rebuild the hot arrays from the vertex and edge data.
+     * This is a no-op unless hot_data_traits is specialized for the
+     * vertex or edge data type.
+     */
+    void refresh_hot_data() {
+      if(vertex_hot_traits::enabled) {
+        vertex_hot.resize(vertices.size());
+#pragma omp parallel for
+        for(ssize_t i = 0; i < ssize_t(vertices.size()); ++i) 
+          vertex_hot[i] = vertex_hot_traits::get(vertices[i]);
+      }
+      if(edge_hot_traits::enabled) {
+        edge_hot.resize(edges.size());
+#pragma omp parallel for
+        for(ssize_t i = 0; i < ssize_t(edges.size()); ++i) 
+          edge_hot[i] = edge_hot_traits::get(edges[i].data());
+      }
+    } // end of refresh hot data
+
     /** \brief Returns a reference to the data stored on the edge source->target. */
     EdgeData& edge_data(vertex_id_type source, vertex_id_type target) {
       ASSERT_LT(source, vertices.size());
@@ -579,10 +773,34 @@ namespace graphlab {
     }
     
     /** \brief This function constructs a heuristic coloring for the 
-        graph and returns the number of colors */
-    size_t compute_coloring() {
-      // Reset the colors
-      for(vertex_id_type v = 0; v < num_vertices(); ++v) color(v) = 0;
+        graph and returns the number of colors.
+
+        \param method Either "greedy" for the serial greedy coloring
+        or "speculative" for the parallel speculate-and-fix coloring.
+     */
+    size_t compute_coloring(const std::string& method = "greedy") {
+      if(method == "greedy") {
+        return greedy_coloring();
+      } else if(method == "speculative") {
+        return speculative_coloring();
+      } else {
+        logstream(LOG_FATAL) << "Unknown coloring method: " << method 
+                             << std::endl;
+      }
+      return 0;
+    } // end of compute coloring
+
+
+    /**
+     * \brief Serial greedy coloring.  Vertices are colored in order of
+     * decreasing in degree with the smallest color not used by any
+     * neighbor.
+     */
+    size_t greedy_coloring() {
+      // Reset the colors.  Uncolored neighbors are ignored when
+      // choosing a color.
+      for(vertex_id_type v = 0; v < num_vertices(); ++v) 
+        color(v) = vertex_color_type(-1);
       // construct a permuation of the vertices to use in the greedy
       // coloring. \todo Should probably sort by degree instead when
       // constructing greedy coloring.
@@ -595,36 +813,83 @@ namespace graphlab {
       std::sort(permutation.begin(), permutation.end());
       // Recolor
       size_t max_color = 0;
-      std::set<vertex_color_type> neighbor_colors;
+      dense_bitset used_colors(max_degree() + 1);
+      used_colors.clear();
       for(size_t i = 0; i < permutation.size(); ++i) {
-        neighbor_colors.clear();
         const vertex_id_type& vid = permutation[i].second;
-        // Get the neighbor colors
-        foreach(edge_id_type eid, in_edge_ids(vid)){
-          const vertex_id_type& neighbor_vid = source(eid);
-          const vertex_color_type& neighbor_color = color(neighbor_vid);
-          neighbor_colors.insert(neighbor_color);
-        }
-        foreach(edge_id_type eid, out_edge_ids(vid)){
-          const vertex_id_type& neighbor_vid = target(eid);
-          const vertex_color_type& neighbor_color = color(neighbor_vid);
-          neighbor_colors.insert(neighbor_color);
-        }
-
         vertex_color_type& vertex_color = color(vid);
-        vertex_color = 0;
-        foreach(vertex_color_type neighbor_color, neighbor_colors) {
-          if(vertex_color != neighbor_color) break;
-          else vertex_color++;
-          // Ensure no wrap around
-          ASSERT_NE(vertex_color, 0);                
-        }
+        vertex_color = smallest_free_color(vid, used_colors);
         max_color = std::max(max_color, size_t(vertex_color) );
-
       }
       // Return the NUMBER of colors
       return max_color + 1;           
-    } // end of compute coloring
+    } // end of greedy coloring
+
+
+    /**
+     * \brief Parallel speculative coloring.
+     *
+     * Each round all uncolored vertices are greedily colored in
+     * parallel using the (possibly stale) colors of their neighbors.
+     * Adjacent vertices colored concurrently may then share a color;
+     * these conflicts are detected in a second parallel pass and the
+     * vertex with the larger id is recolored in the next round.
+     */
+    size_t speculative_coloring() {
+      const vertex_color_type UNCOLORED(-1);
+      // Color high degree vertices first
+      std::vector<std::pair<size_t, vertex_id_type> > 
+        permutation(num_vertices());
+#pragma omp parallel for
+      for(ssize_t v = 0; v < ssize_t(num_vertices()); ++v) {
+        color(v) = UNCOLORED;
+        permutation[v] = 
+          std::make_pair(num_in_neighbors(v) + num_out_neighbors(v), 
+                         vertex_id_type(v));
+      }
+      std::sort(permutation.begin(), permutation.end(),
+                std::greater<std::pair<size_t, vertex_id_type> >());
+      std::vector<vertex_id_type> worklist(num_vertices());
+      for(size_t i = 0; i < permutation.size(); ++i)
+        worklist[i] = permutation[i].second;
+      std::vector<std::pair<size_t, vertex_id_type> >().swap(permutation);
+      // one reusable color mask per thread
+      std::vector<dense_bitset> 
+        used_colors(omp_get_max_threads(), dense_bitset(max_degree() + 1));
+      for(size_t i = 0; i < used_colors.size(); ++i) used_colors[i].clear();
+      std::vector<vertex_id_type> conflicts;
+      while(!worklist.empty()) {
+        // Speculatively color the worklist
+#pragma omp parallel for schedule(dynamic, 64)
+        for(ssize_t i = 0; i < ssize_t(worklist.size()); ++i) {
+          const vertex_id_type vid = worklist[i];
+          color(vid) = 
+            smallest_free_color(vid, used_colors[omp_get_thread_num()]);
+        }
+        // Find the conflicts
+        conflicts.clear();
+#pragma omp parallel
+        {
+          std::vector<vertex_id_type> local_conflicts;
+#pragma omp for schedule(dynamic, 64)
+          for(ssize_t i = 0; i < ssize_t(worklist.size()); ++i) {
+            const vertex_id_type vid = worklist[i];
+            if(has_color_conflict(vid)) local_conflicts.push_back(vid);
+          }
+#pragma omp critical
+          conflicts.insert(conflicts.end(), 
+                           local_conflicts.begin(), local_conflicts.end());
+        }
+        // Conflicts are uncolored before the next round
+        foreach(vertex_id_type vid, conflicts) color(vid) = UNCOLORED;
+        worklist.swap(conflicts);
+      }
+      size_t max_color = 0;
+      for(vertex_id_type v = 0; v < num_vertices(); ++v) 
+        max_color = std::max(max_color, size_t(color(v)));
+      // Return the NUMBER of colors
+      return max_color + 1;
+    } // end of speculative coloring
 
 
     /**
@@ -648,20 +913,46 @@ namespace graphlab {
     
     /** \brief Return the edge ids of the edges arriving at v */
     edge_list in_edge_ids(vertex_id_type v) const {
-      ASSERT_LT(v, in_edges.size());
+      ASSERT_LT(v, vertices.size());
+      if(csr_active) {
+        const size_t len = csr_in_offsets[v+1] - csr_in_offsets[v];
+        return len == 0 ? edge_list() :
+          edge_list(&(csr_in_eids[csr_in_offsets[v]]), len);
+      }
       return edge_list(in_edges[v]);
     } // end of in edges    
 
     /** \brief Return the edge ids of the edges leaving at v */
     edge_list out_edge_ids(vertex_id_type v) const {
-      ASSERT_LT(v, out_edges.size());
+      ASSERT_LT(v, vertices.size());
+      if(csr_active) {
+        const size_t len = csr_out_offsets[v+1] - csr_out_offsets[v];
+        return len == 0 ? edge_list() :
+          edge_list(&(csr_out_eids[csr_out_offsets[v]]), len);
+      }
       return edge_list(out_edges[v]);
     } // end of out edges
+
+    /** 
+     * \brief Hint the processor to start loading the data and the
+     * adjacency of v into cache.  Used by the engines to overlap
+     * memory latency of the next update with the current one.
+     */
+    void prefetch_vertex(vertex_id_type v) const {
+      __builtin_prefetch(vertices.begin() + v);
+      if(csr_active) {
+        __builtin_prefetch(csr_in_eids.begin() + csr_in_offsets[v]);
+        __builtin_prefetch(csr_out_eids.begin() + csr_out_offsets[v]);
+      } else {
+        __builtin_prefetch(&in_edges[v]);
+        __builtin_prefetch(&out_edges[v]);
+      }
+    } // end of prefetch_vertex
     
     /** \brief Get the set of in vertices of vertex v */
     std::vector<vertex_id_type> in_vertices(vertex_id_type v) const {
       std::vector<vertex_id_type> ret;
-      foreach(edge_id_type eid, in_edges[v]) {
+      foreach(edge_id_type eid, in_edge_ids(v)) {
         ret.push_back(edges[eid].source());
       }
       return ret;
@@ -670,7 +961,7 @@ namespace graphlab {
     /** \brief Get the set of out vertices of vertex v */
     std::vector<vertex_id_type> out_vertices(vertex_id_type v) const {
       std::vector<vertex_id_type> ret;
-      foreach(edge_id_type eid, out_edges[v]) {
+      foreach(edge_id_type eid, out_edge_ids(v)) {
         ret.push_back(edges[eid].target());
       }
       return ret;
@@ -692,16 +983,25 @@ namespace graphlab {
           >> out_edges
           >> vcolors
           >> finalized;
+      if(finalized && compact_on_finalize) compact_csr();
+      refresh_hot_data();
     } // end of load
 
     /** \brief Save the graph to an archive */
     void save(oarchive& arc) const {
       // Write the number of edges and vertices
       arc << vertices
-          << edges
-          << in_edges
-          << out_edges
-          << vcolors
+          << edges;
+      // The adjacency is always written in the per vertex layout so
+      // that compacted and uncompacted graphs share a file format
+      if(csr_active) {
+        save_csr_as_vectors(arc, csr_in_offsets, csr_in_eids);
+        save_csr_as_vectors(arc, csr_out_offsets, csr_out_eids);
+      } else {
+        arc << in_edges
+            << out_edges;
+      }
+      arc << vcolors
           << finalized;
     } // end of save
     
@@ -725,6 +1025,224 @@ namespace graphlab {
       fout.close();
     } // end of save
 
+
+    /**
+     * \brief Write the graph to a binary snapshot which can be loaded
+     * with load_snapshot().
+     *
+     * The snapshot stores the raw vertex data, edges, compact
+     * adjacency and colors, each in a page aligned section, so that
+     * it can be memory mapped directly.  The vertex and edge data
+     * must therefore be trivially copyable and the snapshot is only
+     * readable by a binary built with the same data types on the
+     * same architecture (this is verified on load).  The graph must
+     * be finalized.
+     */
+    void save_snapshot(const std::string& filename) const {
+      BOOST_STATIC_ASSERT(boost::has_trivial_copy<VertexData>::value &&
+                          boost::has_trivial_destructor<VertexData>::value);
+      BOOST_STATIC_ASSERT(boost::has_trivial_copy<EdgeData>::value &&
+                          boost::has_trivial_destructor<EdgeData>::value);
+      if(!finalized) {
+        logstream(LOG_FATAL) 
+          << "The graph must be finalized before saving a snapshot" 
+          << std::endl;
+      }
+      snapshot_header header;
+      header.init();
+      header.num_vertices = vertices.size();
+      header.num_edges = edges.size();
+      // Lay out the sections
+      uint64_t offset = snapshot_align(sizeof(snapshot_header));
+      header.vertices_offset = offset;
+      offset = snapshot_align(offset + sizeof(VertexData) * vertices.size());
+      header.edges_offset = offset;
+      offset = snapshot_align(offset + sizeof(edge) * edges.size());
+      header.in_offsets_offset = offset;
+      offset = snapshot_align(offset + sizeof(edge_id_type) * (vertices.size() + 1));
+      header.in_eids_offset = offset;
+      offset = snapshot_align(offset + sizeof(edge_id_type) * edges.size());
+      header.out_offsets_offset = offset;
+      offset = snapshot_align(offset + sizeof(edge_id_type) * (vertices.size() + 1));
+      header.out_eids_offset = offset;
+      offset = snapshot_align(offset + sizeof(edge_id_type) * edges.size());
+      header.colors_offset = offset;
+      offset += sizeof(vertex_color_type) * vertices.size();
+      header.file_size = offset;
+
+      std::ofstream fout(filename.c_str(), std::ios::binary);
+      if(!fout.good()) {
+        logstream(LOG_FATAL) << "Unable to open " << filename 
+                             << " for writing" << std::endl;
+      }
+      snapshot_write(fout, 0, &header, sizeof(snapshot_header));
+      snapshot_write(fout, header.vertices_offset, vertices.begin(),
+                     sizeof(VertexData) * vertices.size());
+      snapshot_write(fout, header.edges_offset, edges.begin(), 
+                     sizeof(edge) * edges.size());
+      if(csr_active) {
+        snapshot_write(fout, header.in_offsets_offset, csr_in_offsets.begin(),
+                       sizeof(edge_id_type) * csr_in_offsets.size());
+        snapshot_write(fout, header.in_eids_offset, csr_in_eids.begin(),
+                       sizeof(edge_id_type) * csr_in_eids.size());
+        snapshot_write(fout, header.out_offsets_offset, csr_out_offsets.begin(),
+                       sizeof(edge_id_type) * csr_out_offsets.size());
+        snapshot_write(fout, header.out_eids_offset, csr_out_eids.begin(),
+                       sizeof(edge_id_type) * csr_out_eids.size());
+      } else {
+        snapshot_write_edge_map(fout, header.in_offsets_offset, 
+                                header.in_eids_offset, in_edges);
+        snapshot_write_edge_map(fout, header.out_offsets_offset, 
+                                header.out_eids_offset, out_edges);
+      }
+      snapshot_write(fout, header.colors_offset, vcolors.begin(),
+                     sizeof(vertex_color_type) * vcolors.size());
+      ASSERT_EQ(uint64_t(fout.tellp()), header.file_size);
+      fout.close();
+    } // end of save snapshot
+
+
+    /**
+     * \brief Load a snapshot written by save_snapshot().
+     *
+     * The file is memory mapped copy-on-write rather than read: the
+     * graph is usable immediately, pages are read from disk as they
+     * are first touched and unmodified pages are shared with any
+     * other process which maps the same snapshot.  Modifying vertex
+     * or edge data only affects this process.  Structural changes
+     * (add_vertex(), add_edge(), ...) copy the affected arrays into
+     * ordinary memory.  The loaded graph is finalized and compact.
+     * The section bounds, the edges and the adjacency are validated
+     * before use, which reads those sections but not the vertex data.
+     */
+    void load_snapshot(const std::string& filename) {
+      boost::shared_ptr<mmap_wrapper> 
+        mapping(new mmap_wrapper(filename, 0, false, true));
+      if(mapping->file_length() < sizeof(snapshot_header)) {
+        logstream(LOG_FATAL) << filename << " is not a graph snapshot" 
+                             << std::endl;
+      }
+      char* base = reinterpret_cast<char*>(mapping->mapped_ptr());
+      const snapshot_header& header = 
+        *reinterpret_cast<const snapshot_header*>(base);
+      snapshot_header expected;
+      expected.init();
+      if(memcmp(header.magic, expected.magic, sizeof(header.magic)) != 0 ||
+         header.version != expected.version) {
+        logstream(LOG_FATAL) << filename << " is not a version " 
+                             << expected.version << " graph snapshot"
+                             << std::endl;
+      }
+      if(header.byte_order != expected.byte_order ||
+         header.vertex_data_size != expected.vertex_data_size ||
+         header.edge_size != expected.edge_size ||
+         header.id_size != expected.id_size) {
+        logstream(LOG_FATAL) 
+          << filename << " was written with different vertex or edge "
+          << "types or on a different architecture" << std::endl;
+      }
+      if(header.file_size > mapping->file_length()) {
+        logstream(LOG_FATAL) << filename << " is truncated" << std::endl;
+      }
+      const uint64_t length = mapping->file_length();
+      const uint64_t nverts = header.num_vertices;
+      const uint64_t nedges = header.num_edges;
+      if(nverts >= uint64_t(vertex_id_type(-1)) || 
+         nedges >= uint64_t(edge_id_type(-1)) ||
+         !snapshot_section_fits(length, header.vertices_offset, 
+                                nverts, sizeof(VertexData)) ||
+         !snapshot_section_fits(length, header.edges_offset, 
+                                nedges, sizeof(edge)) ||
+         !snapshot_section_fits(length, header.in_offsets_offset, 
+                                nverts + 1, sizeof(edge_id_type)) ||
+         !snapshot_section_fits(length, header.in_eids_offset, 
+                                nedges, sizeof(edge_id_type)) ||
+         !snapshot_section_fits(length, header.out_offsets_offset, 
+                                nverts + 1, sizeof(edge_id_type)) ||
+         !snapshot_section_fits(length, header.out_eids_offset, 
+                                nedges, sizeof(edge_id_type)) ||
+         !snapshot_section_fits(length, header.colors_offset, 
+                                nverts, sizeof(vertex_color_type))) {
+        logstream(LOG_FATAL) << filename << " is corrupt: a section lies "
+                             << "outside of the file" << std::endl;
+      }
+      const edge* snapshot_edges = 
+        reinterpret_cast<const edge*>(base + header.edges_offset);
+      if(!snapshot_csr_valid(snapshot_edges, nverts, nedges, true,
+                             reinterpret_cast<const edge_id_type*>
+                             (base + header.in_offsets_offset),
+                             reinterpret_cast<const edge_id_type*>
+                             (base + header.in_eids_offset)) ||
+         !snapshot_csr_valid(snapshot_edges, nverts, nedges, false,
+                             reinterpret_cast<const edge_id_type*>
+                             (base + header.out_offsets_offset),
+                             reinterpret_cast<const edge_id_type*>
+                             (base + header.out_eids_offset))) {
+        logstream(LOG_FATAL) << filename << " is corrupt: invalid "
+                             << "adjacency" << std::endl;
+      }
+      clear();
+      vertices.map(mapping, reinterpret_cast<VertexData*>
+                   (base + header.vertices_offset), nverts);
+      edges.map(mapping, reinterpret_cast<edge*>
+                (base + header.edges_offset), nedges);
+      csr_in_offsets.map(mapping, reinterpret_cast<edge_id_type*>
+                         (base + header.in_offsets_offset), nverts + 1);
+      csr_in_eids.map(mapping, reinterpret_cast<edge_id_type*>
+                      (base + header.in_eids_offset), nedges);
+      csr_out_offsets.map(mapping, reinterpret_cast<edge_id_type*>
+                          (base + header.out_offsets_offset), nverts + 1);
+      csr_out_eids.map(mapping, reinterpret_cast<edge_id_type*>
+                       (base + header.out_eids_offset), nedges);
+      vcolors.map(mapping, reinterpret_cast<vertex_color_type*>
+                  (base + header.colors_offset), nverts);
+      csr_active = true;
+      finalized = true;
+      refresh_hot_data();
+    } // end of load snapshot
+
+    /** \brief Returns true if any of the graph data is still backed
+        by a snapshot */
+    bool is_mapped() const {
+      return vertices.is_mapped() || edges.is_mapped();
+    }
+
+    /**
+     * \brief Place the graph data on the NUMA nodes of the map.
+     *
+     * The vertex data, colors and hot data of the vertices owned by
+     * each node, together with their compact adjacency, are moved to
+     * that node.  The edges are split into equal contiguous ranges
+     * since they are mostly grouped by source.  The per vertex edge
+     * vectors of a graph which is not compact are left in place.
+     * Returns false if the placement is not supported.
+     */
+    bool numa_bind(const numa_map& map) const {
+      if(map.num_nodes() < 2) return true;
+      bool success = true;
+      for(size_t n = 0; n < map.num_nodes(); ++n) {
+        const size_t node = map.node_id(n);
+        const size_t vbegin = map.vertex_begin(n);
+        const size_t vend = map.vertex_begin(n + 1);
+        success &= numa_bind_range(vertices, vbegin, vend, node);
+        numa_bind_range(vcolors, vbegin, vend, node);
+        numa_bind_range(vertex_hot, vbegin, vend, node);
+        if(csr_active) {
+          numa_bind_range(csr_in_offsets, vbegin, vend, node);
+          numa_bind_range(csr_out_offsets, vbegin, vend, node);
+          numa_bind_range(csr_in_eids, csr_in_offsets[vbegin], 
+                          csr_in_offsets[vend], node);
+          numa_bind_range(csr_out_eids, csr_out_offsets[vbegin], 
+                          csr_out_offsets[vend], node);
+        }
+        const size_t ebegin = (n * edges.size()) / map.num_nodes();
+        const size_t eend = ((n + 1) * edges.size()) / map.num_nodes();
+        numa_bind_range(edges, ebegin, eend, node);
+        numa_bind_range(edge_hot, ebegin, eend, node);
+      }
+      return success;
+    } // end of numa bind
+
     /**
      * \brief save the adjacency structure to a text file.
      *
@@ -752,6 +1270,78 @@ namespace graphlab {
 
 
 
+    /**
+     * \brief Renumber the vertices of the graph.
+     *
+     * Vertex v is moved to position perm[v].  The vertex data, colors
+     * and edges are permuted in place and the edges are renumbered so
+     * that edge ids are ordered by (new source, new target).  As a
+     * consequence any previously stored edge ids are invalidated.  The
+     * graph is finalized on return and kept compact if it was compact
+     * before.  See graph_reordering.hpp for methods which compute
+     * locality improving permutations.
+     *
+     * \param perm A permutation of [0, num_vertices()) mapping old
+     * vertex ids to new vertex ids
+     */
+    void permute_vertices(const std::vector<vertex_id_type>& perm) {
+      ASSERT_EQ(perm.size(), num_vertices());
+      // Check that perm is a permutation and build the inverse
+      std::vector<vertex_id_type> inverse(perm.size(), vertex_id_type(-1));
+      for(size_t i = 0; i < perm.size(); ++i) {
+        ASSERT_LT(perm[i], perm.size());
+        ASSERT_EQ(inverse[perm[i]], vertex_id_type(-1));
+        inverse[perm[i]] = vertex_id_type(i);
+      }
+      const bool was_compact = csr_active;
+      expand_csr();
+      // Move the vertex data and colors
+      {
+        mmap_vector<VertexData> new_vertices(vertices.size());
+        mmap_vector<vertex_color_type> new_vcolors(vcolors.size());
+#pragma omp parallel for
+        for(ssize_t i = 0; i < ssize_t(inverse.size()); ++i) {
+          new_vertices[i] = vertices[inverse[i]];
+          new_vcolors[i] = vcolors[inverse[i]];
+        }
+        vertices.swap(new_vertices);
+        vcolors.swap(new_vcolors);
+      }
+      // Edges are stored grouped by source in the new numbering.  The
+      // out edges of the old source already determine this order so
+      // we walk the sources in new order.
+      {
+        mmap_vector<edge> new_edges;
+        new_edges.reserve(edges.size());
+        std::vector< std::pair<vertex_id_type, edge_id_type> > local;
+        for(size_t newsrc = 0; newsrc < inverse.size(); ++newsrc) {
+          local.clear();
+          foreach(edge_id_type eid, out_edges[inverse[newsrc]]) 
+            local.push_back(std::make_pair(perm[edges[eid].target()], eid));
+          std::sort(local.begin(), local.end());
+          for(size_t j = 0; j < local.size(); ++j) {
+            new_edges.push_back(edge(vertex_id_type(newsrc), local[j].first,
+                                     edges[local[j].second].data()));
+          }
+        }
+        ASSERT_EQ(new_edges.size(), edges.size());
+        edges.swap(new_edges);
+      }
+      // Rebuild the adjacency.  Since the edges are sorted by
+      // (source, target) pushing them in order produces sorted edge
+      // sets so the graph is immediately finalized.
+      std::vector< std::vector<edge_id_type> >(vertices.size()).swap(in_edges);
+      std::vector< std::vector<edge_id_type> >(vertices.size()).swap(out_edges);
+      for(edge_id_type eid = 0; eid < edges.size(); ++eid) {
+        in_edges[edges[eid].target()].push_back(eid);
+        out_edges[edges[eid].source()].push_back(eid);
+      }
+      finalized = true;
+      if(was_compact || compact_on_finalize) compact_csr();
+      refresh_hot_data();
+    } // end of permute vertices
+
+
     /**
      * builds a topological_sort of the graph returning it in topsort. 
      * 
@@ -830,7 +1420,11 @@ namespace graphlab {
       }
     }; // end of edge_data
 
+  public:
+    /** The type of an edge.  Can be used to build a range for add_edges() */
+    typedef edge edge_type;
 
+  private:
     
     struct edge_id_less_functor {
       graph* g_ptr;
@@ -857,37 +1451,433 @@ namespace graphlab {
  
     // PRIVATE DATA MEMBERS ===================================================>    
     /** The vertex data is simply a vector of vertex data */
-    std::vector<VertexData> vertices;
+    mmap_vector<VertexData> vertices;
 
     /** The edge data is a vector of edges where each edge stores its
         source, destination, and data. */
-    std::vector<edge> edges;
+    mmap_vector<edge> edges;
     
     /** A map from src_vertex -> dest_vertex -> edge index */   
     std::vector< std::vector<edge_id_type> >  in_edges;
     
     /** A map from src_vertex -> dest_vertex -> edge index */   
     std::vector< std::vector<edge_id_type> >  out_edges;
+
+    /** The compact in edge layout: the in edges of vertex v are
+        csr_in_eids[csr_in_offsets[v] ... csr_in_offsets[v+1]) */
+    mmap_vector<edge_id_type> csr_in_offsets;
+    mmap_vector<edge_id_type> csr_in_eids;
+
+    /** The compact out edge layout (same structure as the in edges) */
+    mmap_vector<edge_id_type> csr_out_offsets;
+    mmap_vector<edge_id_type> csr_out_eids;
     
+    /** Dense copies of the hot fields of the vertex and edge data.
+        These are empty unless hot_data_traits is specialized. */
+    std::vector<vertex_hot_type> vertex_hot;
+    std::vector<edge_hot_type> edge_hot;
+
     /** The vertex colors specified by the user. **/
-    std::vector< vertex_color_type > vcolors;  
+    mmap_vector< vertex_color_type > vcolors;  
     
     /** Mark whether the graph is finalized.  Graph finalization is a
         costly procedure but it can also dramatically improve
         performance. */
     bool finalized;
+
+    /** If set, finalize() packs the adjacency into the csr arrays */
+    bool compact_on_finalize;
+
+    /** True if the adjacency is currently stored in the csr arrays
+        (in which case in_edges and out_edges are empty) */
+    bool csr_active;
     
     /** increments whenever the graph is cleared. Used to track the
      *  changes to the graph structure  */
     size_t changeid;
 
+    /** 
+     * The header of a binary snapshot.  All offsets are in bytes from
+     * the start of the file.
+     */
+    struct snapshot_header {
+      char magic[8];
+      uint32_t version;
+      uint32_t byte_order;
+      uint32_t vertex_data_size;
+      uint32_t edge_size;
+      uint32_t id_size;
+      uint32_t reserved;
+      uint64_t num_vertices;
+      uint64_t num_edges;
+      uint64_t vertices_offset;
+      uint64_t edges_offset;
+      uint64_t in_offsets_offset;
+      uint64_t in_eids_offset;
+      uint64_t out_offsets_offset;
+      uint64_t out_eids_offset;
+      uint64_t colors_offset;
+      uint64_t file_size;
+      /** Fill in the fields which identify the format and types */
+      void init() {
+        memset(this, 0, sizeof(snapshot_header));
+        memcpy(magic, "GLGRAPH", 8);
+        version = 1;
+        byte_order = 0x01020304;
+        vertex_data_size = sizeof(VertexData);
+        edge_size = sizeof(edge);
+        id_size = sizeof(edge_id_type);
+      }
+    };
+
+    /** Sections of a snapshot are page aligned */
+    static uint64_t snapshot_align(uint64_t offset) {
+      const uint64_t ALIGNMENT = 4096;
+      return (offset + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+    }
+
+    /** 
+     * Returns true if count elements of elemsize bytes starting at
+     * offset lie within a file of length bytes and are aligned.
+     */
+    static bool snapshot_section_fits(uint64_t length, uint64_t offset,
+                                      uint64_t count, uint64_t elemsize) {
+      if(offset > length || offset % sizeof(uint64_t) != 0) return false;
+      return count <= (length - offset) / elemsize;
+    }
+
+    /**
+     * Returns true if the offsets of a compact adjacency start at 0,
+     * never decrease and end at nedges, and if the edges listed for
+     * each vertex have that vertex as their target (if by_target is
+     * set) or source.  This also checks the vertex ids of the edges.
+     */
+    static bool snapshot_csr_valid(const edge* snapshot_edges,
+                                   uint64_t nverts, uint64_t nedges,
+                                   bool by_target,
+                                   const edge_id_type* offsets,
+                                   const edge_id_type* eids) {
+      if(offsets[0] != 0 || offsets[nverts] != nedges) return false;
+      for(uint64_t v = 0; v < nverts; ++v) {
+        if(offsets[v] > offsets[v + 1] || offsets[v + 1] > nedges) 
+          return false;
+        for(edge_id_type i = offsets[v]; i < offsets[v + 1]; ++i) {
+          if(eids[i] >= nedges) return false;
+          const edge& e = snapshot_edges[eids[i]];
+          if((by_target ? e.target() : e.source()) != v) return false;
+        }
+      }
+      return true;
+    }
+
+    /** Write len bytes at offset padding the file with zeros */
+    static void snapshot_write(std::ofstream& fout, uint64_t offset,
+                               const void* ptr, size_t len) {
+      const uint64_t pos = fout.tellp();
+      ASSERT_LE(pos, offset);
+      for(uint64_t i = pos; i < offset; ++i) fout.put(0);
+      if(len > 0) fout.write(reinterpret_cast<const char*>(ptr), len);
+      ASSERT_TRUE(fout.good());
+    }
+
+    /** Write a per vertex edge map in the compact layout */
+    static void snapshot_write_edge_map(std::ofstream& fout,
+                                        uint64_t offsets_offset,
+                                        uint64_t eids_offset,
+                                        const std::vector< std::vector<edge_id_type> >& emap) {
+      std::vector<edge_id_type> offsets(emap.size() + 1, 0);
+      for(size_t i = 0; i < emap.size(); ++i) 
+        offsets[i+1] = offsets[i] + edge_id_type(emap[i].size());
+      snapshot_write(fout, offsets_offset, &offsets[0], 
+                     sizeof(edge_id_type) * offsets.size());
+      snapshot_write(fout, eids_offset, NULL, 0);
+      for(size_t i = 0; i < emap.size(); ++i) {
+        if(!emap[i].empty()) 
+          fout.write(reinterpret_cast<const char*>(&emap[i][0]), 
+                     sizeof(edge_id_type) * emap[i].size());
+      }
+      ASSERT_TRUE(fout.good());
+    }
+
     // PRIVATE HELPERS =========================================================>
+    /**
+     * Sort each edge set in the edge map and check for duplicate
+     * edges.  The edge sets are processed in order of decreasing size
+     * with dynamic scheduling so that a few very high degree vertices
+     * do not leave the remaining threads idle.
+     */
+    void sort_edge_map(std::vector< std::vector<edge_id_type> >& emap) {
+      typedef std::vector< edge_id_type > edge_set;
+      edge_id_less_functor less_functor(this);
+      // Only sets with more than one edge need to be sorted
+      std::vector< std::pair<size_t, vertex_id_type> > order;
+      for(size_t i = 0; i < emap.size(); ++i) {
+        if(emap[i].size() > 1) 
+          order.push_back(std::make_pair(emap[i].size(), vertex_id_type(i)));
+      }
+      std::sort(order.begin(), order.end(), 
+                std::greater< std::pair<size_t, vertex_id_type> >());
+      // Exceptions must not escape the parallel region
+      edge_id_type duplicate = edge_id_type(-1);
+#pragma omp parallel for schedule(dynamic, 16)
+      for(ssize_t i = 0; i < ssize_t(order.size()); ++i) {
+        edge_set& eset(emap[order[i].second]);
+        // Sort the edge vector
+        std::sort(eset.begin(),
+                  eset.end(),
+                  less_functor);
+        record_duplicate_edge(duplicate, 
+                              find_duplicate_edge(eset.begin(), eset.end()));
+      }
+      report_duplicate_edge(duplicate);
+    } // end of sort edge map
+
+    /** Bind the elements [begin, end) of an array to a NUMA node */
+    template<typename Vector>
+    static bool numa_bind_range(const Vector& vec, size_t begin, size_t end,
+                                size_t node) {
+      if(end <= begin || end > vec.size()) return true;
+      typedef typename Vector::value_type value_type;
+      return numa_bind_memory(&(vec[begin]), (end - begin) * sizeof(value_type),
+                              node);
+    } // end of numa bind range
+
+    /** 
+     * Returns an edge of the sorted edge set which has a duplicate,
+     * or edge_id_type(-1) if there is none.
+     */
+    template<typename Iterator>
+    edge_id_type find_duplicate_edge(Iterator begin, Iterator end) const {
+      if(begin == end) return edge_id_type(-1);
+      for(Iterator next = begin + 1; next != end; ++begin, ++next) {
+        // Duplicate edge test
+        if(!edge_id_less(*begin, *next)) return *begin;
+      }
+      return edge_id_type(-1);
+    } // end of find duplicate edge
+
+    /** 
+     * Keeps the first duplicate edge found by the threads of a
+     * parallel region in duplicate, which starts as edge_id_type(-1).
+     */
+    static void record_duplicate_edge(edge_id_type& duplicate, 
+                                      edge_id_type eid) {
+      if(eid != edge_id_type(-1)) 
+        atomic_compare_and_swap(duplicate, edge_id_type(-1), eid);
+    } // end of record duplicate edge
+
+    /** Fail if a duplicate edge was recorded.  Call outside of parallel regions. */
+    void report_duplicate_edge(edge_id_type duplicate) const {
+      if(duplicate != edge_id_type(-1)) {
+        logstream(LOG_FATAL)
+          << "Duplicate edge "
+          << "(" << source(duplicate) << ", " << target(duplicate) << ") "
+          << "found!  GraphLab does not support graphs "
+          << "with duplicate edges." << std::endl;
+      }
+    } // end of report duplicate edge
+
+    /**
+     * Build a sorted offset and index array over the edges with ids
+     * first and above, grouped by target if by_target is set and by
+     * source otherwise.  degree holds the number of new edges of each
+     * vertex and is used as scratch space.  add_edges has already
+     * rejected duplicate edges.
+     */
+    void bucket_new_edges(size_t first, bool by_target,
+                          std::vector< atomic<edge_id_type> >& degree,
+                          mmap_vector<edge_id_type>& offsets,
+                          mmap_vector<edge_id_type>& eids) {
+      offsets.resize(degree.size() + 1);
+      offsets[0] = 0;
+      for(size_t i = 0; i < degree.size(); ++i) {
+        offsets[i+1] = offsets[i] + degree[i].value;
+        // degree becomes the insertion cursor
+        degree[i].value = offsets[i];
+      }
+      eids.resize(edges.size() - first);
+#pragma omp parallel for
+      for(ssize_t i = ssize_t(first); i < ssize_t(edges.size()); ++i) {
+        const vertex_id_type v = 
+          by_target? edges[i].target() : edges[i].source();
+        eids[degree[v].inc_ret_last()] = edge_id_type(i);
+      }
+      edge_id_less_functor less_functor(this);
+#pragma omp parallel for schedule(dynamic, 64)
+      for(ssize_t i = 0; i < ssize_t(degree.size()); ++i) {
+        if(offsets[i+1] - offsets[i] < 2) continue;
+        edge_id_type* begin = &(eids[offsets[i]]);
+        edge_id_type* end = begin + (offsets[i+1] - offsets[i]);
+        std::sort(begin, end, less_functor);
+      }
+    } // end of bucket new edges
+
+    /**
+     * Merge the sorted buckets built by bucket_new_edges into the
+     * sorted edge map growing each edge set exactly once.
+     */
+    void merge_edge_map(std::vector< std::vector<edge_id_type> >& emap,
+                        const mmap_vector<edge_id_type>& offsets,
+                        const mmap_vector<edge_id_type>& eids) {
+      ASSERT_EQ(emap.size() + 1, offsets.size());
+      edge_id_less_functor less_functor(this);
+#pragma omp parallel for schedule(dynamic, 64)
+      for(ssize_t i = 0; i < ssize_t(emap.size()); ++i) {
+        if(offsets[i+1] == offsets[i]) continue;
+        std::vector<edge_id_type>& eset(emap[i]);
+        const size_t old_size = eset.size();
+        eset.reserve(old_size + offsets[i+1] - offsets[i]);
+        eset.insert(eset.end(), eids.begin() + offsets[i], 
+                    eids.begin() + offsets[i+1]);
+        std::inplace_merge(eset.begin(), eset.begin() + old_size, eset.end(),
+                           less_functor);
+      }
+    } // end of merge edge map
+
+    /** The largest in + out degree of any vertex */
+    size_t max_degree() const {
+      size_t ret = 0;
+      for(vertex_id_type v = 0; v < num_vertices(); ++v) 
+        ret = std::max(ret, num_in_neighbors(v) + num_out_neighbors(v));
+      return ret;
+    } // end of max degree
+
+    /**
+     * Returns the smallest color not used by any neighbor of vid.
+     * used_colors must be clear and large enough to hold the degree
+     * of vid plus one.  It is left clear on return.
+     */
+    vertex_color_type smallest_free_color(vertex_id_type vid,
+                                          dense_bitset& used_colors) const {
+      const edge_list in_eids = in_edge_ids(vid);
+      const edge_list out_eids = out_edge_ids(vid);
+      // A vertex with d neighbors can always use a color <= d so
+      // larger neighbor colors can be ignored
+      const size_t degree = in_eids.size() + out_eids.size();
+      foreach(edge_id_type eid, in_eids) {
+        const vertex_color_type c = color(source(eid));
+        if(c <= degree) used_colors.set_bit_unsync(c);
+      }
+      foreach(edge_id_type eid, out_eids) {
+        const vertex_color_type c = color(target(eid));
+        if(c <= degree) used_colors.set_bit_unsync(c);
+      }
+      // At most degree of the degree + 1 bits are set
+      vertex_color_type ret = 0;
+      while(ret < degree && used_colors.get(ret)) ++ret;
+      // The neighbors may be recolored concurrently, so reset every
+      // bit which may have been set rather than reading their colors
+      // again
+      for(size_t c = 0; c <= degree; ++c) used_colors.clear_bit_unsync(c);
+      return ret;
+    } // end of smallest free color
+
+    /** 
+     * Returns true if vid shares its color with a neighbor with a
+     * smaller id.  Used to break ties in speculative coloring.
+     */
+    bool has_color_conflict(vertex_id_type vid) const {
+      const vertex_color_type vcolor = color(vid);
+      foreach(edge_id_type eid, in_edge_ids(vid)) {
+        const vertex_id_type nbr = source(eid);
+        if(nbr < vid && color(nbr) == vcolor) return true;
+      }
+      foreach(edge_id_type eid, out_edge_ids(vid)) {
+        const vertex_id_type nbr = target(eid);
+        if(nbr < vid && color(nbr) == vcolor) return true;
+      }
+      return false;
+    } // end of has color conflict
+
+    /**
+     * Pack a per vertex edge map into an offset and index array
+     * releasing the memory held by the edge map.
+     */
+    static void pack_edge_map(std::vector< std::vector<edge_id_type> >& emap,
+                              mmap_vector<edge_id_type>& offsets,
+                              mmap_vector<edge_id_type>& eids) {
+      offsets.resize(emap.size() + 1);
+      offsets[0] = 0;
+      for(size_t i = 0; i < emap.size(); ++i) 
+        offsets[i+1] = offsets[i] + edge_id_type(emap[i].size());
+      eids.resize(offsets.back());
+#pragma omp parallel for
+      for(ssize_t i = 0; i < ssize_t(emap.size()); ++i) {
+        std::copy(emap[i].begin(), emap[i].end(), eids.begin() + offsets[i]);
+      }
+      std::vector< std::vector<edge_id_type> >().swap(emap);
+    } // end of pack edge map
+
+    /**
+     * Inverse of pack_edge_map.  Rebuilds the per vertex edge map and
+     * releases the offset and index arrays.
+     */
+    static void unpack_edge_map(mmap_vector<edge_id_type>& offsets,
+                                mmap_vector<edge_id_type>& eids,
+                                std::vector< std::vector<edge_id_type> >& emap) {
+      ASSERT_FALSE(offsets.empty());
+      emap.resize(offsets.size() - 1);
+#pragma omp parallel for
+      for(ssize_t i = 0; i < ssize_t(emap.size()); ++i) {
+        emap[i].assign(eids.begin() + offsets[i], eids.begin() + offsets[i+1]);
+      }
+      mmap_vector<edge_id_type>().swap(offsets);
+      mmap_vector<edge_id_type>().swap(eids);
+    } // end of unpack edge map
+
+    /** Switch to the compact adjacency layout */
+    void compact_csr() {
+      ASSERT_TRUE(finalized);
+      if(csr_active) return;
+      pack_edge_map(in_edges, csr_in_offsets, csr_in_eids);
+      pack_edge_map(out_edges, csr_out_offsets, csr_out_eids);
+      csr_active = true;
+    } // end of compact csr
+
+    /** Switch back to the growable adjacency layout */
+    void expand_csr() {
+      if(!csr_active) return;
+      unpack_edge_map(csr_in_offsets, csr_in_eids, in_edges);
+      unpack_edge_map(csr_out_offsets, csr_out_eids, out_edges);
+      csr_active = false;
+    } // end of expand csr
+
+    /** Release the compact adjacency layout without expanding it */
+    void clear_csr() {
+      csr_in_offsets.clear();
+      csr_in_eids.clear();
+      csr_out_offsets.clear();
+      csr_out_eids.clear();
+      csr_active = false;
+    } // end of clear csr
+
+    /**
+     * Write a compact edge map in the same format as
+     * std::vector<std::vector<edge_id_type> > so that it can be read
+     * back into the growable layout.
+     */
+    static void save_csr_as_vectors(oarchive& arc,
+                                    const mmap_vector<edge_id_type>& offsets,
+                                    const mmap_vector<edge_id_type>& eids) {
+      // The vector serializer writes the length followed by
+      // serialize_iterator() which writes the length again
+      const size_t numv = offsets.size() - 1;
+      arc << numv << numv;
+      for(size_t i = 0; i < numv; ++i) {
+        const size_t len = offsets[i+1] - offsets[i];
+        // matches the layout written by the std::vector serializer
+        const edge_id_type* ptr = (len > 0) ? &(eids[offsets[i]]) : NULL;
+        arc << len;
+        serialize_iterator(arc, ptr, ptr + len);
+      }
+    } // end of save csr as vectors
+
     /**
      * This function tries to find the edge in the vector.  If it
      * fails it returns size_t(-1)
      * TODO: switch to stl binary search
      */
-    size_t binary_search(const std::vector<edge_id_type>& vec,
+    size_t binary_search(const edge_list& vec,
                          vertex_id_type source, vertex_id_type target) const {
       // Ensure that the graph is finalized before calling this function
       //      finalize();
@@ -910,7 +1900,8 @@ namespace graphlab {
         // otherwise search further
         if(std::make_pair(source, target) <
            std::make_pair(mid_source, mid_target) ) {
-          ASSERT_GT(mid, 0);
+          // Nothing is left of the first edge
+          if(mid == 0) return -1;
           // Search left
           last = mid - 1;
         } else {
@@ -25,6 +25,8 @@
 
 #include <graphlab/graph/graph.hpp>
 #include <graphlab/graph/graph_partitioner.hpp>
+#include <graphlab/graph/graph_reordering.hpp>
+#include <graphlab/graph/graph_loader.hpp>
 #include <graphlab/graph/disk_graph.hpp>
 
 
@@ -0,0 +1,488 @@
+/**  
+ * Copyright (c) 2009 Carnegie Mellon University. 
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+
+/**
+ * \file graph_loader.hpp 
+ *
+ * This file contains a parallel loader which builds a graph from one
+ * or more text files.
+ *
+ */
+
+#ifndef GRAPHLAB_GRAPH_LOADER_HPP
+#define GRAPHLAB_GRAPH_LOADER_HPP
+
+#include <omp.h>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+
+#include <boost/filesystem.hpp>
+
+#include <graphlab/logger/logger.hpp>
+#include <graphlab/logger/assertions.hpp>
+#include <graphlab/graph/graph.hpp>
+
+
+#include <graphlab/macros_def.hpp>
+namespace graphlab { 
+
+  /**
+   * An edge produced by one of the graph_loader line parsers.  The
+   * weight is converted into the graph edge data when the edge is
+   * inserted.
+   */
+  struct parsed_edge {
+    vertex_id_t source;
+    vertex_id_t target;
+    double weight;
+    parsed_edge(vertex_id_t source = 0, vertex_id_t target = 0,
+                double weight = 1.0) :
+      source(source), target(target), weight(weight) { }
+  };
+
+
+  /**
+   * Parses lines of the form "source target [weight]".  Lines
+   * starting with '#' or '%' are treated as comments.
+   */
+  struct edge_list_parser {
+    /** 
+     * Called once for every file before it is split.  Consumes any
+     * header and returns the byte offset of the first data line.
+     */
+    size_t begin_file(std::istream& fin) { return 0; }
+
+    /**
+     * Parse a single null terminated line appending the edges to
+     * edges.  Returns false if the line is malformed.
+     */
+    bool parse_line(const char* line, std::vector<parsed_edge>& edges) const {
+      char* end = NULL;
+      const unsigned long source = strtoul(line, &end, 10);
+      if(end == line) return false;
+      line = end;
+      const unsigned long target = strtoul(line, &end, 10);
+      if(end == line) return false;
+      line = end;
+      double weight = strtod(line, &end);
+      if(end == line) weight = 1.0;
+      edges.push_back(parsed_edge(vertex_id_t(source), vertex_id_t(target),
+                                  weight));
+      return true;
+    }
+  }; // end of edge_list_parser
+
+
+  /**
+   * Parses lines of the form "source target1 target2 ..." where each
+   * line lists the out neighbors of source.  All edges have weight
+   * 1. Lines starting with '#' or '%' are treated as comments.
+   */
+  struct adjacency_list_parser {
+    size_t begin_file(std::istream& fin) { return 0; }
+
+    bool parse_line(const char* line, std::vector<parsed_edge>& edges) const {
+      char* end = NULL;
+      const unsigned long source = strtoul(line, &end, 10);
+      if(end == line) return false;
+      while(true) {
+        line = end;
+        const unsigned long target = strtoul(line, &end, 10);
+        if(end == line) break;
+        edges.push_back(parsed_edge(vertex_id_t(source), vertex_id_t(target)));
+      }
+      // anything left over other than whitespace is an error
+      while(*end != '\0' && isspace(*end)) ++end;
+      return *end == '\0';
+    }
+  }; // end of adjacency_list_parser
+
+
+  /**
+   * Parses a Matrix Market coordinate file.  Entry (i, j) becomes the
+   * edge (i-1) -> (j-1).  If bipartite is set the columns are
+   * numbered after the rows, i.e. entry (i, j) becomes the edge
+   * (i-1) -> (nrows + j-1).  Symmetric matrices produce an edge in
+   * each direction and pattern matrices produce edges of weight 1.
+   *
+   * The banner is parsed directly rather than through libs/matrixmarket
+   * since mmio is not part of the graphlab library.
+   */
+  struct matrix_market_parser {
+    bool bipartite;
+    bool symmetric;
+    size_t nrows, ncols, nnz;
+    matrix_market_parser(bool bipartite = false) : 
+      bipartite(bipartite), symmetric(false), nrows(0), ncols(0), nnz(0) { }
+
+    size_t begin_file(std::istream& fin) {
+      size_t offset = 0;
+      std::string line;
+      // Only the first shard of a matrix carries the banner
+      if(fin.peek() != '%') return 0;
+      std::getline(fin, line);
+      offset += line.size() + 1;
+      std::string banner, object, format, field, symmetry;
+      std::stringstream strm(line);
+      strm >> banner >> object >> format >> field >> symmetry;
+      std::transform(format.begin(), format.end(), format.begin(), ::tolower);
+      std::transform(symmetry.begin(), symmetry.end(), symmetry.begin(), 
+                     ::tolower);
+      if(banner != "%%MatrixMarket" || format != "coordinate") {
+        logstream(LOG_FATAL) 
+          << "Only Matrix Market coordinate files are supported: " 
+          << line << std::endl;
+      }
+      symmetric = (symmetry == "symmetric" || symmetry == "hermitian" ||
+                   symmetry == "skew-symmetric");
+      // skip the comments
+      while(fin.good() && fin.peek() == '%') {
+        std::getline(fin, line);
+        offset += line.size() + 1;
+      }
+      // read the size line
+      std::getline(fin, line);
+      offset += line.size() + 1;
+      std::stringstream sizestrm(line);
+      sizestrm >> nrows >> ncols >> nnz;
+      if(sizestrm.fail()) {
+        logstream(LOG_FATAL) << "Invalid Matrix Market size line: " 
+                             << line << std::endl;
+      }
+      return offset;
+    }
+
+    bool parse_line(const char* line, std::vector<parsed_edge>& edges) const {
+      char* end = NULL;
+      const unsigned long row = strtoul(line, &end, 10);
+      if(end == line || row == 0) return false;
+      line = end;
+      const unsigned long col = strtoul(line, &end, 10);
+      if(end == line || col == 0) return false;
+      line = end;
+      double weight = strtod(line, &end);
+      if(end == line) weight = 1.0;
+      const vertex_id_t source = vertex_id_t(row - 1);
+      const vertex_id_t target = 
+        vertex_id_t(bipartite? nrows + col - 1 : col - 1);
+      edges.push_back(parsed_edge(source, target, weight));
+      if(symmetric && !bipartite && source != target)
+        edges.push_back(parsed_edge(target, source, weight));
+      return true;
+    }
+  }; // end of matrix_market_parser
+
+
+  /**
+   * The default conversion from a parsed edge weight to the graph
+   * edge data.  Requires that EdgeData is constructible from a double.
+   */
+  template<typename EdgeData>
+  struct weight_to_edge_data {
+    EdgeData operator()(double weight) const { return EdgeData(weight); }
+  };
+
+
+
+  struct graph_loader {
+
+    /**
+       \brief the supported file formats
+    */
+    enum file_format {
+      FORMAT_EDGE_LIST,     /**< "source target [weight]" per line */
+      FORMAT_ADJACENCY_LIST,/**< "source target1 target2 ..." per line */
+      FORMAT_MATRIX_MARKET, /**< Matrix Market coordinate format */
+    };
+
+    /// Converts a file_format to a string
+    inline static std::string enum_to_string(file_format val) {
+      switch(val) {
+      case FORMAT_EDGE_LIST:
+        return "edge_list";
+      case FORMAT_ADJACENCY_LIST:
+        return "adjacency_list";
+      case FORMAT_MATRIX_MARKET:
+        return "matrix_market";
+      default:
+        return "";
+      }
+    }
+
+    /// Converts a string to a file_format. Returns true on success
+    inline static bool string_to_enum(std::string s, file_format &val) {
+      if (s == "edge_list") {
+        val = FORMAT_EDGE_LIST;
+        return true;
+      }
+      else if (s == "adjacency_list") {
+        val = FORMAT_ADJACENCY_LIST;
+        return true;
+      }
+      else if (s == "matrix_market") {
+        val = FORMAT_MATRIX_MARKET;
+        return true;
+      }
+      return false;
+    }
+
+
+    /**
+     * \brief Parse a file, or every file in a directory of shards,
+     * into one vector of edges per chunk.  The files are split into
+     * byte ranges which are parsed in parallel; every range begins on
+     * the first line which starts inside it.
+     *
+     * \param path A file or a directory of shards
+     * \param parser A line parser such as edge_list_parser
+     * \param[out] buffers The parsed edges.  Self edges are dropped.
+     * \param nthreads The number of threads. If 0 the OpenMP default
+     * is used.
+     */
+    template <typename Parser>
+    inline static void parse(const std::string& path, Parser& parser,
+                             std::vector< std::vector<parsed_edge> >& buffers,
+                             size_t nthreads = 0) {
+      std::vector<std::string> files;
+      list_shards(path, files);
+      // Build the list of byte ranges
+      std::vector<chunk> chunks;
+      if(nthreads == 0) nthreads = omp_get_max_threads();
+      for(size_t i = 0; i < files.size(); ++i) {
+        std::ifstream fin(files[i].c_str(), std::ios::binary);
+        if(!fin.good()) {
+          logstream(LOG_FATAL) << "Unable to open " << files[i] << std::endl;
+        }
+        const size_t begin = parser.begin_file(fin);
+        fin.clear();
+        fin.seekg(0, std::ios::end);
+        const size_t end = fin.tellg();
+        if(begin >= end) continue;
+        // several ranges per thread balances the uneven line lengths
+        const size_t chunk_size = 
+          std::max(size_t(MIN_CHUNK_SIZE), (end - begin) / (4 * nthreads) + 1);
+        for(size_t start = begin; start < end; start += chunk_size) 
+          chunks.push_back(chunk(i, start, std::min(end, start + chunk_size)));
+      }
+      buffers.clear();
+      buffers.resize(chunks.size());
+      const Parser& const_parser(parser);
+      size_t nerrors = 0, nself = 0;
+#pragma omp parallel for schedule(dynamic, 1) num_threads(nthreads) reduction(+ : nerrors, nself)
+      for(ssize_t i = 0; i < ssize_t(chunks.size()); ++i) {
+        parse_chunk(files[chunks[i].file], chunks[i], const_parser,
+                    buffers[i], nerrors, nself);
+      }
+      if(nerrors > 0) {
+        logstream(LOG_WARNING) << "Skipped " << nerrors 
+                               << " malformed lines in " << path << std::endl;
+      }
+      if(nself > 0) {
+        logstream(LOG_WARNING) << "Skipped " << nself 
+                               << " self edges in " << path << std::endl;
+      }
+    } // end of parse
+
+
+    /**
+     * \brief Load a file, or a directory of shards, into the graph.
+     * Vertices are added as needed so that every vertex id in the
+     * input exists and all the edges are inserted with
+     * graph::add_edges() which leaves the graph finalized.  Duplicate
+     * edges are not permitted.
+     *
+     * \param path A file or a directory of shards
+     * \param parser A line parser such as edge_list_parser
+     * \param graph The graph to add the edges to
+     * \param edge_fn Converts a parsed weight to the graph EdgeData
+     * \param nthreads The number of parsing threads. If 0 the OpenMP
+     * default is used.
+     * \return The number of edges added
+     */
+    template <typename Graph, typename Parser, typename EdgeFunction>
+    inline static size_t load_with_parser(const std::string& path, 
+                                          Parser& parser,
+                                          Graph& graph, EdgeFunction edge_fn,
+                                          size_t nthreads = 0) {
+      typedef typename Graph::vertex_id_type vertex_id_type;
+      std::vector< std::vector<parsed_edge> > buffers;
+      parse(path, parser, buffers, nthreads);
+      // Make sure all the vertices exist
+      size_t nverts = graph.num_vertices();
+      size_t nedges = 0;
+      for(size_t i = 0; i < buffers.size(); ++i) {
+        nedges += buffers[i].size();
+        foreach(const parsed_edge& e, buffers[i]) {
+          nverts = std::max(nverts, size_t(std::max(e.source, e.target)) + 1);
+        }
+      }
+      if(nverts > graph.num_vertices()) graph.resize(nverts);
+      // Convert the edges into one batch releasing the buffers as we go
+      typedef typename Graph::edge_type edge_type;
+      std::vector<size_t> offsets(buffers.size() + 1, 0);
+      for(size_t i = 0; i < buffers.size(); ++i) 
+        offsets[i+1] = offsets[i] + buffers[i].size();
+      std::vector<edge_type> batch(nedges);
+#pragma omp parallel for schedule(dynamic, 1)
+      for(ssize_t i = 0; i < ssize_t(buffers.size()); ++i) {
+        for(size_t j = 0; j < buffers[i].size(); ++j) {
+          const parsed_edge& e(buffers[i][j]);
+          batch[offsets[i] + j] = 
+            edge_type(vertex_id_type(e.source), vertex_id_type(e.target),
+                      edge_fn(e.weight));
+        }
+        std::vector<parsed_edge>().swap(buffers[i]);
+      }
+      graph.add_edges(batch.begin(), batch.end());
+      return nedges;
+    } // end of load
+
+
+    /**
+     * Load a file, or a directory of shards, in one of the available
+     * formats.  EdgeData must be constructible from a double.
+     *
+     * \param format One of "edge_list", "adjacency_list" or
+     * "matrix_market"
+     */
+    template <typename Graph>
+    inline static size_t load(const std::string& path,
+                              const std::string& format,
+                              Graph& graph, size_t nthreads = 0) {
+      typedef typename Graph::edge_data_type edge_data_type;
+      file_format val(FORMAT_EDGE_LIST);
+      const bool successful_parse = string_to_enum(format, val);
+      if(!successful_parse) {
+        logstream(LOG_FATAL) << "Invalid graph file format string: "
+                             << format << std::endl;
+      }
+      weight_to_edge_data<edge_data_type> edge_fn;
+      switch(val) {
+      case FORMAT_EDGE_LIST: {
+        edge_list_parser parser;
+        return load_with_parser(path, parser, graph, edge_fn, nthreads);
+      }
+      case FORMAT_ADJACENCY_LIST: {
+        adjacency_list_parser parser;
+        return load_with_parser(path, parser, graph, edge_fn, nthreads);
+      }
+      case FORMAT_MATRIX_MARKET: {
+        matrix_market_parser parser;
+        return load_with_parser(path, parser, graph, edge_fn, nthreads);
+      }
+      default:
+        ASSERT_TRUE(false); //shoud never ever happen
+      }
+      return 0;
+    }
+
+  private:
+    
+    enum { MIN_CHUNK_SIZE = 1 << 20 };
+
+    /// A byte range [begin, end) of a file
+    struct chunk {
+      size_t file, begin, end;
+      chunk(size_t file = 0, size_t begin = 0, size_t end = 0) : 
+        file(file), begin(begin), end(end) { }
+    };
+
+    /// Fill files with path or the sorted contents of the directory path
+    inline static void list_shards(const std::string& path,
+                                   std::vector<std::string>& files) {
+      namespace fs = boost::filesystem;
+      files.clear();
+      fs::path fspath(path);
+      if(!fs::exists(fspath)) {
+        logstream(LOG_FATAL) << "Graph file " << path 
+                             << " does not exist" << std::endl;
+      }
+      if(!fs::is_directory(fspath)) {
+        files.push_back(path);
+        return;
+      }
+      for(fs::directory_iterator iter(fspath), end_iter; 
+          iter != end_iter; ++iter) {
+        if(!fs::is_directory(iter->status())) 
+          files.push_back(iter->path().string());
+      }
+      std::sort(files.begin(), files.end());
+    }
+
+    /**
+     * Parse all the lines which start in the byte range of the chunk.
+     * A line which straddles the end of the range belongs to this
+     * chunk, and a line which straddles its beginning belongs to the
+     * previous one.
+     */
+    template <typename Parser>
+    inline static void parse_chunk(const std::string& fname, const chunk& c,
+                                   const Parser& parser,
+                                   std::vector<parsed_edge>& edges,
+                                   size_t& nerrors, size_t& nself) {
+      std::ifstream fin(fname.c_str(), std::ios::binary);
+      ASSERT_TRUE(fin.good());
+      size_t pos = c.begin;
+      std::string line;
+      if(pos > 0) {
+        // If the previous byte is not a newline we are in the middle
+        // of a line which is parsed by the previous chunk
+        fin.seekg(pos - 1);
+        char prev = 0;
+        fin.get(prev);
+        if(prev != '\n') {
+          std::getline(fin, line);
+          pos += line.size() + 1;
+        }
+      } else {
+        fin.seekg(0);
+      }
+      while(pos < c.end && std::getline(fin, line)) {
+        pos += line.size() + 1;
+        const char* str = line.c_str();
+        while(*str != '\0' && isspace(*str)) ++str;
+        if(*str == '\0' || *str == '#' || *str == '%') continue;
+        const size_t prev_size = edges.size();
+        if(!parser.parse_line(str, edges)) { ++nerrors; continue; }
+        // drop the self edges which GraphLab does not permit
+        size_t last = prev_size;
+        for(size_t i = prev_size; i < edges.size(); ++i) {
+          if(edges[i].source == edges[i].target) ++nself;
+          else edges[last++] = edges[i];
+        }
+        edges.resize(last);
+      }
+    } // end of parse chunk
+
+  }; // end of graph loader
+
+} // end of namespace graphlab
+#include <graphlab/macros_undef.hpp>
+
+#endif
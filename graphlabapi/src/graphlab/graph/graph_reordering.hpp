@@ -0,0 +1,300 @@
+/**  
+ * Copyright (c) 2009 Carnegie Mellon University. 
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+
+/**
+ * \file graph_reordering.hpp 
+ *
+ * This file contains methods which compute locality improving vertex
+ * orderings for use with graph::permute_vertices().
+ *
+ */
+
+#ifndef GRAPHLAB_GRAPH_REORDERING_HPP
+#define GRAPHLAB_GRAPH_REORDERING_HPP
+
+#include <string>
+#include <vector>
+#include <queue>
+#include <algorithm>
+#include <functional>
+
+#include <graphlab/logger/logger.hpp>
+#include <graphlab/logger/assertions.hpp>
+#include <graphlab/graph/graph_partitioner.hpp>
+
+
+#include <graphlab/macros_def.hpp>
+namespace graphlab { 
+
+
+  struct graph_reordering {
+
+    /**
+       \brief the reordering methods
+    */
+    enum reordering_method {
+      REORDER_RCM,    /**< Reverse Cuthill-McKee ordering.  Each connected
+                         component is traversed breadth first starting
+                         from a minimum degree vertex, visiting
+                         neighbors in order of increasing degree, and the
+                         resulting order is reversed.  This reduces the
+                         bandwidth of the adjacency matrix. */
+      REORDER_DEGREE, /**< Vertices are sorted by decreasing degree so that
+                         the high degree vertices share cache lines. */
+      REORDER_BFS,    /**< Vertices are numbered in breadth first order
+                         starting from vertex 0 in each connected
+                         component. */
+      REORDER_METIS,  /**< The graph is partitioned using METIS (see
+                         graph_partitioner) and the vertices of each
+                         partition are numbered contiguously. */
+    };
+
+    /// Converts a reordering_method to a string
+    inline static std::string enum_to_string(reordering_method val) {
+      switch(val) {
+      case REORDER_RCM:
+        return "rcm";
+      case REORDER_DEGREE:
+        return "degree";
+      case REORDER_BFS:
+        return "bfs";
+      case REORDER_METIS:
+        return "metis";
+      default:
+        return "";
+      }
+    }
+
+    /// Converts a string to a reordering_method. Returns true on success
+    inline static bool string_to_enum(std::string s, reordering_method &val) {
+      if (s == "rcm") {
+        val = REORDER_RCM;
+        return true;
+      }
+      else if (s == "degree") {
+        val = REORDER_DEGREE;
+        return true;
+      }
+      else if (s == "bfs") {
+        val = REORDER_BFS;
+        return true;
+      }
+      else if (s == "metis") {
+        val = REORDER_METIS;
+        return true;
+      }
+      return false;
+    }
+
+
+    /**
+     * \brief Number the vertices in decreasing order of in + out degree.
+     *
+     * \param[out] perm A vector providing an old vertex id -> new
+     * vertex id mapping
+     */
+    template <typename Graph>
+    inline static void degree_order(const Graph& graph,
+                                    std::vector<typename Graph::vertex_id_type>& perm) {
+      typedef typename Graph::vertex_id_type vertex_id_type;
+      std::vector< std::pair<size_t, vertex_id_type> > order(graph.num_vertices());
+      for(vertex_id_type v = 0; v < graph.num_vertices(); ++v) {
+        order[v] = std::make_pair(degree(graph, v), v);
+      }
+      // Ties are broken by the original id which keeps the sort stable
+      std::sort(order.begin(), order.end(), degree_greater<vertex_id_type>);
+      perm.resize(graph.num_vertices());
+      for(size_t i = 0; i < order.size(); ++i) 
+        perm[order[i].second] = vertex_id_type(i);
+    } // end of degree order
+
+
+    /**
+     * \brief Number the vertices in breadth first order.  Edges are
+     * treated as undirected.  If sort_by_degree is true the neighbors
+     * of each vertex are visited in increasing degree order
+     * (Cuthill-McKee) and each traversal starts at an unvisited vertex
+     * of minimum degree.
+     *
+     * \param[out] perm A vector providing an old vertex id -> new
+     * vertex id mapping
+     */
+    template <typename Graph>
+    inline static void bfs_order(const Graph& graph,
+                                 std::vector<typename Graph::vertex_id_type>& perm,
+                                 bool sort_by_degree = false) {
+      typedef typename Graph::vertex_id_type vertex_id_type;
+      typedef typename Graph::edge_id_type edge_id_type;
+      const vertex_id_type UNVISITED(-1);
+      const size_t nverts = graph.num_vertices();
+      perm.assign(nverts, UNVISITED);
+      // The order in which the roots are considered
+      std::vector< std::pair<size_t, vertex_id_type> > roots(nverts);
+      for(vertex_id_type v = 0; v < nverts; ++v) 
+        roots[v] = std::make_pair(sort_by_degree? degree(graph, v) : 0, v);
+      if(sort_by_degree) std::sort(roots.begin(), roots.end());
+      
+      vertex_id_type next_id = 0;
+      std::vector< std::pair<size_t, vertex_id_type> > neighbors;
+      std::queue<vertex_id_type> bfs_queue;
+      for(size_t r = 0; r < roots.size(); ++r) {
+        const vertex_id_type root = roots[r].second;
+        if(perm[root] != UNVISITED) continue;
+        perm[root] = next_id++;
+        bfs_queue.push(root);
+        while(!bfs_queue.empty()) {
+          const vertex_id_type vid = bfs_queue.front();
+          bfs_queue.pop();
+          neighbors.clear();
+          foreach(edge_id_type eid, graph.in_edge_ids(vid)) {
+            const vertex_id_type nbr = graph.source(eid);
+            if(perm[nbr] == UNVISITED) 
+              neighbors.push_back(std::make_pair(sort_by_degree? degree(graph, nbr) : 0, nbr));
+          }
+          foreach(edge_id_type eid, graph.out_edge_ids(vid)) {
+            const vertex_id_type nbr = graph.target(eid);
+            if(perm[nbr] == UNVISITED) 
+              neighbors.push_back(std::make_pair(sort_by_degree? degree(graph, nbr) : 0, nbr));
+          }
+          if(sort_by_degree) std::sort(neighbors.begin(), neighbors.end());
+          for(size_t i = 0; i < neighbors.size(); ++i) {
+            const vertex_id_type nbr = neighbors[i].second;
+            // a neighbor reachable by both an in and an out edge
+            // appears twice
+            if(perm[nbr] != UNVISITED) continue;
+            perm[nbr] = next_id++;
+            bfs_queue.push(nbr);
+          }
+        }
+      }
+      ASSERT_EQ(next_id, nverts);
+    } // end of bfs order
+
+
+    /**
+     * \brief Reverse Cuthill-McKee ordering.
+     *
+     * \param[out] perm A vector providing an old vertex id -> new
+     * vertex id mapping
+     */
+    template <typename Graph>
+    inline static void rcm_order(const Graph& graph,
+                                 std::vector<typename Graph::vertex_id_type>& perm) {
+      typedef typename Graph::vertex_id_type vertex_id_type;
+      bfs_order(graph, perm, true);
+      const vertex_id_type last = vertex_id_type(graph.num_vertices() - 1);
+      for(size_t i = 0; i < perm.size(); ++i) perm[i] = last - perm[i];
+    } // end of rcm order
+
+
+    /**
+     * \brief Number the vertices of each partition contiguously.
+     * Within a partition the original relative order is preserved.
+     *
+     * \param partmethod A partitioning method accepted by
+     * graph_partitioner::partition()
+     * \param nparts The number of parts to partition into. If 0 the
+     * graph is split into parts of roughly 1024 vertices.
+     * \param[out] perm A vector providing an old vertex id -> new
+     * vertex id mapping
+     */
+    template <typename Graph>
+    inline static void partition_order(const Graph& graph,
+                                       const std::string& partmethod,
+                                       size_t nparts,
+                                       std::vector<typename Graph::vertex_id_type>& perm) {
+      typedef typename Graph::vertex_id_type vertex_id_type;
+      typedef graph_partitioner::part_id_type part_id_type;
+      const size_t nverts = graph.num_vertices();
+      if(nparts == 0) nparts = (nverts + 1023) / 1024;
+      perm.resize(nverts);
+      if(nparts < 2) {
+        for(size_t i = 0; i < nverts; ++i) perm[i] = vertex_id_type(i);
+        return;
+      }
+      std::vector<part_id_type> vertex2part;
+      graph_partitioner::partition(partmethod, graph, nparts, vertex2part);
+      ASSERT_EQ(vertex2part.size(), nverts);
+      // counting sort on the partition ids
+      std::vector<size_t> offsets(nparts + 1, 0);
+      for(size_t i = 0; i < nverts; ++i) {
+        ASSERT_LT(vertex2part[i], nparts);
+        ++offsets[vertex2part[i] + 1];
+      }
+      for(size_t p = 0; p < nparts; ++p) offsets[p+1] += offsets[p];
+      for(size_t i = 0; i < nverts; ++i) 
+        perm[i] = vertex_id_type(offsets[vertex2part[i]]++);
+    } // end of partition order
+
+
+    /**
+     * Compute a vertex ordering using one of the available methods.
+     *
+     * \param method One of "rcm", "degree", "bfs" or "metis"
+     * \param[out] perm A vector providing an old vertex id -> new
+     * vertex id mapping suitable for graph::permute_vertices()
+     */
+    template <typename Graph>
+    inline static void reorder(const std::string& method,
+                               const Graph& graph,
+                               std::vector<typename Graph::vertex_id_type>& perm) {
+      reordering_method val(REORDER_RCM);
+      const bool successful_parse = string_to_enum(method, val);
+      if(!successful_parse) {
+        logstream(LOG_FATAL) << "Invalid reordering method string: "
+                             << method << std::endl;
+      }
+      switch(val) {
+      case REORDER_RCM:
+        return rcm_order(graph, perm);
+      case REORDER_DEGREE:
+        return degree_order(graph, perm);
+      case REORDER_BFS:
+        return bfs_order(graph, perm);
+      case REORDER_METIS:
+        return partition_order(graph, "metis", 0, perm);
+      default:
+        ASSERT_TRUE(false); //shoud never ever happen
+      }
+    }
+
+  private:
+    template <typename Graph>
+    inline static size_t degree(const Graph& graph, 
+                                typename Graph::vertex_id_type v) {
+      return graph.num_in_neighbors(v) + graph.num_out_neighbors(v);
+    }
+
+    template <typename VertexId>
+    inline static bool degree_greater(const std::pair<size_t, VertexId>& a,
+                                      const std::pair<size_t, VertexId>& b) {
+      return a.first > b.first || (a.first == b.first && a.second < b.second);
+    }
+
+  }; // end of graph reordering
+
+} // end of namespace graphlab
+#include <graphlab/macros_undef.hpp>
+
+#endif
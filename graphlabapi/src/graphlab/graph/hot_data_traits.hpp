@@ -0,0 +1,78 @@
+/**  
+ * Copyright (c) 2009 Carnegie Mellon University. 
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+
+/**
+ * \file hot_data_traits.hpp
+ *
+ * Declares the trait used to split frequently read ("hot") fields of
+ * the vertex and edge data into separate dense arrays.
+ */
+
+#ifndef GRAPHLAB_HOT_DATA_TRAITS_HPP
+#define GRAPHLAB_HOT_DATA_TRAITS_HPP
+
+#include <boost/static_assert.hpp>
+
+namespace graphlab {
+
+  /**
+   * \brief Describes the hot fields of a vertex or edge data type.
+   *
+   * By default no fields are hot and the graph stores nothing
+   * beyond the vertex and edge data vectors.  An application may
+   * specialize this trait for its vertex or edge data type to have
+   * the graph keep a dense mirror of the hot fields:
+   *
+   * \code
+   * namespace graphlab {
+   *   template<> struct hot_data_traits<vertex_data> {
+   *     BOOST_STATIC_CONSTANT(bool, enabled = true);
+   *     typedef float hot_type;
+   *     static hot_type get(const vertex_data& vdata) { 
+   *       return vdata.value; 
+   *     }
+   *   };
+   * }
+   * \endcode
+   *
+   * Update functions may then read neighbor values through
+   * iscope::const_neighbor_vertex_hot_data() (and
+   * iscope::const_edge_hot_data() for edges) which only touch the
+   * mirror array and not the full data structs.  The full data is
+   * still the authoritative copy: the mirror is rebuilt by
+   * graph::finalize() (which the engine calls on start) and the
+   * general scope refreshes the entries within its scope after
+   * every update.  Writes made directly to the graph outside the
+   * engine require a call to graph::refresh_hot_data().
+   */
+  template<typename Data>
+  struct hot_data_traits {
+    BOOST_STATIC_CONSTANT(bool, enabled = false);
+    typedef char hot_type;
+    static hot_type get(const Data& data) { return hot_type(); }
+  };
+
+} // end of namespace graphlab
+
+#endif
@@ -0,0 +1,232 @@
+/**  
+ * Copyright (c) 2009 Carnegie Mellon University. 
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+
+#ifndef GRAPHLAB_NUMA_TOOLS_HPP
+#define GRAPHLAB_NUMA_TOOLS_HPP
+
+#include <stdint.h>
+#include <cstdlib>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+
+#if defined(__linux__)
+#include <unistd.h>
+#include <sys/syscall.h>
+#endif
+
+#include <graphlab/logger/assertions.hpp>
+#include <graphlab/parallel/pthread_tools.hpp>
+
+namespace graphlab {
+
+  /**
+   * \ingroup util
+   * The NUMA nodes of the machine and the cpus belonging to each.
+   * On linux the topology is read from /sys/devices/system/node.  On
+   * other systems, or if the information is not available, the
+   * machine is treated as a single node containing every cpu.
+   */
+  class numa_topology {
+  public:
+    /// Detect the topology of the machine
+    numa_topology() {
+#if defined(__linux__)
+      for(size_t node = 0; node < MAX_NODES; ++node) {
+        std::stringstream fname;
+        fname << "/sys/devices/system/node/node" << node << "/cpulist";
+        std::ifstream fin(fname.str().c_str());
+        if(!fin.good()) continue;
+        std::string cpulist;
+        std::getline(fin, cpulist);
+        std::vector<size_t> cpus;
+        parse_cpulist(cpulist, cpus);
+        // memory only nodes have no cpus
+        if(cpus.empty()) continue;
+        ids.push_back(node);
+        node_cpu_lists.push_back(cpus);
+      }
+#endif
+      if(ids.empty()) {
+        ids.push_back(0);
+        node_cpu_lists.resize(1);
+        for(size_t i = 0; i < thread::cpu_count(); ++i) 
+          node_cpu_lists[0].push_back(i);
+      }
+    }
+
+    /**
+     * Construct an explicit topology.  node_cpus[i] lists the cpus of
+     * the node with OS id i.
+     */
+    numa_topology(const std::vector< std::vector<size_t> >& node_cpus) : 
+      node_cpu_lists(node_cpus) {
+      ASSERT_FALSE(node_cpus.empty());
+      for(size_t i = 0; i < node_cpus.size(); ++i) ids.push_back(i);
+    }
+
+    /// The topology of this machine, detected once
+    static const numa_topology& system() {
+      static numa_topology topology;
+      return topology;
+    }
+
+    /// The number of nodes with at least one cpu
+    size_t num_nodes() const { return ids.size(); }
+
+    /// The operating system id of the node
+    size_t node_id(size_t node) const { return ids[node]; }
+
+    /// The cpus of the node
+    const std::vector<size_t>& node_cpus(size_t node) const {
+      return node_cpu_lists[node];
+    }
+
+    /// Parse a linux cpu list such as "0-3,8,10-11"
+    static void parse_cpulist(const std::string& str, 
+                              std::vector<size_t>& cpus) {
+      cpus.clear();
+      std::stringstream strm(str);
+      std::string range;
+      while(std::getline(strm, range, ',')) {
+        if(range.empty()) continue;
+        const size_t dash = range.find('-');
+        const size_t first = atol(range.substr(0, dash).c_str());
+        const size_t last = (dash == std::string::npos) ? 
+          first : atol(range.substr(dash + 1).c_str());
+        for(size_t cpu = first; cpu <= last; ++cpu) cpus.push_back(cpu);
+      }
+    }
+
+  private:
+    enum { MAX_NODES = 1024 };
+    std::vector<size_t> ids;
+    std::vector< std::vector<size_t> > node_cpu_lists;
+  }; // end of numa_topology
+
+
+  /**
+   * \ingroup util
+   * Assigns engine workers and vertices to NUMA nodes.  The workers
+   * are split evenly over the nodes (using at most one node per
+   * worker) and each worker is pinned to a distinct cpu of its node
+   * when possible.  The vertices are split into contiguous ranges of
+   * equal size, one per node, so vertex orderings which improve
+   * locality (see graph_reordering) also reduce remote accesses.
+   */
+  class numa_map {
+  public:
+    /// A single node map
+    numa_map() : nvertices(0) { node_ids.push_back(0); }
+
+    numa_map(size_t nworkers, size_t nvertices,
+             const numa_topology& topology = numa_topology::system()) :
+      nvertices(nvertices) {
+      ASSERT_GT(nworkers, 0);
+      const size_t nnodes = std::min(topology.num_nodes(), nworkers);
+      for(size_t n = 0; n < nnodes; ++n) 
+        node_ids.push_back(topology.node_id(n));
+      workers_node.resize(nworkers);
+      workers_cpu.resize(nworkers);
+      for(size_t w = 0; w < nworkers; ++w) {
+        const size_t node = (w * nnodes) / nworkers;
+        // the index of the worker within its node
+        const size_t first = (node * nworkers + nnodes - 1) / nnodes;
+        const std::vector<size_t>& cpus = topology.node_cpus(node);
+        workers_node[w] = node;
+        workers_cpu[w] = cpus[(w - first) % cpus.size()];
+      }
+    }
+
+    /// The number of nodes in use
+    size_t num_nodes() const { return node_ids.size(); }
+
+    /// The operating system id of the node, for numa_bind_memory()
+    size_t node_id(size_t node) const { return node_ids[node]; }
+
+    /// The node of a worker
+    size_t worker_node(size_t worker) const {
+      return worker < workers_node.size() ? workers_node[worker] : 0;
+    }
+
+    /// The cpu a worker should be pinned to
+    size_t worker_cpu(size_t worker) const {
+      return worker < workers_cpu.size() ? workers_cpu[worker] : worker;
+    }
+
+    /// The node owning a vertex
+    size_t vertex_node(size_t vid) const {
+      if(vid >= nvertices) return 0;
+      return (vid * num_nodes()) / nvertices;
+    }
+
+    /**
+     * The first vertex owned by a node.  vertex_begin(num_nodes()) is
+     * the number of vertices.
+     */
+    size_t vertex_begin(size_t node) const {
+      return (node * nvertices + num_nodes() - 1) / num_nodes();
+    }
+
+  private:
+    size_t nvertices;
+    std::vector<size_t> node_ids;
+    std::vector<size_t> workers_node;
+    std::vector<size_t> workers_cpu;
+  }; // end of numa_map
+
+
+  /**
+   * Ask the operating system to place the pages in [ptr, ptr + len)
+   * on a NUMA node, moving them if they were already touched.  Pages
+   * which are only partially inside the range are left alone.
+   * Returns false if the placement is not supported or failed.
+   */
+  inline bool numa_bind_memory(const void* ptr, size_t len, size_t node_id) {
+#if defined(__linux__) && defined(SYS_mbind)
+    // from linux/mempolicy.h
+    const int MPOL_PREFERRED_POLICY = 1;
+    const unsigned long MPOL_MF_MOVE_FLAG = 1 << 1;
+    const uintptr_t pagesize = sysconf(_SC_PAGESIZE);
+    const uintptr_t begin = 
+      (reinterpret_cast<uintptr_t>(ptr) + pagesize - 1) & ~(pagesize - 1);
+    const uintptr_t end = 
+      (reinterpret_cast<uintptr_t>(ptr) + len) & ~(pagesize - 1);
+    if(end <= begin) return true;
+    const size_t bits = 8 * sizeof(unsigned long);
+    std::vector<unsigned long> mask(node_id / bits + 1, 0);
+    mask[node_id / bits] |= 1UL << (node_id % bits);
+    const long ret = syscall(SYS_mbind, begin, end - begin, 
+                             MPOL_PREFERRED_POLICY, &(mask[0]),
+                             mask.size() * bits + 1, MPOL_MF_MOVE_FLAG);
+    return ret == 0;
+#else
+    return false;
+#endif
+  } // end of numa_bind_memory
+
+}
+#endif
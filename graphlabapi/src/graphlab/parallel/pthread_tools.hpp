@@ -31,6 +31,13 @@
 #include <sched.h>
 #include <signal.h>
 #include <sys/time.h>
+#include <stdint.h>
+#include <climits>
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#endif
 #include <vector>
 #include <list>
 #include <queue>
@@ -51,6 +58,19 @@
 
 namespace graphlab {
 
+  /**
+   * \ingroup util
+   * Hints the cpu that the caller is busy waiting.  Issues pause on
+   * x86 and is only a compiler barrier elsewhere.
+   */
+  inline void cpu_relax() {
+#if defined(__i386__) || defined(__x86_64__)
+    __asm volatile("pause" ::: "memory");
+#else
+    __asm volatile("" ::: "memory");
+#endif
+  }
+
   /**
    * \ingroup util
    *
@@ -288,6 +308,90 @@ namespace graphlab {
   }; // End conditional
 
 
+  /**
+   * \class event_count
+   * Lets threads sleep until another thread announces that the
+   * condition they wait for may have changed, without any locking on
+   * the announcing side while nobody sleeps.  A waiter calls
+   * prepare_wait(), checks its condition again and then calls either
+   * cancel_wait() or wait() with the key returned by prepare_wait().
+   * A thread which makes the condition true and then calls
+   * notify_all() wakes every thread which prepared to wait before.
+   * Uses a futex on Linux and a condition variable elsewhere.
+   *
+   * Before you use, see \ref parallel_object_intricacies.
+   */
+  class event_count {
+  private:
+    volatile int epoch;
+    atomic<size_t> waiters;
+#ifndef __linux__
+    mutex m;
+    conditional cond;
+#endif
+
+  public:
+    event_count() : epoch(0), waiters(0) { }
+
+    /** Copy constructor which does not copy. Do not use!
+        Required for compatibility with some STL implementations (LLVM).
+        which use the copy constructor for vector resize, 
+        rather than the standard constructor.    */
+    event_count(const event_count&) : epoch(0), waiters(0) { }
+
+    // not copyable
+    void operator=(const event_count& m) { }
+
+    /// Announces a waiter and returns the key to pass to wait()
+    inline int prepare_wait() {
+      waiters.inc();
+      return epoch;
+    }
+
+    /// Withdraws a prepare_wait() without sleeping
+    inline void cancel_wait() {
+      waiters.dec();
+    }
+
+    /** 
+     * Sleeps until a notify_all() issued after the prepare_wait()
+     * which returned key, or until timeout_ns nanoseconds passed.
+     * May also return spuriously.
+     */
+    inline void wait(int key, size_t timeout_ns) {
+#ifdef __linux__
+      struct timespec timeout;
+      timeout.tv_sec = timeout_ns / 1000000000;
+      timeout.tv_nsec = timeout_ns % 1000000000;
+      syscall(SYS_futex, &epoch, FUTEX_WAIT_PRIVATE, key, &timeout, NULL, 0);
+#else
+      m.lock();
+      if (epoch == key) cond.timedwait_ns(m, int(timeout_ns));
+      m.unlock();
+#endif
+      waiters.dec();
+    }
+
+    /// Wakes all the waiters. Nearly free when there are none
+    inline void notify_all() {
+      if (waiters.value == 0) return;
+      __sync_add_and_fetch(&epoch, 1);
+#ifdef __linux__
+      syscall(SYS_futex, &epoch, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+#else
+      m.lock();
+      cond.broadcast();
+      m.unlock();
+#endif
+    }
+
+    /// The number of threads between prepare_wait() and wait() returning
+    inline size_t num_waiters() const {
+      return waiters.value;
+    }
+  }; // End event_count
+
+
 #ifdef __APPLE__
   /**
    * Custom implementation of a semaphore.
@@ -455,6 +559,74 @@ namespace graphlab {
 #undef atomic_inc
 
 
+  /**
+   * \class compact_rwlock
+   * A 4 byte spinning reader/writer lock for tables holding one lock
+   * per graph element, where a pthread rwlock (56 bytes) would
+   * dominate the memory footprint.  The top bit of the state word
+   * marks a writer and the remaining bits count the readers.  Readers
+   * are preferred over waiting writers, like the default pthread
+   * rwlock.  Waiters spin for a short while before yielding the cpu.
+   *
+   * Before you use, see \ref parallel_object_intricacies.
+   */
+  class compact_rwlock {
+  private:
+    static const uint32_t WRITER = 0x80000000u;
+    static const size_t SPIN_COUNT = 64;
+    mutable volatile uint32_t state;
+
+    static inline void backoff(size_t& spins) {
+      if (++spins < SPIN_COUNT) cpu_relax();
+      else { spins = 0; sched_yield(); }
+    }
+
+  public:
+    compact_rwlock() : state(0) { }
+
+    /** Copy constructor which does not copy. Do not use!
+        Required for compatibility with some STL implementations (LLVM).
+        which use the copy constructor for vector resize, 
+        rather than the standard constructor.    */
+    compact_rwlock(const compact_rwlock&) : state(0) { }
+
+    // not copyable
+    void operator=(const compact_rwlock& m) { }
+
+    /// Non-blocking attempt to acquire a read lock
+    inline bool try_readlock() const {
+      uint32_t s = state;
+      return !(s & WRITER) && __sync_bool_compare_and_swap(&state, s, s + 1);
+    }
+    /// Non-blocking attempt to acquire the write lock
+    inline bool try_writelock() const {
+      return state == 0 && __sync_bool_compare_and_swap(&state, 0, WRITER);
+    }
+    inline void readlock() const {
+      size_t spins = 0;
+      while(!try_readlock()) backoff(spins);
+    }
+    inline void writelock() const {
+      size_t spins = 0;
+      while(!try_writelock()) backoff(spins);
+    }
+    inline void rdunlock() const {
+      __sync_fetch_and_sub(&state, 1);
+    }
+    inline void wrunlock() const {
+      __sync_synchronize();
+      state = 0;
+    }
+    inline void unlock() const {
+      if (state & WRITER) wrunlock();
+      else rdunlock();
+    }
+    ~compact_rwlock() {
+      ASSERT_TRUE(state == 0);
+    }
+  }; // End compact_rwlock
+
+
   /**
    * \class rwlock
    * Wrapper around pthread's rwlock
@@ -0,0 +1,257 @@
+/**  
+ * Copyright (c) 2009 Carnegie Mellon University. 
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+#ifndef GRAPHLAB_CALL_AGGREGATOR_HPP
+#define GRAPHLAB_CALL_AGGREGATOR_HPP
+#include <vector>
+#include <algorithm>
+#include <utility>
+#include <boost/function.hpp>
+#include <boost/bind.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/functional/hash.hpp>
+
+#include <graphlab/rpc/dc.hpp>
+#include <graphlab/rpc/dc_dist_object.hpp>
+#include <graphlab/parallel/pthread_tools.hpp>
+#include <graphlab/parallel/atomic.hpp>
+#include <graphlab/serialization/serialization_includes.hpp>
+
+namespace graphlab {
+
+/**
+ * \ingroup rpc
+ * Aggregates many small one-way calls of the form handler(key, value)
+ * into batches, so that each batch is sent to its target machine as a
+ * single RPC with a single packet header.
+ *
+ * Calls are buffered per target machine. A buffer is sent when it
+ * holds max_batch_calls calls, when flush() is called, or, if
+ * max_delay is positive, by a background thread at most max_delay
+ * seconds after the call was made. The receiving machine runs the
+ * handler of its own call_aggregator on every call of the batch in
+ * the order in which they were made.
+ *
+ * If a combiner is provided, a call to a key which is already in the
+ * unsent buffer of the target is merged into the buffered call with
+ * combiner(buffered_value, new_value) instead of being appended.
+ * For instance, remote add_task calls may keep the maximum priority:
+ *
+ * \code
+ * void add_task_local(const task_type& task, const double& priority);
+ * void max_priority(double& a, const double& b) { a = std::max(a, b); }
+ *
+ * call_aggregator<task_type, double, task_type::hash_functor>
+ *    tasks(dc, boost::bind(&engine::add_task_local, this, _1, _2),
+ *          max_priority);
+ * ...
+ * tasks.call(owner, task, priority);
+ * \endcode
+ *
+ * Like all distributed objects, the call_aggregator must be
+ * constructed in the same order on all machines. Calls made through it
+ * are not visible to barriers and termination detection until they are
+ * sent, so flush() must be called before a full_barrier() or before a
+ * thread declares itself done, and all machines must flush() and
+ * full_barrier() before the aggregator is destroyed.
+ * Aggregated calls do not honor the sequentialization key, and there
+ * is no ordering between aggregated calls and other RPCs.
+ *
+ * KeyType and ValueType must be serializable and Hash must be a hash
+ * functor for KeyType.
+ */
+template <typename KeyType, typename ValueType, 
+          typename Hash = boost::hash<KeyType> >
+class call_aggregator {
+ public:
+  /// The function run on the target machine for every call
+  typedef boost::function<void(const KeyType&, const ValueType&)> handler_type;
+  /// Merges the second value into the first
+  typedef boost::function<void(ValueType&, const ValueType&)> combiner_type;
+  /// The contents of a batch
+  typedef std::vector<std::pair<KeyType, ValueType> > batch_type;
+  
+ private:
+  /// The unsent calls to one target machine
+  struct target_buffer {
+    mutex lock;
+    batch_type calls;
+    /// position of each key in calls. Only used with a combiner.
+    boost::unordered_map<KeyType, size_t, Hash> index;
+  };
+
+  dc_dist_object<call_aggregator<KeyType, ValueType, Hash> > rmi;
+  handler_type handler;
+  combiner_type combiner;
+  size_t max_batch_calls;
+  double max_delay;
+  std::vector<target_buffer> buffers;
+
+  thread flusher;
+  mutex flusher_lock;
+  conditional flusher_cond;
+  bool flusher_stop;
+  
+  atomic<size_t> num_calls;
+  atomic<size_t> num_combined;
+  atomic<size_t> num_batches;
+
+ public:
+  /**
+   * Creates the aggregator. 
+   * \param dc The distributed control object
+   * \param handler The function run for every call received
+   * \param combiner If not empty, merges calls to the same key which
+   *                 are waiting in the same buffer.
+   * \param max_batch_calls The largest number of calls in a batch
+   * \param max_delay The longest time in seconds a call may wait to be
+   *                  sent. If 0, calls are only sent when a batch is
+   *                  full or on flush().
+   */
+  call_aggregator(distributed_control &dc,
+                  handler_type handler,
+                  combiner_type combiner = combiner_type(),
+                  size_t max_batch_calls = 1024,
+                  double max_delay = 0.001):
+      rmi(dc, this), handler(handler), combiner(combiner),
+      max_batch_calls(std::max<size_t>(max_batch_calls, 1)),
+      max_delay(max_delay), buffers(dc.numprocs()), flusher_stop(false) {
+    if (max_delay > 0) {
+      flusher = launch_in_new_thread(
+          boost::bind(&call_aggregator<KeyType, ValueType, Hash>::flush_loop, 
+                      this));
+    }
+  }
+  
+  ~call_aggregator() {
+    if (max_delay > 0) {
+      flusher_lock.lock();
+      flusher_stop = true;
+      flusher_cond.signal();
+      flusher_lock.unlock();
+      flusher.join();
+    }
+    flush();
+  }
+
+  /**
+   * Calls handler(key, value) on the target machine. The call is
+   * buffered and may be combined with an earlier call to the same key.
+   * Calls to the current machine run the handler immediately.
+   */
+  void call(procid_t target, const KeyType& key, const ValueType& value) {
+    if (target == rmi.procid()) {
+      handler(key, value);
+      return;
+    }
+    ASSERT_LT(target, buffers.size());
+    num_calls.inc();
+    target_buffer& buf = buffers[target];
+    batch_type batch;
+    buf.lock.lock();
+    if (combiner) {
+      typename boost::unordered_map<KeyType, size_t, Hash>::iterator iter = 
+        buf.index.find(key);
+      if (iter != buf.index.end()) {
+        combiner(buf.calls[iter->second].second, value);
+        buf.lock.unlock();
+        num_combined.inc();
+        return;
+      }
+      buf.index[key] = buf.calls.size();
+    }
+    buf.calls.push_back(std::make_pair(key, value));
+    if (buf.calls.size() >= max_batch_calls) take_batch(buf, batch);
+    buf.lock.unlock();
+    if (!batch.empty()) send_batch(target, batch);
+  }
+
+  /// Sends all buffered calls to the target machine
+  void flush(procid_t target) {
+    target_buffer& buf = buffers[target];
+    batch_type batch;
+    buf.lock.lock();
+    take_batch(buf, batch);
+    buf.lock.unlock();
+    if (!batch.empty()) send_batch(target, batch);
+  }
+
+  /// Sends all buffered calls
+  void flush() {
+    for (procid_t i = 0;i < buffers.size(); ++i) flush(i);
+  }
+  
+  /// The number of calls made to other machines
+  size_t calls() const {
+    return num_calls.value;
+  }
+
+  /// The number of calls merged into an earlier call by the combiner
+  size_t combined_calls() const {
+    return num_combined.value;
+  }
+
+  /// The number of batches sent
+  size_t batches_sent() const {
+    return num_batches.value;
+  }
+
+  /// \internal Runs the handler on every call of a batch
+  void receive_batch(const batch_type& batch) {
+    for (size_t i = 0;i < batch.size(); ++i) {
+      handler(batch[i].first, batch[i].second);
+    }
+  }
+  
+ private:
+  /// moves the buffered calls into batch. buf must be locked.
+  void take_batch(target_buffer& buf, batch_type& batch) {
+    batch.swap(buf.calls);
+    buf.calls.reserve(std::min(batch.size(), max_batch_calls));
+    buf.index.clear();
+  }
+  
+  void send_batch(procid_t target, const batch_type& batch) {
+    num_batches.inc();
+    rmi.remote_call(target, 
+                    &call_aggregator<KeyType, ValueType, Hash>::receive_batch,
+                    batch);
+  }
+
+  /// flushes all buffers every max_delay seconds until destruction
+  void flush_loop() {
+    flusher_lock.lock();
+    while (!flusher_stop) {
+      if (max_delay >= 1) flusher_cond.timedwait(flusher_lock, int(max_delay));
+      else flusher_cond.timedwait_ns(flusher_lock, int(max_delay * 1e9));
+      if (flusher_stop) break;
+      flusher_lock.unlock();
+      flush();
+      flusher_lock.lock();
+    }
+    flusher_lock.unlock();
+  }
+};
+
+} // namespace graphlab
+#endif
@@ -42,6 +42,10 @@
 #include <graphlab/rpc/dc.hpp>
 #include <graphlab/rpc/dc_tcp_comm.hpp>
 #include <graphlab/rpc/dc_sctp_comm.hpp>
+#ifdef __linux__
+#include <graphlab/rpc/dc_epoll_comm.hpp>
+#include <graphlab/rpc/dc_shm_comm.hpp>
+#endif
 
 #include <graphlab/rpc/dc_stream_send.hpp>
 #include <graphlab/rpc/dc_stream_receive.hpp>
@@ -50,10 +54,8 @@
 #include <graphlab/rpc/dc_buffered_stream_send_expqueue2.hpp>
 #include <graphlab/rpc/dc_buffered_stream_send_multiqueue.hpp>
 
-#ifdef HAS_ZLIB
 #include <graphlab/rpc/dc_buffered_stream_send_expqueue_z.hpp>
 #include <graphlab/rpc/dc_stream_receive_z.hpp>
-#endif
 
 #include <graphlab/rpc/dc_buffered_stream_receive.hpp>
 #include <graphlab/rpc/reply_increment_counter.hpp>
@@ -73,6 +75,7 @@ pthread_key_t thrlocal_sequentialization_key;
 struct dc_tls_data{
   resizing_array_sink ras;
   boost::iostreams::stream<resizing_array_sink_ref> strm;    
+  gather_list segments;
   
   dc_tls_data(): ras(128),strm(ras){ };
   ~dc_tls_data() {
@@ -88,6 +91,7 @@ get_thread_local_stream() {
                         pthread_getspecific(thrlocal_resizing_array_key));
   if (curptr != NULL) {
     curptr->ras.clear();
+    curptr->segments.clear();
     return curptr->strm;
   }
   else {
@@ -98,6 +102,38 @@ get_thread_local_stream() {
   }
 }
 
+bool thread_local_gather(std::ostream* strm, const char* data, size_t len) {
+  dc_tls_data* curptr = reinterpret_cast<dc_tls_data*>(
+                        pthread_getspecific(thrlocal_resizing_array_key));
+  if (curptr == NULL || strm != &(curptr->strm)) return false;
+  curptr->strm.flush();
+  gather_segment seg;
+  seg.offset = curptr->ras.size();
+  seg.data = data;
+  seg.len = len;
+  curptr->segments.push_back(seg);
+  return true;
+}
+
+size_t thread_local_packet_offset(std::ostream* strm) {
+  dc_tls_data* curptr = reinterpret_cast<dc_tls_data*>(
+                        pthread_getspecific(thrlocal_resizing_array_key));
+  if (curptr == NULL || strm != &(curptr->strm)) return size_t(-1);
+  curptr->strm.flush();
+  size_t offset = curptr->ras.size();
+  for (size_t i = 0;i < curptr->segments.size(); ++i) {
+    offset += curptr->segments[i].len;
+  }
+  return offset;
+}
+
+const gather_list& get_thread_local_gather_list() {
+  dc_tls_data* curptr = reinterpret_cast<dc_tls_data*>(
+                        pthread_getspecific(thrlocal_resizing_array_key));
+  ASSERT_TRUE(curptr != NULL);
+  return curptr->segments;
+}
+
 void thrlocal_destructor(void* v){ 
   dc_tls_data* s = reinterpret_cast<dc_tls_data*>(v);
   if (s != NULL) {
@@ -155,19 +191,25 @@ distributed_control::~distributed_control() {
   distributed_services->barrier();
   logstream(LOG_INFO) << "Shutting down distributed control " << std::endl;
   size_t bytessent = bytes_sent();
+  size_t compress_in, compress_out;
+  double compress_seconds, decompress_seconds;
   if (single_sender == false) {
-    for (size_t i = 0;i < senders.size(); ++i) {
-      senders[i]->shutdown();
-      delete senders[i];
-    }
+    for (size_t i = 0;i < senders.size(); ++i) senders[i]->shutdown();
   }
   else {
     senders[0]->shutdown();
-    delete senders[0];
   }
   
   comm->close();
   size_t bytesreceived = bytes_received();
+  compression_statistics(compress_in, compress_out, 
+                         compress_seconds, decompress_seconds);
+  if (single_sender == false) {
+    for (size_t i = 0;i < senders.size(); ++i) delete senders[i];
+  }
+  else {
+    delete senders[0];
+  }
   for (size_t i = 0;i < receivers.size(); ++i) {
     receivers[i]->shutdown();
     delete receivers[i];
@@ -182,6 +224,12 @@ distributed_control::~distributed_control() {
   logstream(LOG_INFO) << "Network Sent: " << network_bytes_sent() << std::endl;
   logstream(LOG_INFO) << "Bytes Received: " << bytesreceived << std::endl;
   logstream(LOG_INFO) << "Calls Received: " << calls_received() << std::endl;
+  if (compress_in > 0) {
+    logstream(LOG_INFO) << "Compressed: " << compress_in << " -> " << compress_out
+                        << " (" << double(compress_out) / compress_in << ") in "
+                        << compress_seconds << "s. Decompression: " 
+                        << decompress_seconds << "s" << std::endl;
+  }
   
   delete comm;
 
@@ -336,6 +384,8 @@ void distributed_control::init(const std::vector<std::string> &machines,
   bool buffered_queued_send = false;
   bool buffered_queued_send_single = false;
   bool compressed = false;
+  bool compress_adaptive = true;
+  std::string compressor = "lz";
   if (options["compressed"] == "true" || 
     options["compressed"] == "1" ||
     options["compressed"] == "yes") {
@@ -343,6 +393,16 @@ void distributed_control::init(const std::vector<std::string> &machines,
     std::cerr << "Compressed Buffered Queued Send Option is ON." << std::endl;
   }
 
+  if (options["compressor"].length() > 0) {
+    compressor = options["compressor"];
+  }
+
+  if (options["compress_adaptive"] == "false" || 
+    options["compress_adaptive"] == "0" ||
+    options["compress_adaptive"] == "no") {
+    compress_adaptive = false;
+  }
+
   if (options["compressed_qlz"] == "true" || 
     options["compressed_qlz"] == "1" ||
     options["compressed_qlz"] == "yes") {
@@ -398,7 +458,23 @@ void distributed_control::init(const std::vector<std::string> &machines,
     std::cerr << "Buffered Recv Option is ON." << std::endl;
   }
   
-  if (commtype == TCP_COMM) {
+  if (commtype == TCP_COMM && options["comm"] == "epoll") {
+    #ifdef __linux__
+    comm = new dc_impl::dc_epoll_comm();
+    std::cerr << "TCP Communication layer with epoll event loops constructed." << std::endl;
+    #else
+    logger(LOG_FATAL, "The epoll communication layer is only available on Linux");
+    #endif
+  }
+  else if (commtype == TCP_COMM && options["comm"] == "shm") {
+    #ifdef __linux__
+    comm = new dc_impl::dc_shm_comm();
+    std::cerr << "Shared memory and TCP Communication layer constructed." << std::endl;
+    #else
+    logger(LOG_FATAL, "The shared memory communication layer is only available on Linux");
+    #endif
+  }
+  else if (commtype == TCP_COMM) {
     comm = new dc_impl::dc_tcp_comm();
     std::cerr << "TCP Communication layer constructed." << std::endl;
   }
@@ -420,12 +496,7 @@ void distributed_control::init(const std::vector<std::string> &machines,
   if (comm->capabilities() && dc_impl::COMM_STREAM) {
     for (procid_t i = 0; i < machines.size(); ++i) {
       if (compressed) {
-        #ifdef HAS_ZLIB
-        receivers.push_back(new dc_impl::dc_stream_receive_z(this));
-        #else
-        logger(LOG_FATAL, "Not compiled with ZLib. Compressed option not available");
-        assert(false);
-        #endif
+        receivers.push_back(new dc_impl::dc_stream_receive_z(this, compressor));
       }
       else if (buffered_recv) {
         receivers.push_back(new dc_impl::dc_buffered_stream_receive(this));
@@ -435,13 +506,10 @@ void distributed_control::init(const std::vector<std::string> &machines,
       }
   
       if (compressed) {
-        #ifdef HAS_ZLIB
         single_sender = false;
-        senders.push_back(new dc_impl::dc_buffered_stream_send_expqueue_z(this, comm, i));
-        #else
-        logger(LOG_FATAL, "Not compiled with ZLib. Compressed option not available");
-        assert(false);
-        #endif
+        senders.push_back(new dc_impl::dc_buffered_stream_send_expqueue_z(this, comm, i,
+                                                                         compressor,
+                                                                         compress_adaptive));
       }      
       else if (buffered_send) {
         single_sender = false;
@@ -610,6 +678,12 @@ std::map<std::string, size_t> distributed_control::gather_statistics(){
     stats[procid()].callssent = calls_sent();
     stats[procid()].bytessent = bytes_sent();
     stats[procid()].network_bytessent = network_bytes_sent();
+    double compress_seconds, decompress_seconds;
+    compression_statistics(stats[procid()].compress_bytes_in,
+                           stats[procid()].compress_bytes_out,
+                           compress_seconds, decompress_seconds);
+    stats[procid()].compress_usec = size_t(compress_seconds * 1e6);
+    stats[procid()].decompress_usec = size_t(decompress_seconds * 1e6);
     gather(stats, 0, true);
     if (procid() == 0) {
       collected_statistics cs;
@@ -620,10 +694,18 @@ std::map<std::string, size_t> distributed_control::gather_statistics(){
         rpc_metrics.set_vector_entry_integer("bytes_sent", i, stats[i].bytessent);
         rpc_metrics.set_vector_entry_integer("network_bytes_sent", i, stats[i].network_bytessent);
         cs.network_bytessent += stats[i].network_bytessent;
+        cs.compress_bytes_in += stats[i].compress_bytes_in;
+        cs.compress_bytes_out += stats[i].compress_bytes_out;
+        cs.compress_usec += stats[i].compress_usec;
+        cs.decompress_usec += stats[i].decompress_usec;
       }
       ret["total_calls_sent"] = cs.callssent;
       ret["total_bytes_sent"] = cs.bytessent;
       ret["network_bytes_sent"] = cs.network_bytessent;
+      ret["compress_bytes_in"] = cs.compress_bytes_in;
+      ret["compress_bytes_out"] = cs.compress_bytes_out;
+      ret["compress_usec"] = cs.compress_usec;
+      ret["decompress_usec"] = cs.decompress_usec;
     }
     return ret; 
 }
@@ -635,6 +717,12 @@ void distributed_control::fill_metrics() {
     rpc_metrics.set_integer("total_calls_sent", ret["total_calls_sent"]);
     rpc_metrics.set_integer("total_bytes_sent", ret["total_bytes_sent"]);
     rpc_metrics.set_integer("total_network_bytes_sent", ret["network_bytes_sent"]);
+    if (ret["compress_bytes_in"] > 0) {
+      rpc_metrics.set("compression_ratio", 
+                      double(ret["compress_bytes_out"]) / ret["compress_bytes_in"]);
+      rpc_metrics.set("compress_seconds", ret["compress_usec"] / 1e6);
+      rpc_metrics.set("decompress_seconds", ret["decompress_usec"] / 1e6);
+    }
   }
   total_bytes_sent = ret["total_bytes_sent"];
 }
@@ -35,6 +35,7 @@
 
 #include <graphlab/rpc/dc_types.hpp>
 #include <graphlab/rpc/dc_internal_types.hpp>
+#include <graphlab/rpc/pod_array_ref.hpp>
 
 #include <graphlab/rpc/dc_receive.hpp>
 #include <graphlab/rpc/dc_send.hpp>
@@ -75,12 +76,29 @@ struct dc_init_param{
     "key1=value1,key2=value2".
     Available options are:
     
-    \li \b compressed=yes Use ZLib compressed communication
+    \li \b compressed=yes Use compressed communication
+    \li \b compressor=lz|zlib The block compressor used by compressed=yes.
+                            "lz" (default) is a fast LZ77 compressor, 
+                            "zlib" compresses better but is much slower
+                            (only if compiled with ZLib)
+    \li \b compress_adaptive=no Compress every block. By default, 
+                                compression is paused for a target while 
+                                its data does not compress
     \li \b buffered_send=yes Put an circular buffer on outgoing transmission
     \li \b buffered_queued_send=yes Put a queue buffer on outgoing transmission
     \li \b buffered_queued_send_single=yes Like buffered_queued but use only one sending thread
     \li \b buffered_recv=yes Put a buffer on incoming transmissions 
                              (not recommended. Tends to decrease performance)
+    \li \b comm=epoll Serve all TCP sockets from a few epoll event loop 
+                     threads instead of one receiving thread per machine 
+                     (Linux only)
+    \li \b comm_threads=N The number of event loops used by comm=epoll
+                          (default 2)
+    \li \b comm=shm Exchange data with processes on the same host through
+                   shared memory ring buffers and use TCP for the other
+                   machines (Linux only)
+    \li \b shm_ring_size=BYTES The capacity of each comm=shm ring 
+                               (default 8MB)
                              
     Internal options which should not be used
     \li \b __socket__=NUMBER Forces TCP comm to use this socket number for its
@@ -471,6 +489,27 @@ class distributed_control{
     return ret;
   }  
 
+  /**
+    Bytes passed to the compressor, the bytes it produced, and the
+    seconds spent compressing and decompressing on this machine.
+    All zero unless the "compressed" option is on.
+  */
+  inline void compression_statistics(size_t& bytes_in, size_t& bytes_out,
+                                     double& compress_seconds,
+                                     double& decompress_seconds) const {
+    bytes_in = 0; bytes_out = 0; 
+    compress_seconds = 0; decompress_seconds = 0;
+    size_t nsenders = single_sender ? 1 : senders.size();
+    for (size_t i = 0;i < nsenders; ++i) {
+      size_t in, out; double t;
+      senders[i]->compression_statistics(in, out, t);
+      bytes_in += in; bytes_out += out; compress_seconds += t;
+    }
+    for (size_t i = 0;i < receivers.size(); ++i) {
+      decompress_seconds += receivers[i]->decompression_seconds();
+    }
+  }
+
   /**
     Returns true if this is the process with the lowest ID
     currently running on this machine in this working directory
@@ -709,12 +748,22 @@ class distributed_control{
     size_t callssent;
     size_t bytessent;
     size_t network_bytessent;
-    collected_statistics(): callssent(0), bytessent(0), network_bytessent(0) { }
+    size_t compress_bytes_in;
+    size_t compress_bytes_out;
+    size_t compress_usec;
+    size_t decompress_usec;
+    collected_statistics(): callssent(0), bytessent(0), network_bytessent(0),
+                            compress_bytes_in(0), compress_bytes_out(0),
+                            compress_usec(0), decompress_usec(0) { }
     void save(oarchive &oarc) const {
-      oarc << callssent << bytessent << network_bytessent;
+      oarc << callssent << bytessent << network_bytessent
+           << compress_bytes_in << compress_bytes_out 
+           << compress_usec << decompress_usec;
     }
     void load(iarchive &iarc) {
-      iarc >> callssent >> bytessent >> network_bytessent;
+      iarc >> callssent >> bytessent >> network_bytessent
+           >> compress_bytes_in >> compress_bytes_out 
+           >> compress_usec >> decompress_usec;
     }
   };
  public:
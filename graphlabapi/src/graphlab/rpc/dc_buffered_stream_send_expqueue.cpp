@@ -70,28 +70,36 @@ namespace graphlab {
     void dc_buffered_stream_send_expqueue::send_data(procid_t target, 
                                                      unsigned char packet_type_mask,
                                                      char* data, size_t len) {
+      send_data(target, packet_type_mask, data, len, gather_list());
+    }
+
+    void dc_buffered_stream_send_expqueue::send_data(procid_t target, 
+                                                     unsigned char packet_type_mask,
+                                                     char* data, size_t len,
+                                                     const gather_list& segments) {
+      size_t total = gather_length(len, segments);
       if ((packet_type_mask & CONTROL_PACKET) == 0) {
         if (packet_type_mask & (FAST_CALL | STANDARD_CALL)) {
           dc->inc_calls_sent(target);
         }
-        bytessent.inc(len);
+        bytessent.inc(total);
       }
 
       // build the packet header
       packet_hdr hdr;
       memset(&hdr, 0, sizeof(packet_hdr));
   
-      hdr.len = len;
+      hdr.len = total;
       hdr.src = dc->procid(); 
       hdr.sequentialization_key = dc->get_sequentialization_key();
       hdr.packet_type_mask = packet_type_mask;
   
-      std::streamsize numbytes_needed = sizeof(packet_hdr) + len;
+      std::streamsize numbytes_needed = sizeof(packet_hdr) + total;
       expqueue_entry eentry;
       eentry.len = numbytes_needed;
       eentry.c = (char*)malloc(numbytes_needed);
       memcpy(eentry.c, &hdr, sizeof(packet_hdr));
-      memcpy(eentry.c + sizeof(packet_hdr), data, len);
+      gather_copy(eentry.c + sizeof(packet_hdr), data, len, segments);
       sendqueue.enqueue_conditional_signal(eentry, wait_count);
     }
 
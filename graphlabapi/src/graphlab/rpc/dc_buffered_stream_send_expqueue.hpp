@@ -100,6 +100,13 @@ class dc_buffered_stream_send_expqueue: public dc_send{
                  unsigned char packet_type_mask,
                  char* data, size_t len);
 
+  /** Assembles the packet directly in the queue entry, 
+  copying the gather segments once. */
+  void send_data(procid_t target, 
+                 unsigned char packet_type_mask,
+                 char* data, size_t len,
+                 const gather_list& segments);
+
   void send_loop();
   
 
@@ -26,11 +26,38 @@
 
 #include <graphlab/rpc/dc.hpp>
 #include <graphlab/rpc/dc_buffered_stream_send_expqueue_z.hpp>
+#include <graphlab/util/timer.hpp>
 
 
 namespace graphlab {
 namespace dc_impl {
 
+dc_buffered_stream_send_expqueue_z::
+dc_buffered_stream_send_expqueue_z(distributed_control* dc, 
+                                   dc_comm_base *comm, 
+                                   procid_t target, 
+                                   const std::string& compressor_name,
+                                   bool adaptive): 
+      dc(dc), comm(comm), target(target), done(false), 
+      adaptive(adaptive), blocklen(0), 
+      skip_blocks(0), next_skip(min_skip_blocks), compress_seconds(0) { 
+  compressor = make_dc_compressor(compressor_name);
+  if (compressor == NULL) {
+    logstream(LOG_FATAL) << "Unknown compressor " << compressor_name << std::endl;
+  }
+  block = (char*)malloc(COMPRESSED_BLOCK_SIZE);
+  outbuflen = compressor->max_compressed_length(COMPRESSED_BLOCK_SIZE);
+  outbuf = (char*)malloc(sizeof(compressed_block_hdr) + outbuflen);
+  thr = launch_in_new_thread(boost::bind(&dc_buffered_stream_send_expqueue_z::send_loop, 
+                                         this));
+}
+
+dc_buffered_stream_send_expqueue_z::~dc_buffered_stream_send_expqueue_z() {
+  free(block);
+  free(outbuf);
+  delete compressor;
+}
+
 void dc_buffered_stream_send_expqueue_z::send_data(procid_t target_, 
                 unsigned char packet_type_mask,
                 std::istream &istrm,
@@ -71,53 +98,107 @@ void dc_buffered_stream_send_expqueue_z::send_data(procid_t target_,
 void dc_buffered_stream_send_expqueue_z::send_data(procid_t target, 
                  unsigned char packet_type_mask,
                  char* data, size_t len) {
+  send_data(target, packet_type_mask, data, len, gather_list());
+}
+
+void dc_buffered_stream_send_expqueue_z::send_data(procid_t target, 
+                 unsigned char packet_type_mask,
+                 char* data, size_t len,
+                 const gather_list& segments) {
+  size_t total = gather_length(len, segments);
   if ((packet_type_mask & CONTROL_PACKET) == 0) {
     if (packet_type_mask & (FAST_CALL | STANDARD_CALL)) {
       dc->inc_calls_sent(target);
     }
-    bytessent.inc(len);
+    bytessent.inc(total);
   }
 
   // build the packet header
   packet_hdr hdr;
   memset(&hdr, 0, sizeof(packet_hdr));
   
-  hdr.len = len;
+  hdr.len = total;
   hdr.src = dc->procid(); 
   hdr.sequentialization_key = dc->get_sequentialization_key();
   hdr.packet_type_mask = packet_type_mask;
   
-  std::streamsize numbytes_needed = sizeof(packet_hdr) + len;
+  std::streamsize numbytes_needed = sizeof(packet_hdr) + total;
   expqueue_z_entry eentry;
   eentry.len = numbytes_needed;
   eentry.c = (char*)malloc(numbytes_needed);
   memcpy(eentry.c, &hdr, sizeof(packet_hdr));
-  memcpy(eentry.c + sizeof(packet_hdr), data, len);
+  gather_copy(eentry.c + sizeof(packet_hdr), data, len, segments);
   sendqueue.enqueue(eentry);
 }
 
 
+void dc_buffered_stream_send_expqueue_z::append_to_block(const char* c, 
+                                                         size_t len) {
+  while (len > 0) {
+    size_t n = std::min(len, COMPRESSED_BLOCK_SIZE - blocklen);
+    memcpy(block + blocklen, c, n);
+    blocklen += n;
+    c += n;
+    len -= n;
+    if (blocklen == COMPRESSED_BLOCK_SIZE) flush_block();
+  }
+}
+
+void dc_buffered_stream_send_expqueue_z::flush_block() {
+  if (blocklen == 0) return;
+  compressed_block_hdr* hdr = reinterpret_cast<compressed_block_hdr*>(outbuf);
+  hdr->rawlen = (uint32_t)blocklen;
+  hdr->complen = 0;
+  if (skip_blocks > 0) {
+    --skip_blocks;
+  }
+  else {
+    timer ti;
+    ti.start();
+    size_t complen = compressor->compress(block, blocklen, 
+                                          outbuf + sizeof(compressed_block_hdr),
+                                          outbuflen);
+    compress_seconds += ti.current_time();
+    // a block which did not fit is sent as is
+    if (complen == 0 || complen >= blocklen) complen = 0;
+    compress_bytes_in.inc(blocklen);
+    compress_bytes_out.inc(complen > 0 ? complen : blocklen);
+    if (adaptive) {
+      if (complen == 0 || complen > blocklen - blocklen / 8) {
+        // does not pay. Stop compressing for a while
+        complen = 0;
+        skip_blocks = next_skip;
+        next_skip = std::min(2 * next_skip, max_skip_blocks);
+      }
+      else {
+        next_skip = min_skip_blocks;
+      }
+    }
+    hdr->complen = (uint32_t)complen;
+  }
+  if (hdr->complen > 0) {
+    comm->send(target, outbuf, sizeof(compressed_block_hdr) + hdr->complen);
+  }
+  else {
+    comm->send2(target, outbuf, sizeof(compressed_block_hdr), block, blocklen);
+  }
+  blocklen = 0;
+}
 
 void dc_buffered_stream_send_expqueue_z::send_loop() {
-  const size_t chunklen = 128*1024;
-  char* chunk = (char*)malloc(chunklen);
-  
   while (1) {
     std::pair<expqueue_z_entry, bool> data = sendqueue.dequeue();
     if (data.second == false) break;
-
-    zstrm.next_in = (Bytef*)data.first.c;
-    zstrm.avail_in = (uInt)data.first.len;
-    bool sqempty = sendqueue.empty();
+    // pack everything which is queued into blocks. 
+    // Then send the last partial block.
     do {
-      zstrm.next_out = (Bytef*)chunk;
-      zstrm.avail_out = chunklen;  
-      ASSERT_NE(deflate(&zstrm, sqempty ? Z_SYNC_FLUSH : Z_NO_FLUSH ), Z_STREAM_ERROR);
-      comm->send(target, chunk, chunklen - zstrm.avail_out);
-    }while(zstrm.avail_out == 0);
-    free(data.first.c);
+      append_to_block(data.first.c, data.first.len);
+      free(data.first.c);
+      data = sendqueue.try_dequeue();
+    } while(data.second);
+    flush_block();
   }
-  free(chunk);
+  flush_block();
 }
 
 void dc_buffered_stream_send_expqueue_z::shutdown() {
@@ -127,5 +208,3 @@ void dc_buffered_stream_send_expqueue_z::shutdown() {
 
 } // namespace dc_impl
 } // namespace graphlab
-
-
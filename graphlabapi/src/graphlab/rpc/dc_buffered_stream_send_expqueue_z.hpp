@@ -24,14 +24,15 @@
 #ifndef DC_BUFFERED_STREAM_SEND_EXPQUEUE_Z_HPP
 #define DC_BUFFERED_STREAM_SEND_EXPQUEUE_Z_HPP
 #include <iostream>
+#include <string>
 #include <boost/function.hpp>
 #include <boost/bind.hpp>
 #include <boost/type_traits/is_base_of.hpp>
-#include <zlib.h>
 #include <graphlab/rpc/dc_internal_types.hpp>
 #include <graphlab/rpc/dc_types.hpp>
 #include <graphlab/rpc/dc_comm_base.hpp>
 #include <graphlab/rpc/dc_send.hpp>
+#include <graphlab/rpc/dc_compressor.hpp>
 #include <graphlab/parallel/pthread_tools.hpp>
 #include <graphlab/util/blocking_queue.hpp>
 #include <graphlab/logger/logger.hpp>
@@ -53,27 +54,30 @@ struct expqueue_z_entry{
   The job of the sender is to take as input data blocks of
   pieces which should be sent to a single destination socket.
   This can be thought of as a sending end of a multiplexor.
-  This class performs compressed ZLib transmissions and is the matching
+  This class performs compressed transmissions and is the matching
   sender for dc_stream_receive_z.
 
+  Packets are queued and a seperate thread packs them into blocks
+  of up to COMPRESSED_BLOCK_SIZE bytes, which are compressed with a 
+  dc_compressor ("lz" by default, or "zlib").
+
+  In adaptive mode, a block which shrinks by less than 1/8 is sent
+  uncompressed and compression is switched off for the next blocks to
+  this target. The pause doubles each time a sampled block does not 
+  compress, up to max_skip_blocks, and is reset by a block which does.
+
   \ref dc_stream_receive_z
 */
 
 class dc_buffered_stream_send_expqueue_z: public dc_send{
  public:
-  dc_buffered_stream_send_expqueue_z(distributed_control* dc, dc_comm_base *comm, procid_t target, bool zlib = false): dc(dc), 
-                                    comm(comm), target(target), done(false) { 
+  dc_buffered_stream_send_expqueue_z(distributed_control* dc, 
+                                     dc_comm_base *comm, 
+                                     procid_t target, 
+                                     const std::string& compressor_name,
+                                     bool adaptive);
   
-    zstrm.zalloc = Z_NULL;
-    zstrm.zfree = Z_NULL;
-    zstrm.opaque = Z_NULL;
-    ASSERT_TRUE(deflateInit(&zstrm, 1) == Z_OK); // level 6 out of 0-9 compression
-    thr = launch_in_new_thread(boost::bind(&dc_buffered_stream_send_expqueue_z::send_loop, 
-                                      this));
-  }
-  
-  ~dc_buffered_stream_send_expqueue_z() {
-  }
+  ~dc_buffered_stream_send_expqueue_z();
   
 
   inline bool channel_active(procid_t target) const {
@@ -97,6 +101,13 @@ class dc_buffered_stream_send_expqueue_z: public dc_send{
                  unsigned char packet_type_mask,
                  char* data, size_t len);
 
+  /** Assembles the packet directly in the queue entry, 
+  copying the gather segments once. */
+  void send_data(procid_t target, 
+                 unsigned char packet_type_mask,
+                 char* data, size_t len,
+                 const gather_list& segments);
+
   void send_loop();
   
 
@@ -106,6 +117,13 @@ class dc_buffered_stream_send_expqueue_z: public dc_send{
     return bytessent.value;
   }
 
+  void compression_statistics(size_t& bytes_in, size_t& bytes_out, 
+                              double& seconds) const {
+    bytes_in = compress_bytes_in.value;
+    bytes_out = compress_bytes_out.value;
+    seconds = compress_seconds;
+  }
+
  private:
   /// pointer to the owner
   distributed_control* dc;
@@ -118,8 +136,32 @@ class dc_buffered_stream_send_expqueue_z: public dc_send{
   bool done;
   atomic<size_t> bytessent;
   
-  z_stream zstrm;
-
+  dc_compressor* compressor;
+  bool adaptive;
+  
+  /// the block being filled. Only touched by the send thread
+  char* block;
+  size_t blocklen;
+  /// the compressed block, preceded by its header
+  char* outbuf;
+  size_t outbuflen;
+
+  /// the number of blocks to send without trying to compress
+  size_t skip_blocks;
+  /// the value of skip_blocks the next time compression does not pay
+  size_t next_skip;
+  static const size_t min_skip_blocks = 16;
+  static const size_t max_skip_blocks = 1024;
+
+  /// bytes passed to the compressor, and bytes it produced
+  atomic<size_t> compress_bytes_in, compress_bytes_out;
+  double compress_seconds;
+
+  /// appends to the block, flushing it when it fills up
+  void append_to_block(const char* c, size_t len);
+
+  /// compresses and transmits the block
+  void flush_block();
 };
 
 
@@ -127,4 +169,3 @@ class dc_buffered_stream_send_expqueue_z: public dc_send{
 } // namespace dc_impl
 } // namespace graphlab
 #endif // DC_BUFFERED_STREAM_SEND_EXPQUEUE_HPP
-
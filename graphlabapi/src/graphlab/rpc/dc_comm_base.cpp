@@ -25,6 +25,13 @@
 namespace graphlab {
   namespace dc_impl {  
     dc_comm_base::dc_comm_base() {}
+
+    void dc_comm_base::sendv(size_t target, const struct iovec* vec, 
+                             size_t count) {
+      for (size_t i = 0;i < count; ++i) {
+        send(target, (const char*)(vec[i].iov_base), vec[i].iov_len);
+      }
+    }
   }
 }
 
@@ -26,6 +26,7 @@
 #include <vector>
 #include <string>
 #include <map>
+#include <sys/uio.h>
 #include <graphlab/rpc/dc_types.hpp>
 #include <graphlab/rpc/dc_internal_types.hpp>
 #include <graphlab/rpc/dc_receive.hpp>
@@ -105,6 +106,14 @@ class dc_comm_base {
              const char* buf1, const size_t len1,
              const char* buf2, const size_t len2) = 0; 
 
+  /**
+   Sends count buffers one after another to the target machine.
+   The default implementation calls send() on each buffer. 
+   Implementations which can transmit the buffers with a single
+   gathering write should override this.
+  */
+  virtual void sendv(size_t target, const struct iovec* vec, size_t count);
+
   // not required and not used
   virtual void flush(size_t target) = 0;
 };
@@ -0,0 +1,218 @@
+/**  
+ * Copyright (c) 2009 Carnegie Mellon University. 
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+#include <cstring>
+#ifdef HAS_ZLIB
+#include <zlib.h>
+#endif
+#include <graphlab/rpc/dc_compressor.hpp>
+
+namespace graphlab {
+namespace dc_impl {
+
+namespace {
+  const size_t MIN_MATCH = 4;
+  /// the last bytes of a block are always literals, so that
+  /// the match finder can read 8 bytes at a time 
+  const size_t LAST_LITERALS = 8;
+  const size_t MAX_OFFSET = 65535;
+
+  inline uint32_t read32(const unsigned char* p) {
+    uint32_t v; memcpy(&v, p, sizeof(v)); return v;
+  }
+  inline uint64_t read64(const unsigned char* p) {
+    uint64_t v; memcpy(&v, p, sizeof(v)); return v;
+  }
+
+  /// writes the extension bytes of a length which did not fit its nibble
+  inline unsigned char* write_length(unsigned char* op, size_t len) {
+    while (len >= 255) {
+      *op++ = 255;
+      len -= 255;
+    }
+    *op++ = (unsigned char)len;
+    return op;
+  }
+
+  /// reads the extension bytes of a length. Returns false on overrun
+  inline bool read_length(const unsigned char*& ip, 
+                          const unsigned char* iend, size_t& len) {
+    unsigned char c;
+    do {
+      if (ip >= iend) return false;
+      c = *ip++;
+      len += c;
+    } while (c == 255);
+    return true;
+  }
+  
+  /// the number of equal bytes at a and b, comparing no further than aend
+  inline size_t match_length(const unsigned char* a, const unsigned char* b,
+                             const unsigned char* aend) {
+    const unsigned char* start = a;
+    while (a + 8 <= aend && read64(a) == read64(b)) {
+      a += 8; b += 8;
+    }
+    while (a < aend && *a == *b) {
+      ++a; ++b;
+    }
+    return a - start;
+  }
+}
+
+
+size_t dc_lz_compressor::max_compressed_length(size_t len) const {
+  // incompressible input grows by one length byte per 255 literals
+  return len + len / 255 + 16;
+}
+
+size_t dc_lz_compressor::compress(const char* in, size_t len, 
+                                  char* out, size_t outlen) {
+  const unsigned char* const base = (const unsigned char*)in;
+  const unsigned char* const iend = base + len;
+  const unsigned char* ip = base;
+  const unsigned char* anchor = base;
+  unsigned char* op = (unsigned char*)out;
+  unsigned char* const oend = op + outlen;
+  
+  table.assign(size_t(1) << HASH_LOG, 0);
+  if (len > MIN_MATCH + LAST_LITERALS) {
+    const unsigned char* const mflimit = iend - LAST_LITERALS;
+    while (ip + MIN_MATCH <= mflimit) {
+      const uint32_t seq = read32(ip);
+      const uint32_t h = (seq * 2654435761U) >> (32 - HASH_LOG);
+      const size_t refpos = table[h];
+      table[h] = uint32_t(ip - base) + 1;
+      const unsigned char* ref = base + (refpos > 0 ? refpos - 1 : 0);
+      const bool found = refpos > 0 && size_t(ip - ref) <= MAX_OFFSET && 
+                         read32(ref) == seq;
+      if (!found) {
+        // skip faster through data which does not match
+        ip += 1 + ((ip - anchor) >> 6);
+        continue;
+      }
+      size_t mlen = MIN_MATCH + match_length(ip + MIN_MATCH, ref + MIN_MATCH,
+                                             mflimit);
+      size_t litlen = ip - anchor;
+      // token + literal length + literals + offset + match length
+      if (op + 1 + litlen / 255 + 1 + litlen + 2 + mlen / 255 + 1 > oend) {
+        return 0;
+      }
+      unsigned char* token = op++;
+      *token = (unsigned char)((litlen >= 15 ? 15 : litlen) << 4);
+      if (litlen >= 15) op = write_length(op, litlen - 15);
+      memcpy(op, anchor, litlen);
+      op += litlen;
+      const size_t offset = ip - ref;
+      *op++ = (unsigned char)(offset & 0xff);
+      *op++ = (unsigned char)(offset >> 8);
+      const size_t mcode = mlen - MIN_MATCH;
+      *token |= (unsigned char)(mcode >= 15 ? 15 : mcode);
+      if (mcode >= 15) op = write_length(op, mcode - 15);
+      ip += mlen;
+      anchor = ip;
+    }
+  }
+  // the remaining literals
+  size_t litlen = iend - anchor;
+  if (op + 1 + litlen / 255 + 1 + litlen > oend) return 0;
+  unsigned char* token = op++;
+  *token = (unsigned char)((litlen >= 15 ? 15 : litlen) << 4);
+  if (litlen >= 15) op = write_length(op, litlen - 15);
+  memcpy(op, anchor, litlen);
+  op += litlen;
+  return op - (unsigned char*)out;
+}
+
+bool dc_lz_compressor::decompress(const char* in, size_t len, 
+                                  char* out, size_t rawlen) {
+  const unsigned char* ip = (const unsigned char*)in;
+  const unsigned char* const iend = ip + len;
+  unsigned char* const obase = (unsigned char*)out;
+  unsigned char* op = obase;
+  unsigned char* const oend = op + rawlen;
+  while (ip < iend) {
+    const unsigned char token = *ip++;
+    size_t litlen = token >> 4;
+    if (litlen == 15 && !read_length(ip, iend, litlen)) return false;
+    if (litlen > size_t(iend - ip) || litlen > size_t(oend - op)) return false;
+    memcpy(op, ip, litlen);
+    ip += litlen;
+    op += litlen;
+    // the last sequence has no match
+    if (ip == iend) break;
+    if (iend - ip < 2) return false;
+    const size_t offset = ip[0] | (size_t(ip[1]) << 8);
+    ip += 2;
+    size_t mlen = token & 15;
+    if (mlen == 15 && !read_length(ip, iend, mlen)) return false;
+    mlen += MIN_MATCH;
+    if (offset == 0 || offset > size_t(op - obase) || 
+        mlen > size_t(oend - op)) return false;
+    const unsigned char* ref = op - offset;
+    if (offset >= mlen) {
+      memcpy(op, ref, mlen);
+      op += mlen;
+    }
+    else {
+      // overlapping match. repeats the last offset bytes
+      for (size_t i = 0;i < mlen; ++i) *op++ = *ref++;
+    }
+  }
+  return op == oend;
+}
+
+
+#ifdef HAS_ZLIB
+size_t dc_zlib_compressor::max_compressed_length(size_t len) const {
+  return compressBound(len);
+}
+
+size_t dc_zlib_compressor::compress(const char* in, size_t len, 
+                                    char* out, size_t outlen) {
+  uLongf destlen = outlen;
+  if (compress2((Bytef*)out, &destlen, (const Bytef*)in, len, 1) != Z_OK) {
+    return 0;
+  }
+  return destlen;
+}
+
+bool dc_zlib_compressor::decompress(const char* in, size_t len, 
+                                    char* out, size_t rawlen) {
+  uLongf destlen = rawlen;
+  return uncompress((Bytef*)out, &destlen, (const Bytef*)in, len) == Z_OK &&
+         destlen == rawlen;
+}
+#endif
+
+
+dc_compressor* make_dc_compressor(const std::string& name) {
+  if (name == "lz") return new dc_lz_compressor;
+  #ifdef HAS_ZLIB
+  if (name == "zlib") return new dc_zlib_compressor;
+  #endif
+  return NULL;
+}
+
+} // namespace dc_impl
+} // namespace graphlab
@@ -0,0 +1,132 @@
+/**  
+ * Copyright (c) 2009 Carnegie Mellon University. 
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+#ifndef DC_COMPRESSOR_HPP
+#define DC_COMPRESSOR_HPP
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+namespace graphlab {
+namespace dc_impl {
+
+/**
+ * \ingroup rpc_internal
+ *
+ * The compressed stream is a sequence of blocks of at most 
+ * COMPRESSED_BLOCK_SIZE bytes of packet data. Each block is this header 
+ * followed by complen bytes of compressed data, or by rawlen bytes of
+ * uncompressed data if complen is 0.
+ */
+struct compressed_block_hdr {
+  uint32_t rawlen;
+  uint32_t complen;
+};
+
+const size_t COMPRESSED_BLOCK_SIZE = 65536;
+
+/**
+ * \ingroup rpc_internal
+ * 
+ * The interface of the block compressors used by the compressed
+ * sender (dc_buffered_stream_send_expqueue_z) and receiver 
+ * (dc_stream_receive_z). Every block is compressed independently.
+ * A compressor instance is used by only one thread at a time.
+ */
+class dc_compressor {
+ public:
+  virtual ~dc_compressor() { }
+  
+  /// The name used to select this compressor in the initstring
+  virtual const char* name() const = 0;
+
+  /** The size of the output buffer compress() needs for an input 
+   *  of length len */
+  virtual size_t max_compressed_length(size_t len) const = 0;
+
+  /**
+   * Compresses [in, in + len) into out, which holds outlen bytes.
+   * Returns the compressed length, or 0 if the output does not fit.
+   */
+  virtual size_t compress(const char* in, size_t len, 
+                          char* out, size_t outlen) = 0;
+
+  /**
+   * Decompresses [in, in + len) into out, which must receive exactly
+   * rawlen bytes. Returns false if the input is corrupt.
+   */
+  virtual bool decompress(const char* in, size_t len, 
+                          char* out, size_t rawlen) = 0;
+};
+
+
+/**
+ * \ingroup rpc_internal
+ * 
+ * A fast LZ77 block compressor in the style of LZ4. 
+ * Matches are found with a single-entry hash table over 4 byte 
+ * sequences and encoded as (literal run, 16 bit offset, match length).
+ * There is no entropy coding, so it compresses less than zlib but
+ * runs an order of magnitude faster in both directions.
+ */
+class dc_lz_compressor: public dc_compressor {
+ public:
+  const char* name() const { return "lz"; }
+  size_t max_compressed_length(size_t len) const;
+  size_t compress(const char* in, size_t len, char* out, size_t outlen);
+  bool decompress(const char* in, size_t len, char* out, size_t rawlen);
+ 
+ private:
+  static const size_t HASH_LOG = 14;
+  /// positions + 1 of the last occurance of each hashed sequence
+  std::vector<uint32_t> table;
+};
+
+
+#ifdef HAS_ZLIB
+/**
+ * \ingroup rpc_internal
+ *
+ * Block compression with zlib at level 1.
+ */
+class dc_zlib_compressor: public dc_compressor {
+ public:
+  const char* name() const { return "zlib"; }
+  size_t max_compressed_length(size_t len) const;
+  size_t compress(const char* in, size_t len, char* out, size_t outlen);
+  bool decompress(const char* in, size_t len, char* out, size_t rawlen);
+};
+#endif
+
+
+/**
+ * \ingroup rpc_internal
+ *
+ * Creates the compressor with the given name ("lz" or "zlib").
+ * Returns NULL if there is no such compressor.
+ */
+dc_compressor* make_dc_compressor(const std::string& name);
+
+} // namespace dc_impl
+} // namespace graphlab
+#endif
@@ -0,0 +1,542 @@
+/**  
+ * Copyright (c) 2009 Carnegie Mellon University. 
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <limits.h>
+#include <netinet/tcp.h>
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+#include <string>
+#include <map>
+
+#include <boost/lexical_cast.hpp>
+#include <boost/bind.hpp>
+#include <graphlab/logger/logger.hpp>
+#include <graphlab/rpc/dc_epoll_comm.hpp>
+#include <graphlab/rpc/dc_internal_types.hpp>
+
+//#define COMM_DEBUG
+namespace graphlab {
+ 
+namespace dc_impl {
+
+/// non-NULL on the event loop threads
+bool event_loop_key_initialized = false;
+pthread_key_t event_loop_key;
+
+void dc_epoll_comm::init(const std::vector<std::string> &machines,
+                         const std::map<std::string,std::string> &initopts,
+                         procid_t curmachineid,
+                         std::vector<dc_receive*> receiver_){ 
+  curid = curmachineid;
+  ASSERT_LT(machines.size(), std::numeric_limits<procid_t>::max());
+  nprocs = (procid_t)(machines.size());
+  receiver = receiver_;
+  all_addrs.resize(nprocs);
+  portnums.resize(nprocs);
+  insocks.resize(nprocs, NULL);
+  outsocks.resize(nprocs, NULL);
+  // parse the machines list, and extract the relevant address information
+  for (size_t i = 0;i < machines.size(); ++i) {
+    size_t pos = machines[i].find(":");
+    ASSERT_NE(pos, std::string::npos);
+    std::string address = machines[i].substr(0, pos);
+    size_t port = boost::lexical_cast<size_t>(machines[i].substr(pos+1));
+    
+    struct hostent* ent = gethostbyname(address.c_str());
+    ASSERT_EQ(ent->h_length, 4);
+    all_addrs[i] = *reinterpret_cast<uint32_t*>(ent->h_addr_list[0]);
+    ASSERT_LT(port, 65536);
+    portnums[i] = (uint16_t)(port);
+  }
+  network_bytessent = 0;
+  network_bytesreceived = 0;
+
+  // start the event loops
+  size_t numloops = 2;
+  std::map<std::string, std::string>::const_iterator iter = 
+    initopts.find("comm_threads");
+  if (iter != initopts.end()) {
+    numloops = std::max(atoi(iter->second.c_str()), 1);
+  }
+  if (event_loop_key_initialized == false) {
+    event_loop_key_initialized = true;
+    int err = pthread_key_create(&event_loop_key, NULL);
+    ASSERT_EQ(err, 0);
+  }
+  loops_stop = false;
+  loops.resize(numloops);
+  for (size_t i = 0;i < loops.size(); ++i) {
+    loops[i].epollfd = epoll_create(64);
+    ASSERT_GE(loops[i].epollfd, 0);
+    loops[i].wakefd = eventfd(0, 0);
+    ASSERT_GE(loops[i].wakefd, 0);
+    epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.ptr = NULL;
+    ASSERT_EQ(epoll_ctl(loops[i].epollfd, EPOLL_CTL_ADD, 
+                        loops[i].wakefd, &ev), 0);
+    loops[i].loopthread = new thread();
+    loops[i].loopthread->launch(boost::bind(&dc_epoll_comm::run_loop, 
+                                            this, i));
+  }
+  logstream(LOG_INFO) << "Proc " << procid() << " serving sockets with "
+                      << loops.size() << " event loops" << std::endl;
+  iter = initopts.find("__sockhandle__");
+  if (iter != initopts.end()) {
+    open_listening(atoi(iter->second.c_str()));
+  }
+  else {
+    open_listening();
+  }
+}
+
+void dc_epoll_comm::close() {
+  if (loops.empty()) return;
+  logstream(LOG_INFO) << "Closing listening socket" << std::endl;
+  if (listensock > 0) {
+    ::close(listensock);
+    listensock = -1;
+  }
+  logstream(LOG_INFO) << "Flushing outgoing sockets" << std::endl;
+  for (size_t i = 0;i < outsocks.size(); ++i) {
+    peer_socket* sock = outsocks[i];
+    if (sock == NULL) continue;
+    sock->lock.lock();
+    while(sock->fd != -1 && sock->pending_size() > 0) sock->cond.wait(sock->lock);
+    sock->lock.unlock();
+  }
+  // stop the event loops
+  loops_stop = true;
+  for (size_t i = 0;i < loops.size(); ++i) {
+    uint64_t one = 1;
+    ssize_t ret = write(loops[i].wakefd, &one, sizeof(one));
+    ASSERT_EQ(ret, (ssize_t)sizeof(one));
+  }
+  for (size_t i = 0;i < loops.size(); ++i) {
+    loops[i].loopthread->join();
+    delete loops[i].loopthread;
+    ::close(loops[i].wakefd);
+    ::close(loops[i].epollfd);
+  }
+  loops.clear();
+  logstream(LOG_INFO) << "Closing sockets" << std::endl;
+  for (std::set<peer_socket*>::iterator iter = handshakes.begin();
+       iter != handshakes.end(); ++iter) {
+    ::close((*iter)->fd);
+    delete *iter;
+  }
+  handshakes.clear();
+  for (size_t i = 0;i < outsocks.size(); ++i) {
+    if (outsocks[i] == NULL) continue;
+    if (outsocks[i]->fd != -1) ::close(outsocks[i]->fd);
+    delete outsocks[i];
+    outsocks[i] = NULL;
+  }
+  for (size_t i = 0;i < insocks.size(); ++i) {
+    if (insocks[i] == NULL) continue;
+    if (insocks[i]->fd != -1) ::close(insocks[i]->fd);
+    delete insocks[i];
+    insocks[i] = NULL;
+  }
+  delete listenpeer;
+  listenpeer = NULL;
+}
+
+void dc_epoll_comm::send(size_t target, const char* buf, size_t len) {
+  struct iovec vec[1];
+  vec[0].iov_base = (void*)buf;
+  vec[0].iov_len = len;
+  send_iovec(target, vec, 1, len);
+}
+
+void dc_epoll_comm::send2(size_t target, 
+                          const char* buf1, const size_t len1,
+                          const char* buf2, const size_t len2) {
+  struct iovec vec[2];
+  vec[0].iov_base = (void*)buf1;
+  vec[0].iov_len = len1;
+  vec[1].iov_base = (void*)buf2;
+  vec[1].iov_len = len2;
+  send_iovec(target, vec, 2, len1 + len2);
+}
+
+void dc_epoll_comm::sendv(size_t target, const struct iovec* vec, 
+                          size_t count) {
+  std::vector<struct iovec> copy(vec, vec + count);
+  size_t len = 0;
+  for (size_t i = 0;i < count; ++i) len += vec[i].iov_len;
+  send_iovec(target, &(copy[0]), count, len);
+}
+
+void dc_epoll_comm::send_iovec(size_t target, struct iovec* vec, 
+                               size_t veclen, size_t len) {
+  network_bytessent.inc(len);
+  if (outsocks[target] == NULL) connect(target);
+  peer_socket* sock = outsocks[target];
+  #ifdef COMM_DEBUG
+  logstream(LOG_INFO) << len << " bytes --> " << target  << std::endl;
+  #endif
+  sock->lock.lock();
+  if (in_event_loop()) {
+    // Calls handled on the event loops may send. The loop must not wait
+    // for a socket only it may be draining, so write what the socket
+    // takes right now and queue the rest regardless of the limit.
+    if (sock->pending_size() > MAX_PENDING_BYTES) write_pending(sock);
+  }
+  else {
+    while(sock->fd != -1 && sock->pending_size() > MAX_PENDING_BYTES) {
+      sock->cond.wait(sock->lock);
+    }
+  }
+  size_t sent = 0;
+  // write directly unless data is already waiting for the socket
+  if (sock->pending_size() == 0) {
+    struct msghdr data;
+    memset(&data, 0, sizeof(data));
+    while(sent < len) {
+      data.msg_iov = vec;
+      data.msg_iovlen = std::min(veclen, (size_t)IOV_MAX);
+      ssize_t ret = sendmsg(sock->fd, &data, MSG_NOSIGNAL);
+      if (ret < 0) {
+        if (errno == EINTR) continue;
+        if (errno != EAGAIN && errno != EWOULDBLOCK) {
+          logstream(LOG_ERROR) << "send error: " << strerror(errno) << std::endl;
+          // the connection is broken. Drop the data.
+          sent = len;
+        }
+        break;
+      }
+      sent += ret;
+      // skip the buffers written
+      while(veclen > 0 && (size_t)ret >= vec->iov_len) {
+        ret -= vec->iov_len;
+        ++vec; --veclen;
+      }
+      if (veclen > 0) {
+        vec->iov_base = (char*)(vec->iov_base) + ret;
+        vec->iov_len -= ret;
+      }
+    }
+  }
+  // queue the rest. The event loop writes it when the socket drains.
+  if (sent < len) {
+    if (sock->pending_head > 0 && sock->pending_head == sock->pending.size()) {
+      sock->pending.clear();
+      sock->pending_head = 0;
+    }
+    for (size_t i = 0;i < veclen; ++i) {
+      const char* c = (const char*)(vec[i].iov_base);
+      sock->pending.insert(sock->pending.end(), c, c + vec[i].iov_len);
+    }
+  }
+  sock->lock.unlock();
+}
+
+void dc_epoll_comm::write_pending(peer_socket* sock) {
+  while(sock->pending_size() > 0) {
+    ssize_t ret = ::send(sock->fd, &(sock->pending[sock->pending_head]), 
+                         sock->pending_size(), MSG_NOSIGNAL);
+    if (ret < 0) {
+      if (errno == EINTR) continue;
+      if (errno != EAGAIN && errno != EWOULDBLOCK) {
+        logstream(LOG_ERROR) << "send error: " << strerror(errno) << std::endl;
+        sock->pending.clear();
+        sock->pending_head = 0;
+      }
+      break;
+    }
+    sock->pending_head += ret;
+  }
+  if (sock->pending_size() == 0) {
+    sock->pending.clear();
+    sock->pending_head = 0;
+  }
+  else if (sock->pending_head > sock->pending.size() / 2) {
+    // drop the written half so the queue does not grow without bound
+    sock->pending.erase(sock->pending.begin(), 
+                        sock->pending.begin() + sock->pending_head);
+    sock->pending_head = 0;
+  }
+  sock->cond.broadcast();
+}
+
+bool dc_epoll_comm::in_event_loop() const {
+  return pthread_getspecific(event_loop_key) != NULL;
+}
+
+int dc_epoll_comm::sendtosock(int sockfd, const char* buf, size_t len) {
+  size_t numsent = 0;
+  while (numsent < len) {
+    ssize_t ret = ::send(sockfd, buf + numsent, len - numsent, 0);
+    if (ret < 0) {
+      logstream(LOG_ERROR) << "send error: " << strerror(errno) << std::endl;
+      return errno;
+    }
+    numsent += ret;
+  }
+  return 0;
+}
+
+void dc_epoll_comm::set_socket_options(int fd) {
+  int flag = 1;
+  int result = setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, 
+                          (char *) &flag, sizeof(int));   
+  if (result < 0) {
+    logger(LOG_WARNING, "Unable to disable Nagle. Performance may be signifantly reduced");
+  }
+}
+
+void dc_epoll_comm::set_non_blocking(int fd) {
+  int flags = fcntl(fd, F_GETFL, 0);
+  ASSERT_EQ(fcntl(fd, F_SETFL, flags | O_NONBLOCK), 0);
+}
+
+void dc_epoll_comm::add_to_loop(peer_socket* sock, size_t loopid, 
+                                uint32_t events) {
+  epoll_event ev;
+  ev.events = events;
+  ev.data.ptr = sock;
+  ASSERT_EQ(epoll_ctl(loops[loopid % loops.size()].epollfd, 
+                      EPOLL_CTL_ADD, sock->fd, &ev), 0);
+}
+
+void dc_epoll_comm::open_listening(int sockhandle) {
+  if (sockhandle == 0) {
+    listensock = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in my_addr;
+    my_addr.sin_family = AF_INET;
+    my_addr.sin_port = htons(portnums[curid]);
+    my_addr.sin_addr.s_addr = INADDR_ANY;
+    memset(&(my_addr.sin_zero), '\0', 8);
+    logstream(LOG_INFO) << "Proc " << procid() << " Bind on " << portnums[curid] << "\n";
+    if (bind(listensock, (sockaddr*)&my_addr, sizeof(my_addr)) < 0) {
+      logstream(LOG_FATAL) << "bind: " << strerror(errno) << "\n";
+      ASSERT_TRUE(0);
+    }
+  }
+  else {
+    listensock = sockhandle;
+  }
+  logstream(LOG_INFO) << "Proc " << procid() << " listening on " << portnums[curid] << "\n";
+  ASSERT_EQ(0, listen(listensock, 128));
+  listenpeer = new peer_socket(peer_socket::LISTEN, listensock, curid);
+  add_to_loop(listenpeer, 0, EPOLLIN);
+}
+
+void dc_epoll_comm::accept_connection() {
+  sockaddr_in their_addr;
+  socklen_t namelen = sizeof(sockaddr_in);
+  int newsock = accept(listensock, (sockaddr*)&their_addr, &namelen);
+  if (newsock < 0) return;
+  set_socket_options(newsock);
+  set_non_blocking(newsock);
+  logstream(LOG_INFO) << "Incoming connection from " << inet_ntoa(their_addr.sin_addr) << std::endl;
+  // the connecting machine first sends its id. It is collected by 
+  // this loop as it arrives so a slow peer cannot stall the loop.
+  peer_socket* sock = new peer_socket(peer_socket::HANDSHAKE, newsock, 
+                                      (procid_t)(-1));
+  sock->addr = *reinterpret_cast<uint32_t*>(&(their_addr.sin_addr));
+  handshakes.insert(sock);
+  add_to_loop(sock, 0, EPOLLIN);
+}
+
+void dc_epoll_comm::receive_handshake(peer_socket* sock) {
+  while(sock->idbytes < sizeof(procid_t)) {
+    ssize_t ret = recv(sock->fd, (char*)(&(sock->id)) + sock->idbytes, 
+                       sizeof(procid_t) - sock->idbytes, 0);
+    if (ret < 0 && errno == EINTR) continue;
+    if (ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+    if (ret <= 0) {
+      // the peer went away before identifying itself
+      epoll_ctl(loops[0].epollfd, EPOLL_CTL_DEL, sock->fd, NULL);
+      ::close(sock->fd);
+      handshakes.erase(sock);
+      delete sock;
+      return;
+    }
+    sock->idbytes += ret;
+  }
+  const procid_t id = sock->id;
+  ASSERT_LT(id, all_addrs.size());
+  ASSERT_EQ(all_addrs[id], sock->addr);
+  ASSERT_TRUE(insocks[id] == NULL);
+  logstream(LOG_INFO) << "Proc " << procid() << " accepted connection "
+                      << "from machine " << id << std::endl;
+  epoll_ctl(loops[0].epollfd, EPOLL_CTL_DEL, sock->fd, NULL);
+  handshakes.erase(sock);
+  sock->type = peer_socket::INCOMING;
+  if (receiver[id]->direct_access_support()) {
+    sock->buf = receiver[id]->get_buffer(sock->buflength);
+  }
+  insocks[id] = sock;
+  // each incoming socket is served by a single loop, so the receiver
+  // of a machine is never called concurrently
+  add_to_loop(sock, id, EPOLLIN);
+}
+
+void dc_epoll_comm::connect(size_t target) {
+  connectlock.lock();
+  if (outsocks[target] != NULL) {
+    connectlock.unlock();
+    return;
+  }
+  int newsock = socket(AF_INET, SOCK_STREAM, 0);
+  set_socket_options(newsock);
+  sockaddr_in serv_addr;
+  serv_addr.sin_family = AF_INET;
+  serv_addr.sin_port = htons(portnums[target]);
+  serv_addr.sin_addr = *(struct in_addr*)&(all_addrs[target]);
+  memset(&(serv_addr.sin_zero), '\0', 8);
+  logstream(LOG_INFO) << "Trying to connect from "
+                      << curid << " -> " << target
+                      << " on port " << portnums[target] << "\n";
+  // retry 10 times at 1 second intervals
+  bool success = false;
+  for (size_t i = 0;i < 10; ++i) {
+    if (::connect(newsock, (sockaddr*)&serv_addr, sizeof(serv_addr)) < 0) {
+      logstream(LOG_WARNING) << "connect " << curid << " to " << target << ": "
+                             << strerror(errno) << ". Retrying...\n";
+      sleep(1);
+      ::close(newsock);
+      newsock = socket(AF_INET, SOCK_STREAM, 0);
+      set_socket_options(newsock);
+    }
+    else {
+      // send my machine id
+      sendtosock(newsock, reinterpret_cast<char*>(&curid), sizeof(curid));
+      success = true;
+      break;
+    }
+  }
+  if (!success) {
+    logstream(LOG_FATAL) << "Failed to establish connection" << std::endl;
+  }
+  set_non_blocking(newsock);
+  peer_socket* sock = new peer_socket(peer_socket::OUTGOING, newsock, 
+                                      (procid_t)target);
+  // edge triggered: the loop is woken when a full socket drains
+  add_to_loop(sock, target, EPOLLOUT | EPOLLET);
+  outsocks[target] = sock;
+  connectlock.unlock();
+  logstream(LOG_INFO) << "connection from " << curid << " to " << target
+                      << " established." << std::endl;
+}
+
+void dc_epoll_comm::receive(peer_socket* sock) {
+  dc_receive* recv_object = receiver[sock->id];
+  // read a bounded amount so that one busy socket cannot starve the
+  // others. The socket is level triggered and will be reported again.
+  for (size_t i = 0;i < 16; ++i) {
+    ssize_t msglen;
+    if (sock->buf != NULL) {
+      msglen = recv(sock->fd, sock->buf, sock->buflength, 0);
+    }
+    else {
+      char c[10240];
+      msglen = recv(sock->fd, c, 10240, 0);
+      if (msglen > 0) recv_object->incoming_data(sock->id, c, msglen);
+    }
+    if (msglen < 0 && errno == EINTR) continue;
+    if (msglen < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+    // if msglen == 0, the socket is closed
+    if (msglen <= 0) {
+      close_incoming(sock);
+      return;
+    }
+    network_bytesreceived.inc(msglen);
+    #ifdef COMM_DEBUG
+    logstream(LOG_INFO) << msglen << " bytes <-- " << sock->id  << std::endl;
+    #endif
+    if (sock->buf != NULL) {
+      sock->buf = recv_object->advance_buffer(sock->buf, msglen, 
+                                              sock->buflength);
+    }
+  }
+}
+
+void dc_epoll_comm::close_incoming(peer_socket* sock) {
+  epoll_ctl(loops[sock->id % loops.size()].epollfd, EPOLL_CTL_DEL, 
+            sock->fd, NULL);
+  ::close(sock->fd);
+  sock->fd = -1;
+}
+
+void dc_epoll_comm::run_loop(size_t loopid) {
+  pthread_setspecific(event_loop_key, &(loops[loopid]));
+  const int MAX_EVENTS = 64;
+  epoll_event events[MAX_EVENTS];
+  while(!loops_stop) {
+    int nevents = epoll_wait(loops[loopid].epollfd, events, MAX_EVENTS, 
+                             100);
+    if (nevents < 0) {
+      if (errno == EINTR) continue;
+      logstream(LOG_ERROR) << "epoll_wait: " << strerror(errno) << std::endl;
+      break;
+    }
+    if (nevents == 0) {
+      // Nothing happened for a while. Retry any queued data in case a
+      // wake up of an edge triggered socket was missed.
+      for (size_t i = loopid;i < outsocks.size(); i += loops.size()) {
+        peer_socket* sock = outsocks[i];
+        if (sock == NULL) continue;
+        sock->lock.lock();
+        if (sock->pending_size() > 0) write_pending(sock);
+        sock->lock.unlock();
+      }
+      continue;
+    }
+    for (int i = 0;i < nevents; ++i) {
+      peer_socket* sock = (peer_socket*)(events[i].data.ptr);
+      // the wake up event. loops_stop is checked by the while loop
+      if (sock == NULL) continue;
+      if (sock->type == peer_socket::LISTEN) {
+        accept_connection();
+      }
+      else if (sock->type == peer_socket::HANDSHAKE) {
+        receive_handshake(sock);
+      }
+      else if (sock->type == peer_socket::INCOMING) {
+        receive(sock);
+      }
+      else {
+        sock->lock.lock();
+        write_pending(sock);
+        sock->lock.unlock();
+      }
+    }
+  }
+  logstream(LOG_INFO) << "Event loop " << loopid << " quitting" << std::endl;
+}
+
+}
+}
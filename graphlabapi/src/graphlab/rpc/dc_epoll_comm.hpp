@@ -0,0 +1,246 @@
+/**  
+ * Copyright (c) 2009 Carnegie Mellon University. 
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+#ifndef DC_EPOLL_COMM_HPP
+#define DC_EPOLL_COMM_HPP
+
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+
+#include <vector>
+#include <string>
+#include <map>
+#include <set>
+
+#include <graphlab/parallel/pthread_tools.hpp>
+#include <graphlab/parallel/atomic.hpp>
+#include <graphlab/rpc/dc_types.hpp>
+#include <graphlab/rpc/dc_internal_types.hpp>
+#include <graphlab/rpc/dc_comm_base.hpp>
+
+namespace graphlab {
+namespace dc_impl {
+  
+/**
+ \ingroup rpc_internal
+TCP implementation of the communications subsystem which serves all
+sockets from a small number of epoll event loop threads instead of one
+receiving thread per machine.
+
+Sends are written directly by the calling thread with non-blocking
+writev. Whatever the socket cannot take is queued on the connection
+and written by the event loop once the socket drains. A sender blocks
+while more than MAX_PENDING_BYTES are queued to its target, except
+for the event loops themselves which never block on a send.
+
+Selected with the initstring option comm=epoll. The option 
+comm_threads=N sets the number of event loops (default 2).
+Linux only.
+*/
+class dc_epoll_comm:public dc_comm_base {
+ public:
+  
+  /// The number of queued bytes to a machine beyond which senders block
+  static const size_t MAX_PENDING_BYTES = 64 * 1024 * 1024;
+
+  dc_epoll_comm(): listensock(-1), listenpeer(NULL) {}
+  
+  size_t capabilities() const {
+    return COMM_STREAM;
+  }
+  
+  /**
+   Same as dc_tcp_comm::init(). machines is a vector of strings of the
+   form [IP]:[portnumber] and machines[curmachineid] is the listening
+   address of this machine. The initopts comm_threads and
+   __sockhandle__ are used.
+  */
+  void init(const std::vector<std::string> &machines,
+            const std::map<std::string,std::string> &initopts,
+            procid_t curmachineid,
+            std::vector<dc_receive*> receiver);
+
+  /** writes out all queued data, shuts down all sockets and cleans up */
+  void close();
+  
+  ~dc_epoll_comm() {
+    close();
+  }
+  
+  inline bool channel_active(size_t target) const {
+    return (outsocks[target] != NULL && outsocks[target]->fd != -1);
+  }
+
+  inline procid_t numprocs() const {
+    return nprocs;
+  }
+  
+  inline procid_t procid() const {
+    return curid;
+  }
+  
+  inline size_t network_bytes_sent() const {
+    return network_bytessent.value;
+  }
+
+  inline size_t network_bytes_received() const {
+    return network_bytesreceived.value;
+  }
+ 
+  /// Not needed. Queued data is written as soon as the socket allows.
+  void flush(size_t target) { }
+  
+  /**
+   Sends the string of length len to the target machine dest.
+   Only valid after call to init();
+   Establishes a connection if necessary
+  */
+  void send(size_t target, const char* buf, size_t len);
+  
+  /**
+   * Sends two buffers one after another to the target machine. 
+   */
+  void send2(size_t target, 
+             const char* buf1, const size_t len1,
+             const char* buf2, const size_t len2); 
+
+  /**
+   * Sends count buffers one after another to the target machine. 
+   */
+  void sendv(size_t target, const struct iovec* vec, size_t count);
+  
+ private:
+  /// A socket registered with an event loop
+  struct peer_socket {
+    /** An accepted socket is a HANDSHAKE until the id of the
+     *  connecting machine has arrived and it becomes INCOMING */
+    enum socket_type {LISTEN, HANDSHAKE, INCOMING, OUTGOING};
+    socket_type type;
+    int fd;
+    procid_t id;
+    /// the address of a HANDSHAKE socket and the bytes of id received
+    uint32_t addr;
+    size_t idbytes;
+    /// the receive buffer when the receiver supports direct access
+    char* buf;
+    size_t buflength;
+    /// protects the pending data of outgoing sockets
+    mutex lock;
+    /// signalled when the pending data shrinks
+    conditional cond;
+    std::vector<char> pending;
+    /// the first byte of pending not yet written
+    size_t pending_head;
+    
+    peer_socket(socket_type type, int fd, procid_t id): 
+      type(type), fd(fd), id(id), addr(0), idbytes(0), 
+      buf(NULL), buflength(0), pending_head(0) { }
+    size_t pending_size() const { return pending.size() - pending_head; }
+  };
+  
+  /// An epoll instance and the thread waiting on it
+  struct event_loop {
+    int epollfd;
+    /// eventfd used to wake the loop for shutdown
+    int wakefd;
+    thread* loopthread;
+  };
+
+  /// the body of the loop threads
+  void run_loop(size_t loopid);
+
+  /// adds the socket to the event loop which serves it
+  void add_to_loop(peer_socket* sock, size_t loopid, uint32_t events);
+  
+  /// accepts a connection on the listening socket
+  void accept_connection();
+
+  /** reads the id of the connecting machine without blocking and
+   *  hands the socket to the loop which serves that machine */
+  void receive_handshake(peer_socket* sock);
+
+  /// reads everything available on an incoming socket
+  void receive(peer_socket* sock);
+
+  /// closes an incoming socket whose peer went away
+  void close_incoming(peer_socket* sock);
+
+  /** writes pending data of an outgoing socket until it is empty or
+   *  the socket is full. sock->lock must be held */
+  void write_pending(peer_socket* sock);
+
+  /** sends the buffers to target in order. The iovecs are modified.
+   *  Anything the socket cannot take right away is copied. */
+  void send_iovec(size_t target, struct iovec* vec, size_t veclen, size_t len);
+
+  /// returns true if the calling thread is one of the event loops
+  bool in_event_loop() const;
+  
+  /// Sets TCP_NO_DELAY on the socket passed in fd
+  void set_socket_options(int fd);
+
+  /// Sets O_NONBLOCK on the socket passed in fd
+  void set_non_blocking(int fd);
+
+  /** opens the listening sock and registers it with the first loop.
+   * Uses sockhandle if non-zero
+   */
+  void open_listening(int sockhandle = 0);
+  
+  /// constructs a connection to the target machine
+  void connect(size_t target);
+
+  /// blocking send which loops till the buffer is all sent
+  int sendtosock(int sockfd, const char* buf, size_t len);
+  
+  /// all_addrs[i] will contain the IP address of machine i
+  std::vector<uint32_t> all_addrs;
+  std::vector<uint16_t> portnums;
+  
+  procid_t curid; 
+  procid_t nprocs;
+  
+  /// the socket we use to listen on 
+  int listensock;
+  peer_socket* listenpeer;
+  
+  std::vector<dc_receive*> receiver;
+  
+  /// insocks[i] and outsocks[i] are the sockets from and to machine i
+  std::vector<peer_socket*> insocks; 
+  std::vector<peer_socket*> outsocks; 
+  /// serializes the creation of outgoing connections
+  mutex connectlock;
+  /// the HANDSHAKE sockets. Only used by the first loop
+  std::set<peer_socket*> handshakes;
+  
+  std::vector<event_loop> loops;
+  volatile bool loops_stop;
+  
+  atomic<size_t> network_bytessent;
+  atomic<size_t> network_bytesreceived;
+};
+
+} // namespace dc_impl
+} // namespace graphlab
+#endif
@@ -23,6 +23,7 @@
 
 #ifndef DC_INTERNAL_TYPES_HPP
 #define DC_INTERNAL_TYPES_HPP
+#include <vector>
 #include <boost/function.hpp>
 #include <boost/unordered_map.hpp>
 #include <graphlab/rpc/dc_types.hpp>
@@ -115,8 +116,60 @@ struct terminator_token {
   bool terminate;
 };
 
+/**
+ * \ingroup rpc_internal
+ *
+ * A block of caller owned memory which is transmitted in place
+ * rather than being copied into the serialization stream. It is
+ * spliced into the packet at byte offset "offset" of the serialized
+ * contents.
+ */
+struct gather_segment {
+  size_t offset;
+  const char* data;
+  size_t len;
+};
+
+typedef std::vector<gather_segment> gather_list;
+
+/**
+ * \ingroup rpc_internal
+ *
+ * Blocks smaller than this are cheaper to copy into the
+ * serialization stream than to transmit as a seperate segment.
+ */
+const size_t GATHER_MIN_BYTES = 4096;
+
 extern boost::iostreams::stream<resizing_array_sink_ref>& get_thread_local_stream();
 
+/**
+ * \ingroup rpc_internal
+ *
+ * If strm is the stream returned by get_thread_local_stream(), records
+ * [data, data + len) as a gather segment at the current end of the
+ * stream and returns true. The bytes must then not be written to the
+ * stream. Returns false otherwise.
+ */
+extern bool thread_local_gather(std::ostream* strm, const char* data, size_t len);
+
+/**
+ * \ingroup rpc_internal
+ *
+ * If strm is the stream returned by get_thread_local_stream(), returns
+ * the offset in the packet contents at which the next byte written to
+ * strm will be received, counting the gather segments before it.
+ * Returns size_t(-1) otherwise.
+ */
+extern size_t thread_local_packet_offset(std::ostream* strm);
+
+/**
+ * \ingroup rpc_internal
+ *
+ * Returns the gather segments recorded since the last call to
+ * get_thread_local_stream()
+ */
+extern const gather_list& get_thread_local_gather_list();
+
 }
 }
 
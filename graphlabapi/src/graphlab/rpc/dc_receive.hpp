@@ -86,6 +86,11 @@ class dc_receive {
   If packet type is marked as CONTROL_PACKET, the packet is not counted
   */
   virtual size_t bytes_received() = 0;
+
+  /// Seconds spent decompressing. Zero for receivers which do not decompress.
+  virtual double decompression_seconds() const { 
+    return 0;
+  }
   
   
   /**
@@ -23,6 +23,8 @@
 
 #ifndef DC_SEND_HPP
 #define DC_SEND_HPP
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <graphlab/rpc/dc_internal_types.hpp>
 #include <graphlab/rpc/dc_types.hpp>
@@ -58,6 +60,22 @@ class dc_send{
                  unsigned char packet_type_mask,
                  char* data, size_t len) = 0;
 
+  /** Sends the contents of data with the gather segments spliced in
+  at their offsets. The caller keeps ownership of all the memory,
+  which need only remain valid until this call returns.
+  The default implementation assembles a contiguous copy of the
+  packet and passes it to send_data(). */
+  virtual void send_data(procid_t target, 
+                 unsigned char packet_type_mask,
+                 char* data, size_t len,
+                 const gather_list& segments) {
+    size_t total = gather_length(len, segments);
+    char* buf = (char*)malloc(total);
+    gather_copy(buf, data, len, segments);
+    send_data(target, packet_type_mask, buf, total);
+    free(buf);
+  }
+
   /**
     Bytes sent must be incremented BEFORE the data is transmitted.
     Packets marked CONTROL_PACKET should not be counted
@@ -83,7 +101,57 @@ class dc_send{
    */
   virtual void shutdown() = 0;
 
+  /**
+   * Bytes passed to the compressor, the bytes it produced and the
+   * seconds spent compressing. Zero for senders which do not compress.
+   */
+  virtual void compression_statistics(size_t& bytes_in, size_t& bytes_out,
+                                      double& seconds) const {
+    bytes_in = 0;
+    bytes_out = 0;
+    seconds = 0;
+  }
+
+  /// The length of the packet formed by data and the gather segments
+  static size_t gather_length(size_t len, const gather_list& segments) {
+    for (size_t i = 0;i < segments.size(); ++i) len += segments[i].len;
+    return len;
+  }
+
+  /** Writes the packet formed by data and the gather segments
+  into out, which must hold gather_length(len, segments) bytes */
+  static void gather_copy(char* out, const char* data, size_t len,
+                          const gather_list& segments) {
+    size_t pos = 0;
+    for (size_t i = 0;i < segments.size(); ++i) {
+      memcpy(out, data + pos, segments[i].offset - pos);
+      out += segments[i].offset - pos;
+      memcpy(out, segments[i].data, segments[i].len);
+      out += segments[i].len;
+      pos = segments[i].offset;
+    }
+    memcpy(out, data + pos, len - pos);
+  }
 };
+
+/**
+\ingroup rpc_internal
+Sends the contents of the thread local stream together with any
+gather segments recorded while serializing into it.
+*/
+inline void send_thread_local_stream(dc_send* sender, 
+                                     procid_t target,
+                                     unsigned char packet_type_mask,
+                         boost::iostreams::stream<resizing_array_sink_ref>& strm) {
+  const gather_list& segments = get_thread_local_gather_list();
+  if (segments.empty()) {
+    sender->send_data(target, packet_type_mask, strm->c_str(), strm->size());
+  }
+  else {
+    sender->send_data(target, packet_type_mask, 
+                      strm->c_str(), strm->size(), segments);
+  }
+}
   
 
 } // namespace dc_impl
@@ -0,0 +1,368 @@
+/**  
+ * Copyright (c) 2009 Carnegie Mellon University. 
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <netdb.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+#include <string>
+#include <map>
+
+#include <boost/lexical_cast.hpp>
+#include <boost/bind.hpp>
+#include <graphlab/logger/logger.hpp>
+#include <graphlab/util/stl_util.hpp>
+#include <graphlab/rpc/dc_shm_comm.hpp>
+#include <graphlab/rpc/dc_internal_types.hpp>
+
+//#define COMM_DEBUG
+namespace graphlab {
+ 
+namespace dc_impl {
+
+/**
+ * The header of a ring buffer in shared memory, followed by the data.
+ * head and tail count the bytes ever consumed and produced, so the
+ * ring holds tail - head bytes starting at head % capacity.
+ */
+struct shm_ring {
+  /// written by the producer only
+  volatile size_t tail;
+  char pad0[64 - sizeof(size_t)];
+  /// written by the consumer only
+  volatile size_t head;
+  char pad1[64 - sizeof(size_t)];
+  /// futex words bumped to wake a sleeping consumer or producer
+  volatile int data_seq;
+  volatile int space_seq;
+  volatile int consumer_sleeping;
+  volatile int producer_sleeping;
+  /// set by the creator once the ring is initialized
+  volatile size_t capacity;
+  /// the size of the mapping
+  size_t mapsize;
+  char pad2[64 - 4 * sizeof(int) - 2 * sizeof(size_t)];
+
+  char* data() { return reinterpret_cast<char*>(this + 1); }
+};
+
+
+/// Waits until *addr != val, a wake up or a timeout of 100ms
+static void shm_futex_wait(volatile int* addr, int val) {
+  timespec timeout;
+  timeout.tv_sec = 0;
+  timeout.tv_nsec = 100 * 1000 * 1000;
+  // not FUTEX_PRIVATE: the word is shared between processes
+  syscall(SYS_futex, addr, FUTEX_WAIT, val, &timeout, NULL, 0);
+}
+
+/// Bumps *addr and wakes everyone waiting on it
+static void shm_futex_wake(volatile int* addr) {
+  __sync_fetch_and_add(addr, 1);
+  syscall(SYS_futex, addr, FUTEX_WAKE, std::numeric_limits<int>::max(), 
+          NULL, NULL, 0);
+}
+
+/// Maps the shared memory object of the given name
+static shm_ring* map_ring(int fd, size_t mapsize) {
+  void* ptr = mmap(NULL, mapsize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (ptr == MAP_FAILED) return NULL;
+  return reinterpret_cast<shm_ring*>(ptr);
+}
+
+
+void dc_shm_comm::init(const std::vector<std::string> &machines,
+                       const std::map<std::string,std::string> &initopts,
+                       procid_t curmachineid,
+                       std::vector<dc_receive*> receiver_){ 
+  curid = curmachineid;
+  ASSERT_LT(machines.size(), std::numeric_limits<procid_t>::max());
+  nprocs = (procid_t)(machines.size());
+  receiver = receiver_;
+  // find the machines on this host
+  std::vector<uint32_t> all_addrs(nprocs);
+  for (size_t i = 0;i < machines.size(); ++i) {
+    size_t pos = machines[i].find(":");
+    ASSERT_NE(pos, std::string::npos);
+    std::string address = machines[i].substr(0, pos);
+    struct hostent* ent = gethostbyname(address.c_str());
+    ASSERT_EQ(ent->h_length, 4);
+    all_addrs[i] = *reinterpret_cast<uint32_t*>(ent->h_addr_list[0]);
+    if (i == 0) jobtag = machines[i].substr(pos + 1);
+  }
+  is_local.resize(nprocs);
+  for (size_t i = 0;i < nprocs; ++i) {
+    is_local[i] = (i != curid && all_addrs[i] == all_addrs[curid]);
+  }
+  
+  ring_size = 8 * 1024 * 1024;
+  std::map<std::string, std::string>::const_iterator iter = 
+    initopts.find("shm_ring_size");
+  if (iter != initopts.end()) {
+    ring_size = std::max(atol(iter->second.c_str()), 4096L);
+  }
+  
+  shm_bytessent = 0;
+  shm_bytesreceived = 0;
+  inrings.resize(nprocs, NULL);
+  outrings.resize(nprocs, NULL);
+  outlocks.resize(nprocs);
+  recvbufs.resize(nprocs, NULL);
+  recvbuflengths.resize(nprocs, 0);
+  receive_stop = false;
+  // create the rings the co-located machines write to
+  for (size_t i = 0;i < nprocs; ++i) {
+    if (!is_local[i]) continue;
+    const std::string name = ring_name(i, curid);
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0 && errno == EEXIST) {
+      // left behind by a job which did not shut down
+      shm_unlink(name.c_str());
+      fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    }
+    if (fd < 0) {
+      logstream(LOG_FATAL) << "shm_open " << name << ": " 
+                           << strerror(errno) << std::endl;
+    }
+    const size_t mapsize = sizeof(shm_ring) + ring_size;
+    ASSERT_EQ(ftruncate(fd, mapsize), 0);
+    shm_ring* ring = map_ring(fd, mapsize);
+    ::close(fd);
+    ASSERT_TRUE(ring != NULL);
+    ring->mapsize = mapsize;
+    __sync_synchronize();
+    ring->capacity = ring_size;
+    inrings[i] = ring;
+    if (receiver[i]->direct_access_support()) {
+      recvbufs[i] = receiver[i]->get_buffer(recvbuflengths[i]);
+    }
+    receive_threads.launch(boost::bind(&dc_shm_comm::receive_loop, this, i));
+  }
+  logstream(LOG_INFO) << "Proc " << procid() << " shares memory with " 
+                      << std::count(is_local.begin(), is_local.end(), true)
+                      << " machines" << std::endl;
+  tcp.init(machines, initopts, curmachineid, receiver_);
+}
+
+std::string dc_shm_comm::ring_name(size_t source, size_t target) const {
+  return "/graphlab_dc_" + jobtag + "_" + tostr(source) + "_" + tostr(target);
+}
+
+void dc_shm_comm::close() {
+  if (inrings.empty()) return;
+  tcp.close();
+  logstream(LOG_INFO) << "Closing shared memory rings" << std::endl;
+  receive_stop = true;
+  for (size_t i = 0;i < inrings.size(); ++i) {
+    if (inrings[i] != NULL) shm_futex_wake(&(inrings[i]->data_seq));
+  }
+  receive_threads.join();
+  for (size_t i = 0;i < inrings.size(); ++i) {
+    if (inrings[i] != NULL) {
+      munmap(inrings[i], inrings[i]->mapsize);
+      shm_unlink(ring_name(i, curid).c_str());
+    }
+    if (outrings[i] != NULL) munmap(outrings[i], outrings[i]->mapsize);
+  }
+  inrings.clear();
+  outrings.clear();
+}
+
+void dc_shm_comm::open_outgoing(size_t target) {
+  const std::string name = ring_name(curid, target);
+  // the target creates the ring in init(), which may not have run yet.
+  // retry for 10 seconds
+  shm_ring* ring = NULL;
+  for (size_t i = 0;i < 1000 && ring == NULL; ++i) {
+    int fd = shm_open(name.c_str(), O_RDWR, 0600);
+    struct stat st;
+    if (fd >= 0 && fstat(fd, &st) == 0 && 
+        (size_t)st.st_size > sizeof(shm_ring)) {
+      ring = map_ring(fd, st.st_size);
+    }
+    if (fd >= 0) ::close(fd);
+    while (ring != NULL && ring->capacity == 0 && i < 1000) {
+      usleep(10000);
+      ++i;
+    }
+    if (ring != NULL && ring->capacity == 0) {
+      munmap(ring, st.st_size);
+      ring = NULL;
+    }
+    if (ring == NULL) usleep(10000);
+  }
+  if (ring == NULL) {
+    logstream(LOG_FATAL) << "Unable to open shared memory ring " << name 
+                         << std::endl;
+  }
+  __sync_synchronize();
+  outrings[target] = ring;
+  logstream(LOG_INFO) << "shared memory ring from " << curid << " to " 
+                      << target << " opened." << std::endl;
+}
+
+void dc_shm_comm::send(size_t target, const char* buf, size_t len) {
+  if (!is_local[target]) {
+    tcp.send(target, buf, len);
+    return;
+  }
+  shm_bytessent.inc(len);
+  outlocks[target].lock();
+  if (outrings[target] == NULL) open_outgoing(target);
+  write_to_ring(outrings[target], buf, len);
+  outlocks[target].unlock();
+}
+
+void dc_shm_comm::send2(size_t target, 
+                        const char* buf1, const size_t len1,
+                        const char* buf2, const size_t len2) {
+  if (!is_local[target]) {
+    tcp.send2(target, buf1, len1, buf2, len2);
+    return;
+  }
+  shm_bytessent.inc(len1 + len2);
+  outlocks[target].lock();
+  if (outrings[target] == NULL) open_outgoing(target);
+  write_to_ring(outrings[target], buf1, len1);
+  write_to_ring(outrings[target], buf2, len2);
+  outlocks[target].unlock();
+}
+
+void dc_shm_comm::sendv(size_t target, const struct iovec* vec, 
+                        size_t count) {
+  if (!is_local[target]) {
+    tcp.sendv(target, vec, count);
+    return;
+  }
+  size_t len = 0;
+  for (size_t i = 0;i < count; ++i) len += vec[i].iov_len;
+  shm_bytessent.inc(len);
+  outlocks[target].lock();
+  if (outrings[target] == NULL) open_outgoing(target);
+  for (size_t i = 0;i < count; ++i) {
+    write_to_ring(outrings[target], (const char*)(vec[i].iov_base), 
+                  vec[i].iov_len);
+  }
+  outlocks[target].unlock();
+}
+
+void dc_shm_comm::write_to_ring(shm_ring* ring, const char* buf, size_t len) {
+  const size_t capacity = ring->capacity;
+  while (len > 0) {
+    const size_t tail = ring->tail;
+    size_t space = capacity - (tail - ring->head);
+    if (space == 0) {
+      // the ring is full. Sleep until the consumer makes room
+      const int seq = ring->space_seq;
+      ring->producer_sleeping = 1;
+      __sync_synchronize();
+      if (capacity - (tail - ring->head) == 0) {
+        shm_futex_wait(&(ring->space_seq), seq);
+      }
+      ring->producer_sleeping = 0;
+      continue;
+    }
+    const size_t n = std::min(space, len);
+    const size_t offset = tail % capacity;
+    const size_t first = std::min(n, capacity - offset);
+    memcpy(ring->data() + offset, buf, first);
+    if (n > first) memcpy(ring->data(), buf + first, n - first);
+    // publish the data before the new tail
+    __sync_synchronize();
+    ring->tail = tail + n;
+    buf += n;
+    len -= n;
+    __sync_synchronize();
+    if (ring->consumer_sleeping) shm_futex_wake(&(ring->data_seq));
+  }
+}
+
+void dc_shm_comm::deliver(size_t source, const char* buf, size_t len) {
+  #ifdef COMM_DEBUG
+  logstream(LOG_INFO) << len << " bytes <-- " << source  << std::endl;
+  #endif
+  if (recvbufs[source] == NULL) {
+    receiver[source]->incoming_data((procid_t)source, buf, len);
+    return;
+  }
+  while (len > 0) {
+    const size_t n = std::min(len, recvbuflengths[source]);
+    memcpy(recvbufs[source], buf, n);
+    recvbufs[source] = receiver[source]->advance_buffer(recvbufs[source], n,
+                                                        recvbuflengths[source]);
+    buf += n;
+    len -= n;
+  }
+}
+
+void dc_shm_comm::receive_loop(size_t source) {
+  shm_ring* ring = inrings[source];
+  const size_t capacity = ring->capacity;
+  size_t idle_rounds = 0;
+  while (1) {
+    const size_t head = ring->head;
+    const size_t avail = ring->tail - head;
+    if (avail > 0) {
+      // read the data after the tail
+      __sync_synchronize();
+      const size_t offset = head % capacity;
+      const size_t first = std::min(avail, capacity - offset);
+      deliver(source, ring->data() + offset, first);
+      if (avail > first) deliver(source, ring->data(), avail - first);
+      __sync_synchronize();
+      ring->head = head + avail;
+      shm_bytesreceived.inc(avail);
+      __sync_synchronize();
+      if (ring->producer_sleeping) shm_futex_wake(&(ring->space_seq));
+      idle_rounds = 0;
+    }
+    else if (receive_stop) {
+      break;
+    }
+    else if (idle_rounds < 16) {
+      ++idle_rounds;
+      sched_yield();
+    }
+    else {
+      // the ring is empty. Sleep until the producer writes
+      const int seq = ring->data_seq;
+      ring->consumer_sleeping = 1;
+      __sync_synchronize();
+      if (ring->tail == head && !receive_stop) {
+        shm_futex_wait(&(ring->data_seq), seq);
+      }
+      ring->consumer_sleeping = 0;
+    }
+  }
+}
+
+}
+}
@@ -0,0 +1,180 @@
+/**  
+ * Copyright (c) 2009 Carnegie Mellon University. 
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+#ifndef DC_SHM_COMM_HPP
+#define DC_SHM_COMM_HPP
+
+#include <vector>
+#include <string>
+#include <map>
+
+#include <graphlab/parallel/pthread_tools.hpp>
+#include <graphlab/parallel/atomic.hpp>
+#include <graphlab/rpc/dc_types.hpp>
+#include <graphlab/rpc/dc_internal_types.hpp>
+#include <graphlab/rpc/dc_comm_base.hpp>
+#include <graphlab/rpc/dc_tcp_comm.hpp>
+
+namespace graphlab {
+namespace dc_impl {
+
+struct shm_ring;
+  
+/**
+ \ingroup rpc_internal
+Communications subsystem which moves data between processes on the
+same machine through single producer / single consumer ring buffers in
+POSIX shared memory, and uses dc_tcp_comm for all other machines.
+
+Two machines are on the same host if their addresses in the machines
+list resolve to the same IP. Each process creates one ring for every
+co-located process sending to it, named after the port of machine 0,
+and serves it with a receiving thread. Senders open the ring on their
+first send. Both sides sleep on a futex in the ring when it is empty
+or full.
+
+Selected with the initstring option comm=shm. The option 
+shm_ring_size=BYTES sets the capacity of each ring (default 8MB).
+Linux only.
+*/
+class dc_shm_comm:public dc_comm_base {
+ public:
+  
+  dc_shm_comm() {}
+  
+  size_t capabilities() const {
+    return COMM_STREAM;
+  }
+  
+  /**
+   Same as dc_tcp_comm::init(). machines is a vector of strings of the
+   form [IP]:[portnumber] and machines[curmachineid] is the listening
+   address of this machine.
+  */
+  void init(const std::vector<std::string> &machines,
+            const std::map<std::string,std::string> &initopts,
+            procid_t curmachineid,
+            std::vector<dc_receive*> receiver);
+
+  /** shuts down the rings and all sockets and cleans up */
+  void close();
+  
+  ~dc_shm_comm() {
+    close();
+  }
+  
+  inline bool channel_active(size_t target) const {
+    if (is_local[target]) return outrings[target] != NULL;
+    return tcp.channel_active(target);
+  }
+
+  inline procid_t numprocs() const {
+    return nprocs;
+  }
+  
+  inline procid_t procid() const {
+    return curid;
+  }
+  
+  inline size_t network_bytes_sent() const {
+    return shm_bytessent.value + tcp.network_bytes_sent();
+  }
+
+  inline size_t network_bytes_received() const {
+    return shm_bytesreceived.value + tcp.network_bytes_received();
+  }
+
+  /// Returns true if the machine is on this host
+  inline bool is_local_machine(size_t target) const {
+    return is_local[target];
+  }
+ 
+  void flush(size_t target) { 
+    if (!is_local[target]) tcp.flush(target);
+  }
+  
+  /**
+   Sends the string of length len to the target machine dest.
+   Only valid after call to init();
+   Establishes a connection if necessary
+  */
+  void send(size_t target, const char* buf, size_t len);
+  
+  /**
+   * Sends two buffers one after another to the target machine. 
+   */
+  void send2(size_t target, 
+             const char* buf1, const size_t len1,
+             const char* buf2, const size_t len2); 
+
+  /**
+   * Sends count buffers one after another to the target machine. 
+   */
+  void sendv(size_t target, const struct iovec* vec, size_t count);
+  
+ private:
+  /// The shared memory name of the ring from source to target
+  std::string ring_name(size_t source, size_t target) const;
+
+  /// opens the ring to target, waiting for the target to create it
+  void open_outgoing(size_t target);
+
+  /// copies len bytes into the ring, waiting for space if it is full
+  void write_to_ring(shm_ring* ring, const char* buf, size_t len);
+
+  /// the body of the thread receiving from the ring of machine source
+  void receive_loop(size_t source);
+
+  /// passes received data to the receiver of machine source
+  void deliver(size_t source, const char* buf, size_t len);
+
+  procid_t curid; 
+  procid_t nprocs;
+  /// the port of machine 0. Identifies this job in the ring names.
+  std::string jobtag;
+  size_t ring_size;
+
+  std::vector<dc_receive*> receiver;
+  std::vector<bool> is_local;
+
+  /// the rings from and to every co-located machine
+  std::vector<shm_ring*> inrings;
+  std::vector<shm_ring*> outrings;
+  /// serializes the senders to each ring
+  std::vector<mutex> outlocks;
+  /// the direct access buffers of the receivers
+  std::vector<char*> recvbufs;
+  std::vector<size_t> recvbuflengths;
+  
+  thread_group receive_threads;
+  volatile bool receive_stop;
+
+  /// carries the traffic to other hosts
+  dc_tcp_comm tcp;
+  
+  atomic<size_t> shm_bytessent;
+  atomic<size_t> shm_bytesreceived;
+};
+
+} // namespace dc_impl
+} // namespace graphlab
+#endif
@@ -125,13 +125,56 @@ char* dc_stream_receive::get_buffer(size_t& retbuflength) {
 }
 
 
+bool dc_stream_receive::begin_large_receive() {
+  if (barrier || size_t(buffer.size()) < sizeof(packet_hdr)) return false;
+  packet_hdr hdr;
+  buffer.peek((char*)(&hdr), sizeof(hdr));
+  if ((hdr.packet_type_mask & STANDARD_CALL) == 0 ||
+      (hdr.packet_type_mask & (FAST_CALL | REPLY_PACKET | BARRIER)) ||
+      hdr.len < direct_receive_threshold ||
+      size_t(buffer.size()) >= sizeof(packet_hdr) + hdr.len) return false;
+  buffer.skip(sizeof(packet_hdr));
+  if ((hdr.packet_type_mask & CONTROL_PACKET) == 0) {
+    bytesreceived += hdr.len;
+  }
+  largehdr = hdr;
+  largebuf = (char*)malloc(hdr.len);
+  largebuf_filled = buffer.size();
+  buffer.read(largebuf, largebuf_filled);
+  return true;
+}
+
 char* dc_stream_receive::advance_buffer(char* c, size_t wrotelength, 
                             size_t& retbuflength) {
   char* ret;
   bufferlock.lock();
-  buffer.advance_write(wrotelength);
-
-  process_buffer(true);
+  if (largebuf != NULL) {
+    // c is inside largebuf
+    largebuf_filled += wrotelength;
+    if (largebuf_filled < largehdr.len) {
+      retbuflength = largehdr.len - largebuf_filled;
+      ret = largebuf + largebuf_filled;
+      bufferlock.unlock();
+      return ret;
+    }
+    // complete. The handler frees largebuf
+    pending_calls.inc();
+    dc->deferred_function_call(largehdr.src, largehdr, largebuf, largehdr.len);
+    largebuf = NULL;
+    largebuf_filled = 0;
+  }
+  else {
+    buffer.advance_write(wrotelength);
+    process_buffer(true);
+    if (begin_large_receive()) {
+      // receive no more than the rest of the call so that the
+      // following packets land in the circular buffer
+      retbuflength = largehdr.len - largebuf_filled;
+      ret = largebuf + largebuf_filled;
+      bufferlock.unlock();
+      return ret;
+    }
+  }
   
   retbuflength = buffer.introspective_write(ret);
   // if the writeable section is too small, sqeeze the buffer 
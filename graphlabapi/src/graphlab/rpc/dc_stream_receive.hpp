@@ -51,7 +51,8 @@ class dc_stream_receive: public dc_receive{
   dc_stream_receive(distributed_control* dc): 
                   buffer(10240),
                   barrier(false), dc(dc),
-                  bytesreceived(0){ }
+                  bytesreceived(0), 
+                  largebuf(NULL), largebuf_filled(0) { }
 
   /**
    Called by the controller when there is data coming
@@ -84,6 +85,18 @@ class dc_stream_receive: public dc_receive{
   distributed_control* dc;
 
   size_t bytesreceived;
+
+  /** Deferred calls at least this long are received directly
+  into their own allocation instead of the circular buffer */
+  static const size_t direct_receive_threshold = 65536;
+
+  /** When not NULL, the contents of a large deferred call
+  which is being received directly. Protected by the bufferlock */
+  char* largebuf;
+  /// The header of the call being received into largebuf
+  packet_hdr largehdr;
+  /// The number of bytes of largebuf which have been received
+  size_t largebuf_filled;
   
   /**
     Reads the incoming buffer and processes, dispatching
@@ -91,6 +104,13 @@ class dc_stream_receive: public dc_receive{
   */
   void process_buffer(bool outsidelocked) ;
 
+  /**
+    If the buffer ends with the start of a large deferred call,
+    moves it into largebuf so that the rest of the call can 
+    be received in place. bufferlock must be held.
+  */
+  bool begin_large_receive();
+
   size_t bytes_received();
   
   void shutdown();
@@ -27,7 +27,7 @@
 #include <graphlab/rpc/dc.hpp>
 #include <graphlab/rpc/dc_internal_types.hpp>
 #include <graphlab/rpc/dc_stream_receive_z.hpp>
-#include <zlib.h>
+#include <graphlab/util/timer.hpp>
 //#define DC_RECEIVE_DEBUG
 
 namespace graphlab {
@@ -41,21 +41,72 @@ namespace dc_impl {
 void dc_stream_receive_z::incoming_data(procid_t src, 
                     const char* buf, 
                     size_t len) {
-  zstrm.avail_in = (uInt)len;
-  zstrm.next_in = (Bytef*)buf;
- 
   compressed_bytesreceived.inc(len); 
-  do{
-    zstrm.avail_out = 128*1024;
-    zstrm.next_out = (Bytef*)zbuffer;
-    ASSERT_NE(inflate(&zstrm, Z_SYNC_FLUSH), Z_STREAM_ERROR);
-    bufferlock.lock();
-    buffer.write(zbuffer, 128*1024 - zstrm.avail_out);
-    bufferlock.unlock();
-  } while(zstrm.avail_out == 0);
+  const size_t hdrlen = sizeof(compressed_block_hdr);
+  compressed_block_hdr hdr;
+  while (len > 0) {
+    // whole blocks are decompressed straight out of buf
+    if (partial.empty() && len >= hdrlen) {
+      memcpy(&hdr, buf, hdrlen);
+      check_block_header(src, hdr);
+      size_t blocklen = hdrlen + (hdr.complen > 0 ? hdr.complen : hdr.rawlen);
+      if (len >= blocklen) {
+        receive_block(hdr, buf + hdrlen);
+        buf += blocklen;
+        len -= blocklen;
+        continue;
+      }
+    }
+    // otherwise collect the block 
+    size_t want = hdrlen;
+    if (partial.size() >= hdrlen) {
+      memcpy(&hdr, &(partial[0]), hdrlen);
+      want = hdrlen + (hdr.complen > 0 ? hdr.complen : hdr.rawlen);
+    }
+    size_t n = std::min(len, want - partial.size());
+    partial.insert(partial.end(), buf, buf + n);
+    buf += n;
+    len -= n;
+    if (partial.size() == hdrlen) {
+      memcpy(&hdr, &(partial[0]), hdrlen);
+      check_block_header(src, hdr);
+    }
+    if (partial.size() == want && want > hdrlen) {
+      receive_block(hdr, &(partial[hdrlen]));
+      partial.clear();
+    }
+  }
   process_buffer(false);
+}
 
-  //std::cout << dc->procid() << ": From " << src << ": " << zstrm.total_in << " --> " << zstrm.total_out << std::endl; 
+void dc_stream_receive_z::check_block_header(procid_t src,
+                                             const compressed_block_hdr& hdr) {
+  if (hdr.rawlen == 0 || hdr.rawlen > COMPRESSED_BLOCK_SIZE ||
+      (hdr.complen > 0 && 
+       hdr.complen > compressor->max_compressed_length(hdr.rawlen))) {
+    logstream(LOG_FATAL) << "Corrupt compressed block header from " << src 
+                         << ": " << hdr.rawlen << " bytes compressed to " 
+                         << hdr.complen << std::endl;
+  }
+}
+
+void dc_stream_receive_z::receive_block(const compressed_block_hdr& hdr, 
+                                        const char* data) {
+  ASSERT_LE(hdr.rawlen, COMPRESSED_BLOCK_SIZE);
+  if (hdr.complen == 0) {
+    bufferlock.lock();
+    buffer.write(data, hdr.rawlen);
+    bufferlock.unlock();
+    return;
+  }
+  timer ti;
+  ti.start();
+  bool success = compressor->decompress(data, hdr.complen, zbuffer, hdr.rawlen);
+  decompress_seconds += ti.current_time();
+  ASSERT_MSG(success, "Corrupt compressed block");
+  bufferlock.lock();
+  buffer.write(zbuffer, hdr.rawlen);
+  bufferlock.unlock();
 }
   
 /** called by the controller when a function
@@ -23,9 +23,11 @@
 
 #ifndef DC_STREAM_RECEIVE_Z_HPP
 #define DC_STREAM_RECEIVE_Z_HPP
+#include <vector>
+#include <string>
 #include <boost/type_traits/is_base_of.hpp>
-#include <zlib.h>
 #include <graphlab/rpc/circular_char_buffer.hpp>
+#include <graphlab/rpc/dc_compressor.hpp>
 #include <graphlab/rpc/dc_internal_types.hpp>
 #include <graphlab/rpc/dc_types.hpp>
 #include <graphlab/rpc/dc_receive.hpp>
@@ -42,30 +44,36 @@ namespace dc_impl {
 
 /**
   \ingroup rpc
-  ZLib Compressed receiver processor for the dc class.
+  Compressed receiver processor for the dc class.
   The job of the receiver is to take as input a byte stream
   (as received from the socket) and cut it up into meaningful chunks.
   This can be thought of as a receiving end of a multiplexor.
   
-  This implements a matching receiver for the ZLib compressed sender
-  dc_stream_send_z. ZLib required to compile this.
+  This implements a matching receiver for the compressed sender
+  dc_buffered_stream_send_expqueue_z. The incoming stream is a sequence
+  of blocks (see compressed_block_hdr) which are decompressed into 
+  the packet buffer.
   
   \see dc_buffered_stream_send_expqueue_z
 */
 class dc_stream_receive_z: public dc_receive{
  public:
   
-  dc_stream_receive_z(distributed_control* dc): 
+  dc_stream_receive_z(distributed_control* dc, 
+                      const std::string& compressor_name): 
                   buffer(10240),
                   barrier(false), dc(dc),
-                  bytesreceived(0){ 
-    zstrm.zalloc = Z_NULL;
-    zstrm.zfree = Z_NULL;
-    zstrm.opaque = Z_NULL;
-    zstrm.avail_in = 0;
-    zstrm.next_in = Z_NULL;
-    ASSERT_TRUE(inflateInit(&zstrm) == Z_OK);   
-    zbuffer = (char*)malloc(128*1024);
+                  bytesreceived(0), decompress_seconds(0) { 
+    compressor = make_dc_compressor(compressor_name);
+    if (compressor == NULL) {
+      logstream(LOG_FATAL) << "Unknown compressor " << compressor_name << std::endl;
+    }
+    zbuffer = (char*)malloc(COMPRESSED_BLOCK_SIZE);
+  }
+
+  ~dc_stream_receive_z() {
+    free(zbuffer);
+    delete compressor;
   }
 
   /**
@@ -100,6 +108,7 @@ class dc_stream_receive_z: public dc_receive{
 
   size_t bytesreceived;
   atomic<size_t> compressed_bytesreceived;
+  double decompress_seconds;
   
   /**
     Reads the incoming buffer and processes, dispatching
@@ -108,6 +117,10 @@ class dc_stream_receive_z: public dc_receive{
   void process_buffer(bool outsidelocked) ;
 
   size_t bytes_received();
+
+  double decompression_seconds() const {
+    return decompress_seconds;
+  }
   
   void shutdown();
 
@@ -121,8 +134,18 @@ class dc_stream_receive_z: public dc_receive{
   char* advance_buffer(char* c, size_t wrotelength, 
                               size_t& retbuflength);
                               
-  z_stream zstrm;
+  dc_compressor* compressor;
+  /// the decompressed block
   char* zbuffer;
+  /// a block which has only partially arrived, starting with its header
+  std::vector<char> partial;
+
+  /** fails on a block header which no sender produces, such as an
+   *  empty block, instead of waiting forever for its data */
+  void check_block_header(procid_t src, const compressed_block_hdr& hdr);
+
+  /// decompresses a complete block into the packet buffer
+  void receive_block(const compressed_block_hdr& hdr, const char* data);
   
 };
 
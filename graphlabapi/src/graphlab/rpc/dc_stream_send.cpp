@@ -22,6 +22,7 @@
 
 
 #include <iostream>
+#include <vector>
 #include <boost/iostreams/stream.hpp>
 
 #include <graphlab/rpc/dc.hpp>
@@ -108,6 +109,53 @@ void dc_stream_send::send_data(procid_t target,
   lock.unlock();
 }
 
+void dc_stream_send::send_data(procid_t target, 
+                               unsigned char packet_type_mask,
+                               char* data, size_t len,
+                               const gather_list& segments) {
+  size_t total = gather_length(len, segments);
+  if ((packet_type_mask & CONTROL_PACKET) == 0) {
+    if (packet_type_mask & (FAST_CALL | STANDARD_CALL)) {
+      dc->inc_calls_sent(target);
+    }
+    bytessent.inc(total);
+  }
+  packet_hdr hdr;
+  memset(&hdr, 0, sizeof(packet_hdr));
+  hdr.len = total;
+  hdr.src = dc->procid(); 
+  hdr.sequentialization_key = dc->get_sequentialization_key();
+  hdr.packet_type_mask = packet_type_mask;
+  // header, then the serialized contents split around each segment
+  std::vector<struct iovec> vec;
+  vec.reserve(2 * segments.size() + 2);
+  struct iovec v;
+  v.iov_base = reinterpret_cast<char*>(&hdr);
+  v.iov_len = sizeof(packet_hdr);
+  vec.push_back(v);
+  size_t pos = 0;
+  for (size_t i = 0;i < segments.size(); ++i) {
+    if (segments[i].offset > pos) {
+      v.iov_base = data + pos;
+      v.iov_len = segments[i].offset - pos;
+      vec.push_back(v);
+    }
+    v.iov_base = (void*)(segments[i].data);
+    v.iov_len = segments[i].len;
+    vec.push_back(v);
+    pos = segments[i].offset;
+  }
+  if (len > pos) {
+    v.iov_base = data + pos;
+    v.iov_len = len - pos;
+    vec.push_back(v);
+  }
+  lock.lock();
+  comm->sendv(target, &(vec[0]), vec.size());
+  comm->flush(target);
+  lock.unlock();
+}
+
 void dc_stream_send::shutdown() { }
 
 } // namespace dc_impl
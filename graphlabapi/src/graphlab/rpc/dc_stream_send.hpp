@@ -81,6 +81,13 @@ class dc_stream_send: public dc_send{
   void send_data(procid_t target, 
                  unsigned char packet_type_mask,
                  char* data, size_t len);
+
+  /** Transmits the packet header, the serialized contents and the
+  gather segments with a single gathering write. Nothing is copied. */
+  void send_data(procid_t target, 
+                 unsigned char packet_type_mask,
+                 char* data, size_t len,
+                 const gather_list& segments);
   /**
    * Stops the sender. Behavior of any send_data calls after shutdown() is undefined
    */
@@ -31,6 +31,7 @@
 #include <netinet/tcp.h>
 #include <ifaddrs.h>
 #include <poll.h>
+#include <limits.h>
 
 #include <limits>
 #include <vector>
@@ -160,61 +161,57 @@ void dc_tcp_comm::send(size_t target, const char* buf, size_t len) {
 void dc_tcp_comm::send2(size_t target, 
                        const char* buf1, const size_t len1,
                        const char* buf2, const size_t len2) {
-  network_bytessent.inc(len1 + len2);
-  check_for_out_connection(target);
-  struct msghdr data;
   struct iovec vec[2];
   vec[0].iov_base = (void*)buf1;
   vec[0].iov_len = len1;
   vec[1].iov_base = (void*)buf2;
   vec[1].iov_len = len2;
- 
+  sendv(target, vec, 2);
+}
+
+void dc_tcp_comm::sendv(size_t target, const struct iovec* vec, 
+                        size_t count) {
+  // amount of data to transmit
+  size_t dataleft = 0;
+  for (size_t i = 0;i < count; ++i) dataleft += vec[i].iov_len;
+  network_bytessent.inc(dataleft);
+  check_for_out_connection(target);
+  #ifdef COMM_DEBUG
+  logstream(LOG_INFO) << dataleft << " bytes --> " << target  << std::endl;
+  #endif
+  // sendmsg advances through a copy of the caller's vectors 
+  std::vector<struct iovec> remaining(vec, vec + count);
+  struct iovec* iovptr = &(remaining[0]);
+  size_t iovlen = count;
+
+  struct msghdr data;
   data.msg_name = NULL;
   data.msg_namelen = 0;
   data.msg_control = NULL;
   data.msg_controllen = 0;
   data.msg_flags = 0;
-  data.msg_iovlen = 2;
-  data.msg_iov = vec;
-  
- 
-  #ifdef COMM_DEBUG
-  logstream(LOG_INFO) << len << " bytes --> " << target  << std::endl;
-  #endif
-  // amount of data to transmit
-  size_t dataleft = len1 + len2;
   // while there is still data to be sent
   while(dataleft > 0) {
-    size_t ret = sendmsg(outsocks[target], &data, 0);
+    data.msg_iov = iovptr;
+    data.msg_iovlen = std::min(iovlen, (size_t)IOV_MAX);
+    ssize_t ret = sendmsg(outsocks[target], &data, 0);
+    if (ret < 0) {
+      if (errno == EINTR) continue;
+      logstream(LOG_ERROR) << "send error: " << strerror(errno) << std::endl;
+      return;
+    }
     // decrement the counter
     dataleft -= ret;
-    // restructure the msghdr depending on how much was sent
-    struct iovec* newiovecptr = data.msg_iov;
-    size_t newiovlen = data.msg_iovlen;
-    for (size_t i = 0;i < (size_t)(data.msg_iovlen); ++i) {
-      // amount sent was less than this entry.
-      // shift the entry and retry
-      if (ret < data.msg_iov[i].iov_len) {
-        // shift the data
-        data.msg_iov[i].iov_len -= ret;
-        char* tmp = (char*) data.msg_iov[i].iov_base;
-        tmp += ret;
-        data.msg_iov[i].iov_base = (void*)tmp;
-        break;
-      }
-      else {
-        // amount sent exceeds this entry. we need to 
-        // erase this entry (increment the iovec_ptr)
-        // and go on to the next entry
-        size_t l = std::min(ret, data.msg_iov[i].iov_len);
-        newiovlen--;
-        newiovecptr++;
-        ret -= l;
-        if (ret == 0) break;
-      }
+    // erase the entries which were completely sent and 
+    // shift the partially sent entry
+    while(iovlen > 0 && (size_t)ret >= iovptr->iov_len) {
+      ret -= iovptr->iov_len;
+      ++iovptr; --iovlen;
+    }
+    if (iovlen > 0) {
+      iovptr->iov_base = (char*)(iovptr->iov_base) + ret;
+      iovptr->iov_len -= ret;
     }
-    data.msg_iov = newiovecptr;
-    data.msg_iovlen = newiovlen;
   }
 }
 
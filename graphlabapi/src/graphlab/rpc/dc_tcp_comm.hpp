@@ -135,6 +135,11 @@ class dc_tcp_comm:public dc_comm_base {
              const char* buf1, const size_t len1,
              const char* buf2, const size_t len2); 
   
+  /**
+   * Sends count buffers one after another to the target machine
+   * using gathering writes.
+   */
+  void sendv(size_t target, const struct iovec* vec, size_t count);
   
   // receiving socket handler
   class socket_handler {
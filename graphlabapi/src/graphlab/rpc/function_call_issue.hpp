@@ -167,7 +167,7 @@ class  BOOST_PP_CAT(FNAME_AND_CALL, N) { \
     if (reinterpret_cast<size_t>(remote_function) == reinterpret_cast<size_t>(reply_increment_counter)) { \
       flags |= REPLY_PACKET; \
     } \
-    sender->send_data(target,flags , strm->c_str(), strm->size());    \
+    send_thread_local_stream(sender, target, flags, strm);    \
   }\
 }; 
 
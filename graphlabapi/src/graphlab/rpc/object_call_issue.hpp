@@ -94,9 +94,10 @@ class  BOOST_PP_CAT(BOOST_PP_TUPLE_ELEM(2,0,FNAME_AND_CALL), N) { \
     arc << objid;       \
     BOOST_PP_REPEAT(N, GENARC, _)                \
     strm.flush();           \
-    sender->send_data(target,flags , strm->c_str(), strm->size());    \
+    send_thread_local_stream(sender, target, flags, strm);    \
     if ((flags & CONTROL_PACKET) == 0)                       \
-      rmi->inc_bytes_sent(target, strm->size());           \
+      rmi->inc_bytes_sent(target, dc_send::gather_length(strm->size(),  \
+                                  get_thread_local_gather_list())); \
   }\
 }; 
 
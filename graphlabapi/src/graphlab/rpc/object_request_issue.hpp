@@ -113,9 +113,10 @@ class  BOOST_PP_CAT(FNAME_AND_CALL, N) { \
     arc << reinterpret_cast<size_t>(&reply);       \
     BOOST_PP_REPEAT(N, GENARC, _)                \
     strm.flush();           \
-    sender->send_data(target, flags, strm->c_str(), strm->size());    \
+    send_thread_local_stream(sender, target, flags, strm);    \
     if ((flags & CONTROL_PACKET) == 0)                       \
-      rmi->inc_bytes_sent(target, strm->size());           \
+      rmi->inc_bytes_sent(target, dc_send::gather_length(strm->size(),  \
+                                  get_thread_local_gather_list())); \
     reply.wait(); \
     boost::iostreams::stream<boost::iostreams::array_source> retstrm(reply.val.c, reply.val.len);  \
     iarchive iarc(retstrm);  \
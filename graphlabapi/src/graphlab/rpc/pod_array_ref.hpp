@@ -0,0 +1,168 @@
+/**  
+ * Copyright (c) 2009 Carnegie Mellon University. 
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+#ifndef GRAPHLAB_POD_ARRAY_REF_HPP
+#define GRAPHLAB_POD_ARRAY_REF_HPP
+#include <vector>
+#include <iostream>
+#include <boost/static_assert.hpp>
+#include <boost/type_traits/is_pod.hpp>
+#include <boost/type_traits/alignment_of.hpp>
+#include <boost/iostreams/stream.hpp>
+#include <boost/iostreams/device/array.hpp>
+#include <graphlab/serialization/serialization_includes.hpp>
+#include <graphlab/rpc/dc_internal_types.hpp>
+
+namespace graphlab {
+
+/**
+ * \ingroup rpc
+ * A reference to an array of POD elements which can be passed as an
+ * RPC argument without copying the array into the serialization
+ * stream.
+ *
+ * On the sending side, the array is transmitted directly from the
+ * caller's memory. The memory must remain valid until the
+ * remote_call / remote_request issuing it returns.
+ * 
+ * On the receiving side, a deferred call (the default) receives a
+ * reference into the receive buffer. This reference is only valid
+ * until the handler returns. Calls which cannot be deserialized in
+ * place (fast calls, or misaligned data) receive a private copy.
+ * 
+ * \code
+ * void set_factors(size_t vid, const pod_array_ref<double>& f);
+ * std::vector<double> f(1000);
+ * dc.remote_call(1, set_factors, vid, pod_array_ref<double>(f));
+ * \endcode
+ */
+template <typename T>
+class pod_array_ref {
+  BOOST_STATIC_ASSERT(boost::is_pod<T>::value);
+  BOOST_STATIC_ASSERT(boost::alignment_of<T>::value <= 16);
+ public:
+  typedef T value_type;
+  typedef const T* const_iterator;
+
+  pod_array_ref(): ptr(NULL), len(0) { }
+  
+  pod_array_ref(const T* ptr, size_t len): ptr(ptr), len(len) { }
+  
+  pod_array_ref(const std::vector<T>& vec): 
+    ptr(vec.empty() ? NULL : &(vec[0])), len(vec.size()) { }
+  
+  pod_array_ref(const pod_array_ref& other) { 
+    assign(other);
+  }
+  
+  pod_array_ref& operator=(const pod_array_ref& other) {
+    if (this != &other) assign(other);
+    return *this;
+  }
+
+  inline const T* data() const { return ptr; }
+  inline size_t size() const { return len; }
+  inline bool empty() const { return len == 0; }
+  inline const_iterator begin() const { return ptr; }
+  inline const_iterator end() const { return ptr + len; }
+  inline const T& operator[](size_t i) const { return ptr[i]; }
+
+  /// Copies the array into a vector
+  operator std::vector<T>() const {
+    return std::vector<T>(begin(), end());
+  }
+
+  void save(oarchive& arc) const {
+    arc << len;
+    // pad so that the array is aligned within the received packet
+    char pad = 0;
+    size_t offset = dc_impl::thread_local_packet_offset(arc.o);
+    if (offset != size_t(-1)) {
+      const size_t align = boost::alignment_of<T>::value;
+      pad = char((align - (offset + 1) % align) % align);
+    }
+    arc << pad;
+    const char zeros[16] = {0};
+    arc.o->write(zeros, pad);
+    const char* bytes = reinterpret_cast<const char*>(ptr);
+    const size_t nbytes = len * sizeof(T);
+    if (nbytes >= dc_impl::GATHER_MIN_BYTES && 
+        dc_impl::thread_local_gather(arc.o, bytes, nbytes)) return;
+    arc.o->write(bytes, nbytes);
+  }
+
+  void load(iarchive& arc) {
+    owned.clear();
+    ptr = NULL;
+    arc >> len;
+    char pad;
+    arc >> pad;
+    // the sender never pads by 16 bytes or more
+    char skip[16];
+    const size_t padlen = (unsigned char)pad;
+    ASSERT_LT(padlen, sizeof(skip));
+    arc.i->read(skip, padlen);
+    if (len == 0) return;
+    const size_t nbytes = len * sizeof(T);
+    // deferred calls are deserialized from an array stream over
+    // the receive buffer. Point into it.
+    typedef boost::iostreams::stream<boost::iostreams::array_source> 
+      array_stream;
+    array_stream* strm = dynamic_cast<array_stream*>(arc.i);
+    if (strm != NULL) {
+      std::pair<char*, char*> seq = (*strm)->input_sequence();
+      std::streamoff pos = strm->tellg();
+      const char* c = seq.first + pos;
+      if (pos >= 0 && c + nbytes <= seq.second &&
+          size_t(c) % boost::alignment_of<T>::value == 0) {
+        ptr = reinterpret_cast<const T*>(c);
+        strm->seekg(nbytes, std::ios_base::cur);
+        return;
+      }
+    }
+    owned.resize(len);
+    arc.i->read(reinterpret_cast<char*>(&(owned[0])), nbytes);
+    ptr = &(owned[0]);
+  }
+
+ private:
+  const T* ptr;
+  size_t len;
+  /// storage when the array could not be referenced in place
+  std::vector<T> owned;
+
+  void assign(const pod_array_ref& other) {
+    len = other.len;
+    if (other.owned.empty()) {
+      owned.clear();
+      ptr = other.ptr;
+    }
+    else {
+      owned = other.owned;
+      ptr = &(owned[0]);
+    }
+  }
+};
+
+} // namespace graphlab
+#endif
@@ -94,7 +94,7 @@ template<typename F BOOST_PP_COMMA_IF(N) BOOST_PP_ENUM_PARAMS(N, typename T) > \
       arc << char(0);    \
       BOOST_PP_REPEAT(N, GENARC, _)                \
         strm.flush();                   \
-      sender->send_data(target,  flags, strm->c_str(), strm->size());    \
+      send_thread_local_stream(sender, target, flags, strm);    \
     }  \
   };
 
@@ -118,7 +118,7 @@ template<typename F BOOST_PP_COMMA_IF(N) BOOST_PP_ENUM_PARAMS(N, typename T) > \
     arc << reinterpret_cast<size_t>(&reply);       \
     BOOST_PP_REPEAT(N, GENARC, _)                \
     strm.flush();           \
-    sender->send_data(target, flags, strm->c_str(), strm->size());    \
+    send_thread_local_stream(sender, target, flags, strm);    \
     reply.wait(); \
     boost::iostreams::stream<boost::iostreams::array_source> retstrm(reply.val.c, reply.val.len);    \
     iarchive iarc(retstrm);  \
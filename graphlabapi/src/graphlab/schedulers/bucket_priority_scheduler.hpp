@@ -0,0 +1,447 @@
+/**  
+ * Copyright (c) 2009 Carnegie Mellon University. 
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+
+/**
+ * This class defines a bucketed (delta-stepping style) priority
+ * scheduler.  Priorities are quantized into log-scaled buckets, each
+ * a concurrent bag of vertices split into one lane per cpu.  The cpus
+ * drain the highest non-empty bucket in parallel, taking the vertices
+ * of a bucket in no particular order.  Adding a task to a queued
+ * vertex only moves it when its priority crosses into a higher
+ * bucket, which is a constant time push.  The entry left in the
+ * lower bucket is skipped when it is reached.
+ **/
+#ifndef GRAPHLAB_BUCKET_PRIORITY_SCHEDULER_HPP
+#define GRAPHLAB_BUCKET_PRIORITY_SCHEDULER_HPP
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include <cassert>
+
+#include <graphlab/graph/graph.hpp>
+#include <graphlab/scope/iscope.hpp>
+#include <graphlab/tasks/update_task.hpp>
+#include <graphlab/schedulers/ischeduler.hpp>
+#include <graphlab/parallel/pthread_tools.hpp>
+#include <graphlab/parallel/atomic.hpp>
+#include <graphlab/schedulers/icallback.hpp>
+#include <graphlab/schedulers/support/vertex_task_set.hpp>
+#include <graphlab/util/task_count_termination.hpp>
+#include <graphlab/metrics/metrics.hpp>
+#include <graphlab/logger/logger.hpp>
+
+
+#include <graphlab/macros_def.hpp>
+
+namespace graphlab {
+
+
+  /** \ingroup group_schedulers
+   */
+  template<typename Graph>
+  class bucket_priority_scheduler : public ischeduler<Graph> {
+  public:
+    typedef Graph graph_type;
+    typedef ischeduler<Graph> base;
+
+    typedef typename base::vertex_id_type vertex_id_type;
+    typedef typename base::iengine_type iengine_type;
+    typedef typename base::update_task_type update_task_type;
+    typedef typename base::update_function_type update_function_type;
+    typedef typename base::callback_type callback_type;
+    typedef typename base::monitor_type monitor_type;
+    typedef task_count_termination terminator_type;
+
+  private:
+    using base::monitor;
+
+    /** One lane of a bucket, a stack of vertices with its lock */
+    struct lane_type {
+      spinlock lock;
+      std::vector<vertex_id_type> vertices;
+      char pad[64];
+    };
+
+    /** A bucket. size counts the entries of all lanes */
+    struct bucket_type {
+      std::vector<lane_type> lanes;
+      atomic<size_t> size;
+      char pad[64];
+    };
+
+    /// Marks a vertex which is in no bucket
+    static const uint32_t NO_BUCKET = uint32_t(-1);
+
+    /// The per cpu statistics
+    struct bucket_stats {
+      size_t pops;
+      size_t stale;
+      size_t promotions;
+      char pad[64];
+      bucket_stats() : pops(0), stale(0), promotions(0) { }
+    };
+
+    /**
+     * The callback of one cpu.  The tasks added through it go to the
+     * lanes of the cpu.
+     */
+    class cpu_callback : public icallback<Graph> {
+    public:
+      cpu_callback(bucket_priority_scheduler* scheduler = NULL,
+                   iengine_type* engine = NULL, 
+                   size_t cpuid = 0) : 
+        scheduler(scheduler), engine(engine), cpuid(cpuid) { }
+
+      void add_task(update_task_type task, double priority) {
+        assert(task.function() != NULL);
+        scheduler->add_task_from_cpu(cpuid, task, priority);
+      }
+
+      void add_tasks(const std::vector<vertex_id_type> &vertices,
+                     update_function_type func,
+                     double priority) {
+        foreach(vertex_id_type vertex, vertices) {
+          add_task(update_task_type(vertex, func), priority);
+        }
+      }
+
+      void force_abort() {
+        assert(engine != NULL);
+        engine->stop();
+      }
+    private:
+      bucket_priority_scheduler* scheduler;
+      iengine_type* engine;
+      size_t cpuid;
+    };
+
+  public:
+
+    bucket_priority_scheduler(iengine_type* engine,
+                              Graph& g, 
+                              size_t ncpus) : 
+      numvertices(g.num_vertices()),
+      ncpus(ncpus),
+      bucket_width(1.0),
+      top_bucket(0),
+      bucket_of(numvertices, uint32_t(NO_BUCKET)),
+      task_set(numvertices),
+      stats(ncpus),
+      next_lane(0),
+      shared_promotions(0),
+      terminator(ncpus),
+      sched_metrics("bucket_priority") { 
+      for(size_t i = 0; i < ncpus; ++i) 
+        callbacks.push_back(cpu_callback(this, engine, i));
+      make_buckets(64);
+    }
+
+    ~bucket_priority_scheduler() { }
+
+    callback_type& get_callback(size_t cpuid) {
+      return callbacks[cpuid];
+    }
+    
+    void start() { }
+
+    /**
+     * Takes a vertex from the highest non-empty bucket, starting with
+     * the lane of the cpu.  The top_bucket hint may be too high but is
+     * never left too low, so EMPTY is only returned when every bucket
+     * is empty.
+     */
+    sched_status::status_enum get_next_task(size_t cpuid,
+                                            update_task_type &ret_task) {
+      while(true) {
+        const size_t top = top_bucket;
+        size_t b = top + 1;
+        while(b > 0 && buckets[b - 1].size.value == 0) --b;
+        if (b == 0) {
+          if (top_bucket == top) return sched_status::EMPTY;
+          continue;
+        }
+        --b;
+        if (b < top) lower_top_bucket(top, b);
+        double priority = 0;
+        if (pop_bucket(cpuid, b, ret_task, priority)) {
+          ++stats[cpuid].pops;
+          if (monitor != NULL)
+            monitor->scheduler_task_scheduled(ret_task, priority);
+          return sched_status::NEWTASK;
+        }
+      }
+    } // end of get_next_task
+
+
+    /**
+     * Adds the task and moves the vertex up if its priority now
+     * falls into a higher bucket.
+     */
+    void add_task(update_task_type task, double priority) {
+      add_task_from_cpu(size_t(-1), task, priority);
+    } // end of add_task
+
+  private:
+    /**
+     * Adds a task on behalf of the worker running on cpuid, or of
+     * any other thread if cpuid is -1.
+     */
+    void add_task_from_cpu(size_t cpuid, update_task_type task, 
+                           double priority) {
+      const bool first_add = task_set.add(task, priority);
+      if (first_add) terminator.new_job();
+      promote(cpuid, task.vertex(), bucket_index(priority));
+      if (monitor != NULL) {
+        if (first_add) monitor->scheduler_task_added(task, priority);
+        else monitor->scheduler_task_pruned(task);
+      }
+    } // end of add_task_from_cpu
+
+  public:
+
+    void add_tasks(const std::vector<vertex_id_type> &vertices,
+                   update_function_type func,
+                   double priority) {
+      foreach(vertex_id_type vertex, vertices) {
+        add_task(update_task_type(vertex, func), priority);
+      }
+    }
+
+    void add_task_to_all(update_function_type func, double priority) {
+      for (vertex_id_type vertex = 0; vertex < numvertices; ++vertex){
+        add_task(update_task_type(vertex, func), priority);
+      }
+    }
+
+    void completed_task(size_t cpuid, const update_task_type &task) {
+      terminator.completed_job(cpuid);
+    }
+
+    terminator_type& get_terminator() {
+      return terminator;
+    };
+
+    /**
+     * Changing the buckets re-buckets the queued vertices.  Must not
+     * be called concurrently with the other functions.
+     */
+    void set_options(const scheduler_options &opts) {
+      size_t new_nbuckets = buckets.size();
+      double new_width = bucket_width;
+      opts.get_int_option("buckets", new_nbuckets);
+      opts.get_float_option("bucket_width", new_width);
+      new_nbuckets = std::max(new_nbuckets, size_t(1));
+      if (!(new_width > 0)) {
+        logstream(LOG_WARNING) << "bucket_width must be positive. "
+                               << "Keeping " << bucket_width << std::endl;
+        new_width = bucket_width;
+      }
+      if (new_nbuckets == buckets.size() && new_width == bucket_width) 
+        return;
+      bucket_width = new_width;
+      std::vector<bucket_type> old_buckets;
+      old_buckets.swap(buckets);
+      make_buckets(new_nbuckets);
+      for(size_t b = 0; b < old_buckets.size(); ++b) {
+        foreach(const lane_type& lane, old_buckets[b].lanes) {
+          foreach(vertex_id_type vertex, lane.vertices) {
+            if (bucket_of[vertex] != b) continue;
+            bucket_of[vertex] = NO_BUCKET;
+            promote(size_t(-1), vertex, 
+                    bucket_index(task_set.top_priority(vertex)));
+          }
+        }
+      }
+    }
+
+    static void print_options_help(std::ostream &out) {
+      out << "buckets = [integer, default = 64]. The number of priority "
+          << "buckets. Priorities outside the range of the buckets go "
+          << "to the lowest or the highest bucket\n";
+      out << "bucket_width = [double, default = 1]. The width of a "
+          << "bucket in powers of two: bucket i holds the priorities in "
+          << "[2^(w*(i - buckets/2)), 2^(w*(i + 1 - buckets/2)))\n";
+    };
+
+    /**
+     * stale_entries counts the bucket entries which were skipped since
+     * the vertex had moved to a higher bucket or had already run.
+     */
+    metrics get_metrics() {
+      for(size_t i = 0; i < stats.size(); ++i) {
+        sched_metrics.add("pops", (double)stats[i].pops, INTEGER);
+        sched_metrics.add("stale_entries", (double)stats[i].stale, INTEGER);
+        sched_metrics.add("promotions", 
+                          (double)stats[i].promotions, INTEGER);
+      }
+      sched_metrics.add("promotions", 
+                        (double)shared_promotions.value, INTEGER);
+      return sched_metrics;
+    }
+
+    void reset_metrics() {
+      for(size_t i = 0; i < stats.size(); ++i) stats[i] = bucket_stats();
+      shared_promotions.value = 0;
+      sched_metrics.clear();
+    }
+
+  private:
+
+    void make_buckets(size_t nbuckets) {
+      buckets.resize(nbuckets);
+      for(size_t b = 0; b < nbuckets; ++b) buckets[b].lanes.resize(ncpus);
+      inv_log_width = 1.0 / (bucket_width * std::log(2.0));
+      top_bucket = 0;
+    }
+
+    /** The bucket of a priority */
+    size_t bucket_index(double priority) const {
+      if (!(priority > 0)) return 0;
+      const double b = std::floor(std::log(priority) * inv_log_width) + 
+        double(buckets.size() / 2);
+      if (b < 0) return 0;
+      if (b >= double(buckets.size())) return buckets.size() - 1;
+      return size_t(b);
+    }
+
+    /**
+     * Makes sure the vertex is queued in bucket b or a higher one.
+     * The entry in a lower bucket is left behind and skipped later.
+     * cpuid is the worker calling, or -1 for any other thread, whose
+     * entries are spread round robin over the lanes.
+     */
+    void promote(size_t cpuid, vertex_id_type vertex, size_t b) {
+      while(true) {
+        const uint32_t cur = *(volatile uint32_t*)&bucket_of[vertex];
+        if (cur != NO_BUCKET && cur >= b) return;
+        if (atomic_compare_and_swap(bucket_of[vertex], cur, uint32_t(b))) {
+          if (cur != NO_BUCKET) {
+            if (cpuid < ncpus) ++stats[cpuid].promotions;
+            else shared_promotions.inc();
+          }
+          break;
+        }
+      }
+      const size_t laneid = 
+        cpuid < ncpus ? cpuid : next_lane.inc_ret_last() % ncpus;
+      lane_type& lane = buckets[b].lanes[laneid];
+      lane.lock.lock();
+      lane.vertices.push_back(vertex);
+      lane.lock.unlock();
+      buckets[b].size.inc();
+      // raise the hint after the push so a cpu which lowers it
+      // concurrently sees the new entry when it rechecks
+      while(true) {
+        const size_t top = top_bucket;
+        if (top >= b || atomic_compare_and_swap(top_bucket, top, b)) break;
+      }
+    } // end of promote
+
+    /**
+     * Lowers the hint from top to b and raises it again if a bucket
+     * above b was filled meanwhile.
+     */
+    void lower_top_bucket(size_t top, size_t b) {
+      if (!atomic_compare_and_swap(top_bucket, top, b)) return;
+      for(size_t i = top; i > b; --i) {
+        if (buckets[i].size.value > 0) {
+          while(true) {
+            const size_t cur = top_bucket;
+            if (cur >= i || atomic_compare_and_swap(top_bucket, cur, i)) 
+              return;
+          }
+        }
+      }
+    }
+
+    /**
+     * Takes an entry of bucket b and the best task of its vertex.
+     * Returns false if the bucket was empty or the entry was stale.
+     * The remaining tasks of the vertex are queued again.
+     */
+    bool pop_bucket(size_t cpuid, size_t b, 
+                    update_task_type& ret_task, double& priority) {
+      bucket_type& bucket = buckets[b];
+      vertex_id_type vertex = 0;
+      bool found = false;
+      for(size_t i = 0; i < ncpus && !found; ++i) {
+        lane_type& lane = bucket.lanes[(cpuid + i) % ncpus];
+        if (lane.vertices.empty()) continue;
+        lane.lock.lock();
+        if (!lane.vertices.empty()) {
+          vertex = lane.vertices.back();
+          lane.vertices.pop_back();
+          found = true;
+        }
+        lane.lock.unlock();
+      }
+      if (!found) return false;
+      bucket.size.dec();
+      if (!atomic_compare_and_swap(bucket_of[vertex], uint32_t(b), 
+                                   uint32_t(NO_BUCKET)) ||
+          !task_set.pop(vertex, ret_task, priority)) {
+        ++stats[cpuid].stale;
+        return false;
+      }
+      update_task_type next_task;
+      double next_priority = 0;
+      if (task_set.top(vertex, next_task, next_priority)) 
+        promote(cpuid, vertex, bucket_index(next_priority));
+      return true;
+    } // end of pop_bucket
+
+    size_t numvertices; /// Remember the number of vertices in the graph
+    size_t ncpus;
+    double bucket_width;
+    double inv_log_width;
+
+    std::vector<bucket_type> buckets;
+    /// The highest bucket which may be non-empty
+    volatile size_t top_bucket;
+    /// The highest bucket holding each vertex, NO_BUCKET if none
+    std::vector<uint32_t> bucket_of;
+
+    /// The pending tasks and their priorities on each vertex
+    vertex_task_set<Graph> task_set;
+
+    /// The callbacks pre-created for each cpuid
+    std::vector<cpu_callback> callbacks; 
+
+    std::vector<bucket_stats> stats;
+    /// The lane of the next entry added by a thread which is no worker
+    atomic<size_t> next_lane;
+    /// The promotions made by threads which are no workers
+    atomic<size_t> shared_promotions;
+
+    task_count_termination terminator;
+
+    metrics sched_metrics;
+  }; 
+
+
+} // end of namespace graphlab
+#include <graphlab/macros_undef.hpp>
+
+#endif
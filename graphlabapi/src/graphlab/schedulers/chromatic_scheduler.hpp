@@ -34,8 +34,11 @@
 #include <graphlab/util/controlled_termination.hpp>
 
 #include <graphlab/parallel/atomic.hpp>
+#include <graphlab/util/dense_bitset.hpp>
 #include <graphlab/schedulers/support/unused_scheduler_callback.hpp>
 
+#include <graphlab/macros_def.hpp>
+
 
 namespace graphlab {
 
@@ -51,6 +54,7 @@ namespace graphlab {
     typedef ischeduler<Graph> base;
 
     typedef typename base::vertex_id_type       vertex_id_type;
+    typedef typename Graph::edge_id_type        edge_id_type;
     typedef typename base::vertex_color_type    vertex_color_type;
     typedef typename base::iengine_type         iengine_type;
     typedef typename base::update_task_type     update_task_type;
@@ -79,18 +83,9 @@ namespace graphlab {
       cpu_index(ncpus), cpu_color(ncpus), cpu_waiting(ncpus),
       max_iterations(0),
       color_graph(true),
+      coloring_method("greedy"),
       update_function(NULL) {
       color.value = 0;
-      // Verify the coloring
-      if (color_graph && graph.valid_coloring() == false) {
-        graph.compute_coloring();
-      }
-      // Initialize the chromatic blocks
-      for(vertex_id_type i = 0; i < graph.num_vertices(); ++i) {
-        vertex_color_type color = graph.color(i);
-        if( color >= color_blocks.size() ) color_blocks.resize(color + 1);
-        color_blocks[color].push_back(i);        
-      }
     }
 
     
@@ -100,6 +95,19 @@ namespace graphlab {
         std::cout << "No update function provided!" << std::endl;
       }
       assert(update_function != NULL);
+      // Verify the coloring.  This is done here rather than in the
+      // constructor so that the coloring options are respected.
+      if (color_graph && graph.valid_coloring() == false) {
+        graph.compute_coloring(coloring_method);
+      }
+      mark_color_conflicts();
+      // Initialize the chromatic blocks
+      color_blocks.clear();
+      for(vertex_id_type i = 0; i < graph.num_vertices(); ++i) {
+        vertex_color_type color = graph.color(i);
+        if( color >= color_blocks.size() ) color_blocks.resize(color + 1);
+        color_blocks[color].push_back(i);        
+      }
       color.value = 0;
       // Initialize the cpu indexs
       for(size_t i = 0; i < cpu_index.size(); ++i) {
@@ -201,6 +209,37 @@ namespace graphlab {
       }
       return sched_status::EMPTY;
     } // end of get_next_task
+
+    /**
+     * Hands out up to max_tasks tasks of the current color.  Stops
+     * before the cpu would run past the end of the color so that a
+     * block never holds tasks of two colors.
+     */
+    size_t get_next_tasks(size_t cpuid, update_task_type* ret_tasks,
+                          size_t max_tasks) {
+      size_t ntasks = 0;
+      while(ntasks < max_tasks) {
+        if(ntasks > 0 && !cpu_waiting[cpuid].value) {
+          const size_t current_color = 
+            cpu_color[cpuid].value % color_blocks.size();
+          if(cpu_index[cpuid].value + cpu_index.size() >= 
+             color_blocks[current_color].size()) break;
+        }
+        if(get_next_task(cpuid, ret_tasks[ntasks]) != sched_status::NEWTASK)
+          break;
+        ++ntasks;
+      }
+      return ntasks;
+    } // end of get_next_tasks
+
+    /**
+     * Only tasks of a single color run at the same time so the
+     * neighbors of a vertex are never updated concurrently with it,
+     * unless the vertex shares its color with one of its neighbors.
+     */
+    bool exclusive_neighborhood(vertex_id_type vertex) const {
+      return !color_conflicts.get(vertex);
+    }
     
     /**
      * This is called after a task has been executed
@@ -218,6 +257,7 @@ namespace graphlab {
     void set_options(const scheduler_options &opts) {
       opts.get_int_option("max_iterations", max_iterations);
       opts.get_int_option("color_graph", color_graph );
+      opts.get_string_option("coloring", coloring_method);
 
       any uf;
       if (opts.get_any_option("update_function", uf)) {
@@ -227,10 +267,32 @@ namespace graphlab {
 
     static void print_options_help(std::ostream &out) {
       out << "max_iterations = [integer, default = 0]\n";
+      out << "color_graph = [integer, default = 1]\n";
+      out << "coloring = [greedy or speculative, default = greedy]\n";
       out << "update_function = [update_function_type,"
         "default = set on add_task]\n";
     };
   private:
+
+    /** 
+     * Mark both endpoints of every edge whose endpoints share a
+     * color.  Only happens when color_graph is disabled and the
+     * graph carries an invalid coloring.
+     */
+    void mark_color_conflicts() {
+      color_conflicts.resize(graph.num_vertices());
+      color_conflicts.clear();
+      for(vertex_id_type vid = 0; vid < graph.num_vertices(); ++vid) {
+        foreach(edge_id_type eid, graph.in_edge_ids(vid)) {
+          const vertex_id_type source = graph.source(eid);
+          if(graph.color(source) == graph.color(vid)) {
+            color_conflicts.set_bit_unsync(source);
+            color_conflicts.set_bit_unsync(vid);
+          }
+        }
+      }
+    } // end of mark_color_conflicts
+
     Graph& graph;
     
     /// The callbacks pre-created for each cpuid
@@ -238,12 +300,15 @@ namespace graphlab {
 
     
     std::vector< std::vector< vertex_id_type> > color_blocks;
+    /// Vertices which have a neighbor of the same color
+    dense_bitset color_conflicts;
     std::vector< cache_line_pad<size_t> > cpu_index;
     std::vector< cache_line_pad<size_t> > cpu_color;
     std::vector< cache_line_pad<size_t> > cpu_waiting;
 
     size_t max_iterations;
     bool color_graph;
+    std::string coloring_method;
 
     update_function_type update_function;
 
@@ -262,5 +327,6 @@ namespace graphlab {
   }; // End of chromatic scheduler
 
 }
+#include <graphlab/macros_undef.hpp>
 #endif
 
@@ -76,7 +76,8 @@ namespace graphlab {
                    Graph& g, 
                    size_t ncpus)  : 
       callbacks(ncpus, direct_callback<Graph>(this, engine)), 
-      vertex_tasks(g.num_vertices()) {
+      vertex_tasks(g.num_vertices()),
+      terminator(ncpus) {
       numvertices = g.num_vertices();
     }
 
@@ -109,6 +110,26 @@ namespace graphlab {
         return sched_status::EMPTY;
       }
     } // end of get_next_task
+
+    /** Takes up to max_tasks tasks off the queue under a single lock */
+    size_t get_next_tasks(size_t cpuid, update_task_type* ret_tasks,
+                          size_t max_tasks) {
+      size_t ntasks = 0;
+      queue_lock.lock();
+      while(ntasks < max_tasks && !task_queue.empty()) {
+        ret_tasks[ntasks++] = task_queue.front();
+        task_queue.pop();
+      }
+      queue_lock.unlock();
+      for(size_t i = 0; i < ntasks; ++i) {
+        if (monitor != NULL) {
+          double priority = vertex_tasks.top_priority(ret_tasks[i].vertex());
+          monitor->scheduler_task_scheduled(ret_tasks[i], priority);
+        }
+        vertex_tasks.remove(ret_tasks[i]);
+      }
+      return ntasks;
+    } // end of get_next_tasks
     
 
     void add_task(update_task_type task, double priority) {
@@ -141,7 +162,12 @@ namespace graphlab {
 
 
     void completed_task(size_t cpuid, const update_task_type &task) {
-      terminator.completed_job();
+      terminator.completed_job(cpuid);
+    }
+
+    void completed_tasks(size_t cpuid, const update_task_type* tasks,
+                         size_t ntasks) {
+      terminator.completed_jobs(cpuid, ntasks);
     }
 
     
@@ -32,6 +32,7 @@
 #include <graphlab/schedulers/icallback.hpp>
 #include <graphlab/schedulers/scheduler_options.hpp>
 #include <graphlab/metrics/metrics.hpp>
+#include <graphlab/parallel/numa_tools.hpp>
 
 namespace graphlab {
   template <typename Graph> class iengine;
@@ -164,6 +165,43 @@ namespace graphlab {
     virtual void completed_task(size_t cpuid, 
                                 const update_task_type &task) = 0;
 
+    /**
+     * Fills ret_tasks with up to max_tasks tasks to be executed back
+     * to back by cpuid and returns the number of tasks written.  A
+     * return value of zero means the scheduler is empty.  Schedulers
+     * which can hand out several tasks under a single lock should
+     * override this; the default calls get_next_task repeatedly.
+     */
+    virtual size_t get_next_tasks(size_t cpuid, 
+                                  update_task_type* ret_tasks,
+                                  size_t max_tasks) {
+      size_t ntasks = 0;
+      while(ntasks < max_tasks &&
+            get_next_task(cpuid, ret_tasks[ntasks]) == sched_status::NEWTASK) 
+        ++ntasks;
+      return ntasks;
+    }
+
+    /**
+     * Returns true if the scheduler guarantees that no task on a
+     * vertex adjacent to vertex is handed out while the task on
+     * vertex runs.  The engine may then skip the neighbor locks of
+     * edge consistency for that vertex.
+     */
+    virtual bool exclusive_neighborhood(vertex_id_type vertex) const {
+      return false;
+    }
+
+    /**
+     * Called after a block of tasks obtained from get_next_tasks has
+     * been executed.
+     */
+    virtual void completed_tasks(size_t cpuid,
+                                 const update_task_type* tasks,
+                                 size_t ntasks) {
+      for(size_t i = 0; i < ntasks; ++i) completed_task(cpuid, tasks[i]);
+    }
+
 
     /** Installs a listener (done by the engine) */
     virtual void register_monitor(monitor_type* monitor_) { 
@@ -174,6 +212,13 @@ namespace graphlab {
 
     static void print_options_help(std::ostream &out) { };
 
+    /**
+     * Called by engines running in NUMA mode before any task is
+     * added.  Schedulers may use the map to prefer running tasks on
+     * workers local to the vertex.
+     */
+    virtual void set_numa_map(const numa_map& map) { };
+
 
     /// UNUSED!!! Only used for temporary backward compatibility with the distributed code
     virtual void set_option(scheduler_options_enum::options_enum, void*) { };
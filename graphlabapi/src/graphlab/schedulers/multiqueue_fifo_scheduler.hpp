@@ -81,8 +81,10 @@ namespace graphlab {
     multiqueue_fifo_scheduler(iengine_type* engine,
                               Graph& g, 
                               size_t ncpus) : 
+      use_numa(false),
       callbacks(ncpus, direct_callback<Graph>(this, engine)), 
-      binary_vertex_tasks(g.local_vertices()), prunecounter(ncpus, 0),
+      binary_vertex_tasks(g.local_vertices()), terminator(ncpus),
+      prunecounter(ncpus, 0),
       sched_metrics("multiqueue_fifo") {
       numvertices = g.local_vertices();
         
@@ -132,6 +134,25 @@ namespace graphlab {
         if (found) break;
       }
   
+      /* In NUMA mode check the other queues of my node next */
+      if (!found && use_numa) {
+        const std::vector<size_t>& local = 
+          node_queues[numa.worker_node(cpuid)];
+        const size_t start = random::fast_uniform<size_t>(0, local.size() - 1);
+        for(size_t i = 0; i < local.size(); ++i) {
+          size_t queueidx = local[(start + i) % local.size()];
+          taskqueue_t& queue = task_queues[queueidx];
+          queue_locks[queueidx].lock();
+          if (!queue.empty()) {
+            ret_task = queue.front();
+            queue.pop();
+            found = true;
+          }
+          queue_locks[queueidx].unlock();
+          if (found)  break;
+        }
+      }
+
       /* Ok, my queues were empty - now check every other queue */
       if (!found) {
         /* First check own queue - if it is empty, check others */
@@ -161,6 +182,41 @@ namespace graphlab {
       return sched_status::NEWTASK;
     } // end of get_next_task
 
+    /**
+     * Drains up to max_tasks tasks from one of the cpu's own queues
+     * under a single lock.  Falls back to get_next_task when the own
+     * queues are empty.
+     */
+    size_t get_next_tasks(size_t cpuid, update_task_type* ret_tasks,
+                          size_t max_tasks) {
+      size_t ntasks = 0;
+      size_t firstown = cpuid * queues_per_cpu;
+      for(size_t ownq_i = 0; ownq_i < queues_per_cpu; ++ownq_i) {
+        size_t queueidx = 
+          firstown + ((ownq_i + lastqueue[cpuid] + 1) % queues_per_cpu);
+        taskqueue_t& queue = task_queues[queueidx];
+        queue_locks[queueidx].lock();
+        while(ntasks < max_tasks && !queue.empty()) {
+          ret_tasks[ntasks++] = queue.front();
+          queue.pop();
+        }
+        queue_locks[queueidx].unlock();
+        if (ntasks > 0) {
+          lastqueue[cpuid] = ownq_i;
+          break;
+        }
+      }
+      if (ntasks == 0) {
+        return get_next_task(cpuid, ret_tasks[0]) == sched_status::NEWTASK;
+      }
+      for(size_t i = 0; i < ntasks; ++i) {
+        binary_vertex_tasks.remove(ret_tasks[i]);
+        if (monitor != NULL) 
+          monitor->scheduler_task_scheduled(ret_tasks[i], 0.0);
+      }
+      return ntasks;
+    } // end of get_next_tasks
+
 
     void add_task(update_task_type task, double priority) {
       if (binary_vertex_tasks.add(task)) {
@@ -184,8 +240,15 @@ namespace graphlab {
         // TODO: this can easily be done with some bit operations on the 
         const size_t prod = 
           random::fast_uniform(size_t(0), num_queues * num_queues - 1);
-        const size_t r1 = prod / num_queues;
-        const size_t r2 = prod % num_queues;
+        size_t r1 = prod / num_queues;
+        size_t r2 = prod % num_queues;
+        if(use_numa) {
+          /* In NUMA mode only the queues of the vertex's node are used */
+          const std::vector<size_t>& local = 
+            node_queues[numa.vertex_node(task.vertex())];
+          r1 = local[r1 % local.size()];
+          r2 = local[r2 % local.size()];
+        }
 
         size_t qidx = 
           (task_queues[r1].size() < task_queues[r2].size()) ? r1 : r2;
@@ -222,7 +285,12 @@ namespace graphlab {
 
 
     void completed_task(size_t cpuid, const update_task_type &task) {
-      terminator.completed_job();
+      terminator.completed_job(cpuid);
+    }
+
+    void completed_tasks(size_t cpuid, const update_task_type* tasks,
+                         size_t ntasks) {
+      terminator.completed_jobs(cpuid, ntasks);
     }
 
 
@@ -247,6 +315,16 @@ namespace graphlab {
 
     void set_options(const scheduler_options &opts) { }
 
+    /** Group the queues by the NUMA node of their cpu */
+    void set_numa_map(const numa_map& map) {
+      numa = map;
+      use_numa = numa.num_nodes() > 1;
+      node_queues.clear();
+      node_queues.resize(numa.num_nodes());
+      for(size_t i = 0; i < num_queues; ++i) 
+        node_queues[numa.worker_node(i / queues_per_cpu)].push_back(i);
+    }
+
     metrics get_metrics() {
       for(unsigned int i=0; i<prunecounter.size(); i++) sched_metrics.add("pruned", (double)prunecounter[i], INTEGER); 
       return sched_metrics;
@@ -268,6 +346,12 @@ namespace graphlab {
     std::vector<spinlock> queue_locks;
     std::vector<size_t> lastqueue;
 
+    /// The NUMA placement.  Only used if use_numa is set
+    bool use_numa;
+    numa_map numa;
+    /// The queues of the cpus on each NUMA node
+    std::vector< std::vector<size_t> > node_queues;
+
     /// The callbacks pre-created for each cpuid
     std::vector<direct_callback<Graph> > callbacks; 
 
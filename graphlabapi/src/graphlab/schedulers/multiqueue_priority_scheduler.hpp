@@ -38,6 +38,7 @@
 #include <graphlab/tasks/update_task.hpp>
 #include <graphlab/schedulers/ischeduler.hpp>
 #include <graphlab/parallel/pthread_tools.hpp>
+#include <graphlab/util/random.hpp>
 #include <graphlab/schedulers/support/direct_callback.hpp>
 #include <graphlab/schedulers/support/binary_vertex_task_set.hpp>
 
@@ -76,8 +77,10 @@ namespace graphlab {
     multiqueue_priority_scheduler(iengine_type* engine,
                                   Graph& g, 
                                   size_t ncpus) : 
+      use_numa(false),
       callbacks(ncpus, direct_callback<Graph>(this, engine)), 
-      binary_vertex_tasks(g.local_vertices()) {
+      binary_vertex_tasks(g.local_vertices()),
+      terminator(ncpus) {
       numvertices = g.local_vertices();
         
       /* How many queues per cpu. More queues, less contention */
@@ -127,6 +130,24 @@ namespace graphlab {
         if (found) break;
       }
   
+      /* In NUMA mode check the other queues of my node next */
+      if (!found && use_numa) {
+        const std::vector<size_t>& local = 
+          node_queues[numa.worker_node(cpuid)];
+        const size_t start = random::fast_uniform<size_t>(0, local.size() - 1);
+        for(size_t i = 0; i < local.size(); ++i) {
+          size_t queueidx = local[(start + i) % local.size()];
+          taskqueue_type& queue = task_queues[queueidx];
+          queue_locks[queueidx].lock();
+          if (!queue.empty()) {
+            ret_task = queue.pop().first;
+            found = true;
+          }
+          queue_locks[queueidx].unlock();
+          if (found)  break;
+        }
+      }
+
       /* Ok, my queues were empty - now check every other queue */
       if (!found) {
         /* First check own queue - if it is empty, check others */
@@ -178,8 +199,15 @@ namespace graphlab {
         // TODO: this can easily be done with some bit operations on the 
         const size_t prod = 
           random::fast_uniform<size_t>(0, num_queues * num_queues - 1);
-        const size_t r1 = prod / num_queues;
-        const size_t r2 = prod % num_queues;
+        size_t r1 = prod / num_queues;
+        size_t r2 = prod % num_queues;
+        if(use_numa) {
+          /* In NUMA mode only the queues of the vertex's node are used */
+          const std::vector<size_t>& local = 
+            node_queues[numa.vertex_node(task.vertex())];
+          r1 = local[r1 % local.size()];
+          r2 = local[r2 % local.size()];
+        }
 
         size_t qidx = 
           (task_queues[r1].size() < task_queues[r2].size()) ? r1 : r2;
@@ -230,7 +258,7 @@ namespace graphlab {
 
 
     void completed_task(size_t cpuid, const update_task_type &task) {
-      terminator.completed_job();
+      terminator.completed_job(cpuid);
     }
 
     terminator_type& get_terminator() {
@@ -239,6 +267,16 @@ namespace graphlab {
 
     void set_options(const scheduler_options &opts) { }
 
+    /** Group the queues by the NUMA node of their cpu */
+    void set_numa_map(const numa_map& map) {
+      numa = map;
+      use_numa = numa.num_nodes() > 1;
+      node_queues.clear();
+      node_queues.resize(numa.num_nodes());
+      for(size_t i = 0; i < num_queues; ++i) 
+        node_queues[numa.worker_node(i / queues_per_cpu)].push_back(i);
+    }
+
     static void print_options_help(std::ostream &out) { };
 
   private:
@@ -251,6 +289,12 @@ namespace graphlab {
     std::vector<mutex> queue_locks;
     std::vector<size_t> lastqueue;
 
+    /// The NUMA placement.  Only used if use_numa is set
+    bool use_numa;
+    numa_map numa;
+    /// The queues of the cpus on each NUMA node
+    std::vector< std::vector<size_t> > node_queues;
+
     /// The callbacks pre-created for each cpuid
     std::vector<direct_callback<Graph> > callbacks; 
 
@@ -95,7 +95,8 @@ namespace graphlab {
                        size_t ncpus) :
       num_vertices(g.local_vertices()),
       task_set(g.local_vertices()),
-      callbacks(ncpus, direct_callback<Graph>(this, engine) ) { }
+      callbacks(ncpus, direct_callback<Graph>(this, engine) ),
+      terminator(ncpus) { }
     
 
     ~priority_scheduler() { }
@@ -179,7 +180,7 @@ namespace graphlab {
     } // end of add tasks to all
 
     void completed_task(size_t cpuid, const update_task_type &task) {
-      terminator.completed_job();
+      terminator.completed_job(cpuid);
     }
 
     terminator_type& get_terminator() {
@@ -0,0 +1,418 @@
+/**  
+ * Copyright (c) 2009 Carnegie Mellon University. 
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+
+/**
+ * This class defines a relaxed concurrent priority scheduler in the
+ * style of the MultiQueue (Rihani, Sanders and Dementiev, 2015).
+ * Vertices are kept in c * ncpus binary heaps each protected by its
+ * own spinlock.  A task is pushed onto a random heap and a cpu pops
+ * the better of the tops of two randomly chosen heaps, so the tasks
+ * run in approximately (rather than strictly) descending priority
+ * while the heaps are rarely contended.  Each vertex lives in at most
+ * one heap which allows its priority to be promoted in place when new
+ * tasks are added to it.
+ **/
+#ifndef GRAPHLAB_RELAXED_PRIORITY_SCHEDULER_HPP
+#define GRAPHLAB_RELAXED_PRIORITY_SCHEDULER_HPP
+
+#include <vector>
+#include <limits>
+#include <algorithm>
+#include <cassert>
+
+#include <graphlab/graph/graph.hpp>
+#include <graphlab/scope/iscope.hpp>
+#include <graphlab/tasks/update_task.hpp>
+#include <graphlab/schedulers/ischeduler.hpp>
+#include <graphlab/parallel/pthread_tools.hpp>
+#include <graphlab/util/random.hpp>
+#include <graphlab/schedulers/support/direct_callback.hpp>
+#include <graphlab/schedulers/support/vertex_task_set.hpp>
+#include <graphlab/util/task_count_termination.hpp>
+#include <graphlab/metrics/metrics.hpp>
+
+
+#include <graphlab/macros_def.hpp>
+
+namespace graphlab {
+
+
+  /** \ingroup group_schedulers
+   */
+  template<typename Graph>
+  class relaxed_priority_scheduler : public ischeduler<Graph> {
+  public:
+    typedef Graph graph_type;
+    typedef ischeduler<Graph> base;
+
+    typedef typename base::vertex_id_type vertex_id_type;
+    typedef typename base::iengine_type iengine_type;
+    typedef typename base::update_task_type update_task_type;
+    typedef typename base::update_function_type update_function_type;
+    typedef typename base::callback_type callback_type;
+    typedef typename base::monitor_type monitor_type;
+    typedef task_count_termination terminator_type;
+
+  private:
+    using base::monitor;
+
+    /// A (priority, vertex) entry of a heap
+    typedef std::pair<double, vertex_id_type> heap_element;
+
+    /** A binary max heap of vertices with its lock */
+    struct heap_type {
+      spinlock lock;
+      std::vector<heap_element> elements;
+      /// The size and the top priority, readable without the lock
+      volatile size_t size;
+      volatile double top;
+      char pad[64];
+      heap_type() : size(0), top(0) { }
+    };
+
+    /// Marks a vertex which is in no heap
+    static const uint32_t NO_HEAP = uint32_t(-1);
+
+    /// Number of random two-choice pops tried before scanning all heaps
+    static const size_t POP_ATTEMPTS = 4;
+
+    /// The per cpu rank error statistics
+    struct rank_stats {
+      size_t pops;
+      size_t samples;
+      size_t total_error;
+      size_t max_error;
+      char pad[64];
+      rank_stats() : pops(0), samples(0), total_error(0), max_error(0) { }
+    };
+
+  public:
+
+    relaxed_priority_scheduler(iengine_type* engine,
+                               Graph& g, 
+                               size_t ncpus) : 
+      numvertices(g.num_vertices()),
+      ncpus(ncpus),
+      queues_per_cpu(2),
+      rank_sample(64),
+      heaps(queues_per_cpu * ncpus),
+      heap_of(numvertices, uint32_t(NO_HEAP)),
+      heap_position(numvertices, 0),
+      task_set(numvertices),
+      callbacks(ncpus, direct_callback<Graph>(this, engine)),
+      stats(ncpus),
+      terminator(ncpus),
+      sched_metrics("relaxed_priority") { }
+
+    ~relaxed_priority_scheduler() { }
+
+    callback_type& get_callback(size_t cpuid) {
+      return callbacks[cpuid];
+    }
+    
+    void start() { }
+
+    /**
+     * Pops the top of the better of two random heaps.  After a few
+     * failed attempts every heap is scanned so that EMPTY is only
+     * returned when no task is left.
+     */
+    sched_status::status_enum get_next_task(size_t cpuid,
+                                            update_task_type &ret_task) {
+      const size_t nheaps = heaps.size();
+      double priority = 0;
+      for(size_t i = 0; i < POP_ATTEMPTS; ++i) {
+        const size_t r1 = random::fast_uniform<size_t>(0, nheaps - 1);
+        const size_t r2 = random::fast_uniform<size_t>(0, nheaps - 1);
+        const size_t h = better_heap(r1, r2);
+        if (heaps[h].size == 0) continue;
+        if (pop_heap(h, ret_task, priority)) {
+          task_popped(cpuid, ret_task, priority);
+          return sched_status::NEWTASK;
+        }
+      }
+      const size_t start = random::fast_uniform<size_t>(0, nheaps - 1);
+      for(size_t i = 0; i < nheaps; ++i) {
+        const size_t h = (start + i) % nheaps;
+        // A heap may still hold entries whose tasks were taken with
+        // an earlier entry of the vertex so keep popping it
+        while(heaps[h].size > 0) {
+          if (pop_heap(h, ret_task, priority)) {
+            task_popped(cpuid, ret_task, priority);
+            return sched_status::NEWTASK;
+          }
+        }
+      }
+      return sched_status::EMPTY;
+    } // end of get_next_task
+
+
+    /**
+     * Adds the task and promotes the vertex to the priority if it is
+     * already queued.
+     */
+    void add_task(update_task_type task, double priority) {
+      const bool first_add = task_set.add(task, priority);
+      if (first_add) terminator.new_job();
+      promote(task.vertex(), priority);
+      if (monitor != NULL) {
+        if (first_add) monitor->scheduler_task_added(task, priority);
+        else monitor->scheduler_task_pruned(task);
+      }
+    } // end of add_task
+
+    void add_tasks(const std::vector<vertex_id_type> &vertices,
+                   update_function_type func,
+                   double priority) {
+      foreach(vertex_id_type vertex, vertices) {
+        add_task(update_task_type(vertex, func), priority);
+      }
+    }
+
+    void add_task_to_all(update_function_type func, double priority) {
+      for (vertex_id_type vertex = 0; vertex < numvertices; ++vertex){
+        add_task(update_task_type(vertex, func), priority);
+      }
+    }
+
+    void completed_task(size_t cpuid, const update_task_type &task) {
+      terminator.completed_job(cpuid);
+    }
+
+    terminator_type& get_terminator() {
+      return terminator;
+    };
+
+    /**
+     * Changing the number of heaps moves the queued vertices over to
+     * the new heaps.  Must not be called concurrently with the other
+     * functions.
+     */
+    void set_options(const scheduler_options &opts) {
+      size_t new_queues_per_cpu = queues_per_cpu;
+      opts.get_int_option("queues_per_cpu", new_queues_per_cpu);
+      opts.get_int_option("rank_sample", rank_sample);
+      new_queues_per_cpu = std::max(new_queues_per_cpu, size_t(1));
+      if (new_queues_per_cpu == queues_per_cpu) return;
+      queues_per_cpu = new_queues_per_cpu;
+      std::vector<heap_type> old_heaps(queues_per_cpu * ncpus);
+      old_heaps.swap(heaps);
+      for(size_t h = 0; h < old_heaps.size(); ++h) {
+        foreach(const heap_element& elem, old_heaps[h].elements) {
+          heap_of[elem.second] = NO_HEAP;
+          promote(elem.second, elem.first);
+        }
+      }
+    }
+
+    static void print_options_help(std::ostream &out) {
+      out << "queues_per_cpu = [integer, default = 2]. The number of "
+          << "heaps per cpu. More heaps reduce contention but increase "
+          << "the deviation from the priority order\n";
+      out << "rank_sample = [integer, default = 64]. Every rank_sample "
+          << "pops of a cpu the number of heap tops with a higher "
+          << "priority than the popped task is recorded in the "
+          << "rank_error metrics. 0 disables sampling\n";
+    };
+
+    /**
+     * The rank error of a sampled pop is the number of heaps whose top
+     * has a strictly higher priority than the popped task, a lower
+     * bound on the number of queued tasks which should have run
+     * first.
+     */
+    metrics get_metrics() {
+      size_t samples = 0, total_error = 0, max_error = 0;
+      for(size_t i = 0; i < stats.size(); ++i) {
+        sched_metrics.add("pops", (double)stats[i].pops, INTEGER);
+        samples += stats[i].samples;
+        total_error += stats[i].total_error;
+        max_error = std::max(max_error, stats[i].max_error);
+      }
+      sched_metrics.set("rank_samples", samples);
+      sched_metrics.set("rank_error_max", max_error);
+      sched_metrics.set("rank_error_mean", 
+                        samples > 0 ? double(total_error) / samples : 0.0);
+      return sched_metrics;
+    }
+
+    void reset_metrics() {
+      for(size_t i = 0; i < stats.size(); ++i) stats[i] = rank_stats();
+      sched_metrics.clear();
+    }
+
+  private:
+
+    /** Returns the heap among h1 and h2 with the better top */
+    size_t better_heap(size_t h1, size_t h2) const {
+      if (heaps[h1].size == 0) return h2;
+      if (heaps[h2].size == 0) return h1;
+      return heaps[h1].top >= heaps[h2].top ? h1 : h2;
+    }
+
+    /** Refreshes the unlocked view of a heap. Requires the heap lock */
+    void publish(heap_type& heap) {
+      heap.size = heap.elements.size();
+      if (!heap.elements.empty()) heap.top = heap.elements[0].first;
+    }
+
+    /** Places the element at index i of the heap */
+    void place(heap_type& heap, size_t i, const heap_element& elem) {
+      heap.elements[i] = elem;
+      heap_position[elem.second] = uint32_t(i);
+    }
+
+    void sift_up(heap_type& heap, size_t i) {
+      const heap_element elem = heap.elements[i];
+      while (i > 0 && heap.elements[(i - 1) / 2].first < elem.first) {
+        place(heap, i, heap.elements[(i - 1) / 2]);
+        i = (i - 1) / 2;
+      }
+      place(heap, i, elem);
+    }
+
+    void sift_down(heap_type& heap, size_t i) {
+      const size_t n = heap.elements.size();
+      const heap_element elem = heap.elements[i];
+      while (2 * i + 1 < n) {
+        size_t child = 2 * i + 1;
+        if (child + 1 < n && 
+            heap.elements[child].first < heap.elements[child + 1].first) 
+          ++child;
+        if (!(elem.first < heap.elements[child].first)) break;
+        place(heap, i, heap.elements[child]);
+        i = child;
+      }
+      place(heap, i, elem);
+    }
+
+    /**
+     * Makes sure the vertex is in a heap with at least the given
+     * priority.  A vertex which is in no heap goes to a random one.
+     */
+    void promote(vertex_id_type vertex, double priority) {
+      while(true) {
+        uint32_t h = *(volatile uint32_t*)&heap_of[vertex];
+        if (h == NO_HEAP) 
+          h = uint32_t(random::fast_uniform<size_t>(0, heaps.size() - 1));
+        heap_type& heap = heaps[h];
+        heap.lock.lock();
+        const uint32_t cur = heap_of[vertex];
+        if (cur == h) {
+          const size_t i = heap_position[vertex];
+          if (heap.elements[i].first < priority) {
+            heap.elements[i].first = priority;
+            sift_up(heap, i);
+            publish(heap);
+          }
+        } else if (cur == NO_HEAP) {
+          heap.elements.push_back(heap_element(priority, vertex));
+          heap_of[vertex] = h;
+          sift_up(heap, heap.elements.size() - 1);
+          publish(heap);
+        }
+        heap.lock.unlock();
+        // otherwise the vertex moved to another heap meanwhile
+        if (cur == h || cur == NO_HEAP) return;
+      }
+    } // end of promote
+
+    /**
+     * Pops the top vertex of heap h and takes its best task.  Returns
+     * false if the heap was empty or the tasks of the vertex were
+     * already taken through an earlier entry.  The remaining tasks of
+     * the vertex are queued again.
+     */
+    bool pop_heap(size_t h, update_task_type& ret_task, double& priority) {
+      heap_type& heap = heaps[h];
+      heap.lock.lock();
+      if (heap.elements.empty()) {
+        heap.lock.unlock();
+        return false;
+      }
+      const vertex_id_type vertex = heap.elements[0].second;
+      heap_of[vertex] = NO_HEAP;
+      const heap_element last = heap.elements.back();
+      heap.elements.pop_back();
+      if (!heap.elements.empty()) {
+        heap.elements[0] = last;
+        sift_down(heap, 0);
+      }
+      publish(heap);
+      heap.lock.unlock();
+      
+      if (!task_set.pop(vertex, ret_task, priority)) return false;
+      update_task_type next_task;
+      double next_priority = 0;
+      if (task_set.top(vertex, next_task, next_priority)) 
+        promote(vertex, next_priority);
+      return true;
+    } // end of pop_heap
+
+    /** Records the pop for the metrics and the monitor */
+    void task_popped(size_t cpuid, const update_task_type& task, 
+                     double priority) {
+      rank_stats& s = stats[cpuid];
+      ++s.pops;
+      if (rank_sample > 0 && s.pops % rank_sample == 0) {
+        size_t error = 0;
+        for(size_t h = 0; h < heaps.size(); ++h) 
+          error += (heaps[h].size > 0 && heaps[h].top > priority);
+        ++s.samples;
+        s.total_error += error;
+        s.max_error = std::max(s.max_error, error);
+      }
+      if (monitor != NULL)
+        monitor->scheduler_task_scheduled(task, priority);
+    }
+
+    size_t numvertices; /// Remember the number of vertices in the graph
+    size_t ncpus;
+    size_t queues_per_cpu;
+    size_t rank_sample;
+
+    std::vector<heap_type> heaps;
+    /// The heap holding each vertex, NO_HEAP if none
+    std::vector<uint32_t> heap_of;
+    /// The index of each vertex in its heap
+    std::vector<uint32_t> heap_position;
+
+    /// The pending tasks and their priorities on each vertex
+    vertex_task_set<Graph> task_set;
+
+    /// The callbacks pre-created for each cpuid
+    std::vector<direct_callback<Graph> > callbacks; 
+
+    std::vector<rank_stats> stats;
+
+    task_count_termination terminator;
+
+    metrics sched_metrics;
+  }; 
+
+
+} // end of namespace graphlab
+#include <graphlab/macros_undef.hpp>
+
+#endif
@@ -99,7 +99,8 @@ namespace graphlab {
       multinomial(g.num_vertices(), ncpus),
       vertex_tasks(g.num_vertices()),
       locks(g.num_vertices()),
-      callbacks(ncpus, direct_callback<Graph>(this, engine) ) { }
+      callbacks(ncpus, direct_callback<Graph>(this, engine) ),
+      terminator(ncpus) { }
 
     
     callback_type& get_callback(size_t cpuid) {
@@ -199,7 +200,7 @@ namespace graphlab {
     
 
     void completed_task(size_t cpuid, const update_task_type& task) {
-      terminator.completed_job();
+      terminator.completed_job(cpuid);
     }
     
 
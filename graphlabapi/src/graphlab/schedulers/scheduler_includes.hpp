@@ -32,5 +32,8 @@
 #include <graphlab/schedulers/round_robin_scheduler.hpp>
 #include <graphlab/schedulers/chromatic_scheduler.hpp>
 #include <graphlab/schedulers/sampling_scheduler.hpp>
+#include <graphlab/schedulers/work_stealing_scheduler.hpp>
+#include <graphlab/schedulers/relaxed_priority_scheduler.hpp>
+#include <graphlab/schedulers/bucket_priority_scheduler.hpp>
 
 
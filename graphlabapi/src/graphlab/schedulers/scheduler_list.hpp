@@ -59,7 +59,19 @@
     "where the entire cluster has a single priority"))                  \
   (("sampling", sampling_scheduler,                                     \
     "A scheduler which samples vertices to update based on a "          \
-    "multinomial probability which can be updated dynamically."))
+    "multinomial probability which can be updated dynamically."))     \
+  (("work_stealing", work_stealing_scheduler,                           \
+    "Each processor owns a lock free deque of tasks and processors "    \
+    "which run out of work steal from randomly chosen victims. Scales " \
+    "better than the multiqueue schedulers on many cores."))            \
+  (("relaxed_priority", relaxed_priority_scheduler,                     \
+    "Several priority heaps per processor. Tasks are pushed onto a "    \
+    "random heap and taken from the better of two random heaps. Runs "  \
+    "tasks in approximate priority order and scales to many cores."))   \
+  (("bucket_priority", bucket_priority_scheduler,                       \
+    "Priorities are quantized into log-scaled buckets and processors "  \
+    "drain the highest non-empty bucket in parallel. Cheaper than a "   \
+    "priority queue when an approximate ordering suffices."))
 
 
 #include <graphlab/schedulers/fifo_scheduler.hpp>
@@ -72,6 +84,9 @@
 #include <graphlab/schedulers/multiqueue_fifo_scheduler.hpp>
 #include <graphlab/schedulers/multiqueue_priority_scheduler.hpp>
 #include <graphlab/schedulers/clustered_priority_scheduler.hpp>
+#include <graphlab/schedulers/work_stealing_scheduler.hpp>
+#include <graphlab/schedulers/relaxed_priority_scheduler.hpp>
+#include <graphlab/schedulers/bucket_priority_scheduler.hpp>
 #include <graphlab/graph/graph.hpp>
 
 namespace graphlab {
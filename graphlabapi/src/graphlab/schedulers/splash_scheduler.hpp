@@ -27,6 +27,11 @@
  *   Gonzalez, Low, Guestrin: Residual splash for optimally parallelizing belief propagation}},
  *   AISTATS,2009
  *
+ * Each cpu grows its splashes with reusable scratch space (a visited
+ * bitmap and a BFS queue) so that no memory is allocated per splash,
+ * and the search is cut off after a fixed amount of work.  In the
+ * locality ordering the vertices of each BFS level are sorted by id so
+ * that consecutive updates touch nearby memory.
  **/
 
 #ifndef GRAPHLAB_SPLASH_SCHEDULER_HPP
@@ -50,6 +55,10 @@
 
 #include <graphlab/util/shared_termination.hpp>
 #include <graphlab/util/dense_bitset.hpp>
+#include <graphlab/util/random.hpp>
+#include <graphlab/util/timer.hpp>
+#include <graphlab/metrics/metrics.hpp>
+#include <graphlab/logger/logger.hpp>
 
 
 
@@ -67,6 +76,7 @@ namespace graphlab {
 
     typedef typename base::vertex_id_type vertex_id_type;
     typedef typename base::edge_id_type   edge_id_type;
+    typedef typename graph_type::edge_list_type edge_list_type;
     typedef typename base::iengine_type iengine_type;
     typedef typename base::update_task_type update_task_type;
     typedef typename base::update_function_type update_function_type;
@@ -86,6 +96,43 @@ namespace graphlab {
     
     /** The type of the priority queue */
     typedef mutable_queue<size_t, double> pqueue_type;
+
+    /** The order of the vertices within a splash */
+    enum splash_order_type {
+      BFS_ORDER,       /**< The order in which the BFS reached them */
+      LOCALITY_ORDER   /**< Each BFS level sorted by vertex id */
+    };
+
+    /**
+     * The per cpu state used to grow splashes.  The containers keep
+     * their capacity between splashes and the visited bits are
+     * cleared through the BFS queue so rebuilding a splash does not
+     * allocate or touch memory proportional to the graph.
+     */
+    struct splash_scratch {
+      dense_bitset visited;
+      /// The BFS queue of (vertex, depth) pairs
+      std::vector<std::pair<vertex_id_type, size_t> > bfs;
+      /// The BFS depth of each vertex in the splash
+      std::vector<size_t> depth;
+      /// (depth, vertex) pairs sorted for the locality order
+      std::vector<std::pair<size_t, vertex_id_type> > order;
+      /// The own queue to try first in get_top
+      size_t lastqid;
+      // Statistics
+      size_t splashes;
+      size_t splash_vertices;
+      size_t max_splash_vertices;
+      size_t budget_exhausted;
+      double build_time;
+      char pad[64];
+      splash_scratch() : lastqid(0) { clear_stats(); }
+      void clear_stats() {
+        splashes = splash_vertices = max_splash_vertices = 0;
+        budget_exhausted = 0;
+        build_time = 0;
+      }
+    };
         
   public:
     
@@ -96,16 +143,24 @@ namespace graphlab {
       graph(graph),
       ncpus(ncpus),
       splash_size(100),
+      splash_budget(0),
+      splash_order(BFS_ORDER),
       update_fun(NULL),
       pqueues(ncpus * queue_multiple),
       queuelocks(ncpus * queue_multiple),
       vmap(graph.num_vertices()),
       splashes(ncpus), 
       splash_index(ncpus, 0),
+      scratch(ncpus),
       active_set(graph.num_vertices()),
       terminator(ncpus),
-      callbacks(ncpus, direct_callback<Graph>(this, engine) ) {
+      callbacks(ncpus, direct_callback<Graph>(this, engine) ),
+      sched_metrics("splash") {
       aborted = false;
+      for(size_t i = 0; i < ncpus; ++i) {
+        scratch[i].visited.resize(graph.num_vertices());
+        scratch[i].visited.clear();
+      }
       // Initialize the vertex map      
       for(vertex_id_type i = 0; i < vmap.size(); ++i) {
         vmap[i] = (vertex_id_type)(i % pqueues.size());
@@ -223,6 +278,14 @@ namespace graphlab {
 
     void set_options(const scheduler_options &opts) {
       opts.get_int_option("splash_size", splash_size);
+      opts.get_int_option("splash_budget", splash_budget);
+      std::string order;
+      if (opts.get_string_option("splash_order", order)) {
+        if (order == "bfs") splash_order = BFS_ORDER;
+        else if (order == "locality") splash_order = LOCALITY_ORDER;
+        else logstream(LOG_WARNING) << "Unknown splash_order " << order
+                                    << ". Using bfs" << std::endl;
+      }
       any uf;
       if (opts.get_any_option("update_function", uf)) {
         update_fun = uf.as<update_function_type>();
@@ -231,9 +294,38 @@ namespace graphlab {
 
     static void print_options_help(std::ostream &out) {
       out << "splash_size = [integer, default = 100]\n";
+      out << "splash_budget = [integer, default = 4 * splash_size]. "
+          << "The number of edges and candidate vertices a splash "
+          << "search may examine\n";
+      out << "splash_order = [bfs | locality, default = bfs]. locality "
+          << "sorts each BFS level of a splash by vertex id\n";
       out << "update_function = [update_function_type,"
                                  "default = set on add_task_to_all]\n";
     };
+
+    metrics get_metrics() {
+      size_t splashes = 0, vertices = 0, max_vertices = 0, exhausted = 0;
+      double build_time = 0;
+      foreach(const splash_scratch& s, scratch) {
+        splashes += s.splashes;
+        vertices += s.splash_vertices;
+        max_vertices = std::max(max_vertices, s.max_splash_vertices);
+        exhausted += s.budget_exhausted;
+        build_time += s.build_time;
+      }
+      sched_metrics.set("splashes", splashes);
+      sched_metrics.set("splash_size_mean", 
+                        splashes > 0 ? double(vertices) / splashes : 0.0);
+      sched_metrics.set("splash_size_max", max_vertices);
+      sched_metrics.set("splash_budget_exhausted", exhausted);
+      sched_metrics.set("splash_build_time", build_time, TIME);
+      return sched_metrics;
+    }
+
+    void reset_metrics() {
+      for(size_t i = 0; i < scratch.size(); ++i) scratch[i].clear_stats();
+      sched_metrics.clear();
+    }
     
   private:
 
@@ -241,10 +333,9 @@ namespace graphlab {
                  vertex_id_type& ret_vertex, double& ret_priority) {
       // starting at queue cpuid and running to the queue at index
       // cpuid + queue_multiple
-      static size_t lastqid[128] = {0};
-      
+      size_t& lastqid = scratch[cpuid].lastqid;
       for(size_t i = 0; i < queue_multiple; ++i) {
-        size_t j = (i + lastqid[cpuid]) % queue_multiple;
+        size_t j = (i + lastqid) % queue_multiple;
         size_t index = cpuid * queue_multiple + j;
         queuelocks[index].lock();
         if(!pqueues[index].empty()) {
@@ -254,12 +345,12 @@ namespace graphlab {
           ret_priority = pqueues[index].top().second;
           pqueues[index].pop();
           queuelocks[index].unlock();
-          lastqid[cpuid] = j + 1;
+          lastqid = j + 1;
           return true;
         }
         queuelocks[index].unlock();
       }
-      lastqid[cpuid] = 0;
+      lastqid = 0;
       return false;
     }
       
@@ -284,42 +375,47 @@ namespace graphlab {
       // Otherwise grow a splash starting at the root Splash growing
       // procedure
       // ----------------------------------------------->
+      splash_scratch& sc(scratch[cpuid]);
+      timer ti;
+      ti.start();
+      const size_t budget = 
+        splash_budget > 0 ? splash_budget : 4 * splash_size;
+      size_t spent = 0;
       
       // We immideatly add the root to the splash updating the work 
       splash.push_back(root);
+      sc.depth.clear();
+      sc.depth.push_back(0);
       size_t splash_work = work(root);
       if (root_priority > 1) splash_work = splash_size;
-      // Initialize the set of visited vertices in the bfs and the bfs
-      // queue
-      std::set<vertex_id_type>    visited;
-      std::queue<vertex_id_type>  bfs_queue;
       
-      // Mark the root as visited
-      visited.insert(root);
-      
-      // Add the roots neighbors to the BFS queue and mark them as
-      // visited
-      // The edges that are shuffled each round
-      std::vector<edge_id_type> shuffled_edges;
-      graph.in_edge_ids(root).fill_vector(shuffled_edges);
-      random::shuffle(shuffled_edges.begin(), shuffled_edges.end());
-      foreach(edge_id_type ineid, shuffled_edges) {
-        vertex_id_type neighbor = graph.source(ineid);
-        bfs_queue.push( neighbor );
-        visited.insert( neighbor );
-      }
-
-    
+      // Mark the root as visited and add its neighbors to the BFS
+      // queue
+      sc.bfs.clear();
+      sc.bfs.push_back(std::make_pair(root, size_t(0)));
+      sc.visited.set_bit_unsync(root);
+      spent += visit_neighbors(sc, root, 1);
       
-      // Fill out the splash looping until the quota is achieved or
-      // the tree becomes disconnected
-      while( splash_work < splash_size  && !bfs_queue.empty() ) {
+      // Fill out the splash looping until the quota is achieved, the
+      // tree becomes disconnected or the search budget is used up
+      size_t head = 1;
+      while( splash_work < splash_size  && head < sc.bfs.size() ) {
+        if (spent >= budget) {
+          ++sc.budget_exhausted;
+          break;
+        }
         // Get the top of the queue
-        vertex_id_type vertex = bfs_queue.front(); bfs_queue.pop();      
+        const vertex_id_type vertex = sc.bfs[head].first;
+        const size_t depth = sc.bfs[head].second;
+        ++head;
+        ++spent;
         // Compute the work associated with the vertex
         size_t vertex_work = work(vertex);
         // If the vertex is too heavy then go to the next vertex
         if(vertex_work + splash_work > splash_size) continue;
+        // A vertex without a task cannot be in a priority queue so
+        // skip it without taking the queue lock
+        if(!active_set.get(vertex)) continue;
         // Get the vertex from the priority queue
         queuelocks[vmap[vertex]].lock();
         bool success = pqueues[vmap[vertex]].remove(vertex);
@@ -329,19 +425,31 @@ namespace graphlab {
         // Otherwise we can add the vertex to the splash and update
         // the work
         splash.push_back(vertex);
+        sc.depth.push_back(depth);
         splash_work += vertex_work;
-        graph.in_edge_ids(vertex).fill_vector(shuffled_edges);
-        random::shuffle(shuffled_edges.begin(), shuffled_edges.end());
-        foreach(edge_id_type eid, shuffled_edges) {
-          vertex_id_type neighbor = graph.source(eid);
-          // if the neighbor has not been visited then add to the
-          // bfs_queue
-          if(visited.count(neighbor) == 0) {
-            visited.insert(neighbor);
-            bfs_queue.push(neighbor);
-          }        
-        } // end of if < splash size
+        spent += visit_neighbors(sc, vertex, depth + 1);
       } // end of while loop   
+
+      // Reset the visited bits for the next splash
+      for(size_t i = 0; i < sc.bfs.size(); ++i) 
+        sc.visited.clear_bit_unsync(sc.bfs[i].first);
+
+      if (splash_order == LOCALITY_ORDER && splash.size() > 2) {
+        // The BFS visits the levels in order so sorting by (depth, id)
+        // only reorders the vertices within each level
+        sc.order.clear();
+        for(size_t i = 0; i < splash.size(); ++i) 
+          sc.order.push_back(std::make_pair(sc.depth[i], splash[i]));
+        std::sort(sc.order.begin(), sc.order.end());
+        for(size_t i = 0; i < splash.size(); ++i) 
+          splash[i] = sc.order[i].second;
+      }
+      
+      ++sc.splashes;
+      sc.splash_vertices += splash.size();
+      sc.max_splash_vertices = std::max(sc.max_splash_vertices, 
+                                        splash.size());
+      sc.build_time += ti.current_time();
       
       // Support reverse splashes ----------------------------------------------->
       size_t original_size = splash.size();
@@ -356,6 +464,26 @@ namespace graphlab {
     } // end of rebuild splash
 
     
+    /**
+     * Adds the unvisited in neighbors of v to the BFS queue starting
+     * at a random edge and returns the number of edges examined.
+     */
+    size_t visit_neighbors(splash_scratch& sc, vertex_id_type v, 
+                           size_t depth) {
+      const edge_list_type in_edges = graph.in_edge_ids(v);
+      const size_t nedges = in_edges.size();
+      if (nedges == 0) return 0;
+      const size_t first = random::fast_uniform<size_t>(0, nedges - 1);
+      for(size_t i = 0; i < nedges; ++i) {
+        size_t j = first + i;
+        if (j >= nedges) j -= nedges;
+        const vertex_id_type neighbor = graph.source(in_edges[j]);
+        if (!sc.visited.set_bit_unsync(neighbor))
+          sc.bfs.push_back(std::make_pair(neighbor, depth));
+      }
+      return nedges;
+    }
+    
     //! Compute an estimate of the work associated with the vertex v
     size_t work(const vertex_id_type &v) const {
       return graph.in_edge_ids(v).size() + graph.out_edge_ids(v).size();
@@ -372,6 +500,8 @@ namespace graphlab {
 
     size_t ncpus;
     size_t splash_size;
+    size_t splash_budget;
+    splash_order_type splash_order;
 
     //! The update function (which must be first set)
     update_function_type update_fun;
@@ -387,6 +517,8 @@ namespace graphlab {
     std::vector< splash_type > splashes;    
     //! The index of each splash
     std::vector< size_t > splash_index;
+    //! The splash construction scratch space of each processor
+    std::vector< splash_scratch > scratch;
 
     //! Vertex task set used to track tasks that are currently active
     dense_bitset active_set;    
@@ -400,6 +532,8 @@ namespace graphlab {
     std::vector<direct_callback<Graph> > callbacks;
 
     bool aborted;
+
+    metrics sched_metrics;
     
   }; // End of splash scheduler
 
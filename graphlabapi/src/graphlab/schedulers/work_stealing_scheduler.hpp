@@ -0,0 +1,334 @@
+/**  
+ * Copyright (c) 2009 Carnegie Mellon University. 
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+
+/**
+ * This class defines a work stealing scheduler.  Each cpu owns a lock
+ * free Chase-Lev deque.  Tasks created by a cpu are pushed onto its
+ * own deque and a cpu whose deque is empty steals the oldest task
+ * from a randomly chosen victim.  By default a cpu also takes its own
+ * tasks oldest first since LIFO execution tends to repeatedly update
+ * the same neighborhood which slows down the convergence of dynamic
+ * algorithms such as PageRank.  The "lifo" option switches to the
+ * classic LIFO owner order.
+ **/
+#ifndef GRAPHLAB_WORK_STEALING_SCHEDULER_HPP
+#define GRAPHLAB_WORK_STEALING_SCHEDULER_HPP
+
+#include <queue>
+#include <cmath>
+#include <cassert>
+
+#include <graphlab/graph/graph.hpp>
+#include <graphlab/scope/iscope.hpp>
+#include <graphlab/tasks/update_task.hpp>
+#include <graphlab/schedulers/ischeduler.hpp>
+#include <graphlab/parallel/pthread_tools.hpp>
+#include <graphlab/parallel/atomic.hpp>
+#include <graphlab/util/random.hpp>
+#include <graphlab/util/chase_lev_deque.hpp>
+#include <graphlab/schedulers/support/vertex_task_set.hpp>
+#include <graphlab/schedulers/icallback.hpp>
+#include <graphlab/util/shared_termination.hpp>
+#include <graphlab/metrics/metrics.hpp>
+
+
+#include <graphlab/macros_def.hpp>
+
+namespace graphlab {
+
+
+  /** \ingroup group_schedulers
+   */
+  template<typename Graph>
+  class work_stealing_scheduler: public ischeduler<Graph> {
+  public:
+    typedef Graph graph_type;
+    typedef ischeduler<Graph> base;
+
+    typedef typename base::vertex_id_type vertex_id_type;
+    typedef typename base::iengine_type iengine_type;
+    typedef typename base::update_task_type update_task_type;
+    typedef typename base::update_function_type update_function_type;
+    typedef typename base::callback_type callback_type;
+    typedef typename base::monitor_type monitor_type;
+
+    typedef chase_lev_deque<update_task_type> deque_type;
+
+    /**
+     * The shared termination checker which also marks the end of the
+     * run, so that tasks added before the next run are spread round
+     * robin again.
+     */
+    class terminator_type : public shared_termination {
+    public:
+      terminator_type(size_t ncpus, bool* started) : 
+        shared_termination(ncpus), started(started) { }
+      bool end_critical_section(size_t cpuid) {
+        const bool done = shared_termination::end_critical_section(cpuid);
+        if (done) *started = false;
+        return done;
+      }
+    private:
+      bool* started;
+    };
+
+    /**
+     * The callback of one cpu.  Only the worker running on that cpu
+     * uses it so the tasks it adds can go to the deque of the cpu.
+     */
+    class cpu_callback : public icallback<Graph> {
+    public:
+      cpu_callback(work_stealing_scheduler* scheduler = NULL,
+                   iengine_type* engine = NULL, 
+                   size_t cpuid = 0) : 
+        scheduler(scheduler), engine(engine), cpuid(cpuid) { }
+
+      void add_task(update_task_type task, double priority) {
+        assert(task.function() != NULL);
+        scheduler->add_task_from_cpu(cpuid, task, priority);
+      }
+
+      void add_tasks(const std::vector<vertex_id_type> &vertices,
+                     update_function_type func,
+                     double priority) {
+        foreach(vertex_id_type vertex, vertices) {
+          add_task(update_task_type(vertex, func), priority);
+        }
+      }
+
+      void force_abort() {
+        assert(engine != NULL);
+        engine->stop();
+      }
+    private:
+      work_stealing_scheduler* scheduler;
+      iengine_type* engine;
+      size_t cpuid;
+    };
+    
+  private:
+    using base::monitor;
+
+  public:
+
+    work_stealing_scheduler(iengine_type* engine,
+                            Graph& g, 
+                            size_t ncpus)  : 
+      vertex_tasks(g.num_vertices()),
+      deques(ncpus), 
+      lifo(false), started(false), next_deque(0),
+      steals(ncpus, 0),
+      terminator(ncpus, &started),
+      sched_metrics("work_stealing") {
+      numvertices = g.num_vertices();
+      for(size_t i = 0; i < ncpus; ++i) 
+        callbacks.push_back(cpu_callback(this, engine, i));
+      for(size_t i = 0; i < deques.size(); ++i) 
+        deques[i] = new deque_type();
+    }
+
+    ~work_stealing_scheduler() {
+      for(size_t i = 0; i < deques.size(); ++i) delete deques[i];
+    }
+
+    callback_type& get_callback(size_t cpuid) {
+      return callbacks[cpuid];
+    }
+    
+    void start() { started = true; }
+
+    /** 
+     * Get the next task.  The cpu first pops from its own deque, then
+     * takes tasks added by threads which are not workers and finally
+     * tries to steal from every other cpu starting at a random
+     * victim.
+     */
+    sched_status::status_enum get_next_task(size_t cpuid,
+                                            update_task_type &ret_task) {
+      deque_type& own_deque(*deques[cpuid]);
+      bool success = false;
+      if(lifo) {
+        success = own_deque.pop(ret_task);
+      } else {
+        // steal() only fails spuriously if another cpu took a task so
+        // retrying until the deque is empty terminates.  The own
+        // deque must never appear empty while it has tasks since
+        // nobody else would wake up to run them.
+        while(!success && !own_deque.empty()) 
+          success = own_deque.steal(ret_task);
+      }
+      if(!success && overflow_size.value > 0) {
+        overflow_lock.lock();
+        if(!overflow.empty()) {
+          ret_task = overflow.front();
+          overflow.pop();
+          overflow_size.dec();
+          success = true;
+        }
+        overflow_lock.unlock();
+      }
+      if(!success && deques.size() > 1) {
+        const size_t start = 
+          random::fast_uniform(size_t(0), deques.size() - 2);
+        for(size_t i = 0; i < deques.size() - 1 && !success; ++i) {
+          // skip over the cpu itself
+          const size_t victim = (cpuid + 1 + (start + i) % (deques.size() - 1))
+            % deques.size();
+          success = deques[victim]->steal(ret_task);
+        }
+        if(success) ++steals[cpuid];
+      }
+      if(success) {
+        if (monitor != NULL) {
+          double priority = vertex_tasks.top_priority(ret_task.vertex());
+          monitor->scheduler_task_scheduled(ret_task, priority);
+        }
+        vertex_tasks.remove(ret_task);
+        return sched_status::NEWTASK;
+      } else {
+        return sched_status::EMPTY;
+      }
+    } // end of get_next_task
+    
+
+    /**
+     * Add a task.  Before start() the tasks are spread round robin
+     * over the deques.  While running, tasks go to a shared locked
+     * queue since only the owner may push onto a deque.  Workers add
+     * tasks to their own deque through their callback.
+     */
+    void add_task(update_task_type task, double priority) {
+      add_task_from_cpu(size_t(-1), task, priority);
+    } // end of add_task
+
+  private:
+    /**
+     * Adds a task on behalf of the worker running on cpuid, or of
+     * any other thread if cpuid is -1.
+     */
+    void add_task_from_cpu(size_t cpuid, update_task_type task, 
+                           double priority) {
+      if (vertex_tasks.add(task)) {
+        if(!started) {
+          deques[next_deque]->push(task);
+          next_deque = (next_deque + 1) % deques.size();
+        } else if(cpuid < deques.size()) {
+          deques[cpuid]->push(task);
+        } else {
+          overflow_lock.lock();
+          overflow.push(task);
+          overflow_size.inc();
+          overflow_lock.unlock();
+        }
+        terminator.new_job();
+        if (monitor != NULL) 
+          monitor->scheduler_task_added(task, priority);
+      } else {
+        if (monitor != NULL) 
+          monitor->scheduler_task_pruned(task);
+      }
+    } // end of add_task_from_cpu
+
+  public:
+    void add_tasks(const std::vector<vertex_id_type> &vertices,
+                   update_function_type func,
+                   double priority) {
+      foreach(vertex_id_type vertex, vertices) {
+        add_task(update_task_type(vertex, func), priority);
+      }
+    } // end of add_tasks
+
+    void add_task_to_all(update_function_type func, double priority) {
+      for (vertex_id_type vertex = 0; vertex < numvertices; ++vertex){
+        add_task(update_task_type(vertex, func), priority);
+      }
+    } // end of add_task_to_all
+
+
+    void completed_task(size_t cpuid, const update_task_type &task) { }
+
+    
+    terminator_type& get_terminator() {
+      return terminator;
+    };
+
+
+    void set_options(const scheduler_options &opts) {
+      opts.get_int_option("lifo", lifo);
+    }
+
+    static void print_options_help(std::ostream &out) {
+      out << "lifo = [integer, default = 0]. If set each cpu runs its "
+          << "own tasks newest first\n";
+    };
+
+    metrics get_metrics() {
+      for(size_t i = 0; i < steals.size(); ++i) 
+        sched_metrics.add("steals", (double)steals[i], INTEGER); 
+      return sched_metrics;
+    }
+
+    void reset_metrics() {
+      for(size_t i = 0; i < steals.size(); ++i) steals[i] = 0;
+      sched_metrics.clear();
+    }
+
+  private:
+    size_t numvertices; /// Remember the number of vertices in the graph
+
+    /// The callbacks pre-created for each cpuid
+    std::vector<cpu_callback> callbacks; 
+
+    // Task set for task pruning
+    vertex_task_set<Graph> vertex_tasks;
+
+    /// One deque per cpu
+    std::vector<deque_type*> deques;
+
+    /// Take the newest task from the own deque
+    bool lifo;
+
+    /// Set while the engine is executing tasks
+    bool started;
+    /// The deque receiving the next task added before start()
+    size_t next_deque;
+
+    /// Tasks added by threads which do not own a deque
+    std::queue<update_task_type> overflow;
+    spinlock overflow_lock;
+    atomic<size_t> overflow_size;
+
+    /// The number of successful steals by each cpu
+    std::vector<size_t> steals;
+  
+    terminator_type terminator;
+
+    metrics sched_metrics;
+  }; 
+
+
+} // end of namespace graphlab
+#include <graphlab/macros_undef.hpp>
+
+#endif
@@ -0,0 +1,134 @@
+/**  
+ * Copyright (c) 2009 Carnegie Mellon University. 
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+
+#ifndef GRAPHLAB_DOUBLE_BUFFERED_SCOPE_HPP
+#define GRAPHLAB_DOUBLE_BUFFERED_SCOPE_HPP
+
+#include <vector>
+
+#include <graphlab/scope/iscope.hpp>
+
+
+namespace graphlab {
+  
+  /**
+   * The scope used by the synchronous_engine.  Writes to the vertex
+   * go to the graph while reads of neighboring vertices are served
+   * from a copy of the vertex data taken at the end of the previous
+   * superstep.  Therefore no locks are needed: all vertices of a
+   * superstep see the same neighbor values regardless of the order
+   * in which they run.
+   *
+   * Edge data is not buffered.  An update function may only write
+   * edges which no other vertex of the same superstep writes (for
+   * instance only its in edges).
+   */
+  template<typename Graph>
+  class double_buffered_scope : 
+    public iscope<Graph> {
+  public:
+    typedef iscope<Graph> base;
+    typedef typename Graph::vertex_id_type   vertex_id_type;
+    typedef typename Graph::edge_id_type     edge_id_type;
+    typedef typename Graph::vertex_data_type vertex_data_type;
+    typedef typename Graph::edge_data_type   edge_data_type;
+
+    using base::_vertex;
+    using base::_graph_ptr;
+
+  public:
+    double_buffered_scope() : base(NULL, 0), _previous(NULL) { }
+
+    double_buffered_scope(Graph* graph, 
+                          std::vector<vertex_data_type>* previous,
+                          vertex_id_type vertex) :
+      base(graph, vertex), _previous(previous) { }
+    
+    ~double_buffered_scope() { }
+    
+    void commit() { }
+    
+    void init(Graph* graph, 
+              std::vector<vertex_data_type>* previous,
+              vertex_id_type vertex) {
+      _graph_ptr = graph;
+      _vertex = vertex;
+      _previous = previous;
+    }
+    
+    /// Returns the data on the base vertex
+    vertex_data_type& vertex_data()  {
+      return _graph_ptr->vertex_data(_vertex);
+    }
+
+    const vertex_data_type& vertex_data() const  {
+      return const_vertex_data();
+    }
+
+    const vertex_data_type& const_vertex_data() const  {
+      return _graph_ptr->vertex_data(_vertex);
+    }
+
+    edge_data_type& edge_data(edge_id_type eid) {
+      return _graph_ptr->edge_data(eid);
+    }
+
+    const edge_data_type& edge_data(edge_id_type eid) const { 
+      return const_edge_data(eid);
+    }
+
+    const edge_data_type& const_edge_data(edge_id_type eid) const { 
+      return _graph_ptr->edge_data(eid);
+    }
+    
+    /**
+     * Returns the value the neighbor had at the end of the last
+     * superstep.  Neighbors are read only in a superstep: the
+     * reference is into the read buffer and is not written back.
+     */
+    vertex_data_type& neighbor_vertex_data(vertex_id_type vertex) {
+      assert(_previous != NULL);
+      return (*_previous)[vertex];
+    }
+
+    const vertex_data_type& neighbor_vertex_data(vertex_id_type vertex) const {
+      return const_neighbor_vertex_data(vertex);
+    }
+
+    /// Returns the value the neighbor had at the end of the last superstep
+    const vertex_data_type& 
+    const_neighbor_vertex_data(vertex_id_type vertex) const {
+      assert(_previous != NULL);
+      return (*_previous)[vertex];
+    }
+
+  private:
+    std::vector<vertex_data_type>* _previous;
+  }; // end of double_buffered_scope
+  
+} // end of graphlab namespace
+
+
+#endif
+
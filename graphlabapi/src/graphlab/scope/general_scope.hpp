@@ -38,6 +38,8 @@
 #include <graphlab/scope/iscope.hpp>
 #include <graphlab/scope/iscope_factory.hpp>
 
+#include <graphlab/macros_def.hpp>
+
 
 
 namespace graphlab {
@@ -78,7 +80,31 @@ namespace graphlab {
 
     ~general_scope() { }
 
-    void commit() {}
+    /**
+     * Refresh the hot data arrays (see hot_data_traits) for the data
+     * that could have been modified through this scope.  This
+     * compiles to nothing if no hot fields are declared.
+     */
+    void commit() {
+      typedef typename Graph::vertex_hot_traits vertex_hot_traits;
+      typedef typename Graph::edge_hot_traits edge_hot_traits;
+      if(vertex_hot_traits::enabled) {
+        _graph_ptr->refresh_vertex_hot_data(_vertex);
+        // Only full consistency permits writes to the neighbors
+        if(stype == scope_range::FULL_CONSISTENCY) {
+          foreach(edge_id_type eid, _graph_ptr->in_edge_ids(_vertex))
+            _graph_ptr->refresh_vertex_hot_data(_graph_ptr->source(eid));
+          foreach(edge_id_type eid, _graph_ptr->out_edge_ids(_vertex))
+            _graph_ptr->refresh_vertex_hot_data(_graph_ptr->target(eid));
+        }
+      }
+      if(edge_hot_traits::enabled) {
+        foreach(edge_id_type eid, _graph_ptr->in_edge_ids(_vertex))
+          _graph_ptr->refresh_edge_hot_data(eid);
+        foreach(edge_id_type eid, _graph_ptr->out_edge_ids(_vertex))
+          _graph_ptr->refresh_edge_hot_data(eid);
+      }
+    }
     
 
     void init(Graph* graph, vertex_id_type vertex) {
@@ -144,5 +170,6 @@ namespace graphlab {
 } // end of graphlab namespace
 
 
+#include <graphlab/macros_undef.hpp>
 #endif
 
@@ -39,6 +39,7 @@
 #include <graphlab/scope/iscope.hpp>
 #include <graphlab/scope/iscope_factory.hpp>
 #include <graphlab/scope/general_scope.hpp>
+#include <graphlab/scope/vertex_lock_table.hpp>
 #include <graphlab/parallel/pthread_tools.hpp>
 #include <graphlab/graph/graph.hpp>
 
@@ -64,20 +65,87 @@ namespace graphlab {
   private:
     Graph& graph;
     std::vector<general_scope_type*> scopes;
-    std::vector<rwlock> locks;
+    vertex_lock_table locks;
     scope_range::scope_range_enum default_scope;
 
+    /** Acquires each lock it is called with */
+    struct lock_op {
+      const vertex_lock_table& locks;
+      lock_op(const vertex_lock_table& locks) : locks(locks) { }
+      void operator()(size_t id, bool write) const { locks.lock(id, write); }
+    };
+
+    /** Releases each lock it is called with */
+    struct unlock_op {
+      const vertex_lock_table& locks;
+      unlock_op(const vertex_lock_table& locks) : locks(locks) { }
+      void operator()(size_t id, bool write) const { locks.unlock(id); }
+    };
+
+    /**
+     * Calls op(lockid, write) once for every lock protecting v and
+     * its neighbors, in increasing lock order.  A lock shared by
+     * several of these vertices is write locked if any of them
+     * requires it.
+     */
+    template<typename LockOp>
+    void foreach_scope_lock(vertex_id_type v, bool center_write, 
+                            bool adjacent_write, const LockOp& op) const {
+      const edge_list_type inedges =  graph.in_edge_ids(v);
+      const edge_list_type outedges = graph.out_edge_ids(v);
+
+      size_t inidx = 0;
+      size_t outidx = 0;
+
+      bool curvisited = false;
+      vertex_id_type numv = (vertex_id_type)(graph.num_vertices());
+      vertex_id_type inv  = (inedges.size() > 0) ? graph.source(inedges[0]) : numv;
+      vertex_id_type outv  = (outedges.size() > 0) ? graph.target(outedges[0]) : numv;
+      size_t lockid = size_t(-1);
+      bool lockwrite = false;
+      // iterate both in order including the current vertex and merge
+      // the vertices sharing a lock
+      while (true) {
+        vertex_id_type u;
+        bool write = adjacent_write;
+        if (!curvisited && v <= inv && v <= outv) {
+          u = v; write = center_write;
+          curvisited = true;
+        } else if (inv == numv && outv == numv) {
+          break;
+        } else if (inv <= outv) {
+          u = inv;
+          if (inv == outv) {
+            ++outidx;
+            outv = (outedges.size() > outidx) ? graph.target(outedges[outidx]) : numv;
+          }
+          ++inidx;
+          inv = (inedges.size() > inidx) ? graph.source(inedges[inidx]) : numv;
+        } else {
+          u = outv; ++outidx;
+          outv = (outedges.size() > outidx) ? graph.target(outedges[outidx]) : numv;
+        }
+        const size_t id = locks.lock_id(u);
+        if (id == lockid) {
+          lockwrite = lockwrite || write;
+        } else {
+          if (lockid != size_t(-1)) op(lockid, lockwrite);
+          lockid = id; lockwrite = write;
+        }
+      }
+      if (lockid != size_t(-1)) op(lockid, lockwrite);
+    }
+
   public:
 
     general_scope_factory(Graph& graph,
                           size_t ncpus,
                           scope_range::scope_range_enum default_scope_range 
                           = scope_range::NULL_CONSISTENCY) :
-      base(graph,ncpus), graph(graph),
+      base(graph,ncpus), graph(graph), locks(graph.num_vertices()),
       default_scope(default_scope_range) {
       if (default_scope == scope_range::USE_DEFAULT)
         default_scope = scope_range::VERTEX_CONSISTENCY;
-      locks.resize(graph.num_vertices());
       
       // preallocate the scopes
       scopes.resize(2 * ncpus);
@@ -94,6 +162,16 @@ namespace graphlab {
         default_scope = scope_range::VERTEX_CONSISTENCY;
     }
 
+    /**
+     * Selects the lock implementation and the number of lock stripes
+     * (0 = one lock per vertex).  Must not be called while any scope
+     * or range lock is held.
+     */
+    void set_lock_table(vertex_lock_table::lock_type_enum lock_type,
+                        size_t nstripes) {
+      locks.configure(lock_type, nstripes);
+    }
+
     ~general_scope_factory() { 
       for (size_t i = 0;i < scopes.size(); ++i) {
         delete scopes[i];
@@ -132,42 +210,7 @@ namespace graphlab {
       
       scope->init(&graph, v);
       scope->stype = scope_range::FULL_CONSISTENCY;
-
-      const edge_list_type inedges =  graph.in_edge_ids(v);
-      const edge_list_type outedges = graph.out_edge_ids(v);
-
-      size_t inidx = 0;
-      size_t outidx = 0;
-
-      bool curlocked = false;
-      vertex_id_type numv = (vertex_id_type)(graph.num_vertices());
-      vertex_id_type curv = scope->vertex();
-      vertex_id_type inv  = (inedges.size() > 0) ? graph.source(inedges[0]) : numv;
-      vertex_id_type outv  = (outedges.size() > 0) ? graph.target(outedges[0]) : numv;
-      // iterate both in order and lock
-      // include the current vertex in the iteration
-      while (inidx < inedges.size() || outidx < outedges.size()) {
-        if (!curlocked && curv < inv  && curv < outv) {
-          locks[curv].writelock();
-          curlocked = true;
-          curv = numv;
-        } else if (inv < outv) {
-          locks[inv].writelock(); ++inidx;
-          inv = (inedges.size() > inidx) ? graph.source(inedges[inidx]) : numv;
-        } else if (outv < inv) {
-          locks[outv].writelock(); ++outidx;
-          outv= (outedges.size() > outidx) ? graph.target(outedges[outidx]) : numv;
-        } else if (inv == outv){
-          locks[inv].writelock();
-          ++inidx; ++outidx;
-          inv = (inedges.size() > inidx) ? graph.source(inedges[inidx]) : numv;
-          outv= (outedges.size() > outidx) ? graph.target(outedges[outidx]) : numv;
-        }
-      }
-      // just in case we never got around to locking it
-      if (!curlocked) {
-        locks[curv].writelock();
-      }
+      foreach_scope_lock(v, true, true, lock_op(locks));
       return scope;
     }
 
@@ -177,44 +220,7 @@ namespace graphlab {
       
       scope->init(&graph, v);
       scope->stype = scope_range::EDGE_CONSISTENCY;
-
-      const edge_list_type inedges =  graph.in_edge_ids(v);
-      const edge_list_type outedges = graph.out_edge_ids(v);
-
-      size_t inidx = 0;
-      size_t outidx = 0;
-
-
-      bool curlocked = false;
-      vertex_id_type numv = (vertex_id_type)(graph.num_vertices());
-      vertex_id_type curv = scope->vertex();
-      vertex_id_type inv  = (inedges.size() > 0) ? graph.source(inedges[0]) : numv;
-      vertex_id_type outv  = (outedges.size() > 0) ? graph.target(outedges[0]) : numv;
-      // iterate both in order and lock
-      // include the current vertex in the iteration
-      while (inidx < inedges.size() || outidx < outedges.size()) {
-        if (!curlocked && curv < inv  && curv < outv) {
-          locks[curv].writelock();
-          curlocked = true;
-          curv = numv;
-        } else if (inv < outv) {
-          locks[inv].readlock(); ++inidx;
-          inv = (inedges.size() > inidx) ? graph.source(inedges[inidx]) : numv;
-        } else if (outv < inv) {
-          locks[outv].readlock(); ++outidx;
-          outv= (outedges.size() > outidx) ? graph.target(outedges[outidx]) : numv;
-        } else if (inv == outv){
-          locks[inv].readlock();
-          ++inidx; ++outidx;
-          inv = (inedges.size() > inidx) ? graph.source(inedges[inidx]) : numv;
-          outv= (outedges.size() > outidx) ? graph.target(outedges[outidx]) : numv;
-        }
-      }
-      // just in case we never got around to locking it
-      if (!curlocked) {
-        locks[curv].writelock();
-      }
-
+      foreach_scope_lock(v, true, false, lock_op(locks));
       return scope;
     }
 
@@ -225,26 +231,26 @@ namespace graphlab {
       scope->stype = scope_range::VERTEX_CONSISTENCY;
 
       vertex_id_type curv = scope->vertex();
-      locks[curv].writelock();
+      locks.writelock(locks.lock_id(curv));
 
       return scope;
     }
 
 
     void acquire_range_lock(size_t start, size_t end) {
-        for (size_t i = start; i <= end; ++i) {
-          locks[i].readlock();
-        }
+      for (size_t i = locks.lock_id(start); i <= locks.lock_id(end); ++i) {
+        locks.readlock(i);
+      }
     }
 
     iscope_type* get_vertex_read_scope(size_t cpuid, vertex_id_type v) {
       general_scope_type* scope = scopes[cpuid];
       
       scope->init(&graph, v);
-      scope->stype = scope_range::READ_CONSISTENCY;
+      scope->stype = scope_range::VERTEX_READ_CONSISTENCY;
 
       vertex_id_type curv = scope->vertex();
-      locks[curv].readlock();
+      locks.readlock(locks.lock_id(curv));
       return scope;
     }
 
@@ -253,43 +259,7 @@ namespace graphlab {
       
       scope->init(&graph, v);
       scope->stype = scope_range::READ_CONSISTENCY;
-
-      const edge_list_type inedges =  graph.in_edge_ids(v);
-      const edge_list_type outedges = graph.out_edge_ids(v);
-
-      size_t inidx = 0;
-      size_t outidx = 0;
-
-
-      bool curlocked = false;
-      vertex_id_type numv = (vertex_id_type)(graph.num_vertices());
-      vertex_id_type curv = scope->vertex();
-      vertex_id_type inv  = (inedges.size() > 0) ? graph.source(inedges[0]) : numv;
-      vertex_id_type outv  = (outedges.size() > 0) ? graph.target(outedges[0]) : numv;
-      // iterate both in order and lock
-      // include the current vertex in the iteration
-      while (inidx < inedges.size() || outidx < outedges.size()) {
-        if (!curlocked && curv < inv  && curv < outv) {
-          locks[curv].readlock();
-          curlocked = true;
-          curv = numv;
-        } else if (inv < outv) {
-          locks[inv].readlock(); ++inidx;
-          inv = (inedges.size() > inidx) ? graph.source(inedges[inidx]) : numv;
-        } else if (outv < inv) {
-          locks[outv].readlock(); ++outidx;
-          outv= (outedges.size() > outidx) ? graph.target(outedges[outidx]) : numv;
-        } else if (inv == outv){
-          locks[inv].readlock();
-          ++inidx; ++outidx;
-          inv = (inedges.size() > inidx) ? graph.source(inedges[inidx]) : numv;
-          outv= (outedges.size() > outidx) ? graph.target(outedges[outidx]) : numv;
-        }
-      }
-      // just in case we never got around to locking it
-      if (!curlocked) {
-        locks[curv].readlock();
-      }
+      foreach_scope_lock(v, false, false, lock_op(locks));
       return scope;
     }
 
@@ -326,57 +296,17 @@ namespace graphlab {
     }
 
     void release_full_edge_scope(general_scope_type* scope) {
-      vertex_id_type v = scope->vertex();
-      const edge_list_type inedges =  graph.in_edge_ids(v);
-      const edge_list_type outedges = graph.out_edge_ids(v);
-      size_t inidx = inedges.size() - 1;
-      size_t outidx = outedges.size() - 1;
-
-      bool curvunlocked = false;
-
-      vertex_id_type curv = scope->vertex();
-      vertex_id_type inv  = (inedges.size() > inidx) ?
-        graph.source(inedges[inidx]) : vertex_id_type(-1);
-      vertex_id_type outv  = (outedges.size() > outidx) ?
-        graph.target(outedges[outidx]) : vertex_id_type(-1);
-      // iterate both in order and lock
-      // include the current vertex in the iteration
-      while (inidx < inedges.size() || outidx < outedges.size()) {
-        if (!curvunlocked && (curv > inv || inv == vertex_id_type(-1)) &&
-            (curv > outv || outv == vertex_id_type(-1))) {
-          locks[curv].unlock();
-          curvunlocked = true;
-        } else if ((inv+1) > (outv+1)) {
-          locks[inv].unlock(); --inidx;
-          inv  = (inedges.size() > inidx) ?
-            graph.source(inedges[inidx]) : vertex_id_type(-1);
-        } else if ((outv+1) > (inv+1)) {
-          locks[outv].unlock(); --outidx;
-          outv  = (outedges.size() > outidx) ?
-            graph.target(outedges[outidx]) : vertex_id_type(-1);
-        } else if (inv == outv){
-          locks[inv].unlock();
-          --inidx; --outidx;
-          inv  = (inedges.size() > inidx) ?
-            graph.source(inedges[inidx]) : vertex_id_type(-1);
-          outv  = (outedges.size() > outidx) ?
-            graph.target(outedges[outidx]) : vertex_id_type(-1);
-        }
-      }
-
-      if (!curvunlocked) {
-        locks[curv].unlock();
-      }
+      foreach_scope_lock(scope->vertex(), false, false, unlock_op(locks));
     }
 
     void release_vertex_scope(general_scope_type* scope) {
       vertex_id_type curv = scope->vertex();
-      locks[curv].unlock();
+      locks.unlock(locks.lock_id(curv));
     }
 
     void release_range_lock(size_t start, size_t end) {
-      for (size_t i = start; i <= end; ++i)
-        locks[i].unlock();
+      for (size_t i = locks.lock_id(start); i <= locks.lock_id(end); ++i)
+        locks.unlock(i);
     }
 
     void release_null_scope(general_scope_type* scope) {
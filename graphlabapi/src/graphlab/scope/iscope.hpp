@@ -166,6 +166,11 @@ namespace graphlab {
     //! The edge data type associated with the graph
     typedef typename Graph::edge_list_type   edge_list_type;
 
+    //! The hot vertex fields (see hot_data_traits)
+    typedef typename Graph::vertex_hot_type vertex_hot_type;
+    //! The hot edge fields (see hot_data_traits)
+    typedef typename Graph::edge_hot_type   edge_hot_type;
+
 
 
   public:    
@@ -403,6 +408,30 @@ namespace graphlab {
     const_neighbor_vertex_data(vertex_id_type vertex) const = 0;
 
 
+    /**
+     * \brief get an immutable reference to the hot fields of a
+     * neighboring vertex.
+     *
+     * This reads from the dense hot array maintained by the graph
+     * and therefore does not touch the rest of the neighbor vertex
+     * data.  Requires hot_data_traits to be specialized for the
+     * vertex data type.  The same consistency rules as
+     * const_neighbor_vertex_data() apply.
+     */
+    const vertex_hot_type& 
+    const_neighbor_vertex_hot_data(vertex_id_type vertex) const {
+      return _graph_ptr->vertex_hot_data(vertex);
+    }
+
+    /**
+     * \brief get an immutable reference to the hot fields of an
+     * adjacent edge.  Requires hot_data_traits to be specialized for
+     * the edge data type.
+     */
+    const edge_hot_type& const_edge_hot_data(edge_id_type eid) const {
+      return _graph_ptr->edge_hot_data(eid);
+    }
+
     /**
     Experimental scope upgrade scheme. Returns true if scope upgrade is 
     successful. If this ever returns false, you are hosed. Should work
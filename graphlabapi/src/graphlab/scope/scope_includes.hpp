@@ -26,7 +26,9 @@
 #include <graphlab/scope/iscope.hpp>
 #include <graphlab/scope/synchronous_scope_factory.hpp>
 #include <graphlab/scope/synchronous_scope.hpp>
+#include <graphlab/scope/double_buffered_scope.hpp>
 #include <graphlab/scope/general_scope_factory.hpp>
+#include <graphlab/scope/vertex_lock_table.hpp>
 #include <graphlab/scope/general_scope.hpp>
 
 
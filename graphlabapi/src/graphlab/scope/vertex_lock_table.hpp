@@ -0,0 +1,126 @@
+/**  
+ * Copyright (c) 2009 Carnegie Mellon University. 
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+
+#ifndef GRAPHLAB_VERTEX_LOCK_TABLE_HPP
+#define GRAPHLAB_VERTEX_LOCK_TABLE_HPP
+
+#include <vector>
+#include <string>
+
+#include <graphlab/parallel/pthread_tools.hpp>
+
+
+namespace graphlab {
+
+  /**
+   * The table of reader/writer locks used by the general scope
+   * factory to lock vertices.  By default every vertex has its own
+   * pthread rwlock.  The table may instead hold 4 byte compact
+   * spinning locks, and may be striped so that a fixed number of
+   * locks is shared by blocks of consecutive vertex ids.
+   *
+   * The vertex to lock mapping is non-decreasing in the vertex id so
+   * that locking vertices in increasing id order also acquires the
+   * locks in increasing order.  Callers walking a neighborhood in
+   * vertex order must merge consecutive equal lock ids since several
+   * vertices may map to the same lock.
+   */
+  class vertex_lock_table {
+  public:
+    enum lock_type_enum {
+      PTHREAD_LOCKS,   ///< One pthread rwlock per entry
+      COMPACT_LOCKS    ///< One compact_rwlock per entry
+    };
+
+    vertex_lock_table(size_t nverts = 0) : 
+      lock_type(PTHREAD_LOCKS), nverts(nverts), nlocks(nverts) {
+      plocks.resize(nlocks);
+    }
+
+    /**
+     * Rebuilds the table.  Must not be called while any lock is
+     * held.  A stripe count of zero (or at least the number of
+     * vertices) gives one lock per vertex.
+     */
+    void configure(lock_type_enum new_type, size_t nstripes) {
+      lock_type = new_type;
+      nlocks = (nstripes == 0 || nstripes > nverts) ? nverts : nstripes;
+      std::vector<rwlock>().swap(plocks);
+      std::vector<compact_rwlock>().swap(clocks);
+      if (lock_type == PTHREAD_LOCKS) plocks.resize(nlocks);
+      else clocks.resize(nlocks);
+    }
+
+    /**
+     * Parses the lock type names "pthread" and "compact".  Returns
+     * false if the name is not recognized.
+     */
+    static bool parse_lock_type(const std::string& name, 
+                                lock_type_enum& ret) {
+      if (name == "pthread") ret = PTHREAD_LOCKS;
+      else if (name == "compact") ret = COMPACT_LOCKS;
+      else return false;
+      return true;
+    }
+    
+    lock_type_enum get_lock_type() const { return lock_type; }
+
+    size_t num_locks() const { return nlocks; }
+
+    /// Returns the lock protecting vertex v
+    inline size_t lock_id(size_t v) const {
+      return (nlocks == nverts) ? v : size_t((uint64_t(v) * nlocks) / nverts);
+    }
+
+    inline void readlock(size_t id) const {
+      if (lock_type == COMPACT_LOCKS) clocks[id].readlock();
+      else plocks[id].readlock();
+    }
+
+    inline void writelock(size_t id) const {
+      if (lock_type == COMPACT_LOCKS) clocks[id].writelock();
+      else plocks[id].writelock();
+    }
+
+    inline void lock(size_t id, bool write) const {
+      if (write) writelock(id);
+      else readlock(id);
+    }
+    
+    inline void unlock(size_t id) const {
+      if (lock_type == COMPACT_LOCKS) clocks[id].unlock();
+      else plocks[id].unlock();
+    }
+
+  private:
+    lock_type_enum lock_type;
+    size_t nverts;
+    size_t nlocks;
+    std::vector<rwlock> plocks;
+    std::vector<compact_rwlock> clocks;
+  }; // end of vertex_lock_table
+
+} // end of namespace graphlab
+
+#endif
@@ -0,0 +1,157 @@
+/**  
+ * Copyright (c) 2009 Carnegie Mellon University. 
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+#ifndef GRAPHLAB_CHASE_LEV_DEQUE_HPP
+#define GRAPHLAB_CHASE_LEV_DEQUE_HPP
+
+#include <stdint.h>
+#include <vector>
+
+#include <graphlab/logger/assertions.hpp>
+
+namespace graphlab {
+  /**
+   * \ingroup util_internal
+   *
+   * A lock free work stealing deque (Chase and Lev, "Dynamic Circular
+   * Work-Stealing Deque", SPAA 2005).  Only the owning thread may call
+   * push() and pop() which operate on the bottom of the deque.  Any
+   * thread may call steal() which removes from the top.
+   *
+   * The circular array grows when full.  Retired arrays are kept
+   * until the deque is destroyed since a concurrent steal() may still
+   * be reading from them.  T must be cheap to copy.
+   */
+  template <typename T>
+  class chase_lev_deque {
+  private:
+    struct circular_array {
+      size_t mask;
+      T* data;
+      circular_array(size_t size) : mask(size - 1), data(new T[size]) { 
+        ASSERT_EQ(size & mask, 0);
+      }
+      ~circular_array() { delete [] data; }
+      size_t size() const { return mask + 1; }
+      const T& get(int64_t i) const { return data[i & mask]; }
+      void put(int64_t i, const T& value) { data[i & mask] = value; }
+    };
+
+  public:
+    chase_lev_deque(size_t initial_size = 1024) : top(0), bottom(0) {
+      // round up to a power of two
+      size_t size = 16;
+      while(size < initial_size) size *= 2;
+      circular_array* a = new circular_array(size);
+      arrays.push_back(a);
+      array = a;
+    }
+
+    ~chase_lev_deque() {
+      for(size_t i = 0; i < arrays.size(); ++i) delete arrays[i];
+    }
+
+    /// Add an element to the bottom.  Owner only.
+    void push(const T& value) {
+      const int64_t b = bottom;
+      const int64_t t = top;
+      circular_array* a = array;
+      if(b - t >= int64_t(a->size())) a = grow(a, b, t);
+      a->put(b, value);
+      // the element must be visible before the new bottom
+      __sync_synchronize();
+      bottom = b + 1;
+    }
+
+    /// Remove an element from the bottom.  Owner only.
+    bool pop(T& ret) {
+      const int64_t b = bottom - 1;
+      circular_array* a = array;
+      bottom = b;
+      // the new bottom must be visible before top is read
+      __sync_synchronize();
+      const int64_t t = top;
+      if(t > b) {
+        // empty
+        bottom = b + 1;
+        return false;
+      }
+      ret = a->get(b);
+      if(t == b) {
+        // the last element: race the thieves for it
+        const bool success = __sync_bool_compare_and_swap(&top, t, t + 1);
+        bottom = b + 1;
+        return success;
+      }
+      return true;
+    }
+
+    /**
+     * Remove an element from the top.  May be called by any thread.
+     * Returns false if the deque is empty or another thread removed
+     * the element first.
+     */
+    bool steal(T& ret) {
+      const int64_t t = top;
+      __sync_synchronize();
+      const int64_t b = bottom;
+      if(t >= b) return false;
+      circular_array* a = array;
+      ret = a->get(t);
+      return __sync_bool_compare_and_swap(&top, t, t + 1);
+    }
+
+    /// An estimate of the number of elements
+    size_t size() const {
+      const int64_t b = bottom;
+      const int64_t t = top;
+      return b > t ? size_t(b - t) : 0;
+    }
+
+    bool empty() const { return size() == 0; }
+
+  private:
+    /// Double the array size.  Owner only.
+    circular_array* grow(circular_array* a, int64_t b, int64_t t) {
+      circular_array* new_array = new circular_array(2 * a->size());
+      for(int64_t i = t; i < b; ++i) new_array->put(i, a->get(i));
+      arrays.push_back(new_array);
+      __sync_synchronize();
+      array = new_array;
+      return new_array;
+    }
+
+    volatile int64_t top;
+    char pad[64 - sizeof(int64_t)];
+    volatile int64_t bottom;
+    circular_array* volatile array;
+    /// All the arrays ever allocated, including the current one
+    std::vector<circular_array*> arrays;
+
+    // not copyable
+    chase_lev_deque(const chase_lev_deque&);
+    chase_lev_deque& operator=(const chase_lev_deque&);
+  }; // end of chase_lev_deque
+
+}
+#endif
@@ -0,0 +1,135 @@
+/**  
+ * Copyright (c) 2009 Carnegie Mellon University. 
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+
+#ifndef GRAPHLAB_CYCLE_HISTOGRAM_HPP
+#define GRAPHLAB_CYCLE_HISTOGRAM_HPP
+
+#include <string>
+#include <algorithm>
+#include <graphlab/util/timer.hpp>
+#include <graphlab/metrics/metrics.hpp>
+
+namespace graphlab {
+
+  /**
+   * \ingroup util
+   * A histogram of durations measured in rdtsc() ticks.  Bucket 0
+   * counts zero length durations and bucket b > 0 the durations in
+   * [2^(b-1), 2^b).  Adding a sample touches three words and takes
+   * no lock, so each thread should own its histogram and the
+   * histograms are merged when reporting.
+   */
+  class cycle_histogram {
+  public:
+    enum { NUM_BUCKETS = 65 };
+
+    cycle_histogram() { clear(); }
+
+    void clear() {
+      std::fill(counts, counts + NUM_BUCKETS, 0);
+      nsamples = 0;
+      total_ticks = 0;
+      max_ticks = 0;
+    }
+
+    /** Records a duration of ticks */
+    inline void add(unsigned long long ticks) {
+      ++counts[bucket_of(ticks)];
+      ++nsamples;
+      total_ticks += ticks;
+      if (ticks > max_ticks) max_ticks = ticks;
+    }
+
+    /** Records the ticks since start and returns the current tick */
+    inline unsigned long long lap(unsigned long long start) {
+      const unsigned long long now = rdtsc();
+      add(now - start);
+      return now;
+    }
+
+    void merge(const cycle_histogram& other) {
+      for(size_t i = 0; i < NUM_BUCKETS; ++i) counts[i] += other.counts[i];
+      nsamples += other.nsamples;
+      total_ticks += other.total_ticks;
+      max_ticks = std::max(max_ticks, other.max_ticks);
+    }
+
+    size_t count() const { return nsamples; }
+    unsigned long long total() const { return total_ticks; }
+    unsigned long long max() const { return max_ticks; }
+    size_t bucket_count(size_t b) const { return counts[b]; }
+
+    static size_t bucket_of(unsigned long long ticks) {
+      return ticks == 0 ? 0 : 64 - __builtin_clzll(ticks);
+    }
+
+    /**
+     * Returns an upper bound on the q quantile (0 <= q <= 1): the
+     * upper end of the bucket holding it, but no more than max().
+     */
+    unsigned long long quantile(double q) const {
+      if (nsamples == 0) return 0;
+      const double target = q * nsamples;
+      size_t seen = 0;
+      for(size_t b = 0; b < NUM_BUCKETS; ++b) {
+        seen += counts[b];
+        if (seen > 0 && seen >= target) {
+          if (b == 0) return 0;
+          if (b >= 64) return max_ticks;
+          return std::min(max_ticks, (1ULL << b) - 1);
+        }
+      }
+      return max_ticks;
+    }
+
+    /**
+     * Adds name_count, name_total, name_mean, name_p50, name_p99
+     * and name_max to m, converting ticks to seconds, and the bucket
+     * counts to the vector name_histogram.
+     */
+    void report(metrics& m, const std::string& name, 
+                double ticks_per_second) const {
+      const double scale = 1.0 / ticks_per_second;
+      m.add(name + "_count", (double)nsamples, INTEGER);
+      m.add(name + "_total", total_ticks * scale, TIME);
+      if (nsamples == 0) return;
+      m.add(name + "_mean", total_ticks * scale / nsamples, TIME);
+      m.add(name + "_p50", quantile(0.5) * scale, TIME);
+      m.add(name + "_p99", quantile(0.99) * scale, TIME);
+      m.add(name + "_max", max_ticks * scale, TIME);
+      size_t last = NUM_BUCKETS;
+      while(last > 0 && counts[last - 1] == 0) --last;
+      for(size_t b = 0; b < last; ++b) 
+        m.add_vector_entry(name + "_histogram", b, (double)counts[b]);
+    }
+
+  private:
+    size_t counts[NUM_BUCKETS];
+    size_t nsamples;
+    unsigned long long total_ticks;
+    unsigned long long max_ticks;
+  };
+
+}
+#endif
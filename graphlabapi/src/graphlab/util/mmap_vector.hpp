@@ -0,0 +1,177 @@
+/**  
+ * Copyright (c) 2009 Carnegie Mellon University. 
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+
+#ifndef GRAPHLAB_MMAP_VECTOR_HPP
+#define GRAPHLAB_MMAP_VECTOR_HPP
+
+#include <vector>
+#include <algorithm>
+
+#include <boost/shared_ptr.hpp>
+
+#include <graphlab/logger/assertions.hpp>
+#include <graphlab/serialization/iarchive.hpp>
+#include <graphlab/serialization/oarchive.hpp>
+#include <graphlab/serialization/vector.hpp>
+#include <graphlab/util/mmap_wrapper.hpp>
+
+namespace graphlab {
+
+  /**
+   * \ingroup util_internal
+   * A minimal std::vector replacement which can either own its
+   * storage or act as a view of an array inside a memory mapped file.
+   *
+   * Element access never copies.  Any operation which changes the
+   * size of a mapped vector first copies the mapped array onto the
+   * heap (after which the vector behaves like a std::vector) except
+   * clear() which simply drops the mapping.  The mapping is kept alive
+   * by a shared pointer so several vectors can view the same file.
+   * Copying a mmap_vector always produces a heap backed copy.
+   */
+  template<typename T>
+  class mmap_vector {
+  public:
+    typedef T value_type;
+    typedef T* iterator;
+    typedef const T* const_iterator;
+    typedef T& reference;
+    typedef const T& const_reference;
+    
+  private:
+    std::vector<T> heap;
+    boost::shared_ptr<mmap_wrapper> mapping;
+    T* mapped_ptr;
+    size_t mapped_len;
+
+    /** Copy the mapped array onto the heap */
+    void unmap() {
+      if(mapping != NULL) {
+        std::vector<T>(mapped_ptr, mapped_ptr + mapped_len).swap(heap);
+        drop_mapping();
+      }
+    }
+
+    void drop_mapping() {
+      mapping.reset();
+      mapped_ptr = NULL;
+      mapped_len = 0;
+    }
+
+  public:
+    mmap_vector() : mapped_ptr(NULL), mapped_len(0) { }
+
+    explicit mmap_vector(size_t n, const T& value = T()) :
+      heap(n, value), mapped_ptr(NULL), mapped_len(0) { }
+
+    mmap_vector(const mmap_vector& other) : 
+      heap(other.begin(), other.end()), mapped_ptr(NULL), mapped_len(0) { }
+
+    mmap_vector& operator=(const mmap_vector& other) {
+      if(this != &other) {
+        drop_mapping();
+        heap.assign(other.begin(), other.end());
+      }
+      return *this;
+    }
+
+    /** 
+     * Make this vector a view of len elements starting at ptr which
+     * must lie inside the region mapped by m.
+     */
+    void map(const boost::shared_ptr<mmap_wrapper>& m, T* ptr, size_t len) {
+      std::vector<T>().swap(heap);
+      mapping = m;
+      mapped_ptr = ptr;
+      mapped_len = len;
+    }
+
+    /** Returns true if the elements live in a mapped file */
+    bool is_mapped() const { return mapping != NULL; }
+
+    size_t size() const { return is_mapped() ? mapped_len : heap.size(); }
+    bool empty() const { return size() == 0; }
+
+    T* begin() { 
+      return is_mapped() ? mapped_ptr : (heap.empty() ? NULL : &heap[0]); 
+    }
+    const T* begin() const { 
+      return is_mapped() ? mapped_ptr : (heap.empty() ? NULL : &heap[0]); 
+    }
+    T* end() { return begin() + size(); }
+    const T* end() const { return begin() + size(); }
+
+    T& operator[](size_t i) { return begin()[i]; }
+    const T& operator[](size_t i) const { return begin()[i]; }
+    T& back() { return end()[-1]; }
+    const T& back() const { return end()[-1]; }
+
+    void push_back(const T& value) { 
+      if(is_mapped()) {
+        // value may refer to an element of the mapping
+        T tmp(value);
+        unmap();
+        heap.push_back(tmp);
+      } else {
+        heap.push_back(value);
+      }
+    }
+
+    void resize(size_t n, T value = T()) { unmap(); heap.resize(n, value); }
+    void reserve(size_t n) { unmap(); heap.reserve(n); }
+    template<typename InputIterator>
+    void assign(InputIterator first, InputIterator last) {
+      // the range may point into the mapping
+      std::vector<T> tmp(first, last);
+      heap.swap(tmp);
+      drop_mapping();
+    }
+    void clear() { drop_mapping(); heap.clear(); }
+
+    void swap(mmap_vector& other) {
+      heap.swap(other.heap);
+      mapping.swap(other.mapping);
+      std::swap(mapped_ptr, other.mapped_ptr);
+      std::swap(mapped_len, other.mapped_len);
+    }
+
+    /** Serialized exactly like a std::vector */
+    void save(oarchive& arc) const {
+      if(is_mapped()) {
+        std::vector<T> tmp(begin(), end());
+        arc << tmp;
+      } else {
+        arc << heap;
+      }
+    }
+
+    void load(iarchive& arc) {
+      drop_mapping();
+      arc >> heap;
+    }
+  }; // end of mmap_vector
+
+} // end of namespace graphlab
+
+#endif
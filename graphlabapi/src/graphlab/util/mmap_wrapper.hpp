@@ -29,6 +29,8 @@
 #include <unistd.h>
 #include <sys/mman.h>
 #include <stdint.h>
+#include <cstring>
+#include <cerrno>
 
 #include <string>
 #include <graphlab/logger/assertions.hpp>
@@ -40,14 +42,30 @@ namespace graphlab {
      * mmaps a file into memory if pad > 0, the file will be padded so
      * that it is at least "pad" bytes if diskuncached is true, all
      * writes to the mmapped location will not be cached but will
-     * write to physical disk immediately.
+     * write to physical disk immediately.  
+     *
+     * If copy_on_write is true the file is opened read only and
+     * mapped privately: pages are read lazily and shared with other
+     * processes mapping the same file until they are written, at
+     * which point the writing process gets a private copy.  The file
+     * itself is never modified.  pad and diskuncached are ignored.
      */
     inline mmap_wrapper(std::string file, 
 			size_t pad = 0, 
-			bool diskuncached = false):
-      fname(file), fd(0), ptr(NULL), ptrlen(0) {
+			bool diskuncached = false,
+                        bool copy_on_write = false):
+      fname(file), fd(0), ptr(NULL), ptrlen(0), 
+      copy_on_write(copy_on_write) {
       advisetype = MADV_NORMAL;
       fd = 0;
+      if (copy_on_write) {
+        fd = open(file.c_str(), O_RDONLY);
+        ASSERT_MSG(fd >= 0, strerror(errno));
+        ptrlen = file_length();
+        ptr = mmap(0, ptrlen, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        ASSERT_MSG(ptr != MAP_FAILED, strerror(errno));
+        return;
+      }
       if (diskuncached) {
 #ifdef __APPLE__
         fd = open(file.c_str(), O_RDWR | O_CREAT | O_SYNC, 
@@ -72,6 +90,7 @@ namespace graphlab {
     }
   
     void extend_file_and_remap(uint64_t pad) {
+      ASSERT_FALSE(copy_on_write);
       extend_file(file_length() + pad);
       if (remap_nomove() == false) remap();
     }
@@ -137,7 +156,7 @@ namespace graphlab {
   
     inline void close() {
       if (ptr != NULL) {
-        sync_all();
+        if (!copy_on_write) sync_all();
         munmap(ptr, ptrlen);
         ::close(fd);
         ptr = NULL;
@@ -186,6 +205,7 @@ namespace graphlab {
     void* ptr;
     size_t ptrlen;
     int advisetype;
+    bool copy_on_write;
   };
 
 } // end namespace graphlab
@@ -24,7 +24,9 @@
 #ifndef GRAPHLAB_TASK_COUNT_TERMINATION_HPP
 #define GRAPHLAB_TASK_COUNT_TERMINATION_HPP
 
+#include <sched.h>
 #include <cassert>
+#include <vector>
 
 #include <graphlab/parallel/pthread_tools.hpp>
 #include <graphlab/parallel/atomic.hpp>
@@ -42,29 +44,57 @@ namespace graphlab {
    * - If the queue has no jobs, then call end_critical_section(cpuid)
    * - If (end_critical_section() returns true, the scheduler can terminate.
    * Otherwise it must loop again.
+   *
+   * When constructed with the number of cpus, an idle cpu backs off in
+   * end_critical_section(): it first spins, then yields and finally
+   * parks on an event_count until a new job is created, the last job
+   * completes or PARK_TIMEOUT_NS passes.  The backoff restarts when
+   * the cpu completes a job, so a cpu woken for a job which another
+   * cpu took goes straight back to sleep.
    */
   class task_count_termination {
     atomic<size_t> newtaskcount;
     atomic<size_t> finishedtaskcount;
     bool force_termination; //signal computation is aborted
 
+    /// Idle rounds spent spinning, then yielding, before parking
+    static const size_t SPIN_ROUNDS = 4;
+    static const size_t YIELD_ROUNDS = 8;
+    /// Bounds the sleep so other termination conditions are noticed
+    static const size_t PARK_TIMEOUT_NS = 1000000;
+
+    struct idle_state {
+      size_t rounds;
+      /// newtaskcount when the cpu last found no task
+      size_t jobs_seen;
+      char pad[64];
+      idle_state() : rounds(0), jobs_seen(0) { }
+    };
+    std::vector<idle_state> idle;
+    event_count idle_event;
+
   public:
-    task_count_termination() : newtaskcount(0), 
-                               finishedtaskcount(0), 
-                               force_termination(false) { }
+    task_count_termination(size_t ncpus = 0) : newtaskcount(0), 
+                                               finishedtaskcount(0), 
+                                               force_termination(false),
+                                               idle(ncpus) { }
     
     ~task_count_termination(){ }
 
-    void begin_critical_section(size_t cpuid) { }
+    void begin_critical_section(size_t cpuid) { 
+      if (cpuid < idle.size()) idle[cpuid].jobs_seen = newtaskcount.value;
+    }
     void cancel_critical_section(size_t cpuid)  { }
     
     bool end_critical_section(size_t cpuid) {
-      return newtaskcount.value == finishedtaskcount.value 
-        || force_termination;
+      if (done()) return true;
+      if (cpuid < idle.size()) backoff(idle[cpuid]);
+      return done();
     }
     
     void abort(){
       force_termination = true;
+      idle_event.notify_all();
     }
 
     bool is_aborted(){ return force_termination; }
@@ -72,6 +102,7 @@ namespace graphlab {
 
     void new_job() {
       newtaskcount.inc();
+      idle_event.notify_all();
     }
     
     void new_job(size_t cpuhint) {
@@ -79,10 +110,60 @@ namespace graphlab {
     }
     
     void completed_job() {
-      finishedtaskcount.inc();
-      assert(finishedtaskcount.value <= newtaskcount.value);
+      const size_t finished = finishedtaskcount.inc();
+      assert(finished <= newtaskcount.value);
+      if (finished == newtaskcount.value) idle_event.notify_all();
+    }
+
+    /** Records a job completed by cpuid and restarts its backoff */
+    void completed_job(size_t cpuid) {
+      if (cpuid < idle.size()) idle[cpuid].rounds = 0;
+      completed_job();
+    }
+
+    /** Records the completion of several jobs with one atomic add */
+    void completed_jobs(size_t cpuid, size_t njobs) {
+      if (cpuid < idle.size()) idle[cpuid].rounds = 0;
+      const size_t finished = finishedtaskcount.inc(njobs);
+      assert(finished <= newtaskcount.value);
+      if (finished == newtaskcount.value) idle_event.notify_all();
     }
     
+  private:
+    /**
+     * The finished count must be read before the new count: both only
+     * grow and finished <= new, so equality means all the jobs created
+     * up to the first read were finished.  Reading the new count first
+     * could pair a stale new count with a finished count which
+     * includes jobs created in between.
+     */
+    bool done() const {
+      const size_t finished = finishedtaskcount.value;
+      __sync_synchronize();
+      return finished == newtaskcount.value || force_termination;
+    }
+
+    void backoff(idle_state& state) {
+      ++state.rounds;
+      if (state.rounds <= SPIN_ROUNDS) {
+        for(size_t i = 0; i < (size_t(16) << state.rounds); ++i) 
+          cpu_relax();
+      } else if (state.rounds <= SPIN_ROUNDS + YIELD_ROUNDS) {
+        sched_yield();
+      } else {
+        // Registering as a waiter before re-reading the job count
+        // guarantees that a concurrent new_job() either is seen here
+        // or sees the waiter and wakes it
+        const int key = idle_event.prepare_wait();
+        if (newtaskcount.value != state.jobs_seen || done()) {
+          idle_event.cancel_wait();
+        } else {
+          idle_event.wait(key, PARK_TIMEOUT_NS);
+        }
+      }
+    }
+
+  public:
     void print() {
       std::cout << finishedtaskcount.value << " of "
                 << newtaskcount.value << std::endl;
@@ -89,6 +89,25 @@ namespace graphlab {
   }
   
   
+  static double measure_rdtsc_ticks_per_second() {
+    timer ti;
+    ti.start();
+    const unsigned long long begin = rdtsc();
+    double elapsed = 0;
+    unsigned long long end = begin;
+    while(elapsed < 0.01) {
+      elapsed = ti.current_time();
+      end = rdtsc();
+    }
+    return double(end - begin) / elapsed;
+  }
+
+  double rdtsc_ticks_per_second() {
+    static const double ticks_per_second = measure_rdtsc_ticks_per_second();
+    return ticks_per_second;
+  }
+  
+
   /**
    * Precision of deciseconds 
    */
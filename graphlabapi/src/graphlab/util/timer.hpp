@@ -25,6 +25,7 @@
 #define GRAPHLAB_TIMER_HPP
 
 #include <sys/time.h>
+#include <time.h>
 #include <stdio.h>
 
 #include <iostream>
@@ -96,6 +97,32 @@ namespace graphlab {
 
   }; // end of Timer
   
+  /**
+   * Returns the time stamp counter of the processor.  This costs a
+   * few dozen cycles and is meant for timing short sections such as
+   * a single update.  The counter of different processors may be
+   * skewed slightly, so intervals should be measured on one thread.
+   * On other architectures this falls back to a nanosecond clock.
+   */
+  inline unsigned long long rdtsc() {
+#if defined(__i386__) || defined(__x86_64__)
+    unsigned int lo, hi;
+    __asm__ __volatile__ ("rdtsc" : "=a" (lo), "=d" (hi));
+    return ((unsigned long long)hi << 32) | lo;
+#else
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif
+  }
+
+  /**
+   * Returns the number of rdtsc() ticks per second.  The rate is
+   * measured against the wall clock on the first call, which takes
+   * about 10ms.
+   */
+  double rdtsc_ticks_per_second();
+
   /**
    Returns the time since program start.
    This value is only updated once every 100ms.
@@ -0,0 +1,128 @@
+/**  
+ * Copyright (c) 2009 Carnegie Mellon University. 
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <graphlab/rpc/dc_compressor.hpp>
+#include <graphlab/rpc/dc_stream_receive_z.hpp>
+
+using namespace graphlab::dc_impl;
+
+void roundtrip(dc_compressor& c, const std::string& s) {
+  std::vector<char> out(c.max_compressed_length(s.length()) + 1);
+  size_t clen = c.compress(s.c_str(), s.length(), &(out[0]), out.size());
+  TS_ASSERT(clen > 0);
+  std::vector<char> back(s.length() + 1);
+  TS_ASSERT(c.decompress(&(out[0]), clen, &(back[0]), s.length()));
+  TS_ASSERT_EQUALS(std::string(&(back[0]), s.length()), s);
+}
+
+std::string random_string(size_t len, size_t alphabet) {
+  std::string s(len, ' ');
+  for (size_t i = 0;i < len; ++i) s[i] = char('a' + rand() % alphabet);
+  return s;
+}
+
+void test_compressor(dc_compressor& c) {
+  roundtrip(c, "");
+  roundtrip(c, "a");
+  roundtrip(c, "abcdefghijkl");
+  roundtrip(c, std::string(COMPRESSED_BLOCK_SIZE, '\0'));
+  roundtrip(c, random_string(COMPRESSED_BLOCK_SIZE, 256));
+  roundtrip(c, random_string(COMPRESSED_BLOCK_SIZE, 4));
+  // overlapping matches of every short period
+  for (size_t period = 1; period < 10; ++period) {
+    std::string unit = random_string(period, 26);
+    std::string s;
+    while (s.length() < 1000) s += unit;
+    roundtrip(c, s + random_string(17, 26));
+  }
+  // repeats far apart and long literal runs
+  std::string chunk = random_string(3000, 256);
+  roundtrip(c, chunk + random_string(40000, 256) + chunk + chunk);
+}
+
+class CompressorTestSuite: public CxxTest::TestSuite {
+ public:  
+  void test_lz_roundtrip() {
+    dc_lz_compressor c;
+    test_compressor(c);
+  }
+
+  void test_lz_ratio() {
+    dc_lz_compressor c;
+    std::string s;
+    while (s.length() < COMPRESSED_BLOCK_SIZE) s += "vertex 12345 edge 67890 ";
+    std::vector<char> out(c.max_compressed_length(s.length()));
+    size_t clen = c.compress(s.c_str(), s.length(), &(out[0]), out.size());
+    TS_ASSERT(clen > 0);
+    TS_ASSERT_LESS_THAN(clen, s.length() / 20);
+  }
+
+  void test_lz_limits() {
+    dc_lz_compressor c;
+    std::string s = random_string(10000, 256);
+    std::vector<char> out(c.max_compressed_length(s.length()));
+    // output too small
+    TS_ASSERT_EQUALS(c.compress(s.c_str(), s.length(), &(out[0]), 100), size_t(0));
+    // truncated input
+    size_t clen = c.compress(s.c_str(), s.length(), &(out[0]), out.size());
+    std::vector<char> back(s.length());
+    TS_ASSERT(!c.decompress(&(out[0]), clen / 2, &(back[0]), s.length()));
+    // wrong length
+    TS_ASSERT(!c.decompress(&(out[0]), clen, &(back[0]), s.length() - 1));
+  }
+
+  void test_factory() {
+    dc_compressor* c = make_dc_compressor("lz");
+    TS_ASSERT(c != NULL);
+    TS_ASSERT_EQUALS(std::string(c->name()), "lz");
+    delete c;
+    TS_ASSERT(make_dc_compressor("nosuchcompressor") == NULL);
+#ifdef HAS_ZLIB
+    c = make_dc_compressor("zlib");
+    TS_ASSERT(c != NULL);
+    test_compressor(*c);
+    delete c;
+#endif
+  }
+
+  void test_corrupt_block_header() {
+    const compressed_block_hdr bad[3] = {{0, 0}, 
+                                         {COMPRESSED_BLOCK_SIZE + 1, 0},
+                                         {100, 100000}};
+    for (size_t i = 0;i < 3; ++i) {
+      dc_stream_receive_z receiver(NULL, "lz");
+      const char* data = reinterpret_cast<const char*>(&bad[i]);
+      // a whole header, then a header split over two calls
+      TS_ASSERT_THROWS(receiver.incoming_data(0, data, sizeof(bad[i])), 
+                       const char*);
+      dc_stream_receive_z receiver2(NULL, "lz");
+      receiver2.incoming_data(0, data, 1);
+      TS_ASSERT_THROWS(receiver2.incoming_data(0, data + 1, 
+                                               sizeof(bad[i]) - 1), 
+                       const char*);
+    }
+  }
+};
@@ -27,7 +27,13 @@
 #include <vector>
 #include <string>
 #include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iterator>
 #include <iostream>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
 
 #include <cxxtest/TestSuite.h>
 
@@ -49,6 +55,20 @@ struct edge_data {
   size_t sum;
 };
 
+struct hot_vertex_data {
+  double value;
+  char cold[64];
+  hot_vertex_data(double value = 0) : value(value) { }
+};
+
+namespace graphlab {
+  template<> struct hot_data_traits<hot_vertex_data> {
+    BOOST_STATIC_CONSTANT(bool, enabled = true);
+    typedef double hot_type;
+    static hot_type get(const hot_vertex_data& vdata) { return vdata.value; }
+  };
+}
+
 
 
 class GraphTestSuite: public CxxTest::TestSuite {
@@ -154,8 +174,371 @@ public:
         TS_ASSERT_DIFFERS(graph.color(graph.target(e)), graph.color(i));
       }
     }
+    TS_TRACE("Testing Speculative Coloring");
+    ti.start();
+    size_t ncolors = graph.compute_coloring("speculative");
+    std::cerr << ncolors << " colors computed in " 
+              << ti.current_time() << " s" << std::endl;
+    TS_ASSERT(graph.valid_coloring());
+    for(vertex_id_type i = 0; i < num_verts; ++i) {
+      TS_ASSERT_LESS_THAN(graph.color(i), ncolors);
+      foreach(edge_id_type e, graph.out_edge_ids(i)) {
+        TS_ASSERT_DIFFERS(graph.color(graph.target(e)), graph.color(i));
+      }
+    }
+  }
+
+  void test_compact_adjacency() {
+    typedef graph<char, char> graph_type;
+    typedef graph_type::vertex_id_type vertex_id_type;
+    typedef graph_type::edge_id_type edge_id_type;
+    size_t num_verts = 1000;
+    graph_type g(num_verts);
+    g.set_compact_on_finalize(true);
+    // Each vertex points to the next 3 vertices
+    for(vertex_id_type i = 0; i < num_verts; ++i) {
+      for(size_t j = 1; j <= 3; ++j)
+        g.add_edge(i, vertex_id_type((i + j) % num_verts), char(j));
+    }
+    TS_ASSERT(!g.is_compact());
+    g.finalize();
+    TS_ASSERT(g.is_compact());
+    TS_TRACE("Checking compact adjacency");
+    for(vertex_id_type i = 0; i < num_verts; ++i) {
+      TS_ASSERT_EQUALS(g.num_in_neighbors(i), size_t(3));
+      TS_ASSERT_EQUALS(g.num_out_neighbors(i), size_t(3));
+      foreach(edge_id_type e, g.in_edge_ids(i))
+        TS_ASSERT_EQUALS(g.target(e), i);
+      foreach(edge_id_type e, g.out_edge_ids(i))
+        TS_ASSERT_EQUALS(g.source(e), i);
+      for(size_t j = 1; j <= 3; ++j) {
+        vertex_id_type nbr = vertex_id_type((i + j) % num_verts);
+        TS_ASSERT(g.find(i, nbr).first);
+        TS_ASSERT_EQUALS(g.edge_data(i, nbr), char(j));
+        TS_ASSERT(!g.find(nbr, i).first);
+      }
+    }
+    TS_TRACE("Checking save and load of a compact graph");
+    std::stringstream strm;
+    oarchive oarc(strm);
+    oarc << g;
+    strm.flush();
+    graph_type g2;
+    iarchive iarc(strm);
+    iarc >> g2;
+    TS_ASSERT(!g2.is_compact());
+    TS_ASSERT_EQUALS(g2.num_edges(), g.num_edges());
+    for(vertex_id_type i = 0; i < num_verts; ++i) {
+      TS_ASSERT_EQUALS(g2.out_vertices(i), g.out_vertices(i));
+      TS_ASSERT_EQUALS(g2.in_vertices(i), g.in_vertices(i));
+    }
+    TS_TRACE("Checking mutation after compaction");
+    vertex_id_type newv = g.add_vertex(char(0));
+    TS_ASSERT(g.is_compact());
+    TS_ASSERT_EQUALS(g.num_in_neighbors(newv), size_t(0));
+    g.add_edge(newv, 0, char(4));
+    TS_ASSERT(!g.is_compact());
+    g.finalize();
+    TS_ASSERT(g.is_compact());
+    TS_ASSERT_EQUALS(g.num_in_neighbors(0), size_t(4));
+    TS_ASSERT_EQUALS(g.edge_data(newv, 0), char(4));
+  }
+
+  void test_reordering() {
+    typedef graph<size_t, size_t> graph_type;
+    typedef graph_type::vertex_id_type vertex_id_type;
+    // make a 50x50 grid with randomly assigned vertex ids
+    size_t dim = 50;
+    std::vector<vertex_id_type> ids(dim * dim);
+    for(size_t i = 0; i < ids.size(); ++i) ids[i] = vertex_id_type(i);
+    random::shuffle(ids.begin(), ids.end());
+    graph_type g(dim * dim);
+    for(size_t i = 0; i < g.num_vertices(); ++i) g.vertex_data(i) = i;
+    for (size_t i = 0;i < dim; ++i) {
+      for (size_t j = 0;j < dim - 1; ++j) {
+        g.add_edge(ids[dim * i + j], ids[dim * i + j + 1], ids[dim * i + j]);
+        g.add_edge(ids[dim * (j + 1) + i], ids[dim * j + i], ids[dim * j + i]);
+      }
+    }
+    g.finalize();
+    const char* methods[] = {"rcm", "degree", "bfs", "metis"};
+    for(size_t m = 0; m < 4; ++m) {
+      TS_TRACE(std::string("Reordering with ") + methods[m]);
+      graph_type g2(g);
+      std::vector<vertex_id_type> perm;
+      graph_reordering::reorder(methods[m], g2, perm);
+      g2.permute_vertices(perm);
+      TS_ASSERT_EQUALS(g2.num_vertices(), g.num_vertices());
+      TS_ASSERT_EQUALS(g2.num_edges(), g.num_edges());
+      for(vertex_id_type v = 0; v < g.num_vertices(); ++v) {
+        TS_ASSERT_EQUALS(g2.vertex_data(perm[v]), g.vertex_data(v));
+      }
+      size_t bandwidth = 0;
+      for(size_t e = 0; e < g.num_edges(); ++e) {
+        vertex_id_type src = perm[g.source(e)], dst = perm[g.target(e)];
+        TS_ASSERT(g2.find(src, dst).first);
+        TS_ASSERT_EQUALS(g2.edge_data(src, dst), g.edge_data(e));
+        bandwidth = std::max(bandwidth, size_t(std::max(src, dst) - std::min(src, dst)));
+      }
+      // reverse cuthill mckee should recover a banded grid
+      if(std::string(methods[m]) == "rcm") TS_ASSERT_LESS_THAN_EQUALS(bandwidth, 2 * dim);
+    }
+  }
+
+  void test_hot_data() {
+    typedef graph<hot_vertex_data, char> graph_type;
+    typedef graph_type::vertex_id_type vertex_id_type;
+    size_t num_verts = 100;
+    graph_type g;
+    for(size_t i = 0; i < num_verts; ++i) g.add_vertex(hot_vertex_data(i));
+    for(vertex_id_type i = 0; i + 1 < num_verts; ++i) g.add_edge(i, i + 1);
+    g.finalize();
+    for(vertex_id_type i = 0; i < num_verts; ++i) 
+      TS_ASSERT_EQUALS(g.vertex_hot_data(i), double(i));
+    // The hot array is a copy which is refreshed explicitly
+    g.vertex_data(3).value = 42;
+    TS_ASSERT_EQUALS(g.vertex_hot_data(3), 3.0);
+    g.refresh_vertex_hot_data(3);
+    TS_ASSERT_EQUALS(g.vertex_hot_data(3), 42.0);
+    g.vertex_data(4).value = 43;
+    g.refresh_hot_data();
+    TS_ASSERT_EQUALS(g.vertex_hot_data(4), 43.0);
+    // and through the scope
+    general_scope<graph_type> scope(&g, 5, NULL, scope_range::EDGE_CONSISTENCY);
+    scope.vertex_data().value = 44;
+    scope.commit();
+    TS_ASSERT_EQUALS(scope.const_neighbor_vertex_hot_data(5), 44.0);
+  }
+
+  void test_snapshot() {
+    typedef graph<vertex_data, edge_data> graph_type;
+    typedef graph_type::vertex_id_type vertex_id_type;
+    typedef graph_type::edge_id_type edge_id_type;
+    size_t num_verts = 1000;
+    graph_type g(num_verts);
+    for(vertex_id_type i = 0; i < num_verts; ++i) {
+      g.vertex_data(i).bias = i;
+      for(size_t j = 1; j <= 2; ++j) {
+        edge_data edata;
+        edata.weight = i * j;
+        g.add_edge(i, vertex_id_type((i + j) % num_verts), edata);
+      }
+    }
+    g.finalize();
+    g.compute_coloring();
+    TS_TRACE("Saving snapshot");
+    g.save_snapshot("graph_test.snapshot");
+    graph_type g2;
+    g2.load_snapshot("graph_test.snapshot");
+    TS_ASSERT(g2.is_mapped());
+    TS_ASSERT(g2.is_compact());
+    TS_ASSERT_EQUALS(g2.num_vertices(), g.num_vertices());
+    TS_ASSERT_EQUALS(g2.num_edges(), g.num_edges());
+    TS_ASSERT(g2.valid_coloring());
+    for(vertex_id_type i = 0; i < num_verts; ++i) {
+      TS_ASSERT_EQUALS(g2.vertex_data(i).bias, size_t(i));
+      TS_ASSERT_EQUALS(g2.color(i), g.color(i));
+      TS_ASSERT_EQUALS(g2.in_vertices(i), g.in_vertices(i));
+      TS_ASSERT_EQUALS(g2.out_vertices(i), g.out_vertices(i));
+      foreach(edge_id_type eid, g2.out_edge_ids(i)) 
+        TS_ASSERT_EQUALS(g2.edge_data(eid).weight, g.edge_data(eid).weight);
+    }
+    TS_TRACE("Checking that modifications are private");
+    g2.vertex_data(0).bias = 42;
+    g2.add_edge(0, 500);
+    TS_ASSERT_EQUALS(g2.vertex_data(0).bias, size_t(42));
+    TS_ASSERT_EQUALS(g2.num_edges(), g.num_edges() + 1);
+    graph_type g3;
+    g3.load_snapshot("graph_test.snapshot");
+    TS_ASSERT_EQUALS(g3.vertex_data(0).bias, size_t(0));
+    TS_ASSERT_EQUALS(g3.num_edges(), g.num_edges());
+    TS_TRACE("Rejecting corrupt snapshots");
+    std::string contents;
+    {
+      std::ifstream fin("graph_test.snapshot", std::ios::binary);
+      contents.assign(std::istreambuf_iterator<char>(fin), 
+                      std::istreambuf_iterator<char>());
+    }
+    // num_vertices and num_edges are the 64 bit fields at bytes 32
+    // and 40 of the header
+    const size_t field_offsets[2] = {32, 40};
+    const uint64_t field_values[2] = {uint64_t(1) << 30, 1};
+    for(size_t i = 0; i < 2; ++i) {
+      std::string corrupt = contents;
+      memcpy(&corrupt[field_offsets[i]], &field_values[i], sizeof(uint64_t));
+      {
+        std::ofstream fout("graph_test.snapshot", std::ios::binary);
+        fout.write(corrupt.c_str(), corrupt.size());
+      }
+      graph_type g4;
+      TS_ASSERT_THROWS(g4.load_snapshot("graph_test.snapshot"), const char*);
+      TS_ASSERT_EQUALS(g4.num_vertices(), size_t(0));
+    }
+    remove("graph_test.snapshot");
+  }
+
+  void test_duplicate_edges() {
+    typedef graph<char, char> graph_type;
+    typedef graph_type::vertex_id_type vertex_id_type;
+    size_t num_verts = 1000;
+    graph_type g(num_verts);
+    for(vertex_id_type i = 0; i < num_verts; ++i) {
+      g.add_edge(i, vertex_id_type((i + 1) % num_verts));
+      g.add_edge(i, vertex_id_type((i + 2) % num_verts));
+    }
+    g.add_edge(500, 501);
+    // reported as an error, not by terminating in the parallel sort
+    TS_ASSERT_THROWS(g.finalize(), const char*);
+  }
+
+  void test_add_edges() {
+    typedef graph<vertex_data, edge_data> graph_type;
+    typedef graph_type::vertex_id_type vertex_id_type;
+    typedef graph_type::edge_id_type edge_id_type;
+    typedef graph_type::edge_type edge_type;
+    size_t num_verts = 1000;
+    // The batch is deliberately unsorted
+    std::vector<edge_type> batch;
+    for(vertex_id_type i = 0; i < num_verts; ++i) {
+      for(size_t j = 3; j > 0; --j) {
+        edge_data edata;
+        edata.weight = i * j;
+        batch.push_back(edge_type(i, vertex_id_type((i + j) % num_verts), 
+                                  edata));
+      }
+    }
+    std::random_shuffle(batch.begin(), batch.end());
+    graph_type g(num_verts);
+    foreach(const edge_type& e, batch) g.add_edge(e.source(), e.target(), e.data());
+    g.finalize();
+    for(size_t compact = 0; compact < 2; ++compact) {
+      TS_TRACE("Bulk insertion into an empty graph");
+      graph_type g2(num_verts);
+      g2.set_compact_on_finalize(compact);
+      g2.add_edges(batch.begin(), batch.end());
+      TS_ASSERT_EQUALS(g2.is_compact(), bool(compact));
+      TS_ASSERT_EQUALS(g2.num_edges(), g.num_edges());
+      for(vertex_id_type i = 0; i < num_verts; ++i) {
+        TS_ASSERT_EQUALS(g2.in_vertices(i), g.in_vertices(i));
+        TS_ASSERT_EQUALS(g2.out_vertices(i), g.out_vertices(i));
+        foreach(edge_id_type eid, g2.out_edge_ids(i)) {
+          TS_ASSERT_EQUALS(g2.edge_data(eid).weight, 
+                           g.edge_data(g.edge_id(i, g2.target(eid))).weight);
+        }
+      }
+      TS_TRACE("Bulk insertion into a non empty graph");
+      graph_type g3(num_verts);
+      g3.set_compact_on_finalize(compact);
+      g3.add_edges(batch.begin(), batch.begin() + batch.size() / 2);
+      g3.add_edge(batch.back().source(), batch.back().target(), 
+                  batch.back().data());
+      g3.add_edges(batch.begin() + batch.size() / 2, batch.end() - 1);
+      TS_ASSERT_EQUALS(g3.is_compact(), bool(compact));
+      TS_ASSERT_EQUALS(g3.num_edges(), g.num_edges());
+      for(vertex_id_type i = 0; i < num_verts; ++i) {
+        TS_ASSERT_EQUALS(g3.in_vertices(i), g.in_vertices(i));
+        TS_ASSERT_EQUALS(g3.out_vertices(i), g.out_vertices(i));
+      }
+    }
+  }
+
+  void test_add_edges_invalid() {
+    typedef graph<char, char> graph_type;
+    typedef graph_type::vertex_id_type vertex_id_type;
+    typedef graph_type::edge_type edge_type;
+    size_t num_verts = 1000;
+    std::vector<edge_type> batch;
+    for(vertex_id_type i = 0; i < num_verts; ++i) 
+      batch.push_back(edge_type(i, vertex_id_type((i + 1) % num_verts), 0));
+    graph_type g(num_verts);
+    // Rejected batches must leave the graph untouched
+    batch[500] = edge_type(500, vertex_id_type(num_verts), 0);
+    TS_ASSERT_THROWS(g.add_edges(batch.begin(), batch.end()), const char*);
+    TS_ASSERT_EQUALS(g.num_edges(), size_t(0));
+    batch[500] = edge_type(500, 500, 0);
+    TS_ASSERT_THROWS(g.add_edges(batch.begin(), batch.end()), const char*);
+    TS_ASSERT_EQUALS(g.num_edges(), size_t(0));
+    batch[500] = edge_type(499, 500, 0);
+    TS_ASSERT_THROWS(g.add_edges(batch.begin(), batch.end()), const char*);
+    TS_ASSERT_EQUALS(g.num_edges(), size_t(0));
+    TS_ASSERT_EQUALS(g.out_vertices(0).size(), size_t(0));
+    // A batch which repeats an existing edge
+    batch[500] = edge_type(500, 501, 0);
+    g.add_edges(batch.begin(), batch.begin() + 10);
+    g.add_edge(0, 2);
+    TS_ASSERT_THROWS(g.add_edges(batch.begin() + 5, batch.end()), 
+                     const char*);
+    TS_ASSERT_EQUALS(g.num_edges(), size_t(11));
+    TS_ASSERT_EQUALS(g.out_vertices(0).size(), size_t(2));
+    TS_ASSERT_EQUALS(g.in_vertices(11).size(), size_t(0));
+    g.add_edges(batch.begin() + 10, batch.end());
+    TS_ASSERT_EQUALS(g.num_edges(), num_verts + 1);
+  }
+
+  void test_loader() {
+    typedef graph<char, double> graph_type;
+    typedef graph_type::vertex_id_type vertex_id_type;
+    typedef graph_type::edge_id_type edge_id_type;
+    // Large enough to be split into several byte ranges
+    size_t num_verts = 100000;
+    {
+      std::ofstream fout("graph_test.edges");
+      fout << "# a comment\n";
+      for(size_t i = 0; i < num_verts; ++i) {
+        fout << i << "\t" << (i + 1) % num_verts << "\t" << i << "\n";
+        fout << i << " " << (i + 7) % num_verts << "\n";
+      }
+      fout << "5 5 1.0\n";
+    }
+    graph_type g;
+    TS_TRACE("Loading edge list");
+    size_t nedges = graph_loader::load("graph_test.edges", "edge_list", g, 4);
+    TS_ASSERT_EQUALS(nedges, 2 * num_verts);
+    TS_ASSERT_EQUALS(g.num_vertices(), num_verts);
+    TS_ASSERT_EQUALS(g.num_edges(), 2 * num_verts);
+    for(vertex_id_type i = 0; i < num_verts; ++i) {
+      std::pair<bool, edge_id_type> res = 
+        g.find(i, vertex_id_type((i + 1) % num_verts));
+      TS_ASSERT(res.first);
+      TS_ASSERT_EQUALS(g.edge_data(res.second), double(i));
+      res = g.find(i, vertex_id_type((i + 7) % num_verts));
+      TS_ASSERT(res.first);
+      TS_ASSERT_EQUALS(g.edge_data(res.second), 1.0);
+    }
+    TS_TRACE("Loading a directory of adjacency list shards");
+    boost::filesystem::create_directory("graph_test_shards");
+    for(size_t s = 0; s < 3; ++s) {
+      std::stringstream fname;
+      fname << "graph_test_shards/part" << s;
+      std::ofstream fout(fname.str().c_str());
+      for(size_t i = s; i < 30; i += 3) fout << i << " " << (i + 1) % 30 
+                                             << " " << (i + 2) % 30 << "\n";
+    }
+    graph_type g2;
+    graph_loader::load("graph_test_shards", "adjacency_list", g2);
+    TS_ASSERT_EQUALS(g2.num_vertices(), size_t(30));
+    TS_ASSERT_EQUALS(g2.num_edges(), size_t(60));
+    for(vertex_id_type i = 0; i < 30; ++i) {
+      TS_ASSERT_EQUALS(g2.num_out_neighbors(i), size_t(2));
+      TS_ASSERT(g2.find(i, (i + 2) % 30).first);
+    }
+    TS_TRACE("Loading a symmetric Matrix Market file");
+    {
+      std::ofstream fout("graph_test.mtx");
+      fout << "%%MatrixMarket matrix coordinate real symmetric\n"
+           << "% comment\n"
+           << "4 4 3\n"
+           << "2 1 0.5\n3 1 1.5\n4 4 2.0\n";
+    }
+    graph_type g3;
+    graph_loader::load("graph_test.mtx", "matrix_market", g3);
+    TS_ASSERT_EQUALS(g3.num_vertices(), size_t(3));
+    TS_ASSERT_EQUALS(g3.num_edges(), size_t(4));
+    TS_ASSERT_EQUALS(g3.edge_data(g3.edge_id(0, 2)), 1.5);
+    TS_ASSERT_EQUALS(g3.edge_data(g3.edge_id(2, 0)), 1.5);
+    TS_ASSERT_EQUALS(g3.edge_data(g3.edge_id(1, 0)), 0.5);
   }
-                               
+
   void test_partition() {
     typedef graph<char, char> graph_type;
     typedef graph_type::vertex_id_type vertex_id_type;
@@ -173,6 +173,261 @@ bool test_graphlab_colored(gl::core &glcore,
 }
 
 
+
+/** Hop distance from vertex 0, reading the previous superstep */
+void distance_update(gl::iscope& scope,
+                     gl::icallback& scheduler) {
+  vertex_data& curvdata = scope.vertex_data();
+  curvdata.ucount += 1;
+  int best = curvdata.val;
+  foreach(gl::edge_id eid, scope.in_edge_ids()) {
+    const vertex_data& nbrvertex =
+      scope.const_neighbor_vertex_data(scope.source(eid));
+    best = std::min(best, nbrvertex.val + 1);
+  }
+  if (best < curvdata.val) {
+    curvdata.val = best;
+    foreach(gl::edge_id eid, scope.out_edge_ids()) {
+      scheduler.add_task(gl::update_task(scope.target(eid), distance_update),
+                         1.0);
+    }
+  }
+}
+
+graphlab::glshared<int> distance_sum;
+
+void sum_sync(gl::iscope& scope, graphlab::any& acc) {
+  acc.as<int>() += scope.const_vertex_data().val;
+}
+
+void sum_unsync(gl::iscope& scope, graphlab::any& acc) {
+  acc.as<int>() -= scope.const_vertex_data().val;
+}
+
+void sum_merge(graphlab::any& dest, const graphlab::any& src) {
+  dest.as<int>() += src.as<int>();
+}
+
+void sum_apply(graphlab::any& current, const graphlab::any& acc) {
+  current.as<int>() = acc.as<int>();
+}
+
+bool test_graphlab_sync_engine(gl::core &glcore, size_t length) {
+  init_graph(glcore.graph(), length);
+  for (gl::vertex_id i = 1; i < length; ++i) {
+    glcore.graph().vertex_data(i).val = int(length);
+  }
+  glcore.set_sync(distance_sum, sum_sync, sum_apply, int(0), 0, sum_merge);
+  glcore.add_task_to_all(distance_update, 1.0);
+  glcore.start();
+  TS_ASSERT_EQUALS(glcore.engine().last_exec_status(), 
+                   graphlab::EXEC_TASK_DEPLETION);
+  // The distance travels one hop per superstep
+  TS_ASSERT_EQUALS(glcore.engine().get_metrics().
+                   get("num_supersteps").value, length);
+  TS_ASSERT_EQUALS(distance_sum.get_val(), int(length * (length - 1) / 2));
+  for (gl::vertex_id i = 0; i < length; ++i) {
+    if (glcore.graph().vertex_data(i).val != int(i)) return false;
+  }
+  return true;
+}
+
+size_t stale_reads = 0;
+
+/** 
+ * Counts supersteps, reading the neighbors through the non-const
+ * neighbor_vertex_data as jacobi does.  A neighbor has the count of
+ * the previous superstep, which equals the current one of the vertex.
+ */
+void mutable_neighbor_update(gl::iscope& scope,
+                             gl::icallback& scheduler) {
+  vertex_data& curvdata = scope.vertex_data();
+  foreach(gl::edge_id eid, scope.in_edge_ids()) {
+    vertex_data& nbrvertex = scope.neighbor_vertex_data(scope.source(eid));
+    if (nbrvertex.ucount != curvdata.ucount) 
+      __sync_fetch_and_add(&stale_reads, 1);
+  }
+  curvdata.ucount += 1;
+  if (curvdata.ucount < 10) 
+    scheduler.add_task(gl::update_task(scope.vertex(), 
+                                       mutable_neighbor_update), 1.0);
+}
+
+bool test_graphlab_sync_engine_neighbors(gl::core &glcore, size_t length) {
+  init_graph(glcore.graph(), length);
+  stale_reads = 0;
+  glcore.add_task_to_all(mutable_neighbor_update, 1.0);
+  glcore.start();
+  TS_ASSERT_EQUALS(stale_reads, size_t(0));
+  for (gl::vertex_id i = 0; i < length; ++i) {
+    if (glcore.graph().vertex_data(i).ucount != 10) return false;
+  }
+  return true;
+}
+
+void throwing_update(gl::iscope& scope,
+                     gl::icallback& scheduler) {
+  if (scope.vertex() == 7) throw "update failed";
+  scheduler.add_task(scope.vertex(), throwing_update, 1.0);
+}
+
+void throwing_sync(gl::iscope& scope, graphlab::any& acc) {
+  if (scope.vertex() == 7) throw "sync failed";
+}
+
+/** An exception in any worker must stop all workers of the superstep */
+bool test_graphlab_sync_engine_exception(gl::core &glcore, size_t length,
+                                         bool in_sync) {
+  init_graph(glcore.graph(), length);
+  if (in_sync) {
+    glcore.set_sync(distance_sum, throwing_sync, sum_apply, int(0), 0, sum_merge);
+    glcore.add_task_to_all(distance_update, 1.0);
+  } else {
+    glcore.add_task_to_all(throwing_update, 1.0);
+  }
+  const char* message = NULL;
+  try {
+    glcore.start();
+  }
+  catch(const char* c) {
+    message = c;
+  }
+  TS_ASSERT_EQUALS(glcore.engine().last_exec_status(), 
+                   graphlab::EXEC_EXCEPTION);
+  return message != NULL && 
+    std::string(message) == (in_sync ? "sync failed" : "update failed");
+}
+
+graphlab::glshared<int> ucount_sum;
+
+void ucount_sync(gl::iscope& scope, graphlab::any& acc) {
+  acc.as<int>() += scope.const_vertex_data().ucount;
+}
+
+void ucount_unsync(gl::iscope& scope, graphlab::any& acc) {
+  acc.as<int>() -= scope.const_vertex_data().ucount;
+}
+
+/** The largest sum of the update counts seen while running */
+int max_ucount_sum = 0;
+
+void ucount_apply(graphlab::any& current, const graphlab::any& acc) {
+  current.as<int>() = acc.as<int>();
+  max_ucount_sum = std::max(max_ucount_sum, acc.as<int>());
+}
+
+bool test_graphlab_incremental_sync(gl::core &glcore, size_t length) {
+  init_graph(glcore.graph(), length);
+  for (gl::vertex_id i = 1; i < length; ++i) {
+    glcore.graph().vertex_data(i).val = int(length);
+  }
+  max_ucount_sum = 0;
+  glcore.set_incremental_sync(distance_sum, sum_sync, sum_unsync, sum_apply, 
+                              int(0), 1000, sum_merge);
+  glcore.set_sync(ucount_sum, ucount_sync, ucount_apply, int(0), 
+                  1000, sum_merge);
+  glcore.add_task_to_all(distance_update, 1.0);
+  glcore.start();
+  // the incremental sum is exact without a final scan
+  TS_ASSERT_EQUALS(distance_sum.get_val(), int(length * (length - 1) / 2));
+  TS_ASSERT_EQUALS(size_t(ucount_sum.get_val()), 
+                   glcore.engine().last_update_count());
+  // the periodic syncs ran while the engine was running
+  TS_ASSERT(max_ucount_sum > 0);
+  for (gl::vertex_id i = 0; i < length; ++i) {
+    if (glcore.graph().vertex_data(i).val != int(i)) return false;
+  }
+  return true;
+}
+
+/**
+ * Propagates distances along a chain from vertex 0 only, so at most
+ * one or two tasks exist at a time and most cpus are idle.
+ */
+bool test_graphlab_sequential_chain(gl::core &glcore, size_t length) {
+  init_graph(glcore.graph(), length);
+  for (gl::vertex_id i = 1; i < length; ++i) {
+    glcore.graph().vertex_data(i).val = int(length);
+  }
+  glcore.add_task(gl::update_task(1, distance_update), 1.0);
+  glcore.start();
+  for (gl::vertex_id i = 0; i < length; ++i) {
+    if (glcore.graph().vertex_data(i).val != int(i)) return false;
+  }
+  return true;
+}
+
+/**
+ * Runs the distance propagation once while recording a trace and
+ * then twice replaying it on ncpus_replay cpus.  Every replay runs
+ * the recorded tasks, and replays on one cpu give the same vertex
+ * data.
+ */
+bool test_graphlab_replay(size_t ncpus_record, size_t ncpus_replay,
+                          size_t length) {
+  const std::string trace_file = "graphlab_test_trace.bin";
+  std::vector<int> recorded_ucount;
+  size_t recorded_updates = 0;
+  {
+    gl::core glcore;
+    glcore.set_engine_type("async(trace=" + trace_file + ")");
+    glcore.set_ncpus(ncpus_record);
+    init_graph(glcore.graph(), length);
+    for (gl::vertex_id i = 1; i < length; ++i) {
+      glcore.graph().vertex_data(i).val = int(length);
+    }
+    glcore.add_task_to_all(distance_update, 1.0);
+    glcore.start();
+    recorded_updates = glcore.engine().last_update_count();
+    TS_ASSERT_EQUALS(size_t(glcore.engine().get_metrics().
+                            get("trace_tasks").value), recorded_updates);
+    for (gl::vertex_id i = 0; i < length; ++i) {
+      recorded_ucount.push_back(glcore.graph().vertex_data(i).ucount);
+    }
+  }
+  std::vector<int> replayed_val;
+  for (size_t rep = 0; rep < 2; ++rep) {
+    gl::core glcore;
+    glcore.set_engine_type("async(replay=" + trace_file + ")");
+    glcore.set_ncpus(ncpus_replay);
+    init_graph(glcore.graph(), length);
+    for (gl::vertex_id i = 1; i < length; ++i) {
+      glcore.graph().vertex_data(i).val = int(length);
+    }
+    // ignored by the replay
+    glcore.add_task(gl::update_task(0, distance_update), 1.0);
+    glcore.start();
+    TS_ASSERT_EQUALS(glcore.engine().last_update_count(), recorded_updates);
+    for (gl::vertex_id i = 0; i < length; ++i) {
+      const vertex_data& vdata = glcore.graph().vertex_data(i);
+      TS_ASSERT_EQUALS(vdata.ucount, recorded_ucount[i]);
+      if (rep == 0) replayed_val.push_back(vdata.val);
+      else if (ncpus_replay == 1 && vdata.val != replayed_val[i]) return false;
+    }
+  }
+  // a trace of another graph is rejected before anything runs
+  {
+    gl::core glcore;
+    glcore.set_engine_type("async(replay=" + trace_file + ")");
+    glcore.set_ncpus(ncpus_replay);
+    init_graph(glcore.graph(), length / 2);
+    bool rejected = false;
+    try {
+      glcore.start();
+    }
+    catch(const char* c) {
+      rejected = true;
+    }
+    TS_ASSERT(rejected);
+    for (gl::vertex_id i = 0; i < length / 2; ++i) {
+      TS_ASSERT_EQUALS(glcore.graph().vertex_data(i).ucount, 0);
+    }
+  }
+  std::remove(trace_file.c_str());
+  return true;
+}
+
+
 class GraphlabTestSuite: public CxxTest::TestSuite {
 public:
 
@@ -181,14 +436,16 @@ public:
     global_logger().set_log_level(LOG_WARNING);
     global_logger().set_log_to_console(true);
     
-    const char* engine_types[] = {"async"};
+    const char* engine_types[] = {"async", "async(batch=8)", 
+                                  "async(locks=compact)", 
+                                  "async(locks=compact,lock_stripes=7)"};
     const char* scope_types[] = {"vertex", "edge", "full"};
-    const char* schedulers[]  = {"fifo", "multiqueue_fifo", "priority", "multiqueue_priority", "sweep", "clustered_priority"};
+    const char* schedulers[]  = {"fifo", "multiqueue_fifo", "priority", "multiqueue_priority", "sweep", "clustered_priority", "work_stealing", "relaxed_priority", "bucket_priority"};
     std::cout << "\n\n\n";
     std::cout << "engine\tscheduler\tscope\tncpus" << std::endl;
-    for (size_t e = 0;e < 1; ++e) {
+    for (size_t e = 0;e < 4; ++e) {
       for (size_t c = 0; c < 3; ++c) {
-        for (size_t s = 0;s < 6; ++s) {
+        for (size_t s = 0;s < 9; ++s) {
           for (size_t n =1; n <= 4; ++n) {
             gl::core glcore;
             glcore.set_engine_type(engine_types[e]);
@@ -241,14 +498,106 @@ public:
 
 
 
+  void test_splash(void) {
+    global_logger().set_log_level(LOG_WARNING);
+    global_logger().set_log_to_console(true);
+    const char* schedulers[] = {"splash(splash_size=10)",
+                                "splash(splash_size=10,splash_order=locality)",
+                                "splash(splash_size=100,splash_budget=8)"};
+    const char* scope_types[] = {"vertex", "edge", "full"};
+    for (size_t s = 0; s < 3; ++s) {
+      for (size_t c = 0; c < 3; ++c) {
+        for (size_t n = 1; n <= 4; ++n) {
+          gl::core glcore;
+          glcore.set_scheduler_type(schedulers[s]);
+          glcore.set_scope_type(scope_types[c]);
+          glcore.set_ncpus(n);
+          std::cout << schedulers[s] << "\t" << scope_types[c] << "\t" 
+                    << n << std::endl;
+          TS_ASSERT_EQUALS(test_graphlab_static(glcore, c != 0), true);
+        }
+      }
+    }
+  }
+
+
+  void test_sequential_chain(void) {
+    global_logger().set_log_level(LOG_WARNING);
+    global_logger().set_log_to_console(true);
+    const char* schedulers[] = {"fifo", "multiqueue_fifo", "priority", 
+                                "relaxed_priority", "bucket_priority"};
+    for (size_t s = 0; s < 5; ++s) {
+      for (size_t rep = 0; rep < 10; ++rep) {
+        gl::core glcore;
+        glcore.set_scheduler_type(schedulers[s]);
+        glcore.set_ncpus(4);
+        TS_ASSERT_EQUALS(test_graphlab_sequential_chain(glcore, 500), true);
+      }
+    }
+  }
+
+
+  void test_replay(void) {
+    global_logger().set_log_level(LOG_WARNING);
+    global_logger().set_log_to_console(true);
+    TS_ASSERT_EQUALS(test_graphlab_replay(1, 1, 1000), true);
+    TS_ASSERT_EQUALS(test_graphlab_replay(4, 1, 1000), true);
+    TS_ASSERT_EQUALS(test_graphlab_replay(4, 2, 1000), true);
+  }
+
+
+  void test_sync_engine(void) {
+    global_logger().set_log_level(LOG_WARNING);
+    global_logger().set_log_to_console(true);
+    for (size_t n = 1; n <= 4; ++n) {
+      gl::core glcore;
+      glcore.set_engine_type("sync");
+      glcore.set_ncpus(n);
+      TS_ASSERT_EQUALS(test_graphlab_sync_engine(glcore, 500), true);
+    }
+    for (size_t n = 1; n <= 4; ++n) {
+      gl::core glcore;
+      glcore.set_engine_type("sync");
+      glcore.set_ncpus(n);
+      TS_ASSERT_EQUALS(test_graphlab_sync_engine_neighbors(glcore, 500), true);
+    }
+    for (size_t n = 1; n <= 4; ++n) {
+      for (size_t in_sync = 0; in_sync < 2; ++in_sync) {
+        gl::core glcore;
+        glcore.set_engine_type("sync");
+        glcore.set_ncpus(n);
+        TS_ASSERT_EQUALS(test_graphlab_sync_engine_exception(glcore, 500, 
+                                                             in_sync), true);
+      }
+    }
+  }
+
+
+  void test_incremental_sync(void) {
+    global_logger().set_log_level(LOG_WARNING);
+    global_logger().set_log_to_console(true);
+    const char* engine_types[] = {"async", "async(sync_mode=approximate)"};
+    for (size_t e = 0; e < 2; ++e) {
+      for (size_t n = 1; n <= 4; ++n) {
+        gl::core glcore;
+        glcore.set_engine_type(engine_types[e]);
+        glcore.set_scheduler_type("fifo");
+        glcore.set_ncpus(n);
+        TS_ASSERT_EQUALS(test_graphlab_incremental_sync(glcore, 2000), true);
+      }
+    }
+  }
+
+
   void test_colored(void) {
     global_logger().set_log_level(LOG_WARNING);
     global_logger().set_log_to_console(true);
     std::cout << "\n\n\n";
     std::cout << "engine\tscheduler\tscope\tncpus\titerations" << std::endl;
-    const char* engine_types[] = {"async"};
+    const char* engine_types[] = {"async", "async(chromatic=1)",
+                                  "async(chromatic=1,batch=4)"};
     const char* scope_types[] = {"vertex", "edge", "full"};
-    for (size_t e = 0;e < 1; ++e) {
+    for (size_t e = 0;e < 3; ++e) {
       for (size_t c = 0; c < 3; ++c) {
         for (size_t n =1; n <= 4; ++n) {
           for (size_t iter = 1;iter < 4; ++iter) {
@@ -0,0 +1,78 @@
+/**  
+ * Copyright (c) 2009 Carnegie Mellon University. 
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+#include <iostream>
+#include <vector>
+#include <graphlab/util/mpi_tools.hpp>
+#include <graphlab/rpc/dc.hpp>
+#include <graphlab/rpc/dc_init_from_mpi.hpp>
+#include <graphlab/rpc/pod_array_ref.hpp>
+using namespace graphlab;
+
+/*
+ * The array is not copied into the serialization stream on the sender,
+ * and the handler reads it directly out of the receive buffer.
+ */
+void print_sum(const pod_array_ref<double>& factors) {
+  double sum = 0;
+  for (size_t i = 0;i < factors.size(); ++i) sum += factors[i];
+  std::cout << factors.size() << " factors. sum = " << sum << std::endl;
+}
+
+double dot(const pod_array_ref<double>& a, const pod_array_ref<double>& b) {
+  ASSERT_EQ(a.size(), b.size());
+  double ret = 0;
+  for (size_t i = 0;i < a.size(); ++i) ret += a[i] * b[i];
+  return ret;
+}
+
+int main(int argc, char ** argv) {
+  // init MPI
+  mpi_tools::init(argc, argv);
+  
+  if (mpi_tools::size() != 2) {
+    std::cout<< "RPC Example 8: Zero Copy Arrays\n";
+    std::cout << "Run with exactly 2 MPI nodes.\n";
+    return 0;
+  }
+
+  dc_init_param param;
+  ASSERT_TRUE(init_param_from_mpi(param));
+  global_logger().set_log_level(LOG_INFO);
+  distributed_control dc(param);
+  
+  if (dc.procid() == 0) {
+    std::vector<double> factors(100000);
+    for (size_t i = 0;i < factors.size(); ++i) factors[i] = i;
+    // factors must stay valid until remote_call returns
+    dc.remote_call(1, print_sum, pod_array_ref<double>(factors));
+    
+    std::vector<double> ones(factors.size(), 1.0);
+    double d = dc.remote_request(1, dot, 
+                                 pod_array_ref<double>(factors),
+                                 pod_array_ref<double>(ones));
+    std::cout << "dot = " << d << std::endl;
+  }
+  dc.barrier();
+  mpi_tools::finalize();
+}
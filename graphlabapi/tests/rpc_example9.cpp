@@ -0,0 +1,95 @@
+/**  
+ * Copyright (c) 2009 Carnegie Mellon University. 
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+#include <iostream>
+#include <map>
+#include <algorithm>
+#include <graphlab/util/mpi_tools.hpp>
+#include <graphlab/rpc/dc.hpp>
+#include <graphlab/rpc/dc_init_from_mpi.hpp>
+#include <graphlab/rpc/call_aggregator.hpp>
+using namespace graphlab;
+
+/*
+ * Many small "raise the priority of this key" calls are buffered into
+ * batches. Calls to a key which is still waiting to be sent keep only
+ * the highest priority.
+ */
+mutex lock;
+std::map<size_t, double> priorities;
+size_t handler_calls = 0;
+
+void raise_priority(const size_t& key, const double& priority) {
+  lock.lock();
+  double& p = priorities[key];
+  p = std::max(p, priority);
+  ++handler_calls;
+  lock.unlock();
+}
+
+void max_priority(double& a, const double& b) {
+  a = std::max(a, b);
+}
+
+int main(int argc, char ** argv) {
+  // init MPI
+  mpi_tools::init(argc, argv);
+  
+  if (mpi_tools::size() != 2) {
+    std::cout<< "RPC Example 9: Call Aggregation\n";
+    std::cout << "Run with exactly 2 MPI nodes.\n";
+    return 0;
+  }
+
+  dc_init_param param;
+  ASSERT_TRUE(init_param_from_mpi(param));
+  global_logger().set_log_level(LOG_INFO);
+  distributed_control dc(param);
+  
+  call_aggregator<size_t, double> aggregator(dc, raise_priority, max_priority);
+  dc.barrier();
+  
+  if (dc.procid() == 0) {
+    for (size_t i = 0;i < 100000; ++i) {
+      aggregator.call(1, i % 1000, double(i % 7919));
+    }
+  }
+  // all calls must be sent before the barrier
+  aggregator.flush();
+  dc.full_barrier();
+  
+  if (dc.procid() == 0) {
+    std::cout << aggregator.calls() << " calls. " 
+              << aggregator.combined_calls() << " combined. "
+              << aggregator.batches_sent() << " batches." << std::endl;
+  }
+  else {
+    double sum = 0;
+    std::map<size_t, double>::const_iterator iter = priorities.begin();
+    for (; iter != priorities.end(); ++iter) sum += iter->second;
+    std::cout << priorities.size() << " keys. " 
+              << handler_calls << " handler calls. "
+              << "sum of priorities = " << sum << std::endl;
+  }
+  dc.barrier();
+  mpi_tools::finalize();
+}
@@ -2,6 +2,7 @@
 #include <graphlab/parallel/pthread_tools.hpp>
 #include <graphlab/parallel/thread_pool.hpp>
 #include <graphlab/parallel/thread_flip_flop.hpp>
+#include <graphlab/parallel/numa_tools.hpp>
 #include <graphlab/logger/assertions.hpp>
 #include <graphlab/util/timer.hpp>
 #include <boost/bind.hpp>
@@ -207,6 +208,82 @@ void adaptive_mutex_test() {
 
 
 
+/**
+ * Each thread takes random locks out of a table, a write lock one
+ * time in eight, and checks that no other thread writes while the
+ * lock is held.
+ */
+template<typename RWLock>
+void rwlock_table_helper(std::vector<RWLock>* locks, 
+                         std::vector<size_t>* values, 
+                         size_t seed, size_t iterations) {
+  size_t r = seed;
+  for(size_t i = 0; i < iterations; ++i) {
+    r = r * 1103515245 + 12345;
+    const size_t idx = (r >> 8) % locks->size();
+    if ((r >> 4) % 8 == 0) {
+      (*locks)[idx].writelock();
+      (*values)[idx]++;
+      (*locks)[idx].unlock();
+    } else {
+      (*locks)[idx].readlock();
+      const size_t val = (*values)[idx];
+      ASSERT_EQ((*values)[idx], val);
+      (*locks)[idx].unlock();
+    }
+  }
+}
+
+/**
+ * Returns the number of lock acquisitions per second of nthreads
+ * threads working on a table of nlocks locks and checks that the
+ * write locks were exclusive.
+ */
+template<typename RWLock>
+double rwlock_table_throughput(size_t nthreads, size_t nlocks, 
+                               size_t iterations) {
+  std::vector<RWLock> locks(nlocks);
+  std::vector<size_t> values(nlocks, 0);
+  thread_pool pool(nthreads);
+  timer ti;
+  ti.start();
+  for (size_t i = 0; i < nthreads; ++i) {
+    pool.launch(boost::bind(rwlock_table_helper<RWLock>, 
+                            &locks, &values, i + 1, iterations));
+  }
+  pool.join();
+  const double runtime = ti.current_time();
+  // recount the writes
+  size_t nwrites = 0;
+  for (size_t i = 0; i < nthreads; ++i) {
+    size_t r = i + 1;
+    for(size_t j = 0; j < iterations; ++j) {
+      r = r * 1103515245 + 12345;
+      nwrites += ((r >> 4) % 8 == 0);
+    }
+  }
+  size_t total = 0;
+  for (size_t i = 0; i < nlocks; ++i) total += values[i];
+  TS_ASSERT_EQUALS(total, nwrites);
+  return (nthreads * iterations) / std::max(runtime, 1e-6);
+}
+
+
+/** Sleeps on the event until *flag is set */
+void event_count_waiter(event_count* event, volatile bool* flag,
+                        atomic<size_t>* woken) {
+  while(!*flag) {
+    const int key = event->prepare_wait();
+    if (*flag) {
+      event->cancel_wait();
+      break;
+    }
+    event->wait(key, 2000000000);
+  }
+  woken->inc();
+}
+
+
 class ThreadToolsTestSuite : public CxxTest::TestSuite {
 public:
   // void test_thread_group_exception(void) {
@@ -225,4 +302,84 @@ public:
     adaptive_mutex_test();
   }
 
+  void test_numa_map() {
+    std::vector<size_t> cpus;
+    numa_topology::parse_cpulist("0-2,8,10-11", cpus);
+    TS_ASSERT_EQUALS(cpus.size(), size_t(6));
+    TS_ASSERT_EQUALS(cpus[3], size_t(8));
+    TS_ASSERT_EQUALS(cpus[5], size_t(11));
+    // two nodes with two cpus each
+    std::vector< std::vector<size_t> > node_cpus(2);
+    numa_topology::parse_cpulist("0,2", node_cpus[0]);
+    numa_topology::parse_cpulist("1,3", node_cpus[1]);
+    numa_topology topology(node_cpus);
+    numa_map map(3, 10, topology);
+    TS_ASSERT_EQUALS(map.num_nodes(), size_t(2));
+    TS_ASSERT_EQUALS(map.worker_node(0), size_t(0));
+    TS_ASSERT_EQUALS(map.worker_node(1), size_t(0));
+    TS_ASSERT_EQUALS(map.worker_node(2), size_t(1));
+    TS_ASSERT_EQUALS(map.worker_cpu(0), size_t(0));
+    TS_ASSERT_EQUALS(map.worker_cpu(1), size_t(2));
+    TS_ASSERT_EQUALS(map.worker_cpu(2), size_t(1));
+    TS_ASSERT_EQUALS(map.vertex_begin(0), size_t(0));
+    TS_ASSERT_EQUALS(map.vertex_begin(1), size_t(5));
+    TS_ASSERT_EQUALS(map.vertex_begin(2), size_t(10));
+    for(size_t v = 0; v < 10; ++v) 
+      TS_ASSERT_EQUALS(map.vertex_node(v), size_t(v < 5 ? 0 : 1));
+    // a single worker only uses one node
+    TS_ASSERT_EQUALS(numa_map(1, 10, topology).num_nodes(), size_t(1));
+  }
+
+  void test_compact_rwlock() {
+    TS_ASSERT_EQUALS(sizeof(compact_rwlock), size_t(4));
+    compact_rwlock lock;
+    lock.readlock();
+    TS_ASSERT(lock.try_readlock());
+    TS_ASSERT(!lock.try_writelock());
+    lock.unlock();
+    lock.rdunlock();
+    TS_ASSERT(lock.try_writelock());
+    TS_ASSERT(!lock.try_readlock());
+    TS_ASSERT(!lock.try_writelock());
+    lock.unlock();
+    TS_ASSERT(lock.try_readlock());
+    lock.unlock();
+  }
+
+  void test_event_count() {
+    const size_t nthreads = 4;
+    event_count event;
+    volatile bool flag = false;
+    atomic<size_t> woken(0);
+    thread_pool pool(nthreads);
+    for (size_t i = 0; i < nthreads; ++i) {
+      pool.launch(boost::bind(event_count_waiter, &event, &flag, &woken));
+    }
+    while(event.num_waiters() < nthreads) sched_yield();
+    timer ti;
+    ti.start();
+    flag = true;
+    event.notify_all();
+    pool.join();
+    TS_ASSERT_EQUALS(woken.value, nthreads);
+    // the waiters were woken rather than timing out
+    TS_ASSERT_LESS_THAN(ti.current_time(), 1.0);
+  }
+
+  void test_rwlock_throughput() {
+    const size_t nthreads = 4;
+    const size_t iterations = 1000000;
+    std::cout << std::endl << "locks\trwlock\tcompact_rwlock" << std::endl;
+    // from heavy contention to a table with one lock per vertex
+    const size_t nlocks[] = {1, 64, 1 << 20};
+    for (size_t i = 0; i < 3; ++i) {
+      std::cout << nlocks[i] << "\t"
+                << rwlock_table_throughput<rwlock>(nthreads, nlocks[i], 
+                                                   iterations) << "\t"
+                << rwlock_table_throughput<compact_rwlock>(nthreads, nlocks[i], 
+                                                           iterations) 
+                << std::endl;
+    }
+  }
+
 };